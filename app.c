@@ -21,14 +21,13 @@
 #include <asterisk/version.h>	/* ASTERISK_VERSION_NUM */
 
 #include "app.h"		/* app_register() app_unregister() */
-#include "chan_dongle.h"	/* struct pvt */
+#include "chan_dongle.h"	/* resource_ready() */
 #include "helpers.h"		/* send_sms() ITEMS_OF() */
 
 struct ast_channel;
 
 static int app_status_exec (struct ast_channel* channel, const char* data)
 {
-	struct pvt * pvt;
 	char * parse;
 	int stat;
 	char status[2];
@@ -54,11 +53,10 @@ static int app_status_exec (struct ast_channel* channel, const char* data)
 	}
 
 	/* TODO: including options number */
-	pvt = find_device_by_resource(args.resource, 0, NULL, &exists);
-	if(pvt)
+	/* from published ready state without lock of devices */
+	if(resource_ready(args.resource, &exists))
 	{
 		/* ready for outgoing call */
-		ast_mutex_unlock (&pvt->lock);
 		stat = 2;
 	}
 	else
@@ -27,7 +27,7 @@
 #include "at_queue.h"
 #include "char_conv.h"			/* char_to_hexstr_7bit() */
 #include "chan_dongle.h"		/* struct pvt */
-#include "pdu.h"			/* build_pdu() */
+#include "pdu.h"			/* pdu_split() pdu_build_part() pdu_parse_sca() */
 
 static const char cmd_at[] 	 = "AT\r";
 static const char cmd_chld1x[]   = "AT+CHLD=1%d\r";
@@ -136,6 +136,8 @@ EXPORT_DEF int at_enque_initialization(struct cpvt* cpvt, at_cmd_t from_command)
 	static const char cmd22[] = "AT+CPMS=\"ME\",\"ME\",\"ME\"\r";
 	static const char cmd23[] = "AT+CNMI=2,1,0,0,0\r";
 	static const char cmd24[] = "AT+CSQ\r";
+	static const char cmd25[] = "AT+CSMS=1\r";
+	static const char cmd26[] = "AT+CNMI=2,2,0,0,0\r";
 
 	static const at_queue_cmd_t st_cmds[] = {
 		ATQ_CMD_DECLARE_ST(CMD_AT, cmd_at),
@@ -166,6 +168,7 @@ EXPORT_DEF int at_enque_initialization(struct cpvt* cpvt, at_cmd_t from_command)
 		ATQ_CMD_DECLARE_STI(CMD_AT_CSCS, cmd21),	/* UCS-2 text encoding */
 
 		ATQ_CMD_DECLARE_ST(CMD_AT_CPMS, cmd22),		/* SMS Storage Selection */
+		ATQ_CMD_DECLARE_STI(CMD_AT_CSMS, cmd25),	/* optional, phase 2+ messaging service, +CMT acknowledged by AT+CNMA */
 			/* pvt->initialized = 1 after successful of CMD_AT_CNMI */
 		ATQ_CMD_DECLARE_ST(CMD_AT_CNMI, cmd23),		/* New SMS Notification Setting +CNMI=[<mode>[,<mt>[,<bm>[,<ds>[,<bfr>]]]]] */
 		ATQ_CMD_DECLARE_ST(CMD_AT_CSQ, cmd24),		/* Query Signal quality */
@@ -176,8 +179,12 @@ EXPORT_DEF int at_enque_initialization(struct cpvt* cpvt, at_cmd_t from_command)
 	char * ptmp1 = NULL;
 	char * ptmp2 = NULL;
 	pvt_t * pvt = cpvt->pvt;
+	int direct = CONF_SHARED(pvt, smsdirect) && CONF_SHARED(pvt, smsaspdu) && !CONF_SHARED(pvt, disablesms);
 	at_queue_cmd_t cmds[ITEMS_OF(st_cmds)];
 
+	if(from_command == CMD_AT && CONF_SHARED(pvt, smsdirect) && !CONF_SHARED(pvt, smsaspdu))
+		ast_log(LOG_WARNING, "[%s] smsdirect require smsaspdu, incoming SMS stored on SIM\n", PVT_ID(pvt));
+
 	/* customize list */
 	for(in = out = 0; in < ITEMS_OF(st_cmds); in++)
 	{
@@ -193,6 +200,8 @@ EXPORT_DEF int at_enque_initialization(struct cpvt* cpvt, at_cmd_t from_command)
 			continue;
 		if(st_cmds[in].cmd == CMD_AT_U2DIAG && CONF_SHARED(pvt, u2diag) == -1)
 			continue;
+		if(st_cmds[in].cmd == CMD_AT_CSMS && !direct)
+			continue;
 
 		memcpy(&cmds[out], &st_cmds[in], sizeof(st_cmds[in]));
 
@@ -210,6 +219,12 @@ EXPORT_DEF int at_enque_initialization(struct cpvt* cpvt, at_cmd_t from_command)
 				goto failure;
 			ptmp2 = cmds[out].data;
 		}
+		else if(cmds[out].cmd == CMD_AT_CNMI && direct)
+		{
+			/* new messages routed to TE as +CMT without storage */
+			cmds[out].data = (char *)cmd26;
+			cmds[out].length = STRLEN(cmd26);
+		}
 		if(cmds[out].cmd == from_command)
 			begin = out;
 		out++;
@@ -241,17 +256,15 @@ EXPORT_DEF int at_enque_cops (struct cpvt* cpvt)
 }
 
 
-/* SMS sending */
-EXPORT_DEF int at_enque_pdu(struct cpvt * cpvt, const char * pdu, attribute_unused const char * u1, attribute_unused unsigned u2, attribute_unused int u3, void ** id)
+#/* fill AT+CMGS and PDU commands of at_cmd[2] */
+static int at_fill_pdu(at_queue_cmd_t * at_cmd, const char * pdu, size_t length)
 {
-	char * ptr = (char *) pdu;
-	char buf[8+25+1];
-	at_queue_cmd_t at_cmd[] = {
+	static const at_queue_cmd_t cmds[] = {
 		{ CMD_AT_CMGS,    RES_SMS_PROMPT, ATQ_CMD_FLAG_DEFAULT, { ATQ_CMD_TIMEOUT_2S, 0}  , NULL, 0 },
 		{ CMD_AT_SMSTEXT, RES_OK,         ATQ_CMD_FLAG_DEFAULT, { ATQ_CMD_TIMEOUT_40S, 0} , NULL, 0 }
 		};
-
-	size_t length = strlen(pdu);
+	char * ptr = (char *) pdu;
+	char buf[8+25+1];
 	size_t pdulen = length;
 
 	int scalen = pdu_parse_sca(&ptr, &pdulen);
@@ -261,6 +274,7 @@ EXPORT_DEF int at_enque_pdu(struct cpvt * cpvt, const char * pdu, attribute_unus
 		return -EINVAL;
 	}
 
+	memcpy(at_cmd, cmds, sizeof(cmds));
 	at_cmd[1].data = ast_malloc(length + 2);
 	if(!at_cmd[1].data)
 	{		
@@ -280,7 +294,18 @@ EXPORT_DEF int at_enque_pdu(struct cpvt * cpvt, const char * pdu, attribute_unus
 		ast_free(at_cmd[1].data);
 		return -ENOMEM;		
 	}
-			
+
+	return 0;
+}
+
+/* SMS sending */
+EXPORT_DEF int at_enque_pdu(struct cpvt * cpvt, const char * pdu, attribute_unused const char * u1, attribute_unused unsigned u2, attribute_unused int u3, void ** id)
+{
+	at_queue_cmd_t at_cmd[2];
+	int res = at_fill_pdu(at_cmd, pdu, strlen(pdu));
+
+	if(res)
+		return res;
 /*		ast_debug (5, "[%s] PDU Head '%s'\n", PVT_ID(pvt), buf);
 		ast_debug (5, "[%s] PDU Body '%s'\n", PVT_ID(pvt), at_cmd[1].data);
 */
@@ -295,6 +320,19 @@ EXPORT_DEF int at_enque_pdu(struct cpvt * cpvt, const char * pdu, attribute_unus
  */
 
 EXPORT_DEF int at_enque_sms (struct cpvt* cpvt, const char* destination, const char* msg, unsigned validity_minutes, int report_req, void ** id)
+{
+	return at_enque_sms_ref (cpvt, destination, msg, validity_minutes, report_req, NULL, id);
+}
+
+/*!
+ * \brief Enque an SMS message, parts of concatenated SMS from first not sent
+ * \param cpvt -- cpvt structure
+ * \param number -- the destination of the message
+ * \param msg -- utf-8 encoded message
+ * \param ref -- reference kept over attempts, assigned by first attempt, NULL for new reference
+ */
+
+EXPORT_DEF int at_enque_sms_ref (struct cpvt* cpvt, const char* destination, const char* msg, unsigned validity_minutes, int report_req, at_sms_ref_t * ref, void ** id)
 {
 	ssize_t res;
 	char buf[1024] = "AT+CMGS=\"";
@@ -308,27 +346,74 @@ EXPORT_DEF int at_enque_sms (struct cpvt* cpvt, const char* destination, const c
 
 	if(pvt->use_pdu)
 	{
+		pdu_parts_t parts;
+		at_queue_cmd_t pdu_cmds[PDU_MAX_PARTS * 2];
+		unsigned part;
+		unsigned first = 0;
+		unsigned reference;
+
 		/* set default validity period */
 		if(validity_minutes <= 0)
 			validity_minutes = 3 * 24 * 60;
-/*		res = pdu_build(pdu_buf, sizeof(pdu_buf), pvt->sms_scenter, destination, msg, validity_minutes, report_req);
-*/
-		res = pdu_build(pdu_buf, sizeof(pdu_buf), "", destination, msg, validity_minutes, report_req);
-		if(res <= 0)
+
+		/* retry split as first attempt, parts already sent must not change */
+		res = pdu_split(msg, ref && ref->assigned ? ref->ref16 : CONF_SHARED(pvt, smsref16), &parts);
+		if(res < 0)
+		{
+			ast_verb (3, "[%s] SMS Message too long, PDU has limit %d parts\n", PVT_ID(pvt), PDU_MAX_PARTS);
+			ast_log (LOG_WARNING, "[%s] SMS Message too long, PDU has limit %d parts\n", PVT_ID(pvt), PDU_MAX_PARTS);
+			return res;
+		}
+
+		/* all parts in one task, so parts of concatenated SMS not interleaved with other messages */
+		if(ref && ref->assigned)
+		{
+			reference = ref->ref;
+			first = ref->sent < parts.count ? ref->sent : 0;
+		}
+		else
 		{
-			if(res == -E2BIG)
+			reference = ++pvt->sms_ref;
+			if(ref)
+			{
+				ref->ref = reference;
+				ref->ref16 = parts.ref16;
+				ref->sent = 0;
+				ref->assigned = 1;
+			}
+		}
+		for(part = first; part < parts.count; ++part)
+		{
+/*			res = pdu_build_part(pdu_buf, sizeof(pdu_buf), pvt->sms_scenter, destination, msg, validity_minutes, report_req, &parts, part, reference);
+*/
+			res = pdu_build_part(pdu_buf, sizeof(pdu_buf), "", destination, msg, validity_minutes, report_req, &parts, part, reference);
+			if(res > (int)(sizeof(pdu_buf) - 2))
+				res = -1;
+			else if(res > 0)
+				res = at_fill_pdu(&pdu_cmds[(part - first) * 2], pdu_buf, res);
+			else if(res == 0)
+				res = -1;
+			else if(res == -E2BIG)
 			{
 			ast_verb (3, "[%s] SMS Message too long, PDU has limit 140 octets\n", PVT_ID(pvt));
 			ast_log (LOG_WARNING, "[%s] SMS Message too long, PDU has limit 140 octets\n", PVT_ID(pvt));
 			}
-			/* TODO: complain on other errors */
-			return res;
-		}
 
-		if(res > (int)(sizeof(pdu_buf) - 2))
-			return -1;
+			if(res < 0)
+			{
+				/* TODO: complain on other errors */
+				while(part-- > first)
+				{
+					ast_free(pdu_cmds[(part - first) * 2].data);
+					ast_free(pdu_cmds[(part - first) * 2 + 1].data);
+				}
+				return res;
+			}
+		}
+		if(parts.count > 1)
+			ast_debug (1, "[%s] SMS message splitted to %u parts with reference %u, send from part %u\n", PVT_ID(pvt), parts.count, reference & (parts.ref16 ? 0xFFFF : 0xFF), first + 1);
 
-		return at_enque_pdu(cpvt, pdu_buf, NULL, 0, 0, id);
+		return at_queue_insert_task(cpvt, pdu_cmds, (parts.count - first) * 2, 0, (struct at_queue_task **)id);
 	}
 	else
 	{
@@ -360,7 +445,7 @@ EXPORT_DEF int at_enque_sms (struct cpvt* cpvt, const char* destination, const c
 			/* message limit in 178 octet of TPDU (w/o SCA) Headers: Type(1)+MR(1)+DA(3..12)+PID(1)+DCS(1)+VP(0,1,7)+UDL(1) = 8..24 (usually 14)  */
 			if(res > 70)
 			{
-				ast_log (LOG_ERROR, "[%s] SMS message too long, 70 symbols max\n", PVT_ID(pvt));
+				ast_log (LOG_ERROR, "[%s] SMS message too long, 70 symbols max, long messages require smsaspdu\n", PVT_ID(pvt));
 				return -4;
 			}
 
@@ -379,7 +464,7 @@ EXPORT_DEF int at_enque_sms (struct cpvt* cpvt, const char* destination, const c
 		{
 			if(res > 140)
 			{
-				ast_log (LOG_ERROR, "[%s] SMS message too long, 140 symbols max\n", PVT_ID(pvt));
+				ast_log (LOG_ERROR, "[%s] SMS message too long, 140 symbols max, long messages require smsaspdu\n", PVT_ID(pvt));
 				return -4;
 			}
 
@@ -744,6 +829,59 @@ EXPORT_DEF int at_enque_retrive_sms (struct cpvt* cpvt, int index, int delete)
 	return at_queue_insert (cpvt, cmds, cmdsno, 0);
 }
 
+/*!
+ * \brief Enque reading of all unread SMS in store by one AT+CMGL
+ * \param cpvt -- cpvt structure
+ * \param delete -- if non-zero also enque delete of all read messages in store after listing
+ * \return 0 on success
+ */
+EXPORT_DEF int at_enque_list_sms (struct cpvt* cpvt, int delete)
+{
+	static const char cmd_pdu[] = "AT+CMGL=0\r";
+	static const char cmd_text[] = "AT+CMGL=\"REC UNREAD\"\r";
+	static const char cmd_delete[] = "AT+CMGD=1,1\r";
+	at_queue_cmd_t cmds[] = {
+		ATQ_CMD_DECLARE_STFT(CMD_AT_CMGL, RES_OK, cmd_pdu, ATQ_CMD_FLAG_DEFAULT, ATQ_CMD_TIMEOUT_15S, 0),
+		/* listed messages become read, delete all read by one command */
+		ATQ_CMD_DECLARE_STFT(CMD_AT_CMGD, RES_OK, cmd_delete, ATQ_CMD_FLAG_DEFAULT, ATQ_CMD_TIMEOUT_10S, 0),
+		};
+
+	if(!cpvt->pvt->use_pdu)
+	{
+		cmds[0].data = (char *)cmd_text;
+		cmds[0].length = STRLEN(cmd_text);
+	}
+
+	return at_queue_insert_const(cpvt, cmds, delete ? 2 : 1, 0);
+}
+
+/*!
+ * \brief Enque acknowledgement of SMS received as +CMT
+ * \param cpvt -- cpvt structure
+ * \return 0 on success
+ */
+EXPORT_DEF int at_enque_cnma (struct cpvt* cpvt)
+{
+	static const char cmd[] = "AT+CNMA\r";
+	static const at_queue_cmd_t at_cmd = ATQ_CMD_DECLARE_STI(CMD_AT_CNMA, cmd);
+
+	/* network wait for acknowledgement few seconds, run right after current task or current part of SMS */
+	return at_queue_insert_const(cpvt, &at_cmd, 1, 1);
+}
+
+/*!
+ * \brief Enque restore of direct SMS delivery after acknowledgement rejected
+ * \param cpvt -- cpvt structure
+ * \return 0 on success
+ */
+EXPORT_DEF int at_enque_cnmi (struct cpvt* cpvt)
+{
+	static const char cmd[] = "AT+CNMI=2,2,0,0,0\r";
+	static const at_queue_cmd_t at_cmd = ATQ_CMD_DECLARE_ST(CMD_AT_CNMI, cmd);
+
+	return at_queue_insert_const(cpvt, &at_cmd, 1, 1);
+}
+
 /*!
  * \brief Enque AT+CHLD1x or AT+CHUP hangup command
  * \param cpvt -- channel_pvt structure
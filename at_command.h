@@ -69,7 +69,10 @@ typedef enum {
 	CMD_AT_CHLD_2x,
 	CMD_AT_CHLD_2,
 	CMD_AT_CHLD_3,
-	CMD_AT_CLCC
+	CMD_AT_CLCC,
+	CMD_AT_CSMS,
+	CMD_AT_CNMA,
+	CMD_AT_CMGL
 } at_cmd_t;
 
 /*!
@@ -138,12 +141,24 @@ INLINE_DECL const char* at_cmd2str (at_cmd_t cmd)
 		"AT+CHLD=2x",
 		"AT+CHLD=2",
 		"AT+CHLD=3",
-		"AT+CLCC"
+		"AT+CLCC",
+		"AT+CSMS",
+		"AT+CNMA",
+		"AT+CMGL"
 	};
 	return enum2str_def(cmd, cmds, ITEMS_OF(cmds), "UNDEFINED");
 }
 
 
+/* reference of concatenated SMS kept over attempts, send resumed from first part not sent */
+typedef struct at_sms_ref
+{
+	unsigned		ref;				/*!< reference number of concatenated SMS */
+	unsigned		sent;				/*!< parts accepted by network */
+	unsigned		ref16:1;			/*!< 16 bit reference number in UDH */
+	unsigned		assigned:1;			/*!< ref and ref16 set by first attempt */
+} at_sms_ref_t;
+
 struct cpvt;
 
 EXPORT_DECL const char* at_cmd2str (at_cmd_t cmd);
@@ -151,6 +166,7 @@ EXPORT_DECL int at_enque_initialization(struct cpvt * cpvt, at_cmd_t from_comman
 EXPORT_DECL int at_enque_ping (struct cpvt * cpvt);
 EXPORT_DECL int at_enque_cops (struct cpvt * cpvt);
 EXPORT_DECL int at_enque_sms (struct cpvt * cpvt, const char * number, const char * msg, unsigned validity_min, int report_req, void ** id);
+EXPORT_DECL int at_enque_sms_ref (struct cpvt * cpvt, const char * number, const char * msg, unsigned validity_min, int report_req, at_sms_ref_t * ref, void ** id);
 EXPORT_DECL int at_enque_pdu (struct cpvt * cpvt, const char * pdu, attribute_unused const char *, attribute_unused unsigned, attribute_unused int, void ** id);
 EXPORT_DECL int at_enque_ussd (struct cpvt * cpvt, const char * code, attribute_unused const char *, attribute_unused unsigned, attribute_unused int, void ** id);
 EXPORT_DECL int at_enque_dtmf (struct cpvt * cpvt, char digit);
@@ -160,6 +176,9 @@ EXPORT_DECL int at_enque_dial(struct cpvt * cpvt, const char * number, int clir)
 EXPORT_DECL int at_enque_answer(struct cpvt * cpvt);
 EXPORT_DECL int at_enque_user_cmd(struct cpvt * cpvt, const char * input);
 EXPORT_DECL int at_enque_retrive_sms(struct cpvt * cpvt, int index, int delete);
+EXPORT_DECL int at_enque_list_sms(struct cpvt * cpvt, int delete);
+EXPORT_DECL int at_enque_cnma(struct cpvt * cpvt);
+EXPORT_DECL int at_enque_cnmi(struct cpvt * cpvt);
 EXPORT_DECL int at_enque_hangup (struct cpvt * cpvt, int call_idx);
 EXPORT_DECL int at_enque_volsync (struct cpvt * cpvt);
 EXPORT_DECL int at_enque_clcc (struct cpvt * cpvt);
@@ -0,0 +1,270 @@
+/*
+   Copyright (C) 2009 - 2010
+
+   Artem Makhutov <artem@makhutov.org>
+   http://www.makhutov.org
+
+   Dmitry Vagin <dmitry2004@yandex.ru>
+
+   Copyright (C) 2010 - 2011
+   bg <bg_one@mail.ru>
+*/
+/*
+   Split of modem output to responses and classification of responses.
+   Free from asterisk runtime for use by tools/atreplay.
+*/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <sys/types.h>
+#include <sys/uio.h>			/* struct iovec */
+#include <string.h>			/* memmove() strcasecmp() */
+
+#include "at_read.h"			/* at_read_result_iov() at_read_result_classification() */
+#include "at_response.h"		/* at_responses at_res2str() */
+#include "ringbuffer.h"
+#include "mutils.h"			/* STRLEN() ITEMS_OF() */
+
+#define DEF_STR(str)	str,STRLEN(str)
+
+/* magic!!! must be in same order as elements of enums in at_res_t */
+static const at_response_t at_responses_list[] = {
+	{ RES_PARSE_ERROR,"PARSE ERROR", 0, 0 },
+	{ RES_UNKNOWN,"UNKNOWN", 0, 0 },
+
+	{ RES_BOOT,"^BOOT",DEF_STR("^BOOT:") },
+	{ RES_BUSY,"BUSY",DEF_STR("BUSY\r") },
+	{ RES_CEND,"^CEND",DEF_STR("^CEND:") },
+
+	{ RES_CMGR, "+CMGR",DEF_STR("+CMGR:") },
+	{ RES_CMS_ERROR, "+CMS ERROR",DEF_STR("+CMS ERROR:") },
+	{ RES_CMTI, "+CMTI",DEF_STR("+CMTI:") },
+	{ RES_CNUM, "+CNUM",DEF_STR("+CNUM:") },		/* and "ERROR+CNUM:" */
+
+	{ RES_CONF,"^CONF",DEF_STR("^CONF:") },
+	{ RES_CONN,"^CONN",DEF_STR("^CONN:") },
+	{ RES_COPS,"+COPS",DEF_STR("+COPS:") },
+	{ RES_CPIN,"+CPIN",DEF_STR("+CPIN:") },
+
+	{ RES_CREG,"+CREG",DEF_STR("+CREG:") },
+	{ RES_CSQ,"+CSQ",DEF_STR("+CSQ:") },
+	{ RES_CSSI,"+CSSI",DEF_STR("+CSSI:") },
+	{ RES_CSSU,"+CSSU",DEF_STR("+CSSU:") },
+
+	{ RES_CUSD,"+CUSD",DEF_STR("+CUSD:") },
+	{ RES_ERROR,"ERROR",DEF_STR("ERROR\r") },		/* and "COMMAND NOT SUPPORT\r" */
+	{ RES_MODE,"^MODE",DEF_STR("^MODE:") },
+	{ RES_NO_CARRIER,"NO CARRIER",DEF_STR("NO CARRIER\r") },
+
+	{ RES_NO_DIALTONE,"NO DIALTONE",DEF_STR("NO DIALTONE\r") },
+	{ RES_OK,"OK",DEF_STR("OK\r") },
+	{ RES_ORIG,"^ORIG",DEF_STR("^ORIG:") },
+	{ RES_RING,"RING",DEF_STR("RING\r") },
+
+	{ RES_RSSI,"^RSSI",DEF_STR("^RSSI:") },
+	{ RES_SMMEMFULL,"^SMMEMFULL",DEF_STR("^SMMEMFULL:") },
+	{ RES_SMS_PROMPT,"> ",DEF_STR("> ") },
+	{ RES_SRVST,"^SRVST",DEF_STR("^SRVST:") },
+
+	{ RES_CVOICE,"^CVOICE",DEF_STR("^CVOICE:") },
+	{ RES_CMGS,"+CMGS",DEF_STR("+CMGS:") },
+	{ RES_CPMS,"+CPMS",DEF_STR("+CPMS:") },
+	{ RES_CSCA,"+CSCA",DEF_STR("+CSCA:") },
+
+	{ RES_CLCC,"+CLCC", DEF_STR("+CLCC:") },
+	{ RES_CCWA,"+CCWA", DEF_STR("+CCWA:") },
+	{ RES_CMT,"+CMT", DEF_STR("+CMT:") },
+	{ RES_CMGL,"+CMGL", DEF_STR("+CMGL:") },
+
+	/* duplicated response undef other id */
+	{ RES_CNUM, "+CNUM",DEF_STR("ERROR+CNUM:") },
+	{ RES_ERROR,"ERROR",DEF_STR("COMMAND NOT SUPPORT\r") },
+	};
+#undef DEF_STR
+
+EXPORT_DEF const at_responses_t at_responses = { at_responses_list, 2, ITEMS_OF(at_responses_list), RES_MIN, RES_MAX};
+
+/*!
+ * \brief Get the string representation of the given AT response
+ * \param res -- the response to process
+ * \return a string describing the given response
+ */
+
+EXPORT_DEF const char* at_res2str (at_res_t res)
+{
+	if((int)res >= at_responses.name_first && (int)res <= at_responses.name_last)
+		return at_responses.responses[res - at_responses.name_first].name;
+	return "UNDEFINED";
+}
+
+#/* length of two line response like +CMT: [<alpha>],<length>\r\n<pdu>\r up to second CR, 0 if incomplete */
+static size_t at_read_two_line_length (const struct ringbuffer * rb)
+{
+	struct ringbuffer tmp = *rb;
+	struct iovec iov[2];
+	size_t header;
+
+	if (rb_read_until_mem_iov (&tmp, iov, "\r\n", 2) <= 0)
+		return 0;
+	header = iov[0].iov_len + iov[1].iov_len + 2;
+	rb_read_upd (&tmp, header);
+
+	if (rb_read_until_mem_iov (&tmp, iov, "\r\n", 2) <= 0)
+		return 0;
+	return header + iov[0].iov_len + iov[1].iov_len + 1;
+}
+
+#/* */
+EXPORT_DEF int at_read_result_iov (const char * dev, int * read_result, struct ringbuffer* rb, struct iovec iov[2])
+{
+	int	iovcnt = 0;
+	int	res;
+	size_t	s;
+
+	s = rb_used (rb);
+	if (s > 0)
+	{
+/*		ast_debug (5, "[%s] d_read_result %d len %d input [%.*s]\n", dev, *read_result, s, MIN(s, rb->size - rb->read), (char*)rb->buffer + rb->read);
+*/
+
+		if (*read_result == 0)
+		{
+			res = rb_memcmp (rb, "\r\n", 2);
+			if (res == 0)
+			{
+				rb_read_upd (rb, 2);
+				*read_result = 1;
+
+				return at_read_result_iov (dev, read_result, rb, iov);
+			}
+			else if (res > 0)
+			{
+				if (rb_memcmp (rb, "\n", 1) == 0)
+				{
+					/* multiline response */
+					rb_read_upd (rb, 1);
+
+					return at_read_result_iov (dev, read_result, rb, iov);
+				}
+
+				if (rb_memcmp (rb, "+CMGL:", 6) == 0)
+				{
+					/* next message of +CMGL list without leading CRLF */
+					*read_result = 1;
+
+					return at_read_result_iov (dev, read_result, rb, iov);
+				}
+
+				if (rb_read_until_char_iov (rb, iov, '\r') > 0)
+				{
+					s = iov[0].iov_len + iov[1].iov_len + 1;
+				}
+
+				rb_read_upd (rb, s);
+
+				return at_read_result_iov (dev, read_result, rb, iov);
+			}
+
+			return 0;
+		}
+		else
+		{
+			if (rb_memcmp (rb, "+CSSI:", 6) == 0)
+			{
+				iovcnt = rb_read_n_iov (rb, iov, 8);
+				if (iovcnt > 0)
+				{
+					*read_result = 0;
+				}
+
+				return iovcnt;
+			}
+			else if (rb_memcmp (rb, "\r\n+CSSU:", 8) == 0 || rb_memcmp (rb, "\r\n+CMS ERROR:", 13) == 0 ||  rb_memcmp (rb, "\r\n+CMGS:", 8) == 0)
+			{
+				rb_read_upd (rb, 2);
+				return at_read_result_iov (dev, read_result, rb, iov);
+			}
+			else if (rb_memcmp (rb, "> ", 2) == 0)
+			{
+				*read_result = 0;
+				return rb_read_n_iov (rb, iov, 2);
+			}
+			else if (rb_memcmp (rb, "+CMT:", 5) == 0 || rb_memcmp (rb, "+CMGL:", 6) == 0)
+			{
+				/* PDU or text on next line, each message of +CMGL list separately */
+				s = at_read_two_line_length (rb);
+				if (s > 0)
+				{
+					*read_result = 0;
+					return rb_read_n_iov (rb, iov, s);
+				}
+
+				return 0;
+			}
+			else if (rb_memcmp (rb, "+CMGR:", 6) == 0 || rb_memcmp (rb, "+CNUM:", 6) == 0 || rb_memcmp (rb, "ERROR+CNUM:", 11) == 0 || rb_memcmp (rb, "+CLCC:", 6) == 0)
+			{
+				iovcnt = rb_read_until_mem_iov (rb, iov, "\n\r\nOK\r\n", 7);
+				if (iovcnt > 0)
+				{
+					*read_result = 0;
+				}
+
+				return iovcnt;
+			}
+			else
+			{
+				iovcnt = rb_read_until_mem_iov (rb, iov, "\r\n", 2);
+				if (iovcnt > 0)
+				{
+					*read_result = 0;
+					s = iov[0].iov_len + iov[1].iov_len + 1;
+
+					return rb_read_n_iov (rb, iov, s);
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+EXPORT_DEF at_res_t at_read_result_classification (struct ringbuffer * rb, size_t len)
+{
+	at_res_t at_res = RES_UNKNOWN;
+	unsigned idx;
+
+	for(idx = at_responses.ids_first; idx < at_responses.ids; idx++)
+	{
+		if (rb_memcmp (rb, at_responses.responses[idx].id, at_responses.responses[idx].idlen) == 0)
+		{
+			at_res = at_responses.responses[idx].res;
+			break;
+		}
+	}
+
+	switch (at_res)
+	{
+		case RES_SMS_PROMPT:
+			len = 2;
+			break;
+
+		case RES_CMGR:
+			len += 7;
+			break;
+
+		case RES_CSSI:
+			len = 8;
+			break;
+		default:
+			len += 1;
+			break;
+	}
+
+	rb_read_upd (rb, len);
+
+/*	ast_debug (5, "receive result '%s'\n", at_res2str (at_res));
+*/
+
+	return at_res;
+}
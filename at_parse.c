@@ -17,10 +17,12 @@
 #include <stdio.h>			/* NULL */
 #include <errno.h>			/* errno */
 #include <stdlib.h>			/* strtol */
+#include <string.h>			/* memcpy() memset() memchr() strlen() strchr() */
+
+#include <asterisk.h>			/* attribute_unused */
 
 #include "at_parse.h"
 #include "mutils.h"			/* ITEMS_OF() */
-#include "chan_dongle.h"
 #include "pdu.h"			/* pdu_parse() */
 
 #/* */
@@ -272,7 +274,7 @@ EXPORT_DEF int at_parse_cmti (const char* str)
 }
 
 
-static const char * parse_cmgr_text(char ** str, size_t len, char * oa, size_t oa_len, str_encoding_t * oa_enc, char ** msg, str_encoding_t * msg_enc)
+static const char * parse_cmgr_text(char ** str, size_t len, char * oa, size_t oa_len, str_encoding_t * oa_enc, char ** msg, str_encoding_t * msg_enc, attribute_unused pdu_udh_t * udh)
 {
 	/*
 	 * parse cmgr info in the following TEXT format:
@@ -316,7 +318,7 @@ static const char * parse_cmgr_text(char ** str, size_t len, char * oa, size_t o
 	return "Can't parse +CMGR response text";
 }
 
-static const char* parse_cmgr_pdu(char** str, attribute_unused size_t len, char* oa, size_t oa_len, str_encoding_t* oa_enc, char** msg, str_encoding_t* msg_enc)
+static const char* parse_cmgr_pdu(char** str, attribute_unused size_t len, char* oa, size_t oa_len, str_encoding_t* oa_enc, char** msg, str_encoding_t* msg_enc, pdu_udh_t * udh)
 {
 	/*
 	 * parse cmgr info in the following PDU format
@@ -341,12 +343,36 @@ static const char* parse_cmgr_pdu(char** str, attribute_unused size_t len, char*
 		if(tpdu_length <= 0 || end[0] != '\r')
 			return "Invalid TPDU length in CMGR PDU status line";
 		*str = marks[2] + 1;
-		return pdu_parse(str, tpdu_length, oa, oa_len, oa_enc, msg, msg_enc);
+		return pdu_parse(str, tpdu_length, oa, oa_len, oa_enc, msg, msg_enc, udh);
 	}
 
 	return "Can't parse +CMGR response";
 }
 
+#/* parse message of +CMGR or +CMGL after response name or index */
+static const char * parse_cmgr_message(char ** str, size_t len, char * oa, size_t oa_len, str_encoding_t * oa_enc, char ** msg, str_encoding_t * msg_enc, pdu_udh_t * udh)
+{
+	const char* rv = "Can't parse +CMGR response line";
+
+	/* skip leading spaces */
+	while(len > 0 && str[0][0] == ' ')
+	{
+		(*str)++;
+		len--;
+	}
+
+	if(len > 0)
+	{
+		/* check PDU or TEXT mode */
+		const char* (*fptr)(char** str, size_t len, char* num, size_t num_len, str_encoding_t * oa_enc, char** msg, str_encoding_t * msg_enc, pdu_udh_t * udh);
+		fptr = str[0][0] == '"' ? parse_cmgr_text : parse_cmgr_pdu;
+
+		rv = (*fptr)(str, len, oa, oa_len, oa_enc, msg, msg_enc, udh);
+	}
+
+	return rv;
+}
+
 /*!
  * \brief Parse a CMGR message
  * \param str -- pointer to pointer of string to parse (null terminated)
@@ -358,31 +384,109 @@ static const char* parse_cmgr_pdu(char** str, attribute_unused size_t len, char*
  * \retval -1 parse error
  */
 
-EXPORT_DEF const char * at_parse_cmgr(char ** str, size_t len, char * oa, size_t oa_len, str_encoding_t * oa_enc, char ** msg, str_encoding_t * msg_enc)
+EXPORT_DEF const char * at_parse_cmgr(char ** str, size_t len, char * oa, size_t oa_len, str_encoding_t * oa_enc, char ** msg, str_encoding_t * msg_enc, pdu_udh_t * udh)
 {
-	const char* rv = "Can't parse +CMGR response line";
+	memset(udh, 0, sizeof(*udh));
 
 	/* skip "+CMGR:" */
 	*str += 6;
 	len -= 6;
 
-	/* skip leading spaces */
-	while(len > 0 && str[0][0] == ' ')
-	{
-		(*str)++;
-		len--;
-	}
+	return parse_cmgr_message(str, len, oa, oa_len, oa_enc, msg, msg_enc, udh);
+}
 
-	if(len > 0)
-	{
-		/* check PDU or TEXT mode */
-		const char* (*fptr)(char** str, size_t len, char* num, size_t num_len, str_encoding_t * oa_enc, char** msg, str_encoding_t * msg_enc);
-		fptr = str[0][0] == '"' ? parse_cmgr_text : parse_cmgr_pdu;
+/*!
+ * \brief Parse one message of CMGL response
+ * \param str -- pointer to pointer of string to parse (null terminated)
+ * \param len -- string lenght
+ * \param index -- pointer to integer which will store index of message in storage
+ * \param oa -- buffer for originator address
+ * \param msg -- a pointer to a char pointer which will store the message text
+ * @note str will be modified when the CMGL message is parsed
+ * \retval NULL success
+ * \retval error description
+ */
 
-		rv = (*fptr)(str, len, oa, oa_len, oa_enc, msg, msg_enc);
-	}
+EXPORT_DEF const char * at_parse_cmgl(char ** str, size_t len, int * index, char * oa, size_t oa_len, str_encoding_t * oa_enc, char ** msg, str_encoding_t * msg_enc, pdu_udh_t * udh)
+{
+	/*
+	 * parse cmgl message, rest after index same as in +CMGR
+	 * +CMGL: <index>,<stat>,[<alpha>],<length><CR><LF><pdu>
+	 * +CMGL: <index>,<stat>,<oa/da>,[<alpha>],[<scts>]<CR><LF><data>
+	 *
+	 *	sample
+	 * +CMGL: 3,0,,31
+	 * 07911234567890F3040B911234556780F20008012150220040210C041F04400438043204350442
+	 */
 
-	return rv;
+	char * end;
+	long value;
+
+	memset(udh, 0, sizeof(*udh));
+
+	/* skip "+CMGL:" */
+	*str += 6;
+	len -= 6;
+
+	value = strtol(*str, &end, 10);
+	if(end == *str || end[0] != ',' || value < 0)
+		return "Can't parse index in +CMGL response line";
+	*index = value;
+
+	len -= end + 1 - *str;
+	*str = end + 1;
+
+	return parse_cmgr_message(str, len, oa, oa_len, oa_enc, msg, msg_enc, udh);
+}
+
+/*!
+ * \brief Parse a CMT unsolicited message
+ * \param str -- pointer to pointer of string to parse (null terminated)
+ * \param len -- string lenght
+ * \param oa -- buffer for originator address
+ * \param msg -- a pointer to a char pointer which will store the message text
+ * @note str will be modified when the CMT message is parsed
+ * \retval NULL success
+ * \retval error description
+ */
+
+EXPORT_DEF const char * at_parse_cmt(char ** str, size_t len, char * oa, size_t oa_len, str_encoding_t * oa_enc, char ** msg, str_encoding_t * msg_enc, pdu_udh_t * udh)
+{
+	/*
+	 * parse cmt message in the following PDU format
+	 * +CMT: [<alpha>],<length><CR><LF>
+	 * SMSC_number_and_TPDU
+	 *
+	 *	sample
+	 * +CMT: ,31
+	 * 07911234567890F3040B911234556780F20008012150220040210C041F04400438043204350442
+	 */
+
+	char * eol;
+	char * comma;
+	char * end;
+	long tpdu_length;
+
+	memset(udh, 0, sizeof(*udh));
+
+	eol = memchr(*str, '\r', len);
+	if(!eol)
+		return "Can't parse +CMT response line";
+
+	/* alpha may contain commas, length after last */
+	for(comma = eol; comma > *str && comma[-1] != ','; comma--)
+		;
+	if(comma == *str)
+		return "Can't parse +CMT response line";
+
+	tpdu_length = strtol(comma, &end, 10);
+	if(tpdu_length <= 0 || end != eol)
+		return "Invalid TPDU length in CMT PDU status line";
+
+	*str = eol + 1;
+	if(**str == '\n')
+		(*str)++;
+	return pdu_parse(str, tpdu_length, oa, oa_len, oa_enc, msg, msg_enc, udh);
 }
 
  /*!
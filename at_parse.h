@@ -8,13 +8,16 @@
 
 #include "export.h"		/* EXPORT_DECL EXPORT_DECL */
 #include "char_conv.h"		/* str_encoding_t */
+#include "pdu.h"		/* pdu_udh_t */
 struct pvt;
 
 EXPORT_DECL char* at_parse_cnum (char* str);
 EXPORT_DECL char* at_parse_cops (char* str);
 EXPORT_DECL int at_parse_creg (char* str, unsigned len, int* gsm_reg, int* gsm_reg_status, char** lac, char** ci);
 EXPORT_DECL int at_parse_cmti (const char* str);
-EXPORT_DECL const char* at_parse_cmgr (char** str, size_t len, char* oa, size_t oa_len, str_encoding_t* oa_enc, char** msg, str_encoding_t* msg_enc);
+EXPORT_DECL const char* at_parse_cmgr (char** str, size_t len, char* oa, size_t oa_len, str_encoding_t* oa_enc, char** msg, str_encoding_t* msg_enc, pdu_udh_t* udh);
+EXPORT_DECL const char* at_parse_cmgl (char** str, size_t len, int* index, char* oa, size_t oa_len, str_encoding_t* oa_enc, char** msg, str_encoding_t* msg_enc, pdu_udh_t* udh);
+EXPORT_DECL const char* at_parse_cmt (char** str, size_t len, char* oa, size_t oa_len, str_encoding_t* oa_enc, char** msg, str_encoding_t* msg_enc, pdu_udh_t* udh);
 EXPORT_DECL int at_parse_cusd (char* str, int * type, char ** cusd, int * dcs);
 EXPORT_DECL int at_parse_cpin (char* str, size_t len);
 EXPORT_DECL int at_parse_csq (const char* str, int* rssi);
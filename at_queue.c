@@ -15,9 +15,13 @@
 
 #include <asterisk.h>
 #include <asterisk/utils.h>		/* ast_free() */
+#include <asterisk/time.h>		/* ast_tvnow() ast_tvdiff_ms() ast_tvzero() */
 
 #include "at_queue.h"
 #include "chan_dongle.h"		/* struct pvt */
+#include "mutils.h"			/* ITEMS_OF() */
+#include "probes.h"			/* PROBE4() */
+#include "atrec.h"			/* ATREC_ON() atrec_put() */
 
 /*!
  * \brief Free an item data
@@ -97,6 +101,8 @@ static at_queue_cmd_t* at_queue_head_cmd_nc (const struct pvt * pvt)
 static at_queue_task_t * at_queue_add (struct cpvt * cpvt, const at_queue_cmd_t * cmds, unsigned cmdsno, int prio)
 {
 	at_queue_task_t * e = NULL;
+	unsigned idx;
+
 	if(cmdsno > 0)
 	{
 		e = ast_malloc (sizeof(*e) + cmdsno * sizeof(*cmds));
@@ -111,6 +117,8 @@ static at_queue_task_t * at_queue_add (struct cpvt * cpvt, const at_queue_cmd_t
 			e->cpvt = cpvt;
 
 			memcpy(&e->cmds[0], cmds, cmdsno * sizeof(*cmds));
+			for(idx = 0; idx < cmdsno; ++idx)
+				e->cmds[idx].written = ast_tv(0, 0);
 
 
 			if(prio && (first = AST_LIST_FIRST (&pvt->at_queue)))
@@ -195,6 +203,13 @@ EXPORT_DEF int at_write (struct pvt* pvt, const char* buf, size_t count)
 
 	wrote = write_all(pvt->data_fd, buf, count);
 	PVT_STAT(pvt, d_write_bytes) += wrote;
+#ifdef BUILD_ATREC
+	if (ATREC_ON(pvt->atrec))
+	{
+		struct iovec iov = { (void *)buf, wrote };
+		atrec_put(pvt->atrec, PVT_ID(pvt), ATREC_DIR_TX, &iov, 1, wrote);
+	}
+#endif /* BUILD_ATREC */
 	if(wrote != count)
 	{
 		ast_debug (1, "[%s] write() error: %d\n", PVT_ID(pvt), errno);
@@ -203,6 +218,25 @@ EXPORT_DEF int at_write (struct pvt* pvt, const char* buf, size_t count)
 	return wrote != count;
 }
 
+#/* account response latency of written command */
+static void at_queue_latency(struct pvt * pvt, const at_queue_cmd_t * cmd)
+{
+	static const unsigned bounds[] = AT_LATENCY_BOUNDS;
+	unsigned bucket;
+	int64_t ms;
+
+	if(!ast_tvzero(cmd->written))
+	{
+		ms = ast_tvdiff_ms(ast_tvnow(), cmd->written);
+		if(ms < 0)
+			ms = 0;
+		for(bucket = 0; bucket < ITEMS_OF(bounds) && ms > bounds[bucket]; ++bucket)
+			;
+		PVT_STAT(pvt, at_latency[bucket]) ++;
+		PVT_STAT(pvt, at_latency_sum) += ms;
+	}
+}
+
 /*!
  * \brief Remove an cmd item from the front of the queue
  * \param pvt -- pvt structure
@@ -216,6 +250,7 @@ EXPORT_DEF void at_queue_remove_cmd (struct pvt* pvt, at_res_t res)
 	{
 		unsigned index = task->cindex;
 
+		at_queue_latency(pvt, &task->cmds[index]);
 		task->cindex++;
 		PVT_STATE(pvt, at_cmds)--;
 		ast_debug (4, "[%s] remove command '%s' expected response '%s' real '%s' cmd %u/%u flags 0x%02x from queue\n", 
@@ -230,6 +265,33 @@ EXPORT_DEF void at_queue_remove_cmd (struct pvt* pvt, at_res_t res)
 	}
 }
 
+/*!
+ * \brief Move pending SMS acknowledgement before next part of concatenated SMS
+ * \param pvt -- pvt structure
+ *
+ * AT+CNMA queued after head task, but all parts of SMS in one task can hold
+ * it longer than network wait, ME then stop direct delivery.
+ */
+#/* */
+static void at_queue_cnma_first (struct pvt * pvt)
+{
+	at_queue_task_t * task = AST_LIST_FIRST (&pvt->at_queue);
+	at_queue_task_t * next;
+
+	/* only between parts, AT+CMGS and text of one part are inseparable */
+	if(task && task->cmds[task->cindex].cmd == CMD_AT_CMGS && task->cmds[task->cindex].length > 0)
+	{
+		next = AST_LIST_NEXT (task, entry);
+		if(next && next->cmds[0].cmd == CMD_AT_CNMA)
+		{
+			AST_LIST_REMOVE (&pvt->at_queue, next, entry);
+			AST_LIST_INSERT_HEAD (&pvt->at_queue, next, entry);
+			ast_debug (4, "[%s] SMS acknowledgement moved before part %u of %u of SMS message %p\n",
+					PVT_ID(pvt), task->cindex / 2 + 1, task->cmdsno / 2, task);
+		}
+	}
+}
+
 /*!
  * \brief Try real write first command on queue
  * \param pvt -- pvt structure
@@ -239,7 +301,10 @@ EXPORT_DEF void at_queue_remove_cmd (struct pvt* pvt, at_res_t res)
 EXPORT_DEF int at_queue_run (struct pvt * pvt)
 {
 	int fail = 0;
-	at_queue_cmd_t * cmd = at_queue_head_cmd_nc(pvt);
+	at_queue_cmd_t * cmd;
+
+	at_queue_cnma_first(pvt);
+	cmd = at_queue_head_cmd_nc(pvt);
 
 	if(cmd)
 	{
@@ -248,6 +313,7 @@ EXPORT_DEF int at_queue_run (struct pvt * pvt)
 			ast_debug (4, "[%s] write command '%s' expected response '%s' length %u\n", 
 					PVT_ID(pvt), at_cmd2str (cmd->cmd), at_res2str (cmd->res), cmd->length);
 
+			PROBE4(at_command, PVT_ID(pvt), at_cmd2str (cmd->cmd), at_res2str (cmd->res), cmd->length);
 			fail = at_write(pvt, cmd->data, cmd->length);
 			if(fail)
 			{
@@ -257,7 +323,8 @@ EXPORT_DEF int at_queue_run (struct pvt * pvt)
 			else
 			{
 				/* set expire time */
-				cmd->timeout = ast_tvadd (ast_tvnow(), cmd->timeout);
+				cmd->written = ast_tvnow();
+				cmd->timeout = ast_tvadd (cmd->written, cmd->timeout);
 
 				/* free data and mark as written */
 				at_queue_free_data(cmd);
@@ -34,6 +34,7 @@ typedef struct at_queue_cmd
 
 	char*			data;			/*!< command and data to send in device */
 	unsigned		length;			/*!< data length */
+	struct timeval		written;		/*!< time when command actually written on device, for latency statistics */
 } at_queue_cmd_t;
 
 /* initializers */
@@ -24,8 +24,11 @@
 #include "char_conv.h"
 #include "manager.h"
 #include "channel.h"				/* channel_queue_hangup() channel_queue_control() */
-
-#define DEF_STR(str)	str,STRLEN(str)
+#include "probes.h"				/* PROBE4() PROBE_TIMER() */
+#include "smsq.h"				/* smsq_result() smsq_part_sent() */
+#include "concat.h"				/* concat_add() concat_expire() */
+#include "ussd.h"				/* USSD_ID() USSD_TEXT_MAX */
+#include "ussdq.h"				/* ussdq_sent() ussdq_answer() */
 
 #define CCWA_STATUS_NOT_ACTIVE	0
 #define CCWA_STATUS_ACTIVE	1
@@ -34,72 +37,39 @@
 #define CLCC_CALL_TYPE_DATA	1
 #define CLCC_CALL_TYPE_FAX	2
 
-/* magic!!! must be in same order as elements of enums in at_res_t */
-static const at_response_t at_responses_list[] = {
-	{ RES_PARSE_ERROR,"PARSE ERROR", 0, 0 },
-	{ RES_UNKNOWN,"UNKNOWN", 0, 0 },
-
-	{ RES_BOOT,"^BOOT",DEF_STR("^BOOT:") },
-	{ RES_BUSY,"BUSY",DEF_STR("BUSY\r") },
-	{ RES_CEND,"^CEND",DEF_STR("^CEND:") },
-
-	{ RES_CMGR, "+CMGR",DEF_STR("+CMGR:") },
-	{ RES_CMS_ERROR, "+CMS ERROR",DEF_STR("+CMS ERROR:") },
-	{ RES_CMTI, "+CMTI",DEF_STR("+CMTI:") },
-	{ RES_CNUM, "+CNUM",DEF_STR("+CNUM:") },		/* and "ERROR+CNUM:" */
-
-	{ RES_CONF,"^CONF",DEF_STR("^CONF:") },
-	{ RES_CONN,"^CONN",DEF_STR("^CONN:") },
-	{ RES_COPS,"+COPS",DEF_STR("+COPS:") },
-	{ RES_CPIN,"+CPIN",DEF_STR("+CPIN:") },
-
-	{ RES_CREG,"+CREG",DEF_STR("+CREG:") },
-	{ RES_CSQ,"+CSQ",DEF_STR("+CSQ:") },
-	{ RES_CSSI,"+CSSI",DEF_STR("+CSSI:") },
-	{ RES_CSSU,"+CSSU",DEF_STR("+CSSU:") },
-
-	{ RES_CUSD,"+CUSD",DEF_STR("+CUSD:") },
-	{ RES_ERROR,"ERROR",DEF_STR("ERROR\r") },		/* and "COMMAND NOT SUPPORT\r" */
-	{ RES_MODE,"^MODE",DEF_STR("^MODE:") },
-	{ RES_NO_CARRIER,"NO CARRIER",DEF_STR("NO CARRIER\r") },
-
-	{ RES_NO_DIALTONE,"NO DIALTONE",DEF_STR("NO DIALTONE\r") },
-	{ RES_OK,"OK",DEF_STR("OK\r") },
-	{ RES_ORIG,"^ORIG",DEF_STR("^ORIG:") },
-	{ RES_RING,"RING",DEF_STR("RING\r") },
-
-	{ RES_RSSI,"^RSSI",DEF_STR("^RSSI:") },
-	{ RES_SMMEMFULL,"^SMMEMFULL",DEF_STR("^SMMEMFULL:") },
-	{ RES_SMS_PROMPT,"> ",DEF_STR("> ") },
-	{ RES_SRVST,"^SRVST",DEF_STR("^SRVST:") },
-
-	{ RES_CVOICE,"^CVOICE",DEF_STR("^CVOICE:") },
-	{ RES_CMGS,"+CMGS",DEF_STR("+CMGS:") },
-	{ RES_CPMS,"+CPMS",DEF_STR("+CPMS:") },
-	{ RES_CSCA,"+CSCA",DEF_STR("+CSCA:") },
-
-	{ RES_CLCC,"+CLCC", DEF_STR("+CLCC:") },
-	{ RES_CCWA,"+CCWA", DEF_STR("+CCWA:") },
-
-	/* duplicated response undef other id */
-	{ RES_CNUM, "+CNUM",DEF_STR("ERROR+CNUM:") },
-	{ RES_ERROR,"ERROR",DEF_STR("COMMAND NOT SUPPORT\r") },
-	};
-#undef DEF_STR
-
-EXPORT_DEF const at_responses_t at_responses = { at_responses_list, 2, ITEMS_OF(at_responses_list), RES_MIN, RES_MAX};
+#/* queue reading of all unread SMS from storage, once until listing done */
+static void at_sms_drain (struct pvt * pvt)
+{
+	if (pvt->sms_drain || !pvt->has_sms || CONF_SHARED(pvt, disablesms))
+		return;
 
-/*!
- * \brief Get the string representation of the given AT response
- * \param res -- the response to process
- * \return a string describing the given response
- */
+	if (at_enque_list_sms (&pvt->sys_chan, CONF_SHARED(pvt, autodeletesms)))
+	{
+		ast_log (LOG_ERROR, "[%s] Error sending CMGL to list stored SMS messages\n", PVT_ID(pvt));
+		return;
+	}
+	pvt->sms_drain = 1;
+	pvt->sms_listed = 0;
+	pvt->incoming_sms = 1;
+}
 
-EXPORT_DEF const char* at_res2str (at_res_t res)
+#/* listing done, read messages of +CMTI received meanwhile and not listed, without autodeletesms listed stay in storage */
+static void at_sms_drain_done (struct pvt * pvt)
 {
-	if((int)res >= at_responses.name_first && (int)res <= at_responses.name_last)
-		return at_responses.responses[res - at_responses.name_first].name;
-	return "UNDEFINED";
+	int index;
+
+	pvt->sms_drain = 0;
+	for (index = 0; index < SMS_INDEX_MAX; ++index)
+	{
+		if (pvt->sms_cmti[index / 8] & (1 << (index % 8)))
+		{
+			pvt->sms_cmti[index / 8] &= ~(1 << (index % 8));
+			if (at_enque_retrive_sms (&pvt->sys_chan, index, CONF_SHARED(pvt, autodeletesms)))
+				ast_log (LOG_ERROR, "[%s] Error sending CMGR to retrieve SMS message\n", PVT_ID(pvt));
+			else
+				pvt->incoming_sms = 1;
+		}
+	}
 }
 
 /*!
@@ -190,6 +160,16 @@ static int at_response_ok (struct pvt* pvt, at_res_t res)
 				ast_debug (1, "[%s] SMS storage location is established\n", PVT_ID(pvt));
 				break;
 
+			case CMD_AT_CSMS:
+				ast_debug (1, "[%s] Phase 2+ messaging service selected, direct SMS acknowledged by TE\n", PVT_ID(pvt));
+
+				pvt->use_cnma = 1;
+				break;
+
+			case CMD_AT_CNMA:
+				ast_debug (3, "[%s] SMS acknowledgement accepted\n", PVT_ID(pvt));
+				break;
+
 			case CMD_AT_CNMI:
 				ast_debug (1, "[%s] SMS new message indication enabled\n", PVT_ID(pvt));
 				ast_debug (1, "[%s] Dongle has sms support\n", PVT_ID(pvt));
@@ -202,6 +182,9 @@ static int at_response_ok (struct pvt* pvt, at_res_t res)
 					pvt->initialized = 1;
 					ast_verb (3, "[%s] Dongle initialized and ready\n", PVT_ID(pvt));
 					manager_event_device_status(PVT_ID(pvt), "Initialize");
+
+					/* messages received while device was down */
+					at_sms_drain (pvt);
 				}
 				break;
 
@@ -248,9 +231,18 @@ static int at_response_ok (struct pvt* pvt, at_res_t res)
 				break;
 
 			case CMD_AT_SMSTEXT:
+				/* not last part of concatenated SMS, report once on last part */
+				if(task->cindex + 1 < task->cmdsno)
+				{
+					ast_debug (1, "[%s] Part %u of %u of SMS message %p sent\n", PVT_ID(pvt), task->cindex / 2 + 1, task->cmdsno / 2, task);
+					smsq_part_sent(pvt, task);
+					break;
+				}
 				pvt->outgoing_sms = 0;
 				pvt_try_restate(pvt);
 
+				if(smsq_result(pvt, task, 1))
+					break;
 				manager_event_sent_notify(PVT_ID(pvt), "SMS", task, "Sent");
 				/* TODO: move to +CMGS: handler */
 				ast_verb (3, "[%s] Successfully sent SMS message %p\n", PVT_ID(pvt), task);
@@ -262,9 +254,14 @@ static int at_response_ok (struct pvt* pvt, at_res_t res)
 				break;
 
 			case CMD_AT_CUSD:
-				manager_event_sent_notify(PVT_ID(pvt), "USSD", task, "Sent");
-				ast_verb (3, "[%s] Successfully sent USSD %p\n", PVT_ID(pvt), task);
-				ast_log (LOG_NOTICE, "[%s] Successfully sent USSD %p\n", PVT_ID(pvt), task);
+				{
+					uint64_t id = ussdq_sent(pvt, task, 1);
+					const void * ussd_id = id ? USSD_ID(id) : task;
+
+					manager_event_sent_notify(PVT_ID(pvt), "USSD", ussd_id, "Sent");
+					ast_verb (3, "[%s] Successfully sent USSD %p\n", PVT_ID(pvt), ussd_id);
+					ast_log (LOG_NOTICE, "[%s] Successfully sent USSD %p\n", PVT_ID(pvt), ussd_id);
+				}
 				break;
 
 			case CMD_AT_COPS:
@@ -279,6 +276,14 @@ static int at_response_ok (struct pvt* pvt, at_res_t res)
 				ast_debug (1, "[%s] SMS message deleted successfully\n", PVT_ID(pvt));
 				break;
 
+			case CMD_AT_CMGL:
+				ast_debug (1, "[%s] %u stored SMS messages read\n", PVT_ID(pvt), pvt->sms_listed);
+
+				pvt->incoming_sms = 0;
+				at_sms_drain_done (pvt);
+				pvt_try_restate(pvt);
+				break;
+
 			case CMD_AT_CSQ:
 				ast_debug (1, "[%s] Got signal strength result\n", PVT_ID(pvt));
 				break;
@@ -444,6 +449,21 @@ static int at_response_error (struct pvt* pvt, at_res_t res)
 				pvt->use_ucs2_encoding = 0;
 				break;
 
+			case CMD_AT_CSMS:
+				ast_debug (1, "[%s] No phase 2+ messaging service, direct SMS acknowledged by device\n", PVT_ID(pvt));
+
+				pvt->use_cnma = 0;
+				break;
+
+			case CMD_AT_CNMA:
+				ast_log (LOG_WARNING, "[%s] SMS acknowledgement rejected, message may be received again\n", PVT_ID(pvt));
+
+				/* on missed acknowledgement ME reset +CNMI <mt> and <ds> to 0 and store new messages */
+				if (at_enque_cnmi (&pvt->sys_chan))
+					ast_log (LOG_ERROR, "[%s] Error restore direct SMS delivery\n", PVT_ID(pvt));
+				at_sms_drain (pvt);
+				break;
+
 			case CMD_AT_A:
 			case CMD_AT_CHLD_2x:
 				ast_log (LOG_ERROR, "[%s] Answer failed for call idx %d\n", PVT_ID(pvt), task->cpvt->call_idx);
@@ -489,11 +509,20 @@ static int at_response_error (struct pvt* pvt, at_res_t res)
 				ast_log (LOG_ERROR, "[%s] Error deleting SMS message\n", PVT_ID(pvt));
 				break;
 
+			case CMD_AT_CMGL:
+				pvt->incoming_sms = 0;
+				at_sms_drain_done (pvt);
+				pvt_try_restate(pvt);
+				ast_log (LOG_ERROR, "[%s] Error listing stored SMS messages, %u read\n", PVT_ID(pvt), pvt->sms_listed);
+				break;
+
 			case CMD_AT_CMGS:
 			case CMD_AT_SMSTEXT:
 				pvt->outgoing_sms = 0;
 				pvt_try_restate(pvt);
 
+				if(smsq_result(pvt, task, 0))
+					break;
 				manager_event_sent_notify(PVT_ID(pvt), "SMS", task, "NotSent");
 				ast_verb (3, "[%s] Error sending SMS message %p\n", PVT_ID(pvt), task);
 				ast_log (LOG_ERROR, "[%s] Error sending SMS message %p\n", PVT_ID(pvt), task);
@@ -513,9 +542,14 @@ static int at_response_error (struct pvt* pvt, at_res_t res)
 				break;
 
 			case CMD_AT_CUSD:
-				manager_event_sent_notify(PVT_ID(pvt), "USSD", task, "NotSent");
-				ast_verb (3, "[%s] Error sending USSD %p\n", PVT_ID(pvt), task);
-				ast_log (LOG_ERROR, "[%s] Error sending USSD %p\n", PVT_ID(pvt), task);
+				{
+					uint64_t id = ussdq_sent(pvt, task, 0);
+					const void * ussd_id = id ? USSD_ID(id) : task;
+
+					manager_event_sent_notify(PVT_ID(pvt), "USSD", ussd_id, "NotSent");
+					ast_verb (3, "[%s] Error sending USSD %p\n", PVT_ID(pvt), ussd_id);
+					ast_log (LOG_ERROR, "[%s] Error sending USSD %p\n", PVT_ID(pvt), ussd_id);
+				}
 				break;
 
 			default:
@@ -742,10 +776,13 @@ static int at_response_cend (struct pvt * pvt, const char* str)
 	cpvt = pvt_find_cpvt(pvt, call_index);
 	if (cpvt)
 	{
+		/* cpvt may be freed by change_channel_state() */
+		struct cpvt_stat stat = cpvt->stat;
+
 		CPVT_RESET_FLAGS(cpvt, CALL_FLAG_NEED_HANGUP);
 		PVT_STAT(pvt, calls_duration[cpvt->dir]) += duration;
 		change_channel_state(cpvt, CALL_STATE_RELEASED, cc_cause);
-		manager_event_cend(PVT_ID(pvt), call_index, duration, end_status, cc_cause);
+		manager_event_cend(PVT_ID(pvt), call_index, duration, end_status, cc_cause, &stat);
 	}
 	else
 	{
@@ -1143,7 +1180,12 @@ static int at_response_cmti (struct pvt* pvt, const char* str)
 		}
 		else if(pvt_enabled(pvt))
 		{
-			if (at_enque_retrive_sms (&pvt->sys_chan, index, CONF_SHARED(pvt, autodeletesms)))
+			if (pvt->sms_drain && index < SMS_INDEX_MAX)
+			{
+				/* queued AT+CMGL may list it too, read after listing only when not listed */
+				pvt->sms_cmti[index / 8] |= 1 << (index % 8);
+			}
+			else if (at_enque_retrive_sms (&pvt->sys_chan, index, CONF_SHARED(pvt, autodeletesms)))
 			{
 				ast_log (LOG_ERROR, "[%s] Error sending CMGR to retrieve SMS message\n", PVT_ID(pvt));
 				return -1;
@@ -1161,6 +1203,147 @@ static int at_response_cmti (struct pvt* pvt, const char* str)
 	}
 }
 
+#/* pass received SMS to manager and dialplan */
+static void at_sms_deliver (struct pvt * pvt, const char * number, const char * msg, size_t msg_len, const char * cmgr)
+{
+	char		* text_base64;
+
+	scratch_stack_mark (&pvt->sms_scratch, &text_base64);
+	ast_verb (1, "[%s] Got SMS from %s: '%s'\n", PVT_ID(pvt), number, msg);
+
+	if (CONF_SHARED(pvt, dispatch) == DC_DISPATCH_MANAGER)
+	{
+		/* events only, base64 encoded into job and sent by dispatch pool outside of device lock */
+		manager_dispatch_new_sms(PVT_ID(pvt), number, msg, msg_len);
+		return;
+	}
+
+	/* released with other buffers of message by caller */
+	text_base64 = scratch_alloc (&pvt->sms_scratch, BASE64_SIZE(msg_len));
+	if (!text_base64)
+	{
+		ast_log (LOG_ERROR, "[%s] No memory for SMS from %s\n", PVT_ID(pvt), number);
+		return;
+	}
+	base64_encode (msg, msg_len, text_base64, BASE64_SIZE(msg_len));
+
+	{
+		channel_var_t vars[] = 
+		{
+			{ "SMS", (char *)msg } ,
+			{ "SMS_BASE64", text_base64 },
+			{ "CMGR", (char *)cmgr },
+			{ NULL, NULL },
+		};
+
+		manager_event_new_sms(PVT_ID(pvt), number, msg);
+		manager_event_new_sms_base64(PVT_ID(pvt), number, text_base64);
+		if (CONF_SHARED(pvt, dispatch) == DC_DISPATCH_MESSAGE)
+			start_local_message (pvt, "sms", number, msg, vars);
+		else
+			start_local_channel (pvt, "sms", number, vars);
+	}
+}
+
+struct sms_concat_arg
+{
+	struct pvt	* pvt;
+	const char	* cmgr;				/*!< response with part just added, empty on timeout */
+};
+
+#/* concat_deliver_t for assembled SMS */
+static void at_sms_concat_deliver (void * arg, const char * number, const char * text, size_t length, unsigned missing)
+{
+	const struct sms_concat_arg * sca = arg;
+
+	/* only complete message contain part of current response, expired and evicted are other messages */
+	if (missing)
+	{
+		ast_log (LOG_WARNING, "[%s] Incomplete SMS from %s, %u parts lost\n", PVT_ID(sca->pvt), number, missing);
+		at_sms_deliver (sca->pvt, number, text, length, "");
+	}
+	else
+		at_sms_deliver (sca->pvt, number, text, length, sca->cmgr);
+}
+
+/*!
+ * \brief Deliver incomplete concatenated SMS waiting too long for missing parts
+ * \param pvt -- pvt structure
+ */
+EXPORT_DEF void at_sms_expire (struct pvt* pvt)
+{
+	struct sms_concat_arg arg = { pvt, "" };
+
+	if (pvt->concat.msgs)
+	{
+		concat_expire (&pvt->concat, time(NULL), at_sms_concat_deliver, &arg);
+		scratch_reset (&pvt->sms_scratch);
+	}
+}
+
+#/* decode parsed SMS to scratch of device, join parts of concatenated message and deliver, resp is response with message */
+static void at_sms_received (struct pvt * pvt, const char * resp, char * oa, str_encoding_t oa_enc, char * msg, str_encoding_t msg_enc, pdu_udh_t * udh)
+{
+	ssize_t		res;
+	char*		text;
+	char*		number;
+	size_t		oa_len;
+	size_t		msg_len;
+
+	/* last chance to define encodings */
+	if (oa_enc == STR_ENCODING_UNKNOWN)
+		oa_enc = pvt->use_ucs2_encoding ? STR_ENCODING_UCS2_HEX : STR_ENCODING_7BIT;
+
+	if (msg_enc == STR_ENCODING_UNKNOWN)
+		msg_enc = pvt->use_ucs2_encoding ? STR_ENCODING_UCS2_HEX : STR_ENCODING_7BIT;
+
+	/* decode number and message, UTF-8 of any encoding take at most twice of encoded length */
+	oa_len = strlen(oa);
+	msg_len = strlen(msg);
+	number = scratch_alloc (&pvt->sms_scratch, oa_len * 2 + 1);
+	text = scratch_alloc (&pvt->sms_scratch, msg_len * 2 + 1);
+	if (!number || !text)
+	{
+		ast_log (LOG_ERROR, "[%s] No memory for SMS, message is '%s'\n", PVT_ID(pvt), resp);
+		return;
+	}
+
+	res = str_recode (RECODE_DECODE, oa_enc, oa, oa_len, number, oa_len * 2 + 1);
+	if (res < 0)
+	{
+		ast_log (LOG_ERROR, "[%s] Error decode SMS originator address: '%s', message is '%s'\n", PVT_ID(pvt), oa, resp);
+		return;
+	}
+
+	if (msg_enc == STR_ENCODING_7BIT_HEX)
+	{
+		/* UDH of 7-bit message packed as leading septets */
+		res = gsm7_decode_hex (msg, msg_len, udh->skip, udh->septets, text, msg_len * 2 + 1);
+	}
+	else
+	{
+		res = str_recode (RECODE_DECODE, msg_enc, msg, msg_len, text, msg_len * 2 + 1);
+	}
+	if (res < 0)
+	{
+		ast_log (LOG_ERROR, "[%s] Error decode SMS text '%s' from encoding %d, message is '%s'\n", PVT_ID(pvt), msg, msg_enc, resp);
+		return;
+	}
+	msg = text;
+	msg_len = res;
+
+	if (udh->total > 1)
+	{
+		struct sms_concat_arg arg = { pvt, resp };
+
+		ast_debug (1, "[%s] Got part %u of %u of SMS %u from %s\n", PVT_ID(pvt), udh->seq, udh->total, udh->ref, number);
+		if (concat_add (&pvt->concat, number, udh->ref, udh->total, udh->seq, msg, msg_len, time(NULL), at_sms_concat_deliver, &arg) >= 0)
+			return;
+	}
+
+	at_sms_deliver (pvt, number, msg, msg_len, resp);
+}
+
 /*!
  * \brief Handle +CMGR response
  * \param pvt -- pvt structure
@@ -1172,19 +1355,14 @@ static int at_response_cmti (struct pvt* pvt, const char* str)
 
 static int at_response_cmgr (struct pvt* pvt, const char * str, size_t len)
 {
-	char		oa[512] = "";
+	char*		oa = NULL;
 	char*		msg = NULL;
 	str_encoding_t	oa_enc;
 	str_encoding_t	msg_enc;
 	const char*	err;
 	char*		err_pos;
 	char*		cmgr;
-	ssize_t		res;
-	char		sms_utf8_str[4096];
-	char*		number;
-	char		from_number_utf8_str[1024];
-	char		text_base64[16384];
-	size_t		msg_len;
+	pdu_udh_t	udh;
 
 	const struct at_queue_cmd * ecmd = at_queue_head_cmd (pvt);
 
@@ -1197,62 +1375,22 @@ static int at_response_cmgr (struct pvt* pvt, const char * str, size_t len)
 		pvt->incoming_sms = 0;
 		pvt_try_restate(pvt);
 
-		cmgr = err_pos = ast_strdupa (str);
-		err = at_parse_cmgr (&err_pos, len, oa, sizeof(oa), &oa_enc, &msg, &msg_enc);
+		cmgr = err_pos = scratch_strndup (&pvt->sms_scratch, str, len);
+		oa = scratch_alloc (&pvt->sms_scratch, SMS_OA_MAX);
+		if (!cmgr || !oa)
+			err = "No memory";
+		else
+			err = at_parse_cmgr (&err_pos, len, oa, SMS_OA_MAX, &oa_enc, &msg, &msg_enc, &udh);
 		if (err)
 		{
 			ast_log (LOG_WARNING, "[%s] Error parsing incoming message '%s' at possition %d: %s\n", PVT_ID(pvt), str, (int)(err_pos - cmgr), err);
-			return 0;
-		}
-
-		ast_debug (1, "[%s] Successfully read SMS message\n", PVT_ID(pvt));
-
-		/* last chance to define encodings */
-		if (oa_enc == STR_ENCODING_UNKNOWN)
-			oa_enc = pvt->use_ucs2_encoding ? STR_ENCODING_UCS2_HEX : STR_ENCODING_7BIT;
-
-		if (msg_enc == STR_ENCODING_UNKNOWN)
-			msg_enc = pvt->use_ucs2_encoding ? STR_ENCODING_UCS2_HEX : STR_ENCODING_7BIT;
-
-		/* decode number and message */
-		res = str_recode (RECODE_DECODE, oa_enc, oa, strlen(oa), from_number_utf8_str, sizeof (from_number_utf8_str));
-		if (res < 0)
-		{
-			ast_log (LOG_ERROR, "[%s] Error decode SMS originator address: '%s', message is '%s'\n", PVT_ID(pvt), oa, str);
-			number = oa;
-			return 0;
-		}
-		else
-			number = from_number_utf8_str;
-
-		msg_len = strlen(msg);
-		res = str_recode (RECODE_DECODE, msg_enc, msg, msg_len, sms_utf8_str, sizeof (sms_utf8_str));
-		if (res < 0)
-		{
-			ast_log (LOG_ERROR, "[%s] Error decode SMS text '%s' from encoding %d, message is '%s'\n", PVT_ID(pvt), msg, msg_enc, str);
-			return 0;
 		}
 		else
 		{
-			msg = sms_utf8_str;
-			msg_len = res;
-		}
-
-		ast_verb (1, "[%s] Got SMS from %s: '%s'\n", PVT_ID(pvt), number, msg);
-		ast_base64encode (text_base64, (unsigned char*)msg, msg_len, sizeof(text_base64));
-
-		manager_event_new_sms(PVT_ID(pvt), number, msg);
-		manager_event_new_sms_base64(PVT_ID(pvt), number, text_base64);
-		{
-			channel_var_t vars[] = 
-			{
-				{ "SMS", msg } ,
-				{ "SMS_BASE64", text_base64 },
-				{ "CMGR", (char *)str },
-				{ NULL, NULL },
-			};
-			start_local_channel (pvt, "sms", number, vars);
+			ast_debug (1, "[%s] Successfully read SMS message\n", PVT_ID(pvt));
+			at_sms_received (pvt, str, oa, oa_enc, msg, msg_enc, &udh);
 		}
+		scratch_reset (&pvt->sms_scratch);
 	    }
 	    else
 	    {
@@ -1268,6 +1406,112 @@ static int at_response_cmgr (struct pvt* pvt, const char * str, size_t len)
 	return 0;
 }
 
+/*!
+ * \brief Handle one message of +CMGL response
+ * \param pvt -- pvt structure
+ * \param str -- string containing response (null terminated)
+ * \param len -- string lenght
+ * \retval  0 success
+ * \retval -1 error
+ */
+
+static int at_response_cmgl (struct pvt* pvt, const char * str, size_t len)
+{
+	char*		oa = NULL;
+	char*		msg = NULL;
+	str_encoding_t	oa_enc;
+	str_encoding_t	msg_enc;
+	const char*	err;
+	char*		err_pos;
+	char*		cmgl;
+	int		index;
+	pdu_udh_t	udh;
+
+	const struct at_queue_cmd * ecmd = at_queue_head_cmd (pvt);
+
+	if (!ecmd || (ecmd->cmd != CMD_AT_CMGL && ecmd->cmd != CMD_USER))
+	{
+		ast_log (LOG_WARNING, "[%s] Received unexpected '+CMGL'\n", PVT_ID(pvt));
+		return 0;
+	}
+
+	pvt->sms_listed++;
+	cmgl = err_pos = scratch_strndup (&pvt->sms_scratch, str, len);
+	oa = scratch_alloc (&pvt->sms_scratch, SMS_OA_MAX);
+	if (!cmgl || !oa)
+		err = "No memory";
+	else
+		err = at_parse_cmgl (&err_pos, len, &index, oa, SMS_OA_MAX, &oa_enc, &msg, &msg_enc, &udh);
+	if (err)
+	{
+		ast_log (LOG_WARNING, "[%s] Error parsing stored message '%s' at possition %d: %s\n", PVT_ID(pvt), str, (int)(err_pos - cmgl), err);
+	}
+	else
+	{
+		ast_debug (1, "[%s] Successfully read SMS message %d from storage\n", PVT_ID(pvt), index);
+		/* already delivered, not read again by +CMTI received while listing */
+		if (index >= 0 && index < SMS_INDEX_MAX)
+			pvt->sms_cmti[index / 8] &= ~(1 << (index % 8));
+		at_sms_received (pvt, str, oa, oa_enc, msg, msg_enc, &udh);
+	}
+	scratch_reset (&pvt->sms_scratch);
+
+	return 0;
+}
+
+/*!
+ * \brief Handle +CMT unsolicited response of SMS routed directly to TE
+ * \param pvt -- pvt structure
+ * \param str -- string containing response (null terminated)
+ * \param len -- string lenght
+ * \retval  0 success
+ * \retval -1 error
+ */
+
+static int at_response_cmt (struct pvt* pvt, const char * str, size_t len)
+{
+	char*		oa = NULL;
+	char*		msg = NULL;
+	str_encoding_t	oa_enc;
+	str_encoding_t	msg_enc;
+	const char*	err;
+	char*		err_pos;
+	char*		cmt;
+	pdu_udh_t	udh;
+
+	manager_event_message("DongleNewCMT", PVT_ID(pvt), str);
+
+	/* acknowledge before decode and before drop, without it device wait and stop delivery of next messages */
+	if (pvt->use_cnma && at_enque_cnma (&pvt->sys_chan))
+		ast_log (LOG_ERROR, "[%s] Error schedule acknowledgement of SMS\n", PVT_ID(pvt));
+
+	if (CONF_SHARED(pvt, disablesms))
+	{
+		/* only until restart by reload, initialization not select direct delivery with disablesms */
+		ast_log (LOG_WARNING, "[%s] SMS reception has been disabled in the configuration.\n", PVT_ID(pvt));
+		return 0;
+	}
+
+	cmt = err_pos = scratch_strndup (&pvt->sms_scratch, str, len);
+	oa = scratch_alloc (&pvt->sms_scratch, SMS_OA_MAX);
+	if (!cmt || !oa)
+		err = "No memory";
+	else
+		err = at_parse_cmt (&err_pos, len, oa, SMS_OA_MAX, &oa_enc, &msg, &msg_enc, &udh);
+	if (err)
+	{
+		ast_log (LOG_WARNING, "[%s] Error parsing incoming message '%s' at possition %d: %s\n", PVT_ID(pvt), str, (int)(err_pos - cmt), err);
+	}
+	else
+	{
+		ast_debug (1, "[%s] Successfully received SMS message\n", PVT_ID(pvt));
+		at_sms_received (pvt, str, oa, oa_enc, msg, msg_enc, &udh);
+	}
+	scratch_reset (&pvt->sms_scratch);
+
+	return 0;
+}
+
 /*!
  * \brief Send an SMS message from the queue.
  * \param pvt -- pvt structure
@@ -1295,6 +1539,58 @@ static int at_response_sms_prompt (struct pvt* pvt)
 	return 0;
 }
 
+static const char * const ussd_types[] = {
+	"USSD Notify",
+	"USSD Request",
+	"USSD Terminated by network",
+	"Other local client has responded",
+	"Operation not supported",
+	"Network time out",
+};
+
+#/* pass USSD answer of request id (0 if none) to manager and dialplan, text may be changed */
+EXPORT_DEF void at_ussd_deliver (struct pvt * pvt, uint64_t id, int type, char * text, size_t length)
+{
+	char		typebuf[2];
+	char		idbuf[24];
+	const char*	typestr;
+
+	typestr = enum2str(type, ussd_types, ITEMS_OF(ussd_types));
+
+	typebuf[0] = type + '0';
+	typebuf[1] = 0;
+
+	ast_verb (1, "[%s] Got USSD %llu type %d '%s': '%s'\n", PVT_ID(pvt), (unsigned long long)id, type, typestr, text);
+
+	if (CONF_SHARED(pvt, dispatch) == DC_DISPATCH_MANAGER)
+	{
+		manager_dispatch_new_ussd(PVT_ID(pvt), USSD_ID(id), type, text, length);
+		return;
+	}
+
+	snprintf (idbuf, sizeof (idbuf), "%p", USSD_ID(id));
+	{
+		char		text_base64[BASE64_SIZE(length)];
+		channel_var_t vars[] = 
+		{
+			{ "USSD_TYPE", typebuf },
+			{ "USSD_TYPE_STR", ast_strdupa(typestr) },
+			{ "USSD_ID", idbuf },
+			{ "USSD", text },
+			{ "USSD_BASE64", text_base64 },
+			{ NULL, NULL },
+		};
+
+		base64_encode (text, length, text_base64, sizeof(text_base64));
+		manager_event_new_ussd(PVT_ID(pvt), USSD_ID(id), type, text);
+		manager_event_message("DongleNewUSSDBase64", PVT_ID(pvt), text_base64);
+		if (CONF_SHARED(pvt, dispatch) == DC_DISPATCH_MESSAGE)
+			start_local_message(pvt, "ussd", "ussd", text, vars);
+		else
+			start_local_channel(pvt, "ussd", "ussd", vars);
+	}
+}
+
 /*!
  * \brief Handle CUSD response
  * \param pvt -- pvt structure
@@ -1306,24 +1602,13 @@ static int at_response_sms_prompt (struct pvt* pvt)
 
 static int at_response_cusd (struct pvt * pvt, char * str, size_t len)
 {
-	static const char * const types[] = {
-		"USSD Notify",
-		"USSD Request",
-		"USSD Terminated by network",
-		"Other local client has responded",
-		"Operation not supported",
-		"Network time out",
-	};
-
 	ssize_t		res;
 	int		type;
 	char*		cusd;
 	int		dcs;
-	char		cusd_utf8_str[1024];
-	char		text_base64[16384];
+	char		cusd_utf8_str[USSD_TEXT_MAX];
 	str_encoding_t	ussd_encoding;
-	char		typebuf[2];
-	const char*	typestr;
+	uint64_t	id;
 
 	manager_event_message("DongleNewCUSD", PVT_ID(pvt), str);
 
@@ -1333,16 +1618,11 @@ static int at_response_cusd (struct pvt * pvt, char * str, size_t len)
 		return -1;
 	}
 
-	if(type < 0 || type >= (int)ITEMS_OF(types))
+	if(type < 0 || type >= (int)ITEMS_OF(ussd_types))
 	{
 		ast_log (LOG_WARNING, "[%s] Unknown CUSD type: %d\n", PVT_ID(pvt), type);
 	}
 
-	typestr = enum2str(type, types, ITEMS_OF(types));
-
-	typebuf[0] = type + '0';
-	typebuf[1] = 0;
-
 	// FIXME: strictly check USSD encoding and detect encoding
 	if ((dcs == 0 || dcs == 15) && !pvt->cusd_use_ucs2_decoding)
 		ussd_encoding = STR_ENCODING_7BIT_HEX;
@@ -1356,27 +1636,13 @@ static int at_response_cusd (struct pvt * pvt, char * str, size_t len)
 	else
 	{
 		ast_log (LOG_ERROR, "[%s] Error decode CUSD: %s\n", PVT_ID(pvt), cusd);
+		ussdq_answer (pvt, 4, "", 0);
 		return -1;
 	}
 
-	ast_verb (1, "[%s] Got USSD type %d '%s': '%s'\n", PVT_ID(pvt), type, typestr, cusd);
-	ast_base64encode (text_base64, (unsigned char*)cusd, strlen(cusd), sizeof(text_base64));
-
-	// TODO: pass type
-	manager_event_new_ussd(PVT_ID(pvt), cusd);
-	manager_event_message("DongleNewUSSDBase64", PVT_ID(pvt), text_base64);
-
-	{
-		channel_var_t vars[] = 
-		{
-			{ "USSD_TYPE", typebuf },
-			{ "USSD_TYPE_STR", ast_strdupa(typestr) },
-			{ "USSD", cusd },
-			{ "USSD_BASE64", text_base64 },
-			{ NULL, NULL },
-		};
-		start_local_channel(pvt, "ussd", "ussd", vars);
-	}
+	/* before delivery change text */
+	id = ussdq_answer (pvt, type, cusd, res);
+	at_ussd_deliver (pvt, id, type, cusd, res);
 
 	return 0;
 }
@@ -1418,6 +1684,10 @@ static int at_response_cpin (struct pvt* pvt, char* str, size_t len)
 static int at_response_smmemfull (struct pvt* pvt)
 {
 	ast_log (LOG_ERROR, "[%s] SMS storage is full\n", PVT_ID(pvt));
+
+	if (!CONF_SHARED(pvt, autodeletesms))
+		ast_log (LOG_WARNING, "[%s] autodeletesms is off, read messages stay in storage\n", PVT_ID(pvt));
+	at_sms_drain (pvt);
 	return 0;
 }
 
@@ -1669,16 +1939,8 @@ static void at_response_busy(struct pvt* pvt, enum ast_control_frame_type contro
 	}
 }
 
-/*!
- * \brief Do response
- * \param pvt -- pvt structure
- * \param iovcnt -- number of elements array pvt->d_read_iov
- * \param at_res -- result type
- * \retval  0 success
- * \retval -1 error
- */
-
-int at_response (struct pvt* pvt, const struct iovec iov[2], int iovcnt, at_res_t at_res)
+#/* */
+static int at_response_dispatch (struct pvt* pvt, const struct iovec iov[2], int iovcnt, at_res_t at_res)
 {
 	char*		str;
 	size_t		len;
@@ -1783,6 +2045,12 @@ int at_response (struct pvt* pvt, const struct iovec iov[2], int iovcnt, at_res_
 			case RES_CMGR:
 				return at_response_cmgr (pvt, str, len);
 
+			case RES_CMT:
+				return at_response_cmt (pvt, str, len);
+
+			case RES_CMGL:
+				return at_response_cmgl (pvt, str, len);
+
 			case RES_SMS_PROMPT:
 				return at_response_sms_prompt (pvt);
 
@@ -1863,3 +2131,30 @@ int at_response (struct pvt* pvt, const struct iovec iov[2], int iovcnt, at_res_
 
 	return 0;
 }
+
+/*!
+ * \brief Do response
+ * \param pvt -- pvt structure
+ * \param iovcnt -- number of elements array pvt->d_read_iov
+ * \param at_res -- result type
+ * \retval  0 success
+ * \retval -1 error
+ */
+
+int at_response (struct pvt* pvt, const struct iovec iov[2], int iovcnt, at_res_t at_res)
+{
+	int res;
+	PROBE_TIMER(handle);
+#ifdef BUILD_PROBES
+	const struct at_queue_cmd * ecmd = at_queue_head_cmd(pvt);
+	const char * cmd = ecmd ? at_cmd2str (ecmd->cmd) : "";
+#endif /* BUILD_PROBES */
+
+	PROBE_START(handle);
+	res = at_response_dispatch (pvt, iov, iovcnt, at_res);
+	PROBE_STOP(handle);
+
+	/* command taken before handler, it may remove head of queue */
+	PROBE4(at_response, PVT_ID(pvt), at_res2str (at_res), cmd, handle);
+	return res;
+}
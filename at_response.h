@@ -4,6 +4,9 @@
 #ifndef CHAN_DONGLE_AT_RESPONSE_H_INCLUDED
 #define CHAN_DONGLE_AT_RESPONSE_H_INCLUDED
 
+#include <stdint.h>			/* uint64_t */
+#include <sys/types.h>			/* size_t */
+
 #include "export.h"			/* EXPORT_DECL EXPORT_DEF */
 
 struct pvt;
@@ -55,7 +58,9 @@ typedef enum {
 	RES_CSCA,
 	RES_CLCC,
 	RES_CCWA,
-	RES_MAX = RES_CCWA,
+	RES_CMT,
+	RES_CMGL,
+	RES_MAX = RES_CMGL,
 } at_res_t;
 
 /*! response description */
@@ -81,5 +86,7 @@ typedef struct at_responses_t
 EXPORT_DECL const at_responses_t at_responses;
 EXPORT_DECL const char* at_res2str (at_res_t res);
 EXPORT_DECL int at_response (struct pvt* pvt, const struct iovec * iov, int iovcnt, at_res_t at_res);
+EXPORT_DECL void at_sms_expire (struct pvt* pvt);
+EXPORT_DECL void at_ussd_deliver (struct pvt * pvt, uint64_t id, int type, char * text, size_t length);
 
 #endif /* CHAN_DONGLE_AT_RESPONSE_H_INCLUDED */
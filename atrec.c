@@ -0,0 +1,236 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#ifdef BUILD_ATREC
+
+#include <stdio.h>				/* fopen() fwrite() fflush() fclose() */
+#include <string.h>				/* memcpy() strncpy() */
+#include <errno.h>				/* errno */
+#include <time.h>				/* clock_gettime() */
+#include <pthread.h>				/* pthread_t */
+#include <unistd.h>				/* usleep() */
+
+#include <asterisk.h>
+#include <asterisk/utils.h>			/* ast_calloc() ast_pthread_create_background() */
+#include <asterisk/lock.h>			/* AST_MUTEX_DEFINE_STATIC */
+
+#include "atrec.h"
+#include "chan_dongle.h"			/* gpublic struct pvt */
+
+EXPORT_DEF volatile int atrec_active = 0;
+
+AST_MUTEX_DEFINE_STATIC(atrec_lock);			/* serialize start and stop */
+static pthread_t atrec_thread = AST_PTHREADT_NULL;
+static FILE * atrec_file;
+static char atrec_filename[256];
+static unsigned long atrec_bytes;
+static unsigned long atrec_dropped;
+
+#/* copy to ring with wrap */
+static void atrec_ring_copy(struct atrec_ring * ring, unsigned pos, const void * data, size_t length)
+{
+	size_t offset = pos & (ATREC_RING_SIZE - 1);
+	size_t first = ATREC_RING_SIZE - offset;
+
+	if(first > length)
+		first = length;
+	memcpy(ring->buffer + offset, data, first);
+	memcpy(ring->buffer, (const char *)data + first, length - first);
+}
+
+#/* producer side, never block; length is number of bytes taken from iov */
+EXPORT_DEF void atrec_put(struct atrec * rec, const char * device, atrec_dir_t dir, const struct iovec * iov, int iovcnt, size_t length)
+{
+	struct atrec_ring * ring = &rec->ring[dir];
+	struct atrec_record hdr;
+	struct timespec ts;
+	unsigned head = ring->head;
+	unsigned pos;
+	size_t part;
+	size_t total = 0;
+	int i;
+
+	/* recording may be started between take of iov and read */
+	for(i = 0; i < iovcnt; ++i)
+		total += iov[i].iov_len;
+	if(length > total)
+		length = total;
+	if(length == 0)
+		return;
+
+	if(ATREC_RING_SIZE - (head - ring->tail) < sizeof(hdr) + length)
+	{
+		__sync_fetch_and_add(&ring->dropped, 1);
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.timestamp = ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+	hdr.length = length;
+	hdr.dir = dir;
+	strncpy(hdr.device, device, sizeof(hdr.device));
+
+	atrec_ring_copy(ring, head, &hdr, sizeof(hdr));
+	pos = head + sizeof(hdr);
+	for(i = 0; i < iovcnt && length > 0; ++i)
+	{
+		part = iov[i].iov_len < length ? iov[i].iov_len : length;
+		atrec_ring_copy(ring, pos, iov[i].iov_base, part);
+		pos += part;
+		length -= part;
+	}
+
+	/* publish record after data */
+	__sync_synchronize();
+	ring->head = pos;
+}
+
+#/* consumer side, write all published records to file or discard if file is NULL */
+static void atrec_ring_drain(struct atrec_ring * ring, FILE * file)
+{
+	unsigned head = ring->head;
+	unsigned tail = ring->tail;
+	size_t offset = tail & (ATREC_RING_SIZE - 1);
+	size_t length = head - tail;
+	size_t first = ATREC_RING_SIZE - offset;
+	unsigned dropped;
+
+	__sync_synchronize();
+	if(length)
+	{
+		if(file)
+		{
+			if(first > length)
+				first = length;
+			fwrite(ring->buffer + offset, 1, first, file);
+			fwrite(ring->buffer, 1, length - first, file);
+			atrec_bytes += length;
+		}
+
+		/* free space only after data copied */
+		__sync_synchronize();
+		ring->tail = head;
+	}
+	dropped = __sync_fetch_and_and(&ring->dropped, 0);
+	if(file)
+		atrec_dropped += dropped;
+}
+
+#/* visit all devices, allocate rings for new devices and drain rings */
+static void atrec_drain(FILE * file)
+{
+	struct pvt * pvt;
+	struct atrec * rec;
+	unsigned dir;
+
+	AST_RWLIST_RDLOCK(&gpublic->devices);
+	AST_RWLIST_TRAVERSE(&gpublic->devices, pvt, entry)
+	{
+		if(!pvt->atrec)
+		{
+			rec = ast_calloc(1, sizeof(*rec));
+			if(!rec)
+				continue;
+			__sync_synchronize();
+			pvt->atrec = rec;
+		}
+		for(dir = ATREC_DIR_RX; dir <= ATREC_DIR_TX; ++dir)
+			atrec_ring_drain(&pvt->atrec->ring[dir], file);
+	}
+	AST_RWLIST_UNLOCK(&gpublic->devices);
+}
+
+#/* */
+static void * atrec_run(attribute_unused void * arg)
+{
+	while(atrec_active)
+	{
+		atrec_drain(atrec_file);
+		fflush(atrec_file);
+		usleep(ATREC_FLUSH_INTERVAL * 1000);
+	}
+	atrec_drain(atrec_file);
+	return NULL;
+}
+
+#/* return 0 on success, errno otherwise */
+EXPORT_DEF int atrec_start(const char * path)
+{
+	struct atrec_file_hdr hdr;
+	int err = 0;
+
+	ast_mutex_lock(&atrec_lock);
+	if(atrec_active)
+	{
+		err = EBUSY;
+	}
+	else if(!(atrec_file = fopen(path, "wb")))
+	{
+		err = errno;
+	}
+	else
+	{
+		hdr.magic = ATREC_MAGIC;
+		hdr.version = ATREC_VERSION;
+		hdr.record_size = sizeof(struct atrec_record);
+		fwrite(&hdr, sizeof(hdr), 1, atrec_file);
+
+		ast_copy_string(atrec_filename, path, sizeof(atrec_filename));
+		atrec_bytes = 0;
+		atrec_dropped = 0;
+
+		/* allocate rings and discard records left from previous recording */
+		atrec_drain(NULL);
+		atrec_active = 1;
+		if(ast_pthread_create_background(&atrec_thread, NULL, atrec_run, NULL) < 0)
+		{
+			err = errno;
+			atrec_active = 0;
+			fclose(atrec_file);
+			atrec_file = NULL;
+		}
+	}
+	ast_mutex_unlock(&atrec_lock);
+	return err;
+}
+
+#/* return 0 on success, errno otherwise */
+EXPORT_DEF int atrec_stop(unsigned long * bytes, unsigned long * dropped)
+{
+	int err = 0;
+
+	ast_mutex_lock(&atrec_lock);
+	if(!atrec_active)
+	{
+		err = ENOENT;
+	}
+	else
+	{
+		atrec_active = 0;
+		pthread_join(atrec_thread, NULL);
+		atrec_thread = AST_PTHREADT_NULL;
+		if(fclose(atrec_file))
+			err = errno;
+		atrec_file = NULL;
+
+		if(bytes)
+			*bytes = atrec_bytes;
+		if(dropped)
+			*dropped = atrec_dropped;
+	}
+	ast_mutex_unlock(&atrec_lock);
+	return err;
+}
+
+#/* */
+EXPORT_DEF const char * atrec_path()
+{
+	return atrec_active ? atrec_filename : NULL;
+}
+
+#endif /* BUILD_ATREC */
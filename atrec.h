@@ -0,0 +1,85 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifndef CHAN_DONGLE_ATREC_H_INCLUDED
+#define CHAN_DONGLE_ATREC_H_INCLUDED
+
+#include <stdint.h>			/* uint32_t uint64_t */
+#include <sys/uio.h>			/* struct iovec */
+
+#include "export.h"			/* EXPORT_DECL EXPORT_DEF */
+
+/*
+   Recorder of all bytes readed from and written to data_fd of devices.
+   Device threads put records to own lock free rings and never block,
+   background thread move records to file. Rings allocated on first
+   recording and live until device freed.
+
+   File is struct atrec_file_hdr followed by records: struct atrec_record and
+   length bytes of data. Records of one device and direction are in order,
+   records of different rings ordered by timestamp only.
+*/
+
+#define ATREC_MAGIC			0x52414344			/* 'DCAR' */
+#define ATREC_VERSION			1
+#define ATREC_DEVICE_SIZE		24
+#define ATREC_RING_SIZE			65536				/* bytes of each ring, power of 2 */
+#define ATREC_FLUSH_INTERVAL		50				/* ms between writer thread runs */
+
+typedef enum {
+	ATREC_DIR_RX = 0,						/*!< readed from device */
+	ATREC_DIR_TX,							/*!< written to device */
+} atrec_dir_t;
+
+struct atrec_file_hdr
+{
+	uint32_t		magic;				/*!< ATREC_MAGIC */
+	uint16_t		version;			/*!< ATREC_VERSION */
+	uint16_t		record_size;			/*!< sizeof(struct atrec_record) */
+};
+
+struct atrec_record
+{
+	uint64_t		timestamp;			/*!< monotonic time in microseconds */
+	uint32_t		length;				/*!< bytes of data after record */
+	uint8_t			dir;				/*!< see atrec_dir_t */
+	uint8_t			reserved[3];
+	char			device[ATREC_DEVICE_SIZE];	/*!< device name, may be truncated */
+};
+
+/* single producer single consumer ring of records */
+struct atrec_ring
+{
+	volatile unsigned	head;				/*!< total bytes written by producer */
+	volatile unsigned	tail;				/*!< total bytes consumed by writer thread */
+	volatile unsigned	dropped;			/*!< records not fit to ring */
+	char			buffer[ATREC_RING_SIZE];
+};
+
+/* per device, ring by direction because reader and writers of data_fd are different threads */
+struct atrec
+{
+	struct atrec_ring	ring[2];
+};
+
+#ifdef BUILD_ATREC
+
+EXPORT_DECL volatile int atrec_active;
+
+EXPORT_DECL void atrec_put(struct atrec * rec, const char * device, atrec_dir_t dir, const struct iovec * iov, int iovcnt, size_t length);
+EXPORT_DECL int atrec_start(const char * path);
+EXPORT_DECL int atrec_stop(unsigned long * bytes, unsigned long * dropped);
+EXPORT_DECL const char * atrec_path();
+
+/* record if recording started and rings of device allocated */
+#define ATREC_PUT(rec, device, dir, iov, iovcnt, length)	do { if(__builtin_expect(atrec_active, 0) && (rec)) atrec_put(rec, device, dir, iov, iovcnt, length); } while(0)
+#define ATREC_ON(rec)						(__builtin_expect(atrec_active, 0) && (rec))
+
+#else /* BUILD_ATREC */
+
+#define ATREC_PUT(rec, device, dir, iov, iovcnt, length)
+#define ATREC_ON(rec)						0
+
+#endif /* BUILD_ATREC */
+
+#endif /* CHAN_DONGLE_ATREC_H_INCLUDED */
@@ -0,0 +1,135 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <errno.h>			/* EAGAIN EWOULDBLOCK ENOBUFS */
+#include <fcntl.h>			/* fcntl() O_NONBLOCK FD_CLOEXEC */
+#include <string.h>			/* memset() strncpy() */
+#include <unistd.h>			/* close() */
+#include <sys/socket.h>			/* socket() connect() sendmsg() */
+#include <sys/un.h>			/* struct sockaddr_un */
+#include <sys/time.h>			/* gettimeofday() */
+
+#include <asterisk.h>
+#include <asterisk/logger.h>		/* ast_debug() */
+
+#include "audiotap.h"
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL			0
+#endif
+
+#/* */
+EXPORT_DEF void audiotap_close(struct audiotap * tap)
+{
+	if(tap->fd >= 0)
+	{
+		close(tap->fd);
+		tap->fd = -1;
+	}
+}
+
+#/* return 0 on success */
+static int audiotap_connect(struct audiotap * tap, const char * path)
+{
+	struct sockaddr_un addr;
+	time_t now = time(NULL);
+	int flags;
+	int fd;
+
+	/* not flood with connect() when no consumer */
+	if(now < tap->next_connect)
+		return -ENOTCONN;
+	tap->next_connect = now + AUDIOTAP_RECONNECT_INTERVAL;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(addr.sun_path))
+		return -ENAMETOOLONG;
+	strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+	fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	if(fd < 0)
+		return -errno;
+
+	flags = fcntl(fd, F_GETFL);
+	if(flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1 || fcntl(fd, F_SETFD, FD_CLOEXEC) == -1
+		|| connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	{
+		flags = errno;
+		close(fd);
+		ast_debug(4, "Audio tap connect to '%s' failed: %s\n", path, strerror(flags));
+		return -flags;
+	}
+
+	ast_debug(1, "Audio tap connected to '%s'\n", path);
+	tap->fd = fd;
+	return 0;
+}
+
+#/* */
+EXPORT_DEF int audiotap_send(struct audiotap * tap, const char * path, const char * device, int call_idx, const char * uniqueid, audiotap_dir_t dir, const struct iovec * iov, int iovcnt)
+{
+	struct audiotap_hdr hdr;
+	struct iovec vec[AUDIOTAP_MAX_IOV + 1];
+	struct msghdr msg;
+	struct timeval tv;
+	size_t datalen = 0;
+	int i;
+	int err;
+
+	hdr.seqno = tap->seqno[dir]++;
+	hdr.gap = tap->gap[dir];
+	tap->gap[dir] = 0;
+
+	if(tap->fd < 0)
+	{
+		err = audiotap_connect(tap, path);
+		if(err)
+			return err;
+	}
+
+	if(iovcnt > AUDIOTAP_MAX_IOV)
+		return -E2BIG;
+
+	vec[0].iov_base = &hdr;
+	vec[0].iov_len = sizeof(hdr);
+	for(i = 0; i < iovcnt; ++i)
+	{
+		vec[i + 1] = iov[i];
+		datalen += iov[i].iov_len;
+	}
+
+	gettimeofday(&tv, NULL);
+	hdr.magic = AUDIOTAP_MAGIC;
+	hdr.version = AUDIOTAP_VERSION;
+	hdr.dir = dir;
+	hdr.call_idx = call_idx < 0 ? AUDIOTAP_CALL_IDX_NONE : call_idx;
+	hdr.datalen = datalen;
+	hdr.reserved = 0;
+	hdr.timestamp = (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+	strncpy(hdr.device, device, sizeof(hdr.device) - 1);
+	hdr.device[sizeof(hdr.device) - 1] = 0;
+	strncpy(hdr.uniqueid, uniqueid, sizeof(hdr.uniqueid) - 1);
+	hdr.uniqueid[sizeof(hdr.uniqueid) - 1] = 0;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = vec;
+	msg.msg_iovlen = iovcnt + 1;
+
+	if(sendmsg(tap->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0)
+	{
+		err = errno;
+		if(err == EAGAIN || err == EWOULDBLOCK || err == ENOBUFS)
+			return -EAGAIN;
+
+		/* consumer gone, reconnect later */
+		ast_debug(1, "Audio tap '%s' write failed: %s\n", path, strerror(err));
+		audiotap_close(tap);
+		return -err;
+	}
+	return 0;
+}
@@ -0,0 +1,81 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifndef CHAN_DONGLE_AUDIOTAP_H_INCLUDED
+#define CHAN_DONGLE_AUDIOTAP_H_INCLUDED
+
+#include <stdint.h>			/* uint32_t uint64_t */
+#include <time.h>			/* time_t */
+#include <sys/uio.h>			/* struct iovec */
+
+#include "export.h"			/* EXPORT_DECL EXPORT_DEF */
+
+/*
+   Each frame is one SOCK_SEQPACKET datagram: struct audiotap_hdr followed by
+   datalen bytes of signed linear 16 bit 8000Hz little endian samples
+
+   Silence suppressed by VAD (and idle writes of silence to device) not
+   sent, gap of next frame is number of silent samples to insert before its
+   data. Long silence is reported by frames without data every
+   AUDIOTAP_GAP_FLUSH samples, so stream stay complete within that.
+*/
+#define AUDIOTAP_MAGIC			0x50415444			/* 'DTAP' */
+#define AUDIOTAP_VERSION		2
+#define AUDIOTAP_DEVICE_SIZE		32
+#define AUDIOTAP_UNIQUEID_SIZE		64
+#define AUDIOTAP_CALL_IDX_NONE		0xFF
+#define AUDIOTAP_MAX_IOV		4				/* max number of data pieces in one frame */
+#define AUDIOTAP_RECONNECT_INTERVAL	5				/* seconds between connect attempts */
+#define AUDIOTAP_GAP_FLUSH		8000				/* samples of silence reported without waiting for next data */
+
+typedef enum {
+	AUDIOTAP_DIR_RX = 0,						/*!< audio readed from device */
+	AUDIOTAP_DIR_TX,						/*!< audio written to device */
+} audiotap_dir_t;
+
+struct audiotap_hdr
+{
+	uint32_t		magic;				/*!< AUDIOTAP_MAGIC */
+	uint16_t		version;			/*!< AUDIOTAP_VERSION */
+	uint8_t			dir;				/*!< see audiotap_dir_t */
+	uint8_t			call_idx;			/*!< device call index or AUDIOTAP_CALL_IDX_NONE */
+	uint32_t		seqno;				/*!< incremented on each frame of same direction include dropped */
+	uint32_t		datalen;			/*!< number of bytes of samples after header */
+	uint32_t		gap;				/*!< number of silent samples not sent before this frame */
+	uint32_t		reserved;			/*!< zero */
+	uint64_t		timestamp;			/*!< wall clock time of frame in microseconds */
+	char			device[AUDIOTAP_DEVICE_SIZE];	/*!< device name from dongle.conf */
+	char			uniqueid[AUDIOTAP_UNIQUEID_SIZE];/*!< channel uniqueid, empty if not known */
+};
+
+struct audiotap
+{
+	int			fd;				/*!< connected socket or -1 */
+	uint32_t		seqno[2];			/*!< sequence number of next frame by direction */
+	uint32_t		gap[2];				/*!< silent samples not sent yet by direction */
+	time_t			next_connect;			/*!< not try connect before this time */
+};
+
+INLINE_DECL void audiotap_init(struct audiotap * tap)
+{
+	tap->fd = -1;
+	tap->seqno[AUDIOTAP_DIR_RX] = 0;
+	tap->seqno[AUDIOTAP_DIR_TX] = 0;
+	tap->gap[AUDIOTAP_DIR_RX] = 0;
+	tap->gap[AUDIOTAP_DIR_TX] = 0;
+	tap->next_connect = 0;
+}
+
+/* account silent samples instead of sending them, return non-zero when gap should be sent by frame without data */
+INLINE_DECL int audiotap_gap(struct audiotap * tap, audiotap_dir_t dir, unsigned samples)
+{
+	tap->gap[dir] += samples;
+	return tap->gap[dir] >= AUDIOTAP_GAP_FLUSH;
+}
+
+EXPORT_DECL void audiotap_close(struct audiotap * tap);
+
+/* never block, send pending gap with frame, iovcnt may be 0; return 0 if frame sent, -EAGAIN if consumer too slow or other negative errno */
+EXPORT_DECL int audiotap_send(struct audiotap * tap, const char * path, const char * device, int call_idx, const char * uniqueid, audiotap_dir_t dir, const struct iovec * iov, int iovcnt);
+
+#endif /* CHAN_DONGLE_AUDIOTAP_H_INCLUDED */
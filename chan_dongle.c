@@ -53,7 +53,7 @@ ASTERISK_FILE_VERSION(__FILE__, "$Rev: " PACKAGE_REVISION " $")
 #include <signal.h>			/* SIGURG */
 
 #include "chan_dongle.h"
-#include "at_response.h"		/* at_res_t */
+#include "at_response.h"		/* at_res_t at_sms_expire() */
 #include "at_queue.h"			/* struct at_queue_task_cmd at_queue_head_cmd() */
 #include "at_command.h"			/* at_cmd2str() */
 #include "mutils.h"			/* ITEMS_OF() */
@@ -61,6 +61,10 @@ ASTERISK_FILE_VERSION(__FILE__, "$Rev: " PACKAGE_REVISION " $")
 #include "cli.h"
 #include "app.h"
 #include "manager.h"
+#include "metrics.h"			/* metrics_register() metrics_unregister() */
+#include "smsq.h"			/* smsq_init() smsq_stop() smsq_fini() smsq_device_reset() */
+#include "ussdq.h"			/* ussdq_init() ussdq_stop() ussdq_fini() ussdq_device_expire() ussdq_device_reset() */
+#include "dispatch.h"			/* dispatch_init() dispatch_fini() dispatch_stat_read() */
 #include "channel.h"			/* channel_queue_hangup() */
 #include "dc_config.h"			/* dc_uconfig_fill() dc_gconfig_fill() dc_sconfig_fill()  */
 #include "pdiscovery.h"			/* pdiscovery_lookup() pdiscovery_init() pdiscovery_fini() */
@@ -265,6 +269,8 @@ static void disconnect_dongle (struct pvt* pvt)
 		}
 	}
 	at_queue_flush(pvt);
+	smsq_device_reset(pvt);
+	ussdq_device_reset(pvt);
 	pvt->last_dialed_cpvt = NULL;
 
 	closetty (pvt->audio_fd, &pvt->alock);
@@ -309,11 +315,13 @@ static void disconnect_dongle (struct pvt* pvt)
 		pvt->has_voice = 0;
 		pvt->has_call_waiting = 0;
 		pvt->use_pdu = 0;
+		pvt->use_cnma = 0;
 	}
 
 	pvt->connected		= 0;
 	pvt->initialized	= 0;
 	pvt->use_pdu		= 0;
+	pvt->use_cnma		= 0;
 	pvt->has_call_waiting	= 0;
 
 	/* FIXME: LOST real device state */
@@ -322,6 +330,8 @@ static void disconnect_dongle (struct pvt* pvt)
 	pvt->cwaiting = 0;
 	pvt->outgoing_sms = 0;
 	pvt->incoming_sms = 0;
+	pvt->sms_drain = 0;
+	memset(pvt->sms_cmti, 0, sizeof(pvt->sms_cmti));
 	pvt->volume_sync_step = VOLUME_SYNC_BEGIN;
 
 	pvt->current_state = DEV_STATE_STOPPED;
@@ -332,6 +342,8 @@ static void disconnect_dongle (struct pvt* pvt)
 	ast_copy_string (PVT_STATE(pvt, data_tty),  CONF_UNIQ(pvt, data_tty), sizeof (PVT_STATE(pvt, data_tty)));
 	ast_copy_string (PVT_STATE(pvt, audio_tty), CONF_UNIQ(pvt, audio_tty), sizeof (PVT_STATE(pvt, audio_tty)));
 
+	pvt_state_publish(pvt);
+
 	ast_verb (3, "[%s] Dongle has disconnected\n", PVT_ID(pvt));
 
 	manager_event_device_status(PVT_ID(pvt), "Disconnect");
@@ -376,6 +388,8 @@ static void* do_monitor_phone (void* data)
 	struct ringbuffer rb;
 	struct iovec	iov[2];
 	int		iovcnt;
+	struct iovec	rec_iov[2];
+	int		rec_iovcnt;
 	char		dev[sizeof(PVT_ID(pvt))];
 	int 		fd;
 	int		read_result = 0;
@@ -388,6 +402,7 @@ static void* do_monitor_phone (void* data)
 	/* 4 reduce locking time make copy of this readonly fields */
 	fd = pvt->data_fd;
 	ast_copy_string(dev, PVT_ID(pvt), sizeof(dev));
+	scratch_stack_base (&pvt->sms_scratch, &fd);
 
 	clean_read_data(dev, fd);
 	
@@ -417,6 +432,10 @@ static void* do_monitor_phone (void* data)
 			goto e_restart;
 		}
 
+		/* not more often than responses or ping */
+		at_sms_expire(pvt);
+		ussdq_device_expire(pvt);
+
 		t = at_queue_timeout(pvt);
 		if(t < 0)
 			t = pvt->timeout;
@@ -438,13 +457,19 @@ static void* do_monitor_phone (void* data)
 		}
 
 		/* FIXME: access to device not locked */
+		rec_iovcnt = 0;
+		if (ATREC_ON(pvt->atrec))
+			rec_iovcnt = rb_write_iov (&rb, rec_iov);
 		iovcnt = at_read (fd, dev, &rb);
 		if (iovcnt < 0)
 		{
 			break;
 		}
+		ATREC_PUT(pvt->atrec, dev, ATREC_DIR_RX, rec_iov, rec_iovcnt, iovcnt);
 
+		ast_mutex_lock (&pvt->lock);
 		PVT_STAT(pvt, d_read_bytes) += iovcnt;
+		ast_mutex_unlock (&pvt->lock);
 		while ((iovcnt = at_read_result_iov (dev, &read_result, &rb, iov)) > 0)
 		{
 			at_res = at_read_result_classification (&rb, iov[0].iov_len + iov[1].iov_len);
@@ -455,6 +480,7 @@ static void* do_monitor_phone (void* data)
 			{
 				goto e_cleanup;
 			}
+			pvt_state_publish(pvt);
 			ast_mutex_unlock (&pvt->lock);
 		}
 	}
@@ -470,6 +496,7 @@ e_cleanup:
 	pvt->terminate_monitor = 0;
 
 e_restart:
+	scratch_stack_base (&pvt->sms_scratch, NULL);
 	disconnect_dongle (pvt);
 //	pvt->monitor_running = 0;
 	ast_mutex_unlock (&pvt->lock);
@@ -605,12 +632,42 @@ static void pvt_start(struct pvt * pvt)
 	}
 }
 
+#/* assign selection index slot, called with devices list write lock hold; return 0 on success */
+static int pvt_devsel_add(public_state_t * state, struct pvt * pvt)
+{
+	ast_mutex_lock(&state->devsel_lock);
+	pvt->devsel_slot = devsel_add(&state->devsel, pvt, PVT_ID(pvt), CONF_SHARED(pvt, group));
+	ast_mutex_unlock(&state->devsel_lock);
+
+	return pvt->devsel_slot < 0;
+}
+
+#/* release selection index slot, called with devices list write lock hold */
+static void pvt_devsel_remove(public_state_t * state, struct pvt * pvt)
+{
+	if(pvt->devsel_slot >= 0)
+	{
+		ast_mutex_lock(&state->devsel_lock);
+		devsel_remove(&state->devsel, pvt->devsel_slot);
+		ast_mutex_unlock(&state->devsel_lock);
+		pvt->devsel_slot = -1;
+	}
+}
+
 #/* */
 static void pvt_free(struct pvt * pvt)
 {
 	at_queue_flush(pvt);
+	smsq_device_reset(pvt);
+	ussdq_device_reset(pvt);
+	if(pvt->concat.count)
+		ast_log(LOG_WARNING, "[%s] %u incomplete SMS dropped\n", PVT_ID(pvt), pvt->concat.count);
+	concat_destroy(&pvt->concat);
+	scratch_reset(&pvt->sms_scratch);
 	if(pvt->dsp)
 		ast_dsp_free(pvt->dsp);
+	audiotap_close(&pvt->a_tap);
+	ast_free(pvt->atrec);
 
 	ast_mutex_unlock(&pvt->lock);
 
@@ -659,6 +716,8 @@ static void * do_discovery(void * arg)
 						pvt_stop(pvt);
 				}
 			}
+			/* also resync index and status on each discovery pass */
+			pvt_state_publish(pvt);
 			ast_mutex_unlock (&pvt->lock);
 		}
 		AST_RWLIST_UNLOCK (&state->devices);
@@ -671,6 +730,7 @@ static void * do_discovery(void * arg)
 			if(pvt->must_remove)
 			{
 				AST_RWLIST_REMOVE_CURRENT(entry);
+				pvt_devsel_remove(state, pvt);
 				pvt_free(pvt);
 			} else
 				ast_mutex_unlock(&pvt->lock);
@@ -761,6 +821,7 @@ EXPORT_DEF void pvt_on_remove_last_channel(struct pvt* pvt)
 		ast_timer_close(pvt->a_timer);
 		pvt->a_timer = NULL;
 	}
+	audiotap_close(&pvt->a_tap);
 	manager_event_device_status(PVT_ID(pvt), "Free");
 }
 
@@ -880,21 +941,113 @@ static int can_dial(struct pvt* pvt, int opts, const struct ast_channel * reques
 	return ready4voice_call(pvt, NULL, opts);
 }
 
+#/* weighted score for w<group> selection, each part normalized to 0..100 */
+static int pvt_score(const struct pvt * pvt)
+{
+	unsigned rssi = 0;
+	unsigned asr = 50;
+	unsigned queue;
+	unsigned budget = 100;
+	unsigned used;
+
+	/* +CSQ 0..31, 99 mean unknown */
+	if(pvt->rssi > 0 && pvt->rssi <= 31)
+		rssi = pvt->rssi * 100 / 31;
+
+	/* neutral until enought calls for statistics */
+	if(PVT_STAT(pvt, out_calls) >= 5)
+		asr = PVT_STAT(pvt, calls_answered[CALL_DIR_OUTGOING]) * 100 / PVT_STAT(pvt, out_calls);
+
+	queue = 100 / (1 + PVT_STATE(pvt, at_tasks));
+
+	if(CONF_SHARED(pvt, minutebudget))
+	{
+		used = PVT_STAT(pvt, calls_duration[CALL_DIR_OUTGOING]) / 60;
+		if(used >= (unsigned)CONF_SHARED(pvt, minutebudget))
+			return DEVSEL_SCORE_EXCLUDED;
+		budget = 100 - used * 100 / CONF_SHARED(pvt, minutebudget);
+	}
+
+	return CONF_GLOBAL(weight_rssi) * rssi + CONF_GLOBAL(weight_asr) * asr + CONF_GLOBAL(weight_queue) * queue + CONF_GLOBAL(weight_budget) * budget;
+}
+
+#/* sync device selection index with device state */
+static void pvt_devsel_update(struct pvt * pvt)
+{
+	struct devsel * ds = &gpublic->devsel;
+	int slot = pvt->devsel_slot;
+
+	if(slot < 0)
+		return;
+
+	/* keys of slot written only under pvt lock, compare without devsel lock */
+	if(DEVSEL_FIELD(ds, slot, group) != CONF_SHARED(pvt, group) || devsel_provider_changed(ds, slot, pvt->provider_name)
+		|| devsel_key_changed(ds, slot, DEVSEL_HASH_IMEI, pvt->imei) || devsel_key_changed(ds, slot, DEVSEL_HASH_IMSI, pvt->imsi))
+	{
+		ast_mutex_lock(&gpublic->devsel_lock);
+		if(devsel_set_group(ds, slot, CONF_SHARED(pvt, group)) || devsel_set_provider(ds, slot, pvt->provider_name))
+			ast_log (LOG_ERROR, "[%s] Can't update device selection index, out of memory\n", PVT_ID(pvt));
+		devsel_set_key(ds, slot, DEVSEL_HASH_IMEI, pvt->imei);
+		devsel_set_key(ds, slot, DEVSEL_HASH_IMSI, pvt->imsi);
+		ast_mutex_unlock(&gpublic->devsel_lock);
+	}
+
+	devsel_set_score(ds, slot, pvt_score(pvt));
+	devsel_set_ready(ds, slot, DEVSEL_READY_VOICE, ready4voice_call(pvt, NULL, 0));
+	devsel_set_ready(ds, slot, DEVSEL_READY_HOLD, ready4voice_call(pvt, NULL, CALL_FLAG_HOLD_OTHER));
+}
+
+#/* publish device state for lock free readers, called with pvt lock hold after state changes */
+EXPORT_DEF void pvt_state_publish(struct pvt * pvt)
+{
+	pvt_devsel_update(pvt);
+	pvt_status_update(pvt);
+}
+
+#/* copy statistics counters, take device lock for consistent snapshot */
+EXPORT_DEF void pvt_stat_read(struct pvt * pvt, pvt_stat_t * stat)
+{
+	ast_mutex_lock (&pvt->lock);
+	memcpy(stat, &pvt->stat, sizeof(*stat));
+	ast_mutex_unlock (&pvt->lock);
+}
+
+#/* copy last published status of device by name without lock of device; return 0 on success */
+EXPORT_DEF int pvt_status_find(struct public_state * state, const char * name, pvt_status_t * status)
+{
+	struct pvt * pvt = NULL;
+	int slot;
+
+	AST_RWLIST_RDLOCK(&state->devices);
+	ast_mutex_lock(&state->devsel_lock);
+	slot = devsel_lookup(&state->devsel, DEVSEL_HASH_ID, name);
+	if(slot >= 0)
+		pvt = DEVSEL_OWNER(&state->devsel, slot);
+	ast_mutex_unlock(&state->devsel_lock);
+
+	if(pvt)
+		pvt_status_read(pvt, status);
+	AST_RWLIST_UNLOCK(&state->devices);
+
+	return pvt == NULL;
+}
+
 #/* return locked pvt or NULL */
 EXPORT_DEF struct pvt * find_device_ex(struct public_state * state, const char * name)
 {
-	struct pvt * pvt;
+	struct pvt * pvt = NULL;
+	int slot;
 
 	AST_RWLIST_RDLOCK(&state->devices);
-	AST_RWLIST_TRAVERSE(&state->devices, pvt, entry)
-	{
+	ast_mutex_lock(&state->devsel_lock);
+	slot = devsel_lookup(&state->devsel, DEVSEL_HASH_ID, name);
+	if(slot >= 0)
+		pvt = DEVSEL_OWNER(&state->devsel, slot);
+	ast_mutex_unlock(&state->devsel_lock);
+
+	/* device id never changed and owner stable while devices list locked */
+	if(pvt)
 		ast_mutex_lock (&pvt->lock);
-		if (!strcmp (PVT_ID(pvt), name))
-		{
-			break;
-		}
-		ast_mutex_unlock (&pvt->lock);
-	}
 	AST_RWLIST_UNLOCK(&state->devices);
 
 	return pvt;
@@ -922,243 +1075,168 @@ EXPORT_DEF struct pvt * find_device_ext (const char * name, const char ** reason
 	return pvt;
 }
 
-#/* like find_device but for resource spec; return locked! pvt or NULL */
-EXPORT_DEF struct pvt * find_device_by_resource_ex(struct public_state * state, const char * resource, int opts, const struct ast_channel * requestor, int * exists)
+#/* lock and recheck candidates starting after last used slot; return locked pvt or NULL */
+static struct pvt * devsel_pick(struct public_state * state, const devsel_word_t * candidates, unsigned words, int last_used, int opts, const struct ast_channel * requestor)
 {
-	int group;
-	size_t i;
-	size_t j;
-	size_t c;
-	size_t last_used;
 	struct pvt * pvt;
-	struct pvt * found = NULL;
-	struct pvt * round_robin[MAXDONGLEDEVICES];
-
-	*exists = 0;
-	/* Find requested device and make sure it's connected and initialized. */
-	AST_RWLIST_RDLOCK(&state->devices);
+	int first = -1;
+	int slot = last_used;
 
-	if (((resource[0] == 'g') || (resource[0] == 'G')) && ((resource[1] >= '0') && (resource[1] <= '9')))
+	/* owners stable while devices list locked */
+	while((slot = devsel_next(candidates, words, slot)) >= 0 && slot != first)
 	{
-		errno = 0;
-		group = (int) strtol (&resource[1], (char**) NULL, 10);
-		if (errno != EINVAL)
-		{
-			AST_RWLIST_TRAVERSE(&state->devices, pvt, entry)
-			{
-				ast_mutex_lock (&pvt->lock);
+		if(first < 0)
+			first = slot;
 
-				if (CONF_SHARED(pvt, group) == group)
-				{
-					*exists = 1;
-					if(can_dial(pvt, opts, requestor))
-					{
-						found = pvt;
-						break;
-					}
-				}
-				ast_mutex_unlock (&pvt->lock);
-			}
-		}
+		pvt = DEVSEL_OWNER(&state->devsel, slot);
+		ast_mutex_lock (&pvt->lock);
+		if (can_dial(pvt, opts, requestor))
+			return pvt;
+		ast_mutex_unlock (&pvt->lock);
 	}
-	else if (((resource[0] == 'r') || (resource[0] == 'R')) && ((resource[1] >= '0') && (resource[1] <= '9')))
+	return NULL;
+}
+
+#/* lock and recheck candidates in order of score; return locked pvt or NULL */
+static struct pvt * devsel_pick_best(struct public_state * state, devsel_word_t * candidates, unsigned words, int last_used, int opts, const struct ast_channel * requestor)
+{
+	struct pvt * pvt;
+	int slot;
+
+	while((slot = devsel_best(&state->devsel, candidates, words, last_used)) >= 0)
 	{
-		errno = 0;
-		group = (int) strtol (&resource[1], (char**) NULL, 10);
-		if (errno != EINVAL)
-		{
-//			ast_mutex_lock(&state->round_robin_mtx);
+		pvt = DEVSEL_OWNER(&state->devsel, slot);
+		ast_mutex_lock (&pvt->lock);
+		if (can_dial(pvt, opts, requestor))
+			return pvt;
+		ast_mutex_unlock (&pvt->lock);
+		devsel_clear(candidates, slot);
+	}
+	return NULL;
+}
 
-			/* Generate a list of all availible devices */
-			j = ITEMS_OF (round_robin);
-			c = 0; last_used = 0;
-			AST_RWLIST_TRAVERSE(&state->devices, pvt, entry)
-			{
-				ast_mutex_lock (&pvt->lock);
-				if (CONF_SHARED(pvt, group) == group)
-				{
-					round_robin[c] = pvt;
-					if (pvt->group_last_used == 1)
-					{
-						pvt->group_last_used = 0;
-						last_used = c;
-					}
+#/* set candidates to one slot found by hash; called with devices list and devsel locks hold; return non-zero if slot ready */
+static int devsel_resolve_exact(struct devsel * ds, devsel_hash_t hash, const char * value, devsel_ready_t kind, devsel_word_t * candidates, unsigned words, int * exists)
+{
+	int slot = devsel_lookup(ds, hash, value);
 
-					c++;
+	memset(candidates, 0, words * sizeof(*candidates));
+	if(slot < 0)
+		return 0;
 
-					if (c == j)
-					{
-						ast_mutex_unlock (&pvt->lock);
-						break;
-					}
-				}
-				ast_mutex_unlock (&pvt->lock);
-			}
+	*exists = 1;
+	if(!devsel_ready(ds, slot, kind))
+		return 0;
 
-			/* Search for a availible device starting at the last used device */
-			for (i = 0, j = last_used + 1; i < c; i++, j++)
-			{
-				if (j == c)
-				{
-					j = 0;
-				}
+	candidates[slot / DEVSEL_WORD_BITS] |= (devsel_word_t)1 << (slot % DEVSEL_WORD_BITS);
+	return 1;
+}
 
-				pvt = round_robin[j];
-				*exists = 1;
+#/* resolve resource spec to ready candidates from index without lock of devices; called with devices list lock hold; return non-zero if any candidate */
+static int devsel_resolve(struct public_state * state, const char * resource, devsel_ready_t kind, devsel_word_t * candidates, unsigned words, int ** last_used, int * weighted, int * exists)
+{
+	int group;
+	struct devsel_key * key;
+	devsel_word_t * members;
+	int any = 0;
 
-				ast_mutex_lock (&pvt->lock);
-				if (can_dial(pvt, opts, requestor))
-				{
-					pvt->group_last_used = 1;
-					found = pvt;
-					break;
-				}
-				ast_mutex_unlock (&pvt->lock);
-			}
+	*exists = 0;
+	*last_used = NULL;
+	*weighted = 0;
 
-//			ast_mutex_unlock(&state->round_robin_mtx);
-		}
-	}
-	else if (((resource[0] == 'p') || (resource[0] == 'P')) && resource[1] == ':')
+	ast_mutex_lock(&state->devsel_lock);
+	if (((resource[0] == 'g') || (resource[0] == 'G') || (resource[0] == 'r') || (resource[0] == 'R') || (resource[0] == 'w') || (resource[0] == 'W'))
+		&& ((resource[1] >= '0') && (resource[1] <= '9')))
 	{
-//		ast_mutex_lock(&state->round_robin_mtx);
-
-		/* Generate a list of all availible devices */
-		j = ITEMS_OF(round_robin);
-		c = 0; last_used = 0;
-		AST_RWLIST_TRAVERSE(&state->devices, pvt, entry)
+		errno = 0;
+		group = (int) strtol (&resource[1], (char**) NULL, 10);
+		if (errno != EINVAL)
 		{
-			ast_mutex_lock (&pvt->lock);
-			if (!strcmp (pvt->provider_name, &resource[2]))
+			key = devsel_find_group(&state->devsel, group);
+			if(key)
 			{
-				round_robin[c] = pvt;
-				if (pvt->prov_last_used == 1)
-				{
-					pvt->prov_last_used = 0;
-					last_used = c;
-				}
-
-				c++;
+				*exists = 1;
+				any = devsel_candidates(&state->devsel, key->members, key->words, kind, candidates);
 
-				if (c == j)
-				{
-					ast_mutex_unlock (&pvt->lock);
-					break;
-				}
+				/* group 'g' always start from first device, 'r' is round robin, 'w' best score and round robin on equal */
+				*weighted = resource[0] == 'w' || resource[0] == 'W';
+				if(resource[0] != 'g' && resource[0] != 'G')
+					*last_used = &key->last_used;
 			}
-			ast_mutex_unlock (&pvt->lock);
 		}
-
-		/* Search for a availible device starting at the last used device */
-		for (i = 0, j = last_used + 1; i < c; i++, j++)
+	}
+	else if (((resource[0] == 'p') || (resource[0] == 'P')) && resource[1] == ':')
+	{
+		key = devsel_find_provider(&state->devsel, &resource[2]);
+		if(key)
 		{
-			if (j == c)
-			{
-				j = 0;
-			}
-
-			pvt = round_robin[j];
 			*exists = 1;
-
-			ast_mutex_lock (&pvt->lock);
-			if (can_dial(pvt, opts, requestor))
-			{
-				pvt->prov_last_used = 1;
-				found = pvt;
-				break;
-			}
-			ast_mutex_unlock (&pvt->lock);
+			any = devsel_candidates(&state->devsel, key->members, key->words, kind, candidates);
+			*last_used = &key->last_used;
 		}
-
-//		ast_mutex_unlock(&state->round_robin_mtx);
 	}
 	else if (((resource[0] == 's') || (resource[0] == 'S')) && resource[1] == ':')
 	{
-//		ast_mutex_lock(&state->round_robin_mtx);
-
-		/* Generate a list of all availible devices */
-		j = ITEMS_OF(round_robin);
-		c = 0; last_used = 0;
-		i = strlen (&resource[2]);
-
-		AST_RWLIST_TRAVERSE(&state->devices, pvt, entry)
+		if(strlen(&resource[2]) >= IMSI_SIZE)
 		{
-			ast_mutex_lock (&pvt->lock);
-			if (!strncmp (pvt->imsi, &resource[2], i))
-			{
-				round_robin[c] = pvt;
-				if (pvt->sim_last_used == 1)
-				{
-					pvt->sim_last_used = 0;
-					last_used = c;
-				}
-
-				c++;
-
-				if (c == j)
-				{
-					ast_mutex_unlock (&pvt->lock);
-					break;
-				}
-			}
-			ast_mutex_unlock (&pvt->lock);
+			/* full IMSI, exact lookup */
+			any = devsel_resolve_exact(&state->devsel, DEVSEL_HASH_IMSI, &resource[2], kind, candidates, words, exists);
 		}
-
-		/* Search for a availible device starting at the last used device */
-		for (i = 0, j = last_used + 1; i < c; i++, j++)
+		else
 		{
-			if (j == c)
-			{
-				j = 0;
-			}
-
-			pvt = round_robin[j];
-			*exists = 1;
-
-			ast_mutex_lock (&pvt->lock);
-			if (can_dial(pvt, opts, requestor))
+			members = alloca(words * sizeof(*members));
+			if(devsel_match_imsi(&state->devsel, &resource[2], members))
 			{
-				pvt->sim_last_used = 1;
-				found = pvt;
-				break;
+				*exists = 1;
+				any = devsel_candidates(&state->devsel, members, words, kind, candidates);
+				*last_used = &state->devsel.imsi_last_used;
 			}
-			ast_mutex_unlock (&pvt->lock);
 		}
-
-//		ast_mutex_unlock(&state->round_robin_mtx);
 	}
 	else if (((resource[0] == 'i') || (resource[0] == 'I')) && resource[1] == ':')
 	{
-		AST_RWLIST_TRAVERSE(&state->devices, pvt, entry)
-		{
-			ast_mutex_lock (&pvt->lock);
-			if (!strcmp(pvt->imei, &resource[2]))
-			{
-				*exists = 1;
-				if(can_dial(pvt, opts, requestor))
-				{
-					found = pvt;
-					break;
-				}
-			}
-			ast_mutex_unlock (&pvt->lock);
-		}
+		any = devsel_resolve_exact(&state->devsel, DEVSEL_HASH_IMEI, &resource[2], kind, candidates, words, exists);
 	}
 	else
 	{
-		AST_RWLIST_TRAVERSE(&state->devices, pvt, entry)
+		any = devsel_resolve_exact(&state->devsel, DEVSEL_HASH_ID, resource, kind, candidates, words, exists);
+	}
+	ast_mutex_unlock(&state->devsel_lock);
+
+	return any;
+}
+
+#/* like find_device but for resource spec; return locked! pvt or NULL */
+EXPORT_DEF struct pvt * find_device_by_resource_ex(struct public_state * state, const char * resource, int opts, const struct ast_channel * requestor, int * exists)
+{
+	struct pvt * found = NULL;
+	devsel_word_t * candidates;
+	unsigned words;
+	int * last_used;
+	int weighted;
+	int start;
+
+	/* Find requested device and make sure it's connected and initialized. */
+	AST_RWLIST_RDLOCK(&state->devices);
+
+	/* number of chunks changed only under devices list write lock */
+	words = devsel_words(&state->devsel);
+	candidates = alloca(words * sizeof(*candidates));
+
+	if(devsel_resolve(state, resource, (opts & CALL_FLAG_HOLD_OTHER) ? DEVSEL_READY_HOLD : DEVSEL_READY_VOICE, candidates, words, &last_used, &weighted, exists))
+	{
+		/* cursor read without lock, key never freed and stale value harmless */
+		start = last_used ? *last_used : -1;
+		if(weighted)
+			found = devsel_pick_best(state, candidates, words, start, opts, requestor);
+		else
+			found = devsel_pick(state, candidates, words, start, opts, requestor);
+		if(found && last_used)
 		{
-			ast_mutex_lock (&pvt->lock);
-			if (!strcmp (PVT_ID(pvt), resource))
-			{
-				*exists = 1;
-				if(can_dial(pvt, opts, requestor))
-				{
-					found = pvt;
-					break;
-				}
-			}
-			ast_mutex_unlock (&pvt->lock);
+			/* key may be reused meanwhile, harmless for round robin cursor */
+			ast_mutex_lock(&state->devsel_lock);
+			*last_used = found->devsel_slot;
+			ast_mutex_unlock(&state->devsel_lock);
 		}
 	}
 
@@ -1166,6 +1244,24 @@ EXPORT_DEF struct pvt * find_device_by_resource_ex(struct public_state * state,
 	return found;
 }
 
+#/* check any device of resource spec ready for call by published state without lock of devices */
+EXPORT_DEF int resource_ready_ex(struct public_state * state, const char * resource, int * exists)
+{
+	devsel_word_t * candidates;
+	unsigned words;
+	int * last_used;
+	int weighted;
+	int ready;
+
+	AST_RWLIST_RDLOCK(&state->devices);
+	words = devsel_words(&state->devsel);
+	candidates = alloca(words * sizeof(*candidates));
+	ready = devsel_resolve(state, resource, DEVSEL_READY_VOICE, candidates, words, &last_used, &weighted, exists);
+	AST_RWLIST_UNLOCK(&state->devices);
+
+	return ready;
+}
+
 #/* */
 static const char * pvt_state_base(const struct pvt * pvt)
 {
@@ -1399,10 +1495,14 @@ static struct pvt * pvt_create(const pvt_config_t * settings)
 
 		pvt->monitor_thread		= AST_PTHREADT_NULL;
 		pvt->audio_fd			= -1;
+		audiotap_init(&pvt->a_tap);
+		concat_init(&pvt->concat);
+		scratch_init(&pvt->sms_scratch, pvt->sms_scratch_buf, sizeof(pvt->sms_scratch_buf));
 		pvt->data_fd			= -1;
 		pvt->timeout			= DATA_READ_TIMEOUT;
 		pvt->cusd_use_ucs2_decoding	=  1;
 		pvt->gsm_reg_status		= -1;
+		pvt->devsel_slot		= -1;
 
 		ast_copy_string (pvt->provider_name, "NONE", sizeof (pvt->provider_name));
 		ast_copy_string (pvt->subscriber_number, "Unknown", sizeof (pvt->subscriber_number));
@@ -1414,6 +1514,9 @@ static struct pvt * pvt_create(const pvt_config_t * settings)
 
 		/* and copy settings */
 		memcpy(&pvt->settings, settings, sizeof(pvt->settings));
+
+		/* not visible for others yet */
+		pvt_status_update(pvt);
 		return pvt;
 	}
 	else
@@ -1480,6 +1583,10 @@ static int pvt_reconfigure(struct pvt * pvt, const pvt_config_t * settings, rest
 			||
 		   SCONFIG(settings, smsaspdu) != CONF_SHARED(pvt, smsaspdu)
 			||
+		   SCONFIG(settings, smsdirect) != CONF_SHARED(pvt, smsdirect)
+			||
+		   SCONFIG(settings, disablesms) != CONF_SHARED(pvt, disablesms)
+			||
 		   SCONFIG(settings, callwaiting) != CONF_SHARED(pvt, callwaiting)
 		   )
 		{
@@ -1495,9 +1602,32 @@ static int pvt_reconfigure(struct pvt * pvt, const pvt_config_t * settings, rest
 		/* and copy settings */
 		memcpy(&pvt->settings, settings, sizeof(pvt->settings));
 	}
+	pvt_state_publish(pvt);
 	return rv;
 }
 
+#/* start pool when any configured device use dispatch=manager, stop when none */
+static void dispatch_reconfigure(unsigned users)
+{
+	struct dispatch_stat stat;
+
+	dispatch_stat_read(&stat);
+	if(users && !stat.workers)
+	{
+		/* without pool events of dispatch=manager sent from device thread */
+		if(dispatch_init(DISPATCH_WORKERS, DISPATCH_LIMIT))
+			ast_log (LOG_WARNING, "Unable to start dispatch threads\n");
+		else
+			ast_verb (3, "Started %d dispatch threads for %u devices\n", DISPATCH_WORKERS, users);
+	}
+	else if(!users && stat.workers)
+	{
+		/* queued events sent before workers exit, devices not restarted yet send from own thread */
+		dispatch_fini();
+		ast_verb (3, "Stopped dispatch threads, no device with dispatch=manager\n");
+	}
+}
+
 #/* */
 static int reload_config(public_state_t * state, int recofigure, restate_time_t when, unsigned * reload_immediality)
 {
@@ -1509,6 +1639,7 @@ static int reload_config(public_state_t * state, int recofigure, restate_time_t
 	int err;
 	struct pvt * pvt;
 	unsigned reload_now = 0;
+	unsigned dispatch_users = 0;
 
 	if ((cfg = ast_config_load (CONFIG_FILE, config_flags)) == NULL)
 	{
@@ -1540,6 +1671,9 @@ static int reload_config(public_state_t * state, int recofigure, restate_time_t
 			err = dc_config_fill(cfg, cat, &config_defaults, &settings);
 			if(!err)
 			{
+				if(SCONFIG(&settings, dispatch) == DC_DISPATCH_MANAGER && SCONFIG(&settings, initstate) != DEV_STATE_REMOVED)
+					dispatch_users++;
+
 				pvt = find_device(UCONFIG(&settings, id));
 				if(pvt)
 				{
@@ -1568,11 +1702,20 @@ static int reload_config(public_state_t * state, int recofigure, restate_time_t
 						{
 							/* FIXME: deadlock avoid ? */
 							AST_RWLIST_WRLOCK(&state->devices);
-							AST_RWLIST_INSERT_TAIL(&state->devices, pvt, entry);
-							AST_RWLIST_UNLOCK(&state->devices);
-							reload_now++;
-
-							ast_log (LOG_NOTICE, "[%s] Loaded device\n", PVT_ID(pvt));
+							if(pvt_devsel_add(state, pvt) == 0)
+							{
+								AST_RWLIST_INSERT_TAIL(&state->devices, pvt, entry);
+								AST_RWLIST_UNLOCK(&state->devices);
+								reload_now++;
+
+								ast_log (LOG_NOTICE, "[%s] Loaded device\n", PVT_ID(pvt));
+							}
+							else
+							{
+								AST_RWLIST_UNLOCK(&state->devices);
+								ast_log (LOG_ERROR, "[%s] Skipping device: Error allocating memory\n", PVT_ID(pvt));
+								pvt_destroy(pvt);
+							}
 						}
 					}
 				}
@@ -1597,11 +1740,14 @@ static int reload_config(public_state_t * state, int recofigure, restate_time_t
 			}
 			else
 				pvt->restart_time = when;
+			pvt_state_publish(pvt);
 		}
 		ast_mutex_unlock(&pvt->lock);
 	}
 	AST_RWLIST_UNLOCK (&state->devices);
 
+	dispatch_reconfigure(dispatch_users);
+
 	if(reload_immediality)
 		*reload_immediality = reload_now;
 	return 0;
@@ -1617,6 +1763,7 @@ static void devices_destroy(public_state_t * state)
 	AST_RWLIST_WRLOCK(&state->devices);
 	while((pvt = AST_RWLIST_REMOVE_HEAD(&state->devices, entry)))
 	{
+		pvt_devsel_remove(state, pvt);
 		pvt_destroy(pvt);
 	}
 	AST_RWLIST_UNLOCK(&state->devices);
@@ -1652,13 +1799,21 @@ static int public_state_init(struct public_state * state)
 	ast_mutex_init(&state->discovery_lock);
 
 	state->discovery_thread = AST_PTHREADT_NULL;
-//	ast_mutex_init(&state->round_robin_mtx);
+	ast_mutex_init(&state->devsel_lock);
+	devsel_init(&state->devsel);
 
 	if(reload_config(state, 0, RESTATE_TIME_NOW, NULL) == 0)
 	{
 		rv = AST_MODULE_LOAD_FAILURE;
 		if(discovery_restart(state) == 0)
 		{
+			/* without spool SMS sent directly */
+			if(SCONF_GLOBAL(state, smsspool)[0])
+				smsq_init(SCONF_GLOBAL(state, smsspool), SCONF_GLOBAL(state, smsspoolretries));
+
+			/* without thread requests to group refused */
+			ussdq_init();
+
 			/* register our channel type */
 			if(ast_channel_register(&channel_tech) == 0)
 			{
@@ -1666,6 +1821,7 @@ static int public_state_init(struct public_state * state)
 
 				app_register();
 				manager_register();
+				metrics_register();
 
 				return AST_MODULE_LOAD_SUCCESS;
 			}
@@ -1673,20 +1829,27 @@ static int public_state_init(struct public_state * state)
 			{
 				ast_log (LOG_ERROR, "Unable to register channel class %s\n", channel_tech.type);
 			}
+			smsq_stop();
+			ussdq_stop();
 			discovery_stop(state);
 		}
 		else
 		{
 			ast_log (LOG_ERROR, "Unable to create discovery thread\n");
 		}
+		/* pool started by reload_config() */
+		dispatch_fini();
 		devices_destroy(state);
+		smsq_fini();
+		ussdq_fini();
 	}
 	else
 	{
 		ast_log (LOG_ERROR, "Errors reading config file " CONFIG_FILE ", Not loading module\n");
 	}
 
-//	ast_mutex_destroy(&state->round_robin_mtx);
+	devsel_destroy(&state->devsel);
+	ast_mutex_destroy(&state->devsel_lock);
 	ast_mutex_destroy(&state->discovery_lock);
 	AST_RWLIST_HEAD_DESTROY(&state->devices);
 
@@ -1699,18 +1862,28 @@ static void public_state_fini(struct public_state * state)
 	/* First, take us out of the channel loop */
 	ast_channel_unregister (&channel_tech);
 
-	/* Unregister the CLI & APP & MANAGER */
+	/* Unregister the CLI & APP & MANAGER & METRICS */
 
+	metrics_unregister();
 	manager_unregister();
 
 	app_unregister();
 
 	cli_unregister();
 
+	smsq_stop();
+	ussdq_stop();
 	discovery_stop(state);
+	dispatch_fini();
+#ifdef BUILD_ATREC
+	atrec_stop(NULL, NULL);
+#endif /* BUILD_ATREC */
 	devices_destroy(state);
+	smsq_fini();
+	ussdq_fini();
 	
-//	ast_mutex_destroy(&state->round_robin_mtx);
+	devsel_destroy(&state->devsel);
+	ast_mutex_destroy(&state->devsel_lock);
 	ast_mutex_destroy(&state->discovery_lock);
 	AST_RWLIST_HEAD_DESTROY(&state->devices);
 }
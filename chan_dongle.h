@@ -17,13 +17,20 @@
 #include <asterisk/linkedlists.h>
 
 #include "mixbuffer.h"				/* struct mixbuffer */
+#include "audiotap.h"				/* struct audiotap */
+#include "atrec.h"				/* struct atrec */
+#include "devsel.h"				/* struct devsel */
+#include "concat.h"				/* struct concat */
+#include "scratch.h"				/* struct scratch */
+#include "ussd.h"				/* struct ussd_session */
+#include "char_conv.h"				/* BASE64_SIZE() */
+#include "seqlock.h"				/* seqlock_t */
 //#include "ringbuffer.h"				/* struct ringbuffer */
 #include "cpvt.h"				/* struct cpvt */
 #include "export.h"				/* EXPORT_DECL EXPORT_DEF */
 #include "dc_config.h"				/* pvt_config_t */
 
 #define MODULE_DESCRIPTION	"Huawei 3G Dongle Channel Driver"
-#define MAXDONGLEDEVICES	128
 
 INLINE_DECL const char * dev_state2str(dev_state_t state)
 {
@@ -56,42 +63,96 @@ typedef struct pvt_state
 
 #define PVT_STATE_T(state, name)			((state)->name)
 
-/* statictics */
+/* upper bounds of AT command response latency histogram buckets in ms, last is +Inf */
+#define AT_LATENCY_BOUNDS	{ 10, 25, 50, 100, 250, 500, 1000, 2500, 5000 }
+#define AT_LATENCY_BUCKETS	10
+
+/* statictics, 64 bit counters updated under pvt lock */
 typedef struct pvt_stat
 {
-	uint32_t		at_tasks;			/*!< number of tasks added to queue */
-	uint32_t		at_cmds;			/*!< number of commands added to queue */
-	uint32_t		at_responces;			/*!< number of responses handled */
+	uint64_t		at_tasks;			/*!< number of tasks added to queue */
+	uint64_t		at_cmds;			/*!< number of commands added to queue */
+	uint64_t		at_responces;			/*!< number of responses handled */
 
-	uint32_t		d_read_bytes;			/*!< number of bytes of commands actually readed from device */
-	uint32_t		d_write_bytes;			/*!< number of bytes of commands actually written to device */
+	uint64_t		d_read_bytes;			/*!< number of bytes of commands actually readed from device */
+	uint64_t		d_write_bytes;			/*!< number of bytes of commands actually written to device */
 
 	uint64_t		a_read_bytes;			/*!< number of bytes of audio readed from device */
 	uint64_t		a_write_bytes;			/*!< number of bytes of audio written to device */
 
-	uint32_t		read_frames;			/*!< number of frames readed from device */
-	uint32_t		read_sframes;			/*!< number of truncated frames readed from device */
+	uint64_t		read_frames;			/*!< number of frames readed from device */
+	uint64_t		read_sframes;			/*!< number of truncated frames readed from device */
 
-	uint32_t		write_frames;			/*!< number of tries to frame write */
-	uint32_t		write_tframes;			/*!< number of truncated frames to write */
-	uint32_t		write_sframes;			/*!< number of silence frames to write */
+	uint64_t		write_frames;			/*!< number of tries to frame write */
+	uint64_t		write_tframes;			/*!< number of truncated frames to write */
+	uint64_t		write_sframes;			/*!< number of silence frames to write */
 
 	uint64_t		write_rb_overflow_bytes;	/*!< number of overflow bytes */
-	uint32_t		write_rb_overflow;		/*!< number of times when a_write_rb overflowed */
+	uint64_t		write_rb_overflow;		/*!< number of times when a_write_rb overflowed */
+
+	uint64_t		in_calls;			/*!< number of incoming calls not including waiting */
+	uint64_t		cw_calls;			/*!< number of waiting calls */
+	uint64_t		out_calls;			/*!< number of all outgoing calls attempts */
+	uint64_t		in_calls_handled;		/*!< number of ncoming/waiting calls passed to dialplan */
+	uint64_t		in_pbx_fails;			/*!< number of start_pbx fails */
+
+	uint64_t		calls_answered[2];		/*!< number of outgoing and incoming/waiting calls answered */
+	uint64_t		calls_duration[2];		/*!< seconds of outgoing and incoming/waiting calls */
+
+	uint64_t		tap_frames;			/*!< number of frames sent to audio tap */
+	uint64_t		tap_dropped;			/*!< number of frames not sent to audio tap */
 
-	uint32_t		in_calls;			/*!< number of incoming calls not including waiting */
-	uint32_t		cw_calls;			/*!< number of waiting calls */
-	uint32_t		out_calls;			/*!< number of all outgoing calls attempts */
-	uint32_t		in_calls_handled;		/*!< number of ncoming/waiting calls passed to dialplan */
-	uint32_t		in_pbx_fails;			/*!< number of start_pbx fails */
+	uint64_t		smsq_sent;			/*!< number of SMS from spool sent */
+	uint64_t		smsq_failed;			/*!< number of SMS from spool dropped after last attempt */
 
-	uint32_t		calls_answered[2];		/*!< number of outgoing and incoming/waiting calls answered */
-	uint32_t		calls_duration[2];		/*!< seconds of outgoing and incoming/waiting calls */
+	uint64_t		at_latency[AT_LATENCY_BUCKETS];	/*!< number of AT command responses by latency bucket */
+	uint64_t		at_latency_sum;			/*!< sum of AT command response latency in ms */
 } pvt_stat_t;
 
 #define PVT_STAT_T(stat, name)			((stat)->name)
 
+/* longest +CMGR, +CMGL or +CMT response and originator address of single SMS */
+#define SMS_RESPONSE_MAX	1024
+#define SMS_OA_MAX		128
+/* scratch of received SMS: copy of response, originator as received and decoded, text and its base64; decoded text take at most twice of hex digits */
+#define SMS_SCRATCH_SIZE	(SMS_RESPONSE_MAX + 1 + SMS_OA_MAX + SMS_OA_MAX * 2 + 1 + SMS_RESPONSE_MAX * 2 + 1 + BASE64_SIZE(SMS_RESPONSE_MAX * 2))
+
+/* status snapshot published by device owner for readers without lock of device */
+typedef struct pvt_status
+{
+	pvt_config_t		settings;			/*!< device settings */
+	pvt_state_t		state;				/*!< state counters */
+	const char		* str_state;			/*!< result of pvt_str_state(), static string */
+	int			gsm_reg_status;
+	int			rssi;
+	int			linkmode;
+	int			linksubmode;
+	char			provider_name[32];
+	char			manufacturer[32];
+	char			model[32];
+	char			firmware[32];
+	char			imei[17];
+	char			imsi[17];
+	char			subscriber_number[128];
+	char			location_area_code[8];
+	char			cell_id[8];
+	char			sms_scenter[20];
+	dev_state_t		current_state;
+	dev_state_t		desired_state;
+
+	unsigned int		connected:1;
+	unsigned int		enabled:1;			/*!< pvt_enabled() */
+	unsigned int		dial_possible:1;		/*!< is_dial_possible() without options */
+	unsigned int		has_voice:1;
+	unsigned int		has_sms:1;
+	unsigned int		has_call_waiting:1;
+	unsigned int		use_ucs2_encoding:1;
+	unsigned int		cusd_use_7bit_encoding:1;
+	unsigned int		cusd_use_ucs2_decoding:1;
+} pvt_status_t;
+
 struct at_queue_task;
+struct smsq_msg;
 
 typedef struct pvt
 {
@@ -118,6 +179,8 @@ typedef struct pvt
 
 	char			a_write_buf[FRAME_SIZE * 5];	/*!< audio write buffer */
 	struct mixbuffer	a_write_mixb;			/*!< audio mix buffer */
+	struct audiotap		a_tap;				/*!< audio tap consumer connection */
+	struct atrec		* atrec;			/*!< AT traffic recorder rings, NULL until first recording */
 //	struct ringbuffer	a_write_rb;			/*!< audio ring buffer */
 
 //	char			a_read_buf[FRAME_SIZE + AST_FRIENDLY_OFFSET];	/*!< audio read buffer */
@@ -133,6 +196,10 @@ typedef struct pvt
 
 	unsigned long		channel_instanse;		/*!< number of channels created on this device */
 	unsigned int		rings;				/*!< ring/ccwa  number distributed to at_response_clcc() */
+	unsigned int		sms_ref;			/*!< reference number of last concatenated SMS */
+	unsigned int		sms_listed;			/*!< messages received by current AT+CMGL */
+#define SMS_INDEX_MAX		256
+	unsigned char		sms_cmti[SMS_INDEX_MAX / 8];	/*!< storage indexes of +CMTI while AT+CMGL queued, read after listing when not listed */
 
 	/* device caps */
 	unsigned int		use_ucs2_encoding:1;
@@ -163,19 +230,17 @@ typedef struct pvt
 	unsigned int		cwaiting:1;			/*!< HW state; true if has incoming call waiting from first CCWA until CEND or CONN for */
 	unsigned int		outgoing_sms:1;			/*!< outgoing sms */
 	unsigned int		incoming_sms:1;			/*!< incoming sms */
+	unsigned int		sms_drain:1;			/*!< AT+CMGL of unread SMS in storage queued */
 	unsigned int		volume_sync_step:2;		/*!< volume synchronized stage */
 #define VOLUME_SYNC_BEGIN	0
 #define VOLUME_SYNC_DONE	3
 
 	unsigned int		use_pdu:1;			/*!< PDU SMS mode in force */
+	unsigned int		use_cnma:1;			/*!< +CMT must be acknowledged by AT+CNMA, AT+CSMS=1 accepted */
 	unsigned int		has_sms:1;			/*!< device has SMS support */
 	unsigned int		has_voice:1;			/*!< device has voice call support */
 	unsigned int		has_call_waiting:1;		/*!< call waiting enabled on device */
 
-	unsigned int		group_last_used:1;		/*!< mark the last used device */
-	unsigned int		prov_last_used:1;		/*!< mark the last used device */
-	unsigned int		sim_last_used:1;		/*!< mark the last used device */
-
 	unsigned int		terminate_monitor:1;		/*!< non-zero if we want terminate monitor thread i.e. restart, stop, remove */
 //	unsigned int		off:1;				/*!< device not used */
 //	unsigned int		prevent_new:1;			/*!< prevent new usage */
@@ -184,6 +249,18 @@ typedef struct pvt
 //	unsigned int		monitor_running:1;		/*!< true if monitor thread is running */
 	unsigned int		must_remove:1;			/*!< mean must removed from list: NOT FULLY THREADSAFE */
 
+	struct smsq_msg		* smsq_msg;			/*!< message of SMS spool in AT queue or NULL */
+	const void		* smsq_task;			/*!< AT task of smsq_msg */
+	struct timeval		smsq_next;			/*!< time of next message from SMS spool by smsrate */
+	struct concat		concat;				/*!< parts of received concatenated SMS */
+	struct scratch		sms_scratch;			/*!< buffers of received SMS until delivered */
+	char			sms_scratch_buf[SMS_SCRATCH_SIZE];	/*!< arena of sms_scratch */
+	struct ussd_session	ussd;				/*!< USSD request or menu session of device */
+
+	int			devsel_slot;			/*!< slot in device selection index, -1 if device not indexed */
+	seqlock_t		status_lock;			/*!< protect status from readers, writer hold pvt lock */
+	pvt_status_t		status;				/*!< last published status */
+
 	volatile dev_state_t	desired_state;			/*!< desired state */
 	volatile restate_time_t	restart_time;			/*!< time when change state */
 	volatile dev_state_t	current_state;			/*!< current state */
@@ -209,8 +286,8 @@ typedef struct public_state
 	ast_mutex_t			discovery_lock;
 	pthread_t			discovery_thread;		/* The discovery thread handler */
 	volatile int			unloading_flag;			/* no need mutex or other locking for protect this variable because no concurent r/w and set non-0 atomically */
-//	ast_mutex_t			round_robin_mtx;
-//	struct pvt			* round_robin[MAXDONGLEDEVICES];	// TODO: remove and make local variable of find_device_by_resource_ex()
+	ast_mutex_t			devsel_lock;			/* protect devsel, always taken last */
+	struct devsel			devsel;				/* device selection index */
 	struct dc_gconfig		global_settings;
 } public_state_t;
 
@@ -233,6 +310,12 @@ EXPORT_DECL void pvt_on_remove_last_channel(struct pvt* pvt);
 EXPORT_DECL void pvt_reload(restate_time_t when);
 EXPORT_DECL int pvt_enabled(const struct pvt * pvt);
 EXPORT_DECL void pvt_try_restate(struct pvt * pvt);
+EXPORT_DECL void pvt_state_publish(struct pvt * pvt);
+EXPORT_DECL void pvt_status_fill(const struct pvt * pvt, pvt_status_t * status);
+EXPORT_DECL void pvt_status_update(struct pvt * pvt);
+EXPORT_DECL void pvt_status_read(const struct pvt * pvt, pvt_status_t * status);
+EXPORT_DECL void pvt_stat_read(struct pvt * pvt, pvt_stat_t * stat);
+EXPORT_DECL int pvt_status_find(struct public_state * state, const char * name, pvt_status_t * status);
 
 EXPORT_DECL int opentty (const char* dev, char ** lockfile);
 EXPORT_DECL void closetty(int fd, char ** lockfname);
@@ -253,6 +336,13 @@ INLINE_DECL struct pvt * find_device_by_resource(const char * resource, int opts
 	return find_device_by_resource_ex(gpublic, resource, opts, requestor, exists);
 }
 
+EXPORT_DECL int resource_ready_ex(struct public_state * state, const char * resource, int * exists);
+
+INLINE_DECL int resource_ready(const char * resource, int * exists)
+{
+	return resource_ready_ex(gpublic, resource, exists);
+}
+
 EXPORT_DECL struct ast_module * self_module();
 
 #define PVT_NO_CHANS(pvt)		(PVT_STATE(pvt, chansno) == 0)
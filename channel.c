@@ -21,6 +21,10 @@
 #include <asterisk/lock.h>			/* AST_MUTEX_DEFINE_STATIC */
 #include <asterisk/timing.h>			/* ast_timer_fd() ast_timer_set_rate() ast_timer_ack() */
 #include <asterisk/version.h>			/* ASTERISK_VERSION_NUM */
+#include <asterisk/utils.h>			/* ast_slinear_saturated_multiply() ast_slinear_saturated_divide() */
+#ifdef HAVE_AST_MSG_QUEUE
+#include <asterisk/message.h>			/* ast_msg_alloc() ast_msg_set_to() ast_msg_set_var() ast_msg_queue() ... */
+#endif /* HAVE_AST_MSG_QUEUE */
 
 #include "channel.h"
 #include "chan_dongle.h"
@@ -28,9 +32,21 @@
 #include "helpers.h"				/* get_at_clir_value()  */
 #include "at_queue.h"				/* write_all() TODO: move out */
 #include "manager.h"				/* manager_event_call_state_change() */
+#include "audiotap.h"				/* audiotap_send() audiotap_gap() */
+#include "vad.h"				/* vad_energy() vad_silent() vad_energy2dbov() */
+#include "probes.h"				/* PROBE5() PROBE_TIMER() */
+#include "trace.h"				/* TRACE() */
 
 static char silence_frame[FRAME_SIZE];
 
+#if ASTERISK_VERSION_NUM >= 10800
+#define subclass_codec		subclass.codec
+#define subclass_integer	subclass.integer
+#else
+#define subclass_codec		subclass
+#define subclass_integer	subclass
+#endif
+
 #/* */
 static int parse_dial_string(char * dialstr, const char** number, int * opts)
 {
@@ -246,6 +262,28 @@ static int channel_call (struct ast_channel* channel, char* dest, attribute_unus
 	return 0;
 }
 
+#/* setup frames template once, channel_read() update only length and timing fields */
+static void init_read_frames(struct cpvt * cpvt)
+{
+	unsigned i;
+	struct ast_frame * f;
+
+	for(i = 0; i < ITEMS_OF(cpvt->a_read_frame); ++i)
+	{
+		f = &cpvt->a_read_frame[i];
+		memset (f, 0, sizeof (*f));
+
+		f->frametype = AST_FRAME_VOICE;
+		f->subclass_codec = AST_FORMAT_SLINEAR;
+		f->data.ptr = cpvt->a_read_buf[i] + AST_FRIENDLY_OFFSET;
+		f->offset = AST_FRIENDLY_OFFSET;
+		f->src = AST_MODULE;
+
+		cpvt->a_read_iov[i].iov_base = f->data.ptr;
+		cpvt->a_read_iov[i].iov_len = FRAME_SIZE;
+	}
+}
+
 #/* ARCH: move to cpvt level */
 static void disactivate_call(struct cpvt* cpvt)
 {
@@ -299,6 +337,9 @@ static void activate_call(struct cpvt* cpvt)
 	{
 		// FIXME: reset possition?
 		mixb_attach(&pvt->a_write_mixb, &cpvt->mixstream);
+		/* first activation, frames may be still in use by core after unhold */
+		if(!cpvt->a_read_frame[0].data.ptr)
+			init_read_frames(cpvt);
 //		rb_init (&cpvt->a_write_rb, cpvt->a_write_buf, sizeof (cpvt->a_write_buf));
 //		cpvt->write = pvt->a_write_rb.write;
 //		cpvt->used = pvt->a_write_rb.used;
@@ -325,6 +366,48 @@ static void activate_call(struct cpvt* cpvt)
 	}
 }
 
+#/* copy audio to tap consumer if configured */
+static void tap_write(struct pvt * pvt, const struct cpvt * cpvt, audiotap_dir_t dir, const struct iovec * iov, int iovcnt)
+{
+	if(CONF_SHARED(pvt, audiotap)[0] == 0)
+		return;
+
+	if(audiotap_send(&pvt->a_tap, CONF_SHARED(pvt, audiotap), PVT_ID(pvt), cpvt->call_idx,
+			cpvt->channel ? cpvt->channel->uniqueid : "",
+			dir, iov, iovcnt) == 0)
+		PVT_STAT(pvt, tap_frames) ++;
+	else
+		PVT_STAT(pvt, tap_dropped) ++;
+}
+
+#/* account silent frame for tap consumer instead of copy it */
+static void tap_skip(struct pvt * pvt, const struct cpvt * cpvt, audiotap_dir_t dir, size_t len)
+{
+	if(CONF_SHARED(pvt, audiotap)[0] == 0)
+		return;
+
+	if(audiotap_gap(&pvt->a_tap, dir, len / 2))
+		tap_write(pvt, cpvt, dir, NULL, 0);
+}
+
+#/* report silence not sent yet before call leave tap */
+static void tap_flush(struct pvt * pvt, const struct cpvt * cpvt)
+{
+	if(pvt->a_tap.gap[AUDIOTAP_DIR_RX])
+		tap_write(pvt, cpvt, AUDIOTAP_DIR_RX, NULL, 0);
+	if(pvt->a_tap.gap[AUDIOTAP_DIR_TX])
+		tap_write(pvt, cpvt, AUDIOTAP_DIR_TX, NULL, 0);
+}
+
+#/* save audio statistics of call for hangup handlers and CDR, before channel lose cpvt */
+static void set_audiostats_var(struct ast_channel * channel, const struct cpvt * cpvt)
+{
+	char stats[256];
+
+	cpvt_stat_field(&cpvt->stat, "audiostats", stats, sizeof(stats));
+	pbx_builtin_setvar_helper (channel, "DONGLEAUDIOSTATS", stats);
+}
+
 #/* we has 2 case of call this function, when local side want terminate call and when called for cleanup after remote side alreay terminate call, CEND received and cpvt destroyed */
 static int channel_hangup (struct ast_channel* channel)
 {
@@ -349,8 +432,13 @@ static int channel_hangup (struct ast_channel* channel)
 
 		}
 
+		if(CPVT_IS_MASTER(cpvt))
+			tap_flush(pvt, cpvt);
 		disactivate_call (cpvt);
 
+		/* local hangup, on remote hangup saved when CEND received */
+		set_audiostats_var(channel, cpvt);
+
 		/* drop cpvt->channel reference */
 		cpvt->channel = NULL;
 		ast_mutex_unlock (&pvt->lock);
@@ -485,13 +573,12 @@ again:
 	}
 }
 
-#/* */
-static void timing_write (struct pvt* pvt)
+#/* master cpvt write mixed audio of all calls to device */
+static void timing_write (struct pvt* pvt, struct cpvt * cpvt)
 {
 	size_t			used;
 	int			iovcnt;
 	struct iovec		iov[3];
-	const char*		msg = NULL;
 //	char			buffer[FRAME_SIZE];
 //	struct cpvt*		cpvt;
 
@@ -507,6 +594,10 @@ static void timing_write (struct pvt* pvt)
 		used = mixb_used (&pvt->a_write_mixb);
 //		used = rb_used (&cpvt->a_write_rb);
 
+		CPVT_STAT(cpvt, depth_sum) += used;
+		if(used > CPVT_STAT(cpvt, depth_max))
+			CPVT_STAT(cpvt, depth_max) = used;
+
 		if (used >= FRAME_SIZE)
 		{
 			iovcnt = mixb_read_n_iov (&pvt->a_write_mixb, iov, FRAME_SIZE);
@@ -516,7 +607,7 @@ static void timing_write (struct pvt* pvt)
 		else if (used > 0)
 		{
 			PVT_STAT(pvt, write_tframes) ++;
-			msg = "[%s] write truncated frame\n";
+			CPVT_STAT(cpvt, write_tframes) ++;
 
 			iovcnt = mixb_read_all_iov (&pvt->a_write_mixb, iov);
 			mixb_read_all_iov (&pvt->a_write_mixb, iov);
@@ -529,7 +620,7 @@ static void timing_write (struct pvt* pvt)
 		else
 		{
 			PVT_STAT(pvt, write_sframes) ++;
-			msg = "[%s] write silence\n";
+			CPVT_STAT(cpvt, write_sframes) ++;
 
 			iov[0].iov_base		= silence_frame;
 			iov[0].iov_len		= FRAME_SIZE;
@@ -538,13 +629,20 @@ static void timing_write (struct pvt* pvt)
 		}
 
 //		iov_add(buffer, sizeof(buffer), iov);
-		if(msg)
-			ast_debug (7, msg, PVT_ID(pvt));
+		PROBE3(timing_write, PVT_ID(pvt), used, used >= FRAME_SIZE ? 0 : used > 0 ? 1 : 2);
+		TRACE(TRACE_TIMING_WRITE, PVT_ID(pvt), used, used > 0 && used < FRAME_SIZE, used == 0, 0);
 
 //	}
 
 
 	PVT_STAT(pvt, write_frames) ++;
+	CPVT_STAT(cpvt, write_frames) ++;
+
+	/* device need frame each period, with vad idle silence only accounted for tap */
+	if(used == 0 && CONF_SHARED(pvt, vad))
+		tap_skip(pvt, cpvt, AUDIOTAP_DIR_TX, FRAME_SIZE);
+	else
+		tap_write(pvt, cpvt, AUDIOTAP_DIR_TX, iov, iovcnt);
 	iov_write(pvt, pvt->audio_fd, iov, iovcnt);
 //	if(write_all(pvt->audio_fd, buffer, sizeof(buffer)) != sizeof(buffer))
 //		ast_debug (1, "[%s] Write error!\n", PVT_ID(pvt));
@@ -571,13 +669,143 @@ static void write_conference(struct pvt * pvt, const char * buffer, size_t lengt
 
 }
 
-#if ASTERISK_VERSION_NUM >= 10800
-#define subclass_codec		subclass.codec
-#define subclass_integer	subclass.integer
+/* load sample in device (little endian) byte order */
+#if __BYTE_ORDER == __BIG_ENDIAN
+#define SAMPLE_LOAD(ptr)	((short)((((unsigned short)*(ptr)) << 8) | (((unsigned short)*(ptr)) >> 8)))
 #else
-#define subclass_codec		subclass
-#define subclass_integer	subclass
+#define SAMPLE_LOAD(ptr)	(*(ptr))
+#endif
+
+#/* convert samples from device byte order and apply rxgain in one pass, same as ast_frame_byteswap_le() + ast_frame_adjust_volume() */
+static void frame_byteswap_gain(struct ast_frame * f, int gain)
+{
+	short * sample = f->data.ptr;
+	short * end = sample + f->samples;
+	short value;
+	short adjust;
+
+#if __BYTE_ORDER != __BIG_ENDIAN
+	/* nothing todo on little endian host without gain */
+	if(gain == 0)
+		return;
+#endif
+
+	if(gain > 0)
+	{
+		adjust = gain;
+		for(; sample < end; ++sample)
+		{
+			value = SAMPLE_LOAD(sample);
+			ast_slinear_saturated_multiply(&value, &adjust);
+			*sample = value;
+		}
+	}
+	else if(gain < 0)
+	{
+		adjust = -gain;
+		for(; sample < end; ++sample)
+		{
+			value = SAMPLE_LOAD(sample);
+			ast_slinear_saturated_divide(&value, &adjust);
+			*sample = value;
+		}
+	}
+#if __BYTE_ORDER == __BIG_ENDIAN
+	else
+	{
+		for(; sample < end; ++sample)
+			*sample = SAMPLE_LOAD(sample);
+	}
 #endif
+}
+
+#undef SAMPLE_LOAD
+
+#/* classify frame by VAD, return non-zero for silence */
+static int vad_is_silent(const struct pvt * pvt, struct cpvt * cpvt, const void * data, size_t len, unsigned * level)
+{
+	*level = vad_energy(data, len / 2);
+	return vad_silent(&cpvt->vad_hangover, *level, CONF_SHARED(pvt, vadthreshold), CONF_SHARED(pvt, vadhangover));
+}
+
+#/* update interarrival jitter and drift statistics of device reads */
+static void read_stat_update(struct cpvt * cpvt, size_t bytes)
+{
+	struct cpvt_stat * stat = &cpvt->stat;
+	struct timeval now = ast_tvnow();
+	long long delta;
+	long long expected;
+
+	if(ast_tvzero(stat->read_first))
+	{
+		stat->read_first = now;
+	}
+	else
+	{
+		/* 8000 Hz 16 bit samples, 62.5 usec per byte */
+		delta = (now.tv_sec - stat->read_last.tv_sec) * 1000000LL + (now.tv_usec - stat->read_last.tv_usec);
+		expected = stat->read_last_bytes * 125 / 2;
+		delta = delta > expected ? delta - expected : expected - delta;
+
+		stat->jitter += (delta - (long long)stat->jitter) / 16;
+		if(delta > stat->jitter_max)
+			stat->jitter_max = delta;
+		stat->read_bytes += bytes;
+	}
+
+	stat->read_last = now;
+	stat->read_last_bytes = bytes;
+}
+
+#/* inband DTMF detection and filtering, return frame to deliver */
+static struct ast_frame * channel_read_dsp(struct ast_channel * channel, struct pvt * pvt, struct ast_frame * f)
+{
+	f = ast_dsp_process (channel, pvt->dsp, f);
+	if ((f->frametype == AST_FRAME_DTMF_END) || (f->frametype == AST_FRAME_DTMF_BEGIN))
+	{
+		if ((f->subclass_integer == 'm') || (f->subclass_integer == 'u'))
+		{
+			f->frametype = AST_FRAME_NULL;
+			f->subclass_integer = 0;
+		}
+		else if(f->frametype == AST_FRAME_DTMF_BEGIN)
+		{
+			pvt->dtmf_begin_time = ast_tvnow();
+		}
+		else if (f->frametype == AST_FRAME_DTMF_END)
+		{
+			if(!ast_tvzero(pvt->dtmf_begin_time) && ast_tvdiff_ms(ast_tvnow(), pvt->dtmf_begin_time) < CONF_SHARED(pvt, mindtmfgap))
+			{
+				ast_debug(1, "[%s] DTMF char %c ignored min gap %d > %ld\n", PVT_ID(pvt), f->subclass_integer, CONF_SHARED(pvt, mindtmfgap), (long)ast_tvdiff_ms(ast_tvnow(), pvt->dtmf_begin_time));
+				f->frametype = AST_FRAME_NULL;
+				f->subclass_integer = 0;
+			}
+			else if(f->len < CONF_SHARED(pvt, mindtmfduration))
+			{
+				ast_debug(1, "[%s] DTMF char %c ignored min duration %d > %ld\n", PVT_ID(pvt), f->subclass_integer, CONF_SHARED(pvt, mindtmfduration), f->len);
+				f->frametype = AST_FRAME_NULL;
+				f->subclass_integer = 0;
+			}
+			else if(f->subclass_integer == pvt->dtmf_digit
+					&& 
+				!ast_tvzero(pvt->dtmf_end_time)
+					&& 
+				ast_tvdiff_ms(ast_tvnow(), pvt->dtmf_end_time) < CONF_SHARED(pvt, mindtmfinterval))
+			{
+				ast_debug(1, "[%s] DTMF char %c ignored min interval %d > %ld\n", PVT_ID(pvt), f->subclass_integer, CONF_SHARED(pvt, mindtmfinterval), (long)ast_tvdiff_ms(ast_tvnow(), pvt->dtmf_end_time));
+				f->frametype = AST_FRAME_NULL;
+				f->subclass_integer = 0;
+			}
+			else
+			{
+				ast_debug(1, "[%s] Got DTMF char %c\n",PVT_ID(pvt), f->subclass_integer);
+				pvt->dtmf_digit = f->subclass_integer;
+				pvt->dtmf_end_time = ast_tvnow();
+			}
+		}
+	}
+	return f;
+}
 
 #/* */
 static struct ast_frame* channel_read (struct ast_channel* channel)
@@ -585,7 +813,14 @@ static struct ast_frame* channel_read (struct ast_channel* channel)
 	struct cpvt*		cpvt = channel->tech_pvt;
 	struct pvt*		pvt;
 	struct ast_frame*	f = &ast_null_frame;
+	struct ast_frame*	fr;
+	struct ast_frame*	last = NULL;
 	ssize_t			res;
+	size_t			len;
+	unsigned		i;
+	unsigned		energy;
+	int			silent;
+	PROBE_TIMER(wait);
 
 	if(!cpvt || cpvt->channel != channel || !cpvt->pvt)
 	{
@@ -593,12 +828,14 @@ static struct ast_frame* channel_read (struct ast_channel* channel)
 	}
 	pvt = cpvt->pvt;
 
+	PROBE_START(wait);
 	while (ast_mutex_trylock (&pvt->lock))
 	{
 		CHANNEL_DEADLOCK_AVOIDANCE (channel);
 	}
+	PROBE_STOP(wait);
 
-	ast_debug (7, "[%s] read call idx %d state %d audio_fd %d\n", PVT_ID(pvt), cpvt->call_idx, cpvt->state, pvt->audio_fd);
+	TRACE(TRACE_CHANNEL_READ, PVT_ID(pvt), cpvt->call_idx, cpvt->state, pvt->audio_fd, 0);
 
 	/* FIXME: move down for enable timing_write() to device ? */
 	if (!CPVT_IS_SOUND_SOURCE(cpvt) || pvt->audio_fd < 0)
@@ -609,21 +846,14 @@ static struct ast_frame* channel_read (struct ast_channel* channel)
 	if (pvt->a_timer && channel->fdno == 1)
 	{
 		ast_timer_ack (pvt->a_timer, 1);
-		timing_write (pvt);
-		ast_debug (7, "[%s] *** timing ***\n", PVT_ID(pvt));
+		timing_write (pvt, cpvt);
+		TRACE(TRACE_CHANNEL_TIMING, PVT_ID(pvt), cpvt->call_idx, 0, 0, 0);
 	}
 
 	else
 	{
-		memset (&cpvt->a_read_frame, 0, sizeof (cpvt->a_read_frame));
-
-		cpvt->a_read_frame.frametype = AST_FRAME_VOICE;
-		cpvt->a_read_frame.subclass_codec= AST_FORMAT_SLINEAR;
-		cpvt->a_read_frame.data.ptr = cpvt->a_read_buf + AST_FRIENDLY_OFFSET;
-		cpvt->a_read_frame.offset = AST_FRIENDLY_OFFSET;
-		cpvt->a_read_frame.src = AST_MODULE;
-
-		res = read (CPVT_IS_MASTER(cpvt) ? pvt->audio_fd : cpvt->rd_pipe[PIPE_READ], cpvt->a_read_frame.data.ptr, FRAME_SIZE);
+		/* take all already buffered frames by one syscall */
+		res = readv (CPVT_IS_MASTER(cpvt) ? pvt->audio_fd : cpvt->rd_pipe[PIPE_READ], cpvt->a_read_iov, ITEMS_OF(cpvt->a_read_iov));
 		if (res <= 0)
 		{
 			if (errno != EAGAIN && errno != EINTR)
@@ -633,89 +863,109 @@ static struct ast_frame* channel_read (struct ast_channel* channel)
 
 			goto e_return;
 		}
+		PROBE5(channel_read, PVT_ID(pvt), cpvt->call_idx, CPVT_IS_MASTER(cpvt) ? pvt->audio_fd : cpvt->rd_pipe[PIPE_READ], res, wait);
+
+		if(CPVT_IS_MASTER(cpvt))
+			read_stat_update(cpvt, res);
 
 /*		ast_debug (7, "[%s] call idx %d read %u\n", PVT_ID(pvt), cpvt->call_idx, (unsigned)res);
 		ast_debug (6, "[%s] read | call idx %d fd %d readed %d bytes\n", PVT_ID(pvt), cpvt->call_idx, pvt->audio_fd, res);
 */
 
-		if(CPVT_IS_MASTER(cpvt))
+		/* build list of frames, ast_read() queue all after first */
+		for(i = 0; res > 0; ++i, res -= len)
 		{
-			if(CPVT_TEST_FLAG(cpvt, CALL_FLAG_MULTIPARTY))
-				write_conference(pvt, cpvt->a_read_frame.data.ptr, res);
+			fr = &cpvt->a_read_frame[i];
+			len = res < FRAME_SIZE ? (size_t)res : FRAME_SIZE;
+			silent = CONF_SHARED(pvt, vad) && vad_is_silent(pvt, cpvt, fr->data.ptr, len, &energy);
 
-			PVT_STAT(pvt, a_read_bytes) += res;
-			PVT_STAT(pvt, read_frames) ++;
-			if(res < FRAME_SIZE)
-				PVT_STAT(pvt, read_sframes) ++;
-		}
-
-		cpvt->a_read_frame.samples	= res / 2;
-		cpvt->a_read_frame.datalen	= res;
-		ast_frame_byteswap_le (&cpvt->a_read_frame);
-/*
-		cpvt->a_read_frame.ts;
-		cpvt->a_read_frame.len;
-		cpvt->a_read_frame.seqno;
-*/
-		f = &cpvt->a_read_frame;
-		if (pvt->dsp)
-		{
-			f = ast_dsp_process (channel, pvt->dsp, f);
-			if ((f->frametype == AST_FRAME_DTMF_END) || (f->frametype == AST_FRAME_DTMF_BEGIN))
+			if(CPVT_IS_MASTER(cpvt))
 			{
-				if ((f->subclass_integer == 'm') || (f->subclass_integer == 'u'))
+				/* other legs mix every frame, VAD silence too, or mixer under-run */
+				if(CPVT_TEST_FLAG(cpvt, CALL_FLAG_MULTIPARTY))
+					write_conference(pvt, fr->data.ptr, len);
+
+				PVT_STAT(pvt, a_read_bytes) += len;
+				PVT_STAT(pvt, read_frames) ++;
+				CPVT_STAT(cpvt, read_frames) ++;
+				if(len < FRAME_SIZE)
 				{
-					f->frametype = AST_FRAME_NULL;
-					f->subclass_integer = 0;
-					goto e_return;
+					PVT_STAT(pvt, read_sframes) ++;
+					CPVT_STAT(cpvt, read_sframes) ++;
 				}
-				if(f->frametype == AST_FRAME_DTMF_BEGIN)
+
+				if(silent)
 				{
-					pvt->dtmf_begin_time = ast_tvnow();
+					tap_skip(pvt, cpvt, AUDIOTAP_DIR_RX, len);
 				}
-				else if (f->frametype == AST_FRAME_DTMF_END)
+				else
 				{
-					if(!ast_tvzero(pvt->dtmf_begin_time) && ast_tvdiff_ms(ast_tvnow(), pvt->dtmf_begin_time) < CONF_SHARED(pvt, mindtmfgap))
-					{
-						ast_debug(1, "[%s] DTMF char %c ignored min gap %d > %ld\n", PVT_ID(pvt), f->subclass_integer, CONF_SHARED(pvt, mindtmfgap), (long)ast_tvdiff_ms(ast_tvnow(), pvt->dtmf_begin_time));
-						f->frametype = AST_FRAME_NULL;
-						f->subclass_integer = 0;
-					}
-					else if(f->len < CONF_SHARED(pvt, mindtmfduration))
-					{
-						ast_debug(1, "[%s] DTMF char %c ignored min duration %d > %ld\n", PVT_ID(pvt), f->subclass_integer, CONF_SHARED(pvt, mindtmfduration), f->len);
-						f->frametype = AST_FRAME_NULL;
-						f->subclass_integer = 0;
-					}
-					else if(f->subclass_integer == pvt->dtmf_digit
-							&& 
-						!ast_tvzero(pvt->dtmf_end_time)
-							&& 
-						ast_tvdiff_ms(ast_tvnow(), pvt->dtmf_end_time) < CONF_SHARED(pvt, mindtmfinterval))
-					{
-						ast_debug(1, "[%s] DTMF char %c ignored min interval %d > %ld\n", PVT_ID(pvt), f->subclass_integer, CONF_SHARED(pvt, mindtmfinterval), (long)ast_tvdiff_ms(ast_tvnow(), pvt->dtmf_end_time));
-						f->frametype = AST_FRAME_NULL;
-						f->subclass_integer = 0;
-					}
-					else
-					{
-						ast_debug(1, "[%s] Got DTMF char %c\n",PVT_ID(pvt), f->subclass_integer);
-						pvt->dtmf_digit = f->subclass_integer;
-						pvt->dtmf_end_time = ast_tvnow();
-					}
+					cpvt->a_read_iov[i].iov_len = len;
+					tap_write(pvt, cpvt, AUDIOTAP_DIR_RX, &cpvt->a_read_iov[i], 1);
+					cpvt->a_read_iov[i].iov_len = FRAME_SIZE;
+				}
+			}
 
+			fr->datalen	= len;
+			fr->samples	= len / 2;
+			fr->seqno	= cpvt->a_read_seqno++;
+			fr->ts		= cpvt->a_read_ts;
+			cpvt->a_read_ts += fr->samples / 8;
+
+			if(silent)
+			{
+				CPVT_STAT(cpvt, read_vad_silent) ++;
+				if(CONF_SHARED(pvt, cng))
+				{
+					/* one CNG frame on start of silence, next silent frames just dropped */
+					if(cpvt->vad_cng_sent)
+						continue;
+					cpvt->vad_cng_sent = 1;
+					fr->frametype = AST_FRAME_CNG;
+					fr->subclass_integer = vad_energy2dbov(energy);
+					fr->datalen = 0;
+					fr->samples = 0;
+				}
+				else
+				{
+					/* silence not need rxgain and can't contain DTMF, hangover cover tone end for dsp */
+					frame_byteswap_gain (fr, 0);
 				}
-				goto e_return;
 			}
-		}
+			else
+			{
+				if(fr->frametype != AST_FRAME_VOICE)
+				{
+					/* restore voice template after CNG */
+					fr->frametype = AST_FRAME_VOICE;
+					fr->subclass_codec = AST_FORMAT_SLINEAR;
+				}
+				cpvt->vad_cng_sent = 0;
+				frame_byteswap_gain (fr, CONF_SHARED(pvt, rxgain));
+			}
 
-		if (CONF_SHARED(pvt, rxgain) && f->frametype == AST_FRAME_VOICE)
-		{
-			if (ast_frame_adjust_volume (f, CONF_SHARED(pvt, rxgain)) == -1)
+			if (pvt->dsp && !silent)
 			{
-				ast_debug (1, "[%s] Volume could not be adjusted!\n", PVT_ID(pvt));
+				fr = channel_read_dsp(channel, pvt, fr);
+
+				/* dsp own frame reused on next call, copy if more frames follow */
+				if(fr->frametype != AST_FRAME_VOICE && (size_t)res > len)
+				{
+					fr = ast_frdup(fr);
+					if(!fr)
+						break;
+				}
 			}
+
+			if(last)
+				AST_LIST_NEXT(last, frame_list) = fr;
+			else
+				f = fr;
+			last = fr;
 		}
+
+		if(last)
+			AST_LIST_NEXT(last, frame_list) = NULL;
 	}
 
 e_return:
@@ -731,6 +981,7 @@ static int channel_write (struct ast_channel* channel, struct ast_frame* f)
 	struct pvt* pvt;
 	size_t count;
 	int gains[2];
+	PROBE_TIMER(wait);
 
 	if (f->frametype != AST_FRAME_VOICE || f->subclass_codec != AST_FORMAT_SLINEAR)
 	{
@@ -751,12 +1002,15 @@ static int channel_write (struct ast_channel* channel, struct ast_frame* f)
 
 	pvt = cpvt->pvt;
 
-	ast_debug (7, "[%s] write call idx %d state %d\n", PVT_ID(pvt), cpvt->call_idx, cpvt->state);
+	TRACE(TRACE_CHANNEL_WRITE, PVT_ID(pvt), cpvt->call_idx, cpvt->state, 0, 0);
 
+	PROBE_START(wait);
 	while (ast_mutex_trylock (&pvt->lock))
 	{
 		CHANNEL_DEADLOCK_AVOIDANCE (channel);
 	}
+	PROBE_STOP(wait);
+	PROBE5(channel_write, PVT_ID(pvt), cpvt->call_idx, pvt->audio_fd, f->datalen, wait);
 
 	if(!CPVT_IS_ACTIVE(cpvt))
 		goto e_return;
@@ -832,6 +1086,8 @@ static int channel_write (struct ast_channel* channel, struct ast_frame* f)
 
 				PVT_STAT(pvt, write_rb_overflow_bytes) += f->datalen - count;
 				PVT_STAT(pvt, write_rb_overflow) ++;
+				CPVT_STAT(cpvt, write_rb_overflow_bytes) += f->datalen - count;
+				CPVT_STAT(cpvt, write_rb_overflow) ++;
 			}
 
 			mixb_write (&pvt->a_write_mixb, &cpvt->mixstream, f->data.ptr, f->datalen);
@@ -872,16 +1128,16 @@ static int channel_write (struct ast_channel* channel, struct ast_frame* f)
 				iovcnt = 1;
 			}
 
+			tap_write(pvt, cpvt, AUDIOTAP_DIR_TX, iov, iovcnt);
 			iov_write(pvt, pvt->audio_fd, iov, iovcnt);
 			PVT_STAT(pvt, write_frames) ++;
+			CPVT_STAT(cpvt, write_frames) ++;
 			}
 		}
 
 /*		if (f->datalen != 320)
 */
-		{
-			ast_debug (7, "[%s] Write frame: samples = %d, data lenght = %d byte\n", PVT_ID(pvt), f->samples, f->datalen);
-		}
+		TRACE(TRACE_CHANNEL_WRITE_FRAME, PVT_ID(pvt), f->samples, f->datalen, 0, 0);
 	}
 
 e_return:
@@ -919,19 +1175,19 @@ static int channel_fixup (struct ast_channel* oldchannel, struct ast_channel* ne
 static int channel_devicestate (void* data)
 {
 	char*	device;
-	struct pvt*	pvt;
+	pvt_status_t status;
 	int	res = AST_DEVICE_INVALID;
 
 	device = ast_strdupa (data ? data : "");
 
 	ast_debug (1, "Checking device state for device %s\n", device);
 
-	pvt = find_device_ext (device, NULL);
-	if (pvt)
+	/* published status, polled often so never wait for device lock */
+	if (pvt_status_find(gpublic, device, &status) == 0 && status.enabled)
 	{
-		if (pvt->connected)
+		if (status.connected)
 		{
-			if (is_dial_possible(pvt, CALL_FLAG_NONE))
+			if (status.dial_possible)
 			{
 				res = AST_DEVICE_NOT_INUSE;
 			}
@@ -940,7 +1196,6 @@ static int channel_devicestate (void* data)
 				res = AST_DEVICE_INUSE;
 			}
 		}
-		ast_mutex_unlock (&pvt->lock);
 	}
 
 	return res;
@@ -1008,6 +1263,7 @@ EXPORT_DEF void change_channel_state(struct cpvt * cpvt, unsigned newstate, int
 		cpvt->state = newstate;
 		PVT_STATE(pvt, chan_count[oldstate])--;
 		PVT_STATE(pvt, chan_count[newstate])++;
+		PROBE5(state_change, PVT_ID(pvt), call_idx, call_state2str(oldstate), call_state2str(newstate), cause);
 
 		ast_debug (1, "[%s] call idx %d mpty %d, change state from '%s' to '%s' has%s channel\n", PVT_ID(pvt), call_idx, CPVT_TEST_FLAG(cpvt, CALL_FLAG_MULTIPARTY) ? 1 : 0, call_state2str(oldstate), call_state2str(newstate), channel ? "" : "'t");
 
@@ -1090,6 +1346,8 @@ EXPORT_DEF void change_channel_state(struct cpvt * cpvt, unsigned newstate, int
 					disactivate_call(cpvt);
 					/* from +CEND, restart or disconnect */
 
+					set_audiostats_var(channel, cpvt);
+
 
 					/* drop channel -> cpvt reference */
 					channel->tech_pvt = NULL;
@@ -1263,6 +1521,51 @@ EXPORT_DEF void start_local_channel (struct pvt* pvt, const char* exten, const c
 	}
 }
 
+#ifdef HAVE_AST_MSG_QUEUE
+#/* NOTE: called from device level with pvt locked */
+EXPORT_DEF void start_local_message (struct pvt* pvt, const char* exten, const char* number, const char* body, channel_var_t* vars)
+{
+	struct ast_msg*		msg;
+	unsigned		idx;
+	int			res;
+	channel_var_t dev_vars[] =
+	{
+		{ "DONGLENAME", PVT_ID(pvt) },
+		{ "DONGLEPROVIDER", pvt->provider_name },
+		{ "DONGLEIMEI", pvt->imei },
+		{ "DONGLEIMSI", pvt->imsi },
+		{ "DONGLENUMBER", pvt->subscriber_number },
+	};
+
+	/* no channels and pbx thread, message routed by core message thread to exten@context */
+	msg = ast_msg_alloc();
+	if (!msg)
+	{
+		ast_log (LOG_ERROR, "[%s] Unable to allocate message for %s@%s\n", PVT_ID(pvt), exten, CONF_SHARED(pvt, context));
+		return;
+	}
+
+	res = ast_msg_set_to (msg, "dongle:%s", PVT_ID(pvt));
+	res |= ast_msg_set_from (msg, "\"%s\" <%s>", PVT_ID(pvt), number);
+	res |= ast_msg_set_body (msg, "%s", body);
+	res |= ast_msg_set_context (msg, "%s", CONF_SHARED(pvt, context));
+	res |= ast_msg_set_exten (msg, "%s", exten);
+
+	for(idx = 0; idx < ITEMS_OF(dev_vars); ++idx)
+		res |= ast_msg_set_var (msg, dev_vars[idx].name, dev_vars[idx].value);
+	for(; vars->name; ++vars)
+		res |= ast_msg_set_var (msg, vars->name, vars->value);
+
+	if (res == 0)
+		res = ast_msg_queue (msg);
+	if (res)
+	{
+		ast_msg_destroy (msg);
+		ast_log (LOG_ERROR, "[%s] Unable to queue message for %s@%s\n", PVT_ID(pvt), exten, CONF_SHARED(pvt, context));
+	}
+}
+#endif /* HAVE_AST_MSG_QUEUE */
+
 #/* */
 static int channel_func_read(struct ast_channel* channel, attribute_unused const char* function, char* data, char* buf, size_t len)
 {
@@ -1315,7 +1618,14 @@ static int channel_func_read(struct ast_channel* channel, attribute_unused const
 		ast_copy_string(buf, dtmf, len);
 	}
 	else
-		ret = -1;
+	{
+		while (ast_mutex_trylock (&pvt->lock))
+		{
+			CHANNEL_DEADLOCK_AVOIDANCE (channel);
+		}
+		ret = cpvt_stat_field(&cpvt->stat, data, buf, len);
+		ast_mutex_unlock(&pvt->lock);
+	}
 
 	return ret;
 }
@@ -25,6 +25,11 @@ EXPORT_DECL struct ast_channel* new_channel (struct pvt * pvt, int ast_state, co
 EXPORT_DECL int queue_control_channel (struct cpvt * cpvt, enum ast_control_frame_type control);
 EXPORT_DECL int queue_hangup (struct ast_channel * channel, int hangupcause);
 EXPORT_DECL void start_local_channel (struct pvt * pvt, const char * exten, const char * number, channel_var_t * vars);
+#ifdef HAVE_AST_MSG_QUEUE
+EXPORT_DECL void start_local_message (struct pvt * pvt, const char * exten, const char * number, const char * body, channel_var_t * vars);
+#else /* HAVE_AST_MSG_QUEUE */
+#define start_local_message(pvt, exten, number, body, vars)	start_local_channel(pvt, exten, number, vars)
+#endif /* HAVE_AST_MSG_QUEUE */
 EXPORT_DECL void change_channel_state(struct cpvt * cpvt, unsigned newstate, int cause);
 EXPORT_DECL int channels_loop(struct pvt * pvt, const struct ast_channel * requestor);
 
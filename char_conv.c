@@ -13,54 +13,57 @@
 #endif /* HAVE_CONFIG_H */
 
 #include <sys/types.h>
+#include <stdint.h>			/* uint16_t uint64_t */
 
-#include <iconv.h>			/* iconv_t iconv() */
 #include <string.h>			/* memcpy() */
-#include <stdio.h>			/* sscanf() snprintf() */
 #include <errno.h>			/* EINVAL */
 
 #include "char_conv.h"
 #include "mutils.h"			/* ITEMS_OF() */
 
-static ssize_t convert_string (const char* in, size_t in_length, char* out, size_t out_size, char* from, char* to)
-{
-	ICONV_CONST char*	in_ptr = (ICONV_CONST char*) in;
-	size_t			in_bytesleft = in_length;
-	char*			out_ptr = out;
-	size_t			out_bytesleft = out_size - 1;
-	ICONV_T			cd = (ICONV_T) -1;
-	ssize_t			res;
-
-	cd = iconv_open (to, from);
-	if (cd == (ICONV_T) -1)
-	{
-		return -2;
-	}
-
-	res = iconv (cd, &in_ptr, &in_bytesleft, &out_ptr, &out_bytesleft);
-	if (res < 0)
-	{
-		iconv_close (cd);
-		return -3;
-	}
-
-	iconv_close (cd);
-
-	*out_ptr = '\0';
-
-	return (out_ptr - out);
-}
+/* two hex digits of each octet value */
+static const char hex_pairs[] =
+	"000102030405060708090A0B0C0D0E0F"
+	"101112131415161718191A1B1C1D1E1F"
+	"202122232425262728292A2B2C2D2E2F"
+	"303132333435363738393A3B3C3D3E3F"
+	"404142434445464748494A4B4C4D4E4F"
+	"505152535455565758595A5B5C5D5E5F"
+	"606162636465666768696A6B6C6D6E6F"
+	"707172737475767778797A7B7C7D7E7F"
+	"808182838485868788898A8B8C8D8E8F"
+	"909192939495969798999A9B9C9D9E9F"
+	"A0A1A2A3A4A5A6A7A8A9AAABACADAEAF"
+	"B0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+	"C0C1C2C3C4C5C6C7C8C9CACBCCCDCECF"
+	"D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+	"E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEF"
+	"F0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+/* value of hex digit, -1 for other characters */
+static const signed char hex_values[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+};
 
 #/* convert 1 hex digits of PDU to byte, return < 0 on error */
 EXPORT_DEF int parse_hexdigit(int hex)
 {
-	if(hex >= '0' && hex <= '9')
-		return hex - '0';
-	if(hex >= 'a' && hex <= 'f')
-		return hex - 'a' + 10;
-	if(hex >= 'A' && hex <= 'F')
-		return hex - 'A' + 10;
-	return -1;
+	return hex_values[(unsigned char)hex];
 }
 
 static ssize_t hexstr_to_8bitchars (const char* in, size_t in_length, char* out, size_t out_size)
@@ -79,13 +82,11 @@ static ssize_t hexstr_to_8bitchars (const char* in, size_t in_length, char* out,
 	}
 	out_size = in_length;
 	
-	for (; in_length; --in_length)
+	for (; in_length; --in_length, in += 2)
 	{
-		d1 = parse_hexdigit(*in++);
-		if(d1 < 0)
-			return -EINVAL;
-		d2 = parse_hexdigit(*in++);
-		if(d2 < 0)
+		d1 = hex_values[(unsigned char)in[0]];
+		d2 = hex_values[(unsigned char)in[1]];
+		if((d1 | d2) < 0)
 			return -EINVAL;
 		*out++ = (d1 << 4) | d2;
 	}
@@ -97,8 +98,7 @@ static ssize_t hexstr_to_8bitchars (const char* in, size_t in_length, char* out,
 
 static ssize_t chars8bit_to_hexstr (const char* in, size_t in_length, char* out, size_t out_size)
 {
-	static const char hex_table[] = "0123456789ABCDEF";
-	const unsigned char *in2 = (const unsigned char *)in;	/* for save time of first & 0x0F */
+	const unsigned char *in2 = (const unsigned char *)in;
 
 	if (out_size - 1 < in_length * 2)
 	{
@@ -106,151 +106,587 @@ static ssize_t chars8bit_to_hexstr (const char* in, size_t in_length, char* out,
 	}
 	out_size = in_length * 2;
 	
-	for (; in_length; --in_length, ++in2)
-	{
-		*out++ = hex_table[*in2 >> 4];
-		*out++ = hex_table[*in2 & 0xF];
-	}
+	for (; in_length; --in_length, ++in2, out += 2)
+		memcpy(out, hex_pairs + *in2 * 2, 2);
 
 	*out = 0;
 
 	return out_size;
 }
 
-static ssize_t hexstr_ucs2_to_utf8 (const char* in, size_t in_length, char* out, size_t out_size)
+#/* decode UTF-8 character, return bytes of character or 0 if invalid */
+static unsigned utf8_decode (const unsigned char* in, size_t length, unsigned* ucs)
 {
-	char	buf[out_size];
-	ssize_t	res;
+	unsigned c = in[0];
 
-	if (out_size - 1 < in_length / 2)
+	if (c < 0x80)
 	{
-		return -1;
+		*ucs = c;
+		return 1;
 	}
-
-	res = hexstr_to_8bitchars (in, in_length, buf, out_size);
-	if (res < 0)
+	if (c < 0xC2 || c > 0xF4)
+		return 0;
+	if (c < 0xE0)
 	{
-		return res;
+		if (length < 2 || (in[1] & 0xC0) != 0x80)
+			return 0;
+		*ucs = ((c & 0x1F) << 6) | (in[1] & 0x3F);
+		return 2;
 	}
-
-	res = convert_string (buf, res, out, out_size, "UCS-2BE", "UTF-8");
-
-	return res;
+	if (c < 0xF0)
+	{
+		if (length < 3 || (in[1] & 0xC0) != 0x80 || (in[2] & 0xC0) != 0x80)
+			return 0;
+		*ucs = ((c & 0x0F) << 12) | ((in[1] & 0x3F) << 6) | (in[2] & 0x3F);
+		return *ucs < 0x800 || (*ucs >= 0xD800 && *ucs < 0xE000) ? 0 : 3;
+	}
+	if (length < 4 || (in[1] & 0xC0) != 0x80 || (in[2] & 0xC0) != 0x80 || (in[3] & 0xC0) != 0x80)
+		return 0;
+	*ucs = ((c & 0x07) << 18) | ((in[1] & 0x3F) << 12) | ((in[2] & 0x3F) << 6) | (in[3] & 0x3F);
+	return *ucs < 0x10000 || *ucs > 0x10FFFF ? 0 : 4;
 }
 
-static ssize_t utf8_to_hexstr_ucs2 (const char* in, size_t in_length, char* out, size_t out_size)
+#/* encode character to UTF-8, return bytes written */
+static unsigned utf8_encode (unsigned ucs, char* out)
 {
-	char	buf[out_size];
-	ssize_t	res;
-
-	if (out_size - 1 < in_length * 4)
+	if (ucs < 0x80)
 	{
-		return -1;
+		out[0] = ucs;
+		return 1;
 	}
-
-	res = convert_string (in, in_length, buf, out_size, "UTF-8", "UCS-2BE");
-	if (res < 0)
+	if (ucs < 0x800)
+	{
+		out[0] = 0xC0 | (ucs >> 6);
+		out[1] = 0x80 | (ucs & 0x3F);
+		return 2;
+	}
+	if (ucs < 0x10000)
 	{
-		return res;
+		out[0] = 0xE0 | (ucs >> 12);
+		out[1] = 0x80 | ((ucs >> 6) & 0x3F);
+		out[2] = 0x80 | (ucs & 0x3F);
+		return 3;
 	}
+	out[0] = 0xF0 | (ucs >> 18);
+	out[1] = 0x80 | ((ucs >> 12) & 0x3F);
+	out[2] = 0x80 | ((ucs >> 6) & 0x3F);
+	out[3] = 0x80 | (ucs & 0x3F);
+	return 4;
+}
 
-	res = chars8bit_to_hexstr (buf, res, out, out_size);
+#/* value of 4 hex digits of UTF-16 code unit, -1 on invalid digit */
+static int ucs2_hex_unit (const unsigned char* in)
+{
+	int d1 = hex_values[in[0]];
+	int d2 = hex_values[in[1]];
+	int d3 = hex_values[in[2]];
+	int d4 = hex_values[in[3]];
 
-	return res;
+	if ((d1 | d2 | d3 | d4) < 0)
+		return -1;
+	return (d1 << 12) | (d2 << 8) | (d3 << 4) | d4;
 }
 
-static ssize_t char_to_hexstr_7bit (const char* in, size_t in_length, char* out, size_t out_size)
+#/* decode UTF-16BE as hex digits to UTF-8, surrogate pairs joined */
+static ssize_t ucs2_hex_to_utf8 (const char* in, size_t in_length, char* out, size_t out_size)
 {
-	size_t		i;
-	size_t		x = 0;
-	size_t		s;
-	unsigned char	c;
-	unsigned char	b;
-	char	buf[] = { 0x0, 0x0, 0x0 };
-
-	x = (in_length - in_length / 8) * 2;
-	if (out_size - 1 < x)
+	const unsigned char* ptr = (const unsigned char*)in;
+	const unsigned char* end = ptr + in_length;
+	size_t len = 0;
+	char utf8[4];
+	unsigned bytes;
+	int unit, low, d1, d2;
+
+	if (in_length & 0x3)
+		return -EINVAL;
+	if (out_size == 0)
+		return -ENOMEM;
+	out_size--;
+
+	while (ptr < end)
 	{
-		return -1;
+		/* ASCII: "00" and two digits below 0x80 */
+		if (ptr[0] == '0' && ptr[1] == '0' && (d1 = hex_values[ptr[2]]) >= 0 && d1 < 8 && (d2 = hex_values[ptr[3]]) >= 0)
+		{
+			if (len == out_size)
+				return -ENOMEM;
+			out[len++] = (d1 << 4) | d2;
+			ptr += 4;
+			continue;
+		}
+
+		unit = ucs2_hex_unit (ptr);
+		if (unit < 0 || (unit >= 0xDC00 && unit < 0xE000))
+			return -EINVAL;
+		ptr += 4;
+		if (unit >= 0xD800 && unit < 0xDC00)
+		{
+			if (ptr == end)
+				return -EINVAL;
+			low = ucs2_hex_unit (ptr);
+			if (low < 0xDC00 || low >= 0xE000)
+				return -EINVAL;
+			ptr += 4;
+			unit = 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00);
+		}
+
+		bytes = utf8_encode (unit, utf8);
+		if (out_size - len < bytes)
+			return -ENOMEM;
+		memcpy (out + len, utf8, bytes);
+		len += bytes;
 	}
 
-	if(in_length > 0)
+	out[len] = 0;
+	return len;
+}
+
+#/* encode UTF-8 to UTF-16BE as hex digits, characters out of BMP as surrogate pairs */
+static ssize_t utf8_to_ucs2_hex (const char* in, size_t in_length, char* out, size_t out_size)
+{
+	const unsigned char* ptr = (const unsigned char*)in;
+	size_t len = 0;
+	uint64_t word;
+	unsigned ucs;
+	unsigned bytes;
+	unsigned idx;
+
+	if (out_size == 0)
+		return -ENOMEM;
+	out_size--;
+
+	while (in_length)
 	{
-		in_length--;
-		for (i = 0, x = 0, s = 0; i < in_length; i++)
+		/* ASCII: 8 characters checked at once */
+		if (in_length >= 8)
 		{
-			if (s == 7)
+			memcpy (&word, ptr, sizeof(word));
+			if ((word & 0x8080808080808080ULL) == 0)
 			{
-				s = 0;
+				if (out_size - len < 8 * 4)
+					return -ENOMEM;
+				for (idx = 0; idx < 8; ++idx, len += 4)
+				{
+					out[len] = '0';
+					out[len + 1] = '0';
+					memcpy (out + len + 2, hex_pairs + ptr[idx] * 2, 2);
+				}
+				ptr += 8;
+				in_length -= 8;
 				continue;
 			}
+		}
 
-			c = in[i] >> s;
-			b = in[i + 1] << (7 - s);
-			c = c | b;
-			s++;
-
-			snprintf (buf, sizeof(buf), "%.2X", c);
+		bytes = utf8_decode (ptr, in_length, &ucs);
+		if (bytes == 0)
+			return -EINVAL;
+		ptr += bytes;
+		in_length -= bytes;
 
-			memcpy (out + x, buf, 2);
-			x = x + 2;
+		if (ucs >= 0x10000)
+		{
+			if (out_size - len < 8)
+				return -ENOMEM;
+			ucs -= 0x10000;
+			memcpy (out + len, hex_pairs + (0xD8 | (ucs >> 18)) * 2, 2);
+			memcpy (out + len + 2, hex_pairs + ((ucs >> 10) & 0xFF) * 2, 2);
+			len += 4;
+			ucs = 0xDC00 | (ucs & 0x3FF);
 		}
+		if (out_size - len < 4)
+			return -ENOMEM;
+		memcpy (out + len, hex_pairs + (ucs >> 8) * 2, 2);
+		memcpy (out + len + 2, hex_pairs + (ucs & 0xFF) * 2, 2);
+		len += 4;
+	}
+
+	out[len] = 0;
+	return len;
+}
+
+/* GSM 03.38 default alphabet to UCS-2, ESC shown as NBSP */
+static const uint16_t gsm7_default[128] = {
+	0x0040, 0x00A3, 0x0024, 0x00A5, 0x00E8, 0x00E9, 0x00F9, 0x00EC,
+	0x00F2, 0x00C7, 0x000A, 0x00D8, 0x00F8, 0x000D, 0x00C5, 0x00E5,
+	0x0394, 0x005F, 0x03A6, 0x0393, 0x039B, 0x03A9, 0x03A0, 0x03A8,
+	0x03A3, 0x0398, 0x039E, 0x00A0, 0x00C6, 0x00E6, 0x00DF, 0x00C9,
+	0x0020, 0x0021, 0x0022, 0x0023, 0x00A4, 0x0025, 0x0026, 0x0027,
+	0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+	0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+	0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+	0x00A1, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+	0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+	0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+	0x0058, 0x0059, 0x005A, 0x00C4, 0x00D6, 0x00D1, 0x00DC, 0x00A7,
+	0x00BF, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+	0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+	0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+	0x0078, 0x0079, 0x007A, 0x00E4, 0x00F6, 0x00F1, 0x00FC, 0x00E0,
+};
+
+/* GSM 03.38 extension table after ESC to UCS-2, 0 if not defined */
+static const uint16_t gsm7_extension[128] = {
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x000C, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x005E, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x007B, 0x007D, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x005C,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x005B, 0x007E, 0x005D, 0x0000,
+	0x007C, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x20AC, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+	0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+};
+
+#define GSM7_ESC		0x1B
+#define GSM7_CR			0x0D
+#define GSM7_ESCAPED		0x100			/* septet of extension table */
+#define GSM7_NONE		0xFFFF			/* character not in alphabet */
+
+/* Latin-1 to septet or GSM7_ESCAPED | septet, GSM7_NONE if not in alphabet */
+static const uint16_t gsm7_latin1[256] = {
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0x000A, 0xFFFF, 0x010A, 0x000D, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0x0020, 0x0021, 0x0022, 0x0023, 0x0002, 0x0025, 0x0026, 0x0027,
+	0x0028, 0x0029, 0x002A, 0x002B, 0x002C, 0x002D, 0x002E, 0x002F,
+	0x0030, 0x0031, 0x0032, 0x0033, 0x0034, 0x0035, 0x0036, 0x0037,
+	0x0038, 0x0039, 0x003A, 0x003B, 0x003C, 0x003D, 0x003E, 0x003F,
+	0x0000, 0x0041, 0x0042, 0x0043, 0x0044, 0x0045, 0x0046, 0x0047,
+	0x0048, 0x0049, 0x004A, 0x004B, 0x004C, 0x004D, 0x004E, 0x004F,
+	0x0050, 0x0051, 0x0052, 0x0053, 0x0054, 0x0055, 0x0056, 0x0057,
+	0x0058, 0x0059, 0x005A, 0x013C, 0x012F, 0x013E, 0x0114, 0x0011,
+	0xFFFF, 0x0061, 0x0062, 0x0063, 0x0064, 0x0065, 0x0066, 0x0067,
+	0x0068, 0x0069, 0x006A, 0x006B, 0x006C, 0x006D, 0x006E, 0x006F,
+	0x0070, 0x0071, 0x0072, 0x0073, 0x0074, 0x0075, 0x0076, 0x0077,
+	0x0078, 0x0079, 0x007A, 0x0128, 0x0140, 0x0129, 0x013D, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0x0040, 0xFFFF, 0x0001, 0x0024, 0x0003, 0xFFFF, 0x005F,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0x0060,
+	0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0x005B, 0x000E, 0x001C, 0x0009,
+	0xFFFF, 0x001F, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0x005D, 0xFFFF, 0xFFFF, 0xFFFF, 0xFFFF, 0x005C, 0xFFFF,
+	0x000B, 0xFFFF, 0xFFFF, 0xFFFF, 0x005E, 0xFFFF, 0xFFFF, 0x001E,
+	0x007F, 0xFFFF, 0xFFFF, 0xFFFF, 0x007B, 0x000F, 0x001D, 0xFFFF,
+	0x0004, 0x0005, 0xFFFF, 0xFFFF, 0x0007, 0xFFFF, 0xFFFF, 0xFFFF,
+	0xFFFF, 0x007D, 0x0008, 0xFFFF, 0xFFFF, 0xFFFF, 0x007C, 0xFFFF,
+	0x000C, 0x0006, 0xFFFF, 0xFFFF, 0x007E, 0xFFFF, 0xFFFF, 0xFFFF,
+};
 
-		c = in[i] >> s;
-		snprintf (buf, sizeof(buf), "%.2X", c);
-		memcpy (out + x, buf, 2);
-		x = x + 2;
+/* UCS-2 above Latin-1 and septet or GSM7_ESCAPED | septet */
+static const uint16_t gsm7_other[][2] = {
+	{ 0x0393, 0x13 }, { 0x0394, 0x10 }, { 0x0398, 0x19 }, { 0x039B, 0x14 },
+	{ 0x039E, 0x1A }, { 0x03A0, 0x16 }, { 0x03A3, 0x18 }, { 0x03A6, 0x12 },
+	{ 0x03A8, 0x17 }, { 0x03A9, 0x15 }, { 0x20AC, GSM7_ESCAPED | 0x65 },
+};
+
+#/* return septet or GSM7_ESCAPED | septet of character, GSM7_NONE if not in alphabet */
+static unsigned gsm7_from_ucs (unsigned ucs)
+{
+	unsigned idx;
+
+	if (ucs < 0x100)
+		return gsm7_latin1[ucs];
+	for (idx = 0; idx < ITEMS_OF(gsm7_other); ++idx)
+		if (gsm7_other[idx][0] == ucs)
+			return gsm7_other[idx][1];
+	return GSM7_NONE;
+}
+
+#/* */
+EXPORT_DEF unsigned gsm7_char_septets (const char* in, size_t in_length, unsigned* bytes)
+{
+	unsigned ucs;
+	unsigned code;
+
+	*bytes = utf8_decode ((const unsigned char*)in, in_length, &ucs);
+	if (*bytes == 0)
+	{
+		*bytes = 1;
+		return 0;
 	}
-	out[x] = '\0';
+	code = gsm7_from_ucs (ucs);
+	if (code == GSM7_NONE)
+		return 0;
+	return code & GSM7_ESCAPED ? 2 : 1;
+}
 
-	return x;
+#/* pack count up to 8 septets to octets as hex digits, return number of digits */
+static size_t gsm7_pack (const unsigned char* septets, unsigned count, char* out)
+{
+	uint64_t v = 0;
+	unsigned octets = (count * 7 + 7) / 8;
+	unsigned i;
+
+	for (i = 0; i < count; ++i)
+		v |= (uint64_t)septets[i] << (i * 7);
+	for (i = 0; i < octets; ++i, v >>= 8, out += 2)
+		memcpy (out, hex_pairs + (v & 0xFF) * 2, 2);
+	return octets * 2;
 }
 
-static ssize_t hexstr_7bit_to_char (const char* in, size_t in_length, char* out, size_t out_size)
+#/* unpack up to 7 octets from hex digits to 8 septets, return -1 on invalid digit */
+static int gsm7_unpack (const char* in, unsigned octets, unsigned char* septets)
 {
-	size_t		i;
-	size_t		x;
-	size_t		s;
-	int		hexval;
-	unsigned char	c;
-	unsigned char	b;
-	char	buf[] = { 0x0, 0x0, 0x0 };
-
-	in_length = in_length / 2;
-	x = in_length + in_length / 7;
-	if (out_size - 1 < x)
+	uint64_t v = 0;
+	int d1, d2;
+	unsigned i;
+
+	for (i = 0; i < octets; ++i, in += 2)
 	{
-		return -1;
+		d1 = hex_values[(unsigned char)in[0]];
+		d2 = hex_values[(unsigned char)in[1]];
+		if ((d1 | d2) < 0)
+			return -1;
+		v |= (uint64_t)((d1 << 4) | d2) << (i * 8);
+	}
+	for (i = 0; i < 8; ++i, v >>= 7)
+		septets[i] = v & 0x7F;
+	return 0;
+}
+
+struct gsm7_packer
+{
+	unsigned char	block[8];			/*!< septets not packed yet */
+	unsigned	used;				/*!< septets in block */
+	unsigned	count;				/*!< septets total */
+	char*		out;
+	size_t		length;				/*!< digits written */
+	size_t		size;				/*!< digits available */
+};
+
+#/* add septet, pack block when full, return -1 if no space */
+static int gsm7_put (struct gsm7_packer* p, unsigned char septet)
+{
+	p->block[p->used++] = septet;
+	p->count++;
+	if (p->used == 8)
+	{
+		if (p->length + 14 > p->size)
+			return -1;
+		p->length += gsm7_pack (p->block, 8, p->out + p->length);
+		p->used = 0;
 	}
+	return 0;
+}
+
+#/* encode UTF-8 to packed septets after skip zero septets, with pad_cr fill 7 spare bits by CR */
+static ssize_t gsm7_encode (const char* in, size_t in_length, unsigned skip, int pad_cr, char* out, size_t out_size, unsigned* septets)
+{
+	const unsigned char* ptr = (const unsigned char*)in;
+	struct gsm7_packer p;
+	unsigned bytes;
+	unsigned ucs;
+	unsigned code;
 
-	for (i = 0, x = 0, s = 1, b = 0; i < in_length; i++)
+	if (out_size == 0)
+		return -ENOMEM;
+	p.used = p.count = 0;
+	p.out = out;
+	p.length = 0;
+	p.size = out_size - 1;
+
+	for (; skip; --skip)
+		if (gsm7_put (&p, 0))
+			return -ENOMEM;
+
+	while (in_length)
 	{
-		memcpy (buf, in + i * 2, 2);
-		if (sscanf (buf, "%x", &hexval) != 1)
+		if (*ptr < 0x80)
 		{
-			return -1;
+			code = gsm7_latin1[*ptr];
+			bytes = 1;
 		}
+		else
+		{
+			bytes = utf8_decode (ptr, in_length, &ucs);
+			if (bytes == 0)
+				return -EINVAL;
+			code = gsm7_from_ucs (ucs);
+		}
+		if (code == GSM7_NONE)
+			return -EINVAL;
+		if ((code & GSM7_ESCAPED) && gsm7_put (&p, GSM7_ESC))
+			return -ENOMEM;
+		if (gsm7_put (&p, code & 0x7F))
+			return -ENOMEM;
+		ptr += bytes;
+		in_length -= bytes;
+	}
+
+	*septets = p.count;
 
-		c = ((unsigned char) hexval) << s;
-		c = (c >> 1) | b;
-		b = ((unsigned char) hexval) >> (8 - s);
+	/* 7 spare bits of CR not counted, receiver without length drop it */
+	if (pad_cr && p.used == 7)
+		p.block[p.used++] = GSM7_CR;
+	if (p.used)
+	{
+		if (p.length + (p.used * 7 + 7) / 8 * 2 > p.size)
+			return -ENOMEM;
+		p.length += gsm7_pack (p.block, p.used, out + p.length);
+	}
+	out[p.length] = 0;
+
+	return p.length;
+}
+
+#/* decode packed septets to UTF-8 skip leading septets, count is number of septets or 0 for all */
+static ssize_t gsm7_decode (const char* in, size_t in_length, unsigned skip, unsigned count, char* out, size_t out_size)
+{
+	size_t octets = in_length / 2;
+	size_t total = octets * 8 / 7;
+	unsigned char block[8];
+	unsigned char septet;
+	char utf8[4];
+	size_t pos;
+	size_t x = 0;
+	unsigned avail;
+	unsigned len;
+	unsigned i;
+	unsigned ucs;
+	int d1, d2;
+	int escape = 0;
 
-		out[x] = c;
-		x++; s++;
+	if (out_size == 0)
+		return -ENOMEM;
 
-		if (s == 8)
+	if (count == 0 || count > total)
+	{
+		count = total;
+		/* without length CR in 7 spare bits of last octet is padding */
+		if (count && octets % 7 == 0)
 		{
-			out[x] = b;
-			s = 1; b = 0;
-			x++;
+			d1 = hex_values[(unsigned char)in[octets * 2 - 2]];
+			d2 = hex_values[(unsigned char)in[octets * 2 - 1]];
+			if ((d1 | d2) >= 0 && ((d1 << 4) | d2) >> 1 == GSM7_CR)
+				count--;
 		}
 	}
 
-	out[x] = '\0';
+	for (pos = 0; pos < count; pos += 8)
+	{
+		avail = octets - pos / 8 * 7 < 7 ? octets - pos / 8 * 7 : 7;
+		if (gsm7_unpack (in + pos / 8 * 14, avail, block))
+			return -EINVAL;
+
+		for (i = 0; i < 8 && pos + i < count; ++i)
+		{
+			if (pos + i < skip)
+				continue;
+			septet = block[i];
+			if (escape)
+			{
+				/* not defined in extension table shown as in default alphabet */
+				escape = 0;
+				ucs = gsm7_extension[septet] ? gsm7_extension[septet] : gsm7_default[septet];
+			}
+			else if (septet == GSM7_ESC)
+			{
+				escape = 1;
+				continue;
+			}
+			else
+			{
+				ucs = gsm7_default[septet];
+			}
+
+			len = utf8_encode (ucs, utf8);
+			if (x + len > out_size - 1)
+				return -ENOMEM;
+			memcpy (out + x, utf8, len);
+			x += len;
+		}
+	}
+	out[x] = 0;
 
 	return x;
 }
 
+#/* */
+EXPORT_DEF ssize_t gsm7_encode_hex (const char* in, size_t in_length, unsigned skip, char* out, size_t out_size, unsigned* septets)
+{
+	return gsm7_encode (in, in_length, skip, 0, out, out_size, septets);
+}
+
+#/* */
+EXPORT_DEF ssize_t gsm7_decode_hex (const char* in, size_t in_length, unsigned skip, unsigned count, char* out, size_t out_size)
+{
+	return gsm7_decode (in, in_length, skip, count, out, out_size);
+}
+
+#/* coder for USSD and others without length in septets */
+static ssize_t utf8_to_gsm7_hex (const char* in, size_t in_length, char* out, size_t out_size)
+{
+	unsigned septets;
+
+	return gsm7_encode (in, in_length, 0, 1, out, out_size, &septets);
+}
+
+#/* */
+static ssize_t gsm7_hex_to_utf8 (const char* in, size_t in_length, char* out, size_t out_size)
+{
+	return gsm7_decode (in, in_length, 0, 0, out, out_size);
+}
+
+/* base64 alphabet of RFC 4648 */
+static const char base64_chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+#/* */
+EXPORT_DEF ssize_t base64_encode (const char* in, size_t in_length, char* out, size_t out_size)
+{
+	const unsigned char* ptr = (const unsigned char*)in;
+	size_t len = BASE64_SIZE (in_length) - 1;
+	uint64_t word;
+
+	if (out_size <= len)
+		return -ENOMEM;
+
+	/* 6 octets to 8 characters through one 48 bit word */
+	for (; in_length >= 6; in_length -= 6, ptr += 6, out += 8)
+	{
+		word = ((uint64_t)ptr[0] << 40) | ((uint64_t)ptr[1] << 32) | ((uint64_t)ptr[2] << 24)
+			| ((uint64_t)ptr[3] << 16) | ((uint64_t)ptr[4] << 8) | ptr[5];
+		out[0] = base64_chars[(word >> 42) & 0x3F];
+		out[1] = base64_chars[(word >> 36) & 0x3F];
+		out[2] = base64_chars[(word >> 30) & 0x3F];
+		out[3] = base64_chars[(word >> 24) & 0x3F];
+		out[4] = base64_chars[(word >> 18) & 0x3F];
+		out[5] = base64_chars[(word >> 12) & 0x3F];
+		out[6] = base64_chars[(word >> 6) & 0x3F];
+		out[7] = base64_chars[word & 0x3F];
+	}
+
+	/* tail of 1..5 octets, last group padded by '=' */
+	for (; in_length; ptr += 3, out += 4)
+	{
+		word = (uint64_t)ptr[0] << 16;
+		if (in_length > 1)
+			word |= ptr[1] << 8;
+		if (in_length > 2)
+			word |= ptr[2];
+		out[0] = base64_chars[(word >> 18) & 0x3F];
+		out[1] = base64_chars[(word >> 12) & 0x3F];
+		out[2] = in_length > 1 ? base64_chars[(word >> 6) & 0x3F] : '=';
+		out[3] = in_length > 2 ? base64_chars[word & 0x3F] : '=';
+		in_length = in_length > 3 ? in_length - 3 : 0;
+	}
+
+	*out = 0;
+	return len;
+}
+
 #/* */
 ssize_t just_copy (const char* in, size_t in_length, char* out, size_t out_size)
 {
@@ -270,9 +706,9 @@ typedef ssize_t (*coder) (const char* in, size_t in_length, char* out, size_t ou
 static const coder recoders[][2] =
 {
 /* in order of values STR_ENCODING_*  */
-	{ hexstr_7bit_to_char, char_to_hexstr_7bit },		/* STR_ENCODING_7BIT_HEX */
+	{ gsm7_hex_to_utf8, utf8_to_gsm7_hex },			/* STR_ENCODING_7BIT_HEX */
 	{ hexstr_to_8bitchars, chars8bit_to_hexstr },		/* STR_ENCODING_8BIT_HEX */
-	{ hexstr_ucs2_to_utf8, utf8_to_hexstr_ucs2 },		/* STR_ENCODING_UCS2_HEX */
+	{ ucs2_hex_to_utf8, utf8_to_ucs2_hex },			/* STR_ENCODING_UCS2_HEX */
 	{ just_copy, just_copy },				/* STR_ENCODING_7BIT */
 };
 
@@ -288,10 +724,13 @@ EXPORT_DEF ssize_t str_recode(recode_direction_t dir, str_encoding_t encoding, c
 #/* */
 EXPORT_DEF str_encoding_t get_encoding(recode_direction_t hint, const char* in, size_t length)
 {
+	unsigned bytes;
+
 	if(hint == RECODE_ENCODE)
 	{
-		for(; length; --length, ++in)
-			if(*in & 0x80)
+		/* 7-bit if all characters in default alphabet or extension table */
+		for(; length; length -= bytes, in += bytes)
+			if(gsm7_char_septets(in, length, &bytes) == 0)
 				return STR_ENCODING_UCS2_HEX;
 		return STR_ENCODING_7BIT_HEX;
 	}
@@ -11,9 +11,9 @@
 /* for simplefy first 3 values same as in PDU DCS bits 3..2 */
 /* NOTE: order is magic see definition of recoders in char_conv.c */
 typedef enum {
-	STR_ENCODING_7BIT_HEX		= 0,	/* 7bit encoding */
+	STR_ENCODING_7BIT_HEX		= 0,	/* GSM 03.38 7bit alphabet packed septets in hex */
 	STR_ENCODING_8BIT_HEX,			/* 8bit encoding */
-	STR_ENCODING_UCS2_HEX,			/* UCS-2 in hex like PDU */
+	STR_ENCODING_UCS2_HEX,			/* UCS-2 (UTF-16BE with surrogate pairs) in hex like PDU */
 /* TODO: check its really 7bit input from device */
 	STR_ENCODING_7BIT,			/* 7bit ASCII  no need recode to utf-8 */
 //	STR_ENCODING_8BIT,			/* 8bit */
@@ -29,6 +29,19 @@ typedef enum {
 /* recode in both directions */
 EXPORT_DECL ssize_t str_recode(recode_direction_t dir, str_encoding_t encoding, const char* in, size_t in_length, char* out, size_t out_size);
 
+/* GSM 03.38 7-bit default alphabet with extension table, septets packed as hex digits like PDU */
+/* return 1 or 2 septets of UTF-8 character, 0 if not in alphabet, set bytes of character */
+EXPORT_DECL unsigned gsm7_char_septets(const char * in, size_t in_length, unsigned * bytes);
+/* encode after skip zero septets of UDH, set septets to total with skip */
+EXPORT_DECL ssize_t gsm7_encode_hex(const char * in, size_t in_length, unsigned skip, char * out, size_t out_size, unsigned * septets);
+/* decode count septets (0 all of in) and drop skip septets of UDH */
+EXPORT_DECL ssize_t gsm7_decode_hex(const char * in, size_t in_length, unsigned skip, unsigned count, char * out, size_t out_size);
+
+/* size of base64 text of length bytes with trailing zero */
+#define BASE64_SIZE(length)	(((length) + 2) / 3 * 4 + 1)
+/* encode by RFC 4648 with padding, return length of text, -ENOMEM if out_size less than BASE64_SIZE(in_length) */
+EXPORT_DECL ssize_t base64_encode(const char * in, size_t in_length, char * out, size_t out_size);
+
 EXPORT_DECL int parse_hexdigit(int hex);
 EXPORT_DECL str_encoding_t get_encoding(recode_direction_t hint, const char * in, size_t in_length);
 
@@ -21,6 +21,11 @@
 #include "chan_dongle.h"			/* devices */
 #include "helpers.h"				/* ITEMS_OF() send_ccwa_set() send_reset() send_sms() send_ussd() */
 #include "pdiscovery.h"				/* pdiscovery_list_begin() pdiscovery_list_next() pdiscovery_list_end() */
+#include "trace.h"				/* trace_set_mode() trace_dump() */
+#include "atrec.h"				/* atrec_start() atrec_stop() atrec_path() */
+#include "smsq.h"				/* smsq_path() smsq_stat_read() smsq_queues_read() */
+#include "ussdq.h"				/* ussdq_stat_read() ussdq_fanouts_read() ussdq_release() */
+#include "ussd.h"				/* USSD_ID() */
 
 static const char * restate2str_msg(restate_time_t when);
 
@@ -48,6 +53,7 @@ static char* complete_device (const char* word, int state)
 static char* cli_show_devices (struct ast_cli_entry* e, int cmd, struct ast_cli_args* a)
 {
 	struct pvt* pvt;
+	pvt_status_t status;
 
 #define FORMAT1 "%-12.12s %-5.5s %-10.10s %-4.4s %-4.4s %-7.7s %-14.14s %-10.10s %-17.17s %-16.16s %-16.16s %-14.14s\n"
 #define FORMAT2 "%-12.12s %-5d %-10.10s %-4d %-4d %-7d %-14.14s %-10.10s %-17.17s %-16.16s %-16.16s %-14.14s\n"
@@ -74,22 +80,21 @@ static char* cli_show_devices (struct ast_cli_entry* e, int cmd, struct ast_cli_
 	AST_RWLIST_RDLOCK (&gpublic->devices);
 	AST_RWLIST_TRAVERSE (&gpublic->devices, pvt, entry)
 	{
-		ast_mutex_lock (&pvt->lock);
+		pvt_status_read(pvt, &status);
 		ast_cli (a->fd, FORMAT2,
 			PVT_ID(pvt),
-			CONF_SHARED(pvt, group),
-			pvt_str_state(pvt),
-			pvt->rssi,
-			pvt->linkmode,
-			pvt->linksubmode,
-			pvt->provider_name,
-			pvt->model,
-			pvt->firmware,
-			pvt->imei,
-			pvt->imsi,
-			pvt->subscriber_number
+			SCONFIG(&status.settings, group),
+			status.str_state,
+			status.rssi,
+			status.linkmode,
+			status.linksubmode,
+			status.provider_name,
+			status.model,
+			status.firmware,
+			status.imei,
+			status.imsi,
+			status.subscriber_number
 		);
-		ast_mutex_unlock (&pvt->lock);
 	}
 	AST_RWLIST_UNLOCK (&gpublic->devices);
 
@@ -146,11 +151,18 @@ static char* cli_show_device_settings (struct ast_cli_entry* e, int cmd, struct
 		ast_cli (a->fd, "  Disable SMS             : %s\n", CONF_SHARED(pvt, disablesms) ? "Yes" : "No");
 		ast_cli (a->fd, "  Reset Dongle            : %s\n", CONF_SHARED(pvt, resetdongle) ? "Yes" : "No");
 		ast_cli (a->fd, "  SMS PDU                 : %s\n", CONF_SHARED(pvt, smsaspdu) ? "Yes" : "No");
+		ast_cli (a->fd, "  SMS Direct              : %s\n", CONF_SHARED(pvt, smsdirect) ? "Yes" : "No");
+		ast_cli (a->fd, "  SMS 16 bit Reference    : %s\n", CONF_SHARED(pvt, smsref16) ? "Yes" : "No");
+		ast_cli (a->fd, "  Dispatch                : %s\n", dc_dispatch_setting2str(CONF_SHARED(pvt, dispatch)));
 		ast_cli (a->fd, "  Call Waiting            : %s\n", dc_cw_setting2str(CONF_SHARED(pvt, callwaiting)));
 		ast_cli (a->fd, "  DTMF                    : %s\n", dc_dtmf_setting2str(CONF_SHARED(pvt, dtmf)));
 		ast_cli (a->fd, "  Minimal DTMF Gap        : %d\n", CONF_SHARED(pvt, mindtmfgap));
 		ast_cli (a->fd, "  Minimal DTMF Duration   : %d\n", CONF_SHARED(pvt, mindtmfduration));
 		ast_cli (a->fd, "  Minimal DTMF Interval   : %d\n", CONF_SHARED(pvt, mindtmfinterval));
+		ast_cli (a->fd, "  Minute budget           : %d\n", CONF_SHARED(pvt, minutebudget));
+		ast_cli (a->fd, "  SMS rate                : %d\n", CONF_SHARED(pvt, smsrate));
+		ast_cli (a->fd, "  VAD                     : %s threshold %d hangover %d%s\n", CONF_SHARED(pvt, vad) ? "Yes" : "No",
+			CONF_SHARED(pvt, vadthreshold), CONF_SHARED(pvt, vadhangover), CONF_SHARED(pvt, cng) ? " CNG" : "");
 		ast_cli (a->fd, "  Initial device state    : %s\n\n", dev_state2str(CONF_SHARED(pvt, initstate)));
 
 		ast_mutex_unlock (&pvt->lock);
@@ -249,7 +261,7 @@ static char* cli_show_device_state (struct ast_cli_entry* e, int cmd, struct ast
 }
 
 #/* */
-static int32_t getACD(uint32_t calls, uint32_t duration)
+static int32_t getACD(uint64_t calls, uint64_t duration)
 {
 	int32_t acd;
 
@@ -263,7 +275,7 @@ static int32_t getACD(uint32_t calls, uint32_t duration)
 }
 
 #/* */
-static int32_t getASR(uint32_t total, uint32_t handled)
+static int32_t getASR(uint64_t total, uint64_t handled)
 {
 	int32_t asr;
 	if(total) {
@@ -305,29 +317,43 @@ static char* cli_show_device_statistics (struct ast_cli_entry* e, int cmd, struc
 	{
 		ast_cli (a->fd, "-------------- Statistics -------------\n");
 		ast_cli (a->fd, "  Device                      : %s\n", PVT_ID(pvt));
-		ast_cli (a->fd, "  Queue tasks                 : %u\n", PVT_STAT(pvt, at_tasks));
-		ast_cli (a->fd, "  Queue commands              : %u\n", PVT_STAT(pvt, at_cmds));
-		ast_cli (a->fd, "  Responses                   : %u\n", PVT_STAT(pvt, at_responces));
-		ast_cli (a->fd, "  Bytes of read responses     : %u\n", PVT_STAT(pvt, d_read_bytes));
-		ast_cli (a->fd, "  Bytes of written commands   : %u\n", PVT_STAT(pvt, d_write_bytes));
+		ast_cli (a->fd, "  Queue tasks                 : %llu\n", (unsigned long long int)PVT_STAT(pvt, at_tasks));
+		ast_cli (a->fd, "  Queue commands              : %llu\n", (unsigned long long int)PVT_STAT(pvt, at_cmds));
+		ast_cli (a->fd, "  Responses                   : %llu\n", (unsigned long long int)PVT_STAT(pvt, at_responces));
+		ast_cli (a->fd, "  Bytes of read responses     : %llu\n", (unsigned long long int)PVT_STAT(pvt, d_read_bytes));
+		ast_cli (a->fd, "  Bytes of written commands   : %llu\n", (unsigned long long int)PVT_STAT(pvt, d_write_bytes));
 		ast_cli (a->fd, "  Bytes of read audio         : %llu\n", (unsigned long long int)PVT_STAT(pvt, a_read_bytes));
 		ast_cli (a->fd, "  Bytes of written audio      : %llu\n", (unsigned long long int)PVT_STAT(pvt, a_write_bytes));
-		ast_cli (a->fd, "  Readed frames               : %u\n", PVT_STAT(pvt, read_frames));
-		ast_cli (a->fd, "  Readed short frames         : %u\n", PVT_STAT(pvt, read_sframes));
-		ast_cli (a->fd, "  Wrote frames                : %u\n", PVT_STAT(pvt, write_frames));
-		ast_cli (a->fd, "  Wrote short frames          : %u\n", PVT_STAT(pvt, write_tframes));
-		ast_cli (a->fd, "  Wrote silence frames        : %u\n", PVT_STAT(pvt, write_sframes));
+		ast_cli (a->fd, "  Readed frames               : %llu\n", (unsigned long long int)PVT_STAT(pvt, read_frames));
+		ast_cli (a->fd, "  Readed short frames         : %llu\n", (unsigned long long int)PVT_STAT(pvt, read_sframes));
+		ast_cli (a->fd, "  Wrote frames                : %llu\n", (unsigned long long int)PVT_STAT(pvt, write_frames));
+		ast_cli (a->fd, "  Wrote short frames          : %llu\n", (unsigned long long int)PVT_STAT(pvt, write_tframes));
+		ast_cli (a->fd, "  Wrote silence frames        : %llu\n", (unsigned long long int)PVT_STAT(pvt, write_sframes));
 		ast_cli (a->fd, "  Write buffer overflow bytes : %llu\n", (unsigned long long int)PVT_STAT(pvt, write_rb_overflow_bytes));
-		ast_cli (a->fd, "  Write buffer overflow count : %u\n", PVT_STAT(pvt, write_rb_overflow));
-		ast_cli (a->fd, "  Incoming calls              : %u\n", PVT_STAT(pvt, in_calls));
-		ast_cli (a->fd, "  Waiting calls               : %u\n", PVT_STAT(pvt, cw_calls));
-		ast_cli (a->fd, "  Handled input calls         : %u\n", PVT_STAT(pvt, in_calls_handled));
-		ast_cli (a->fd, "  Fails to PBX run            : %u\n", PVT_STAT(pvt, in_pbx_fails));
-		ast_cli (a->fd, "  Attempts to outgoing calls  : %u\n", PVT_STAT(pvt, out_calls));
-		ast_cli (a->fd, "  Answered outgoing calls     : %u\n", PVT_STAT(pvt, calls_answered[CALL_DIR_OUTGOING]));
-		ast_cli (a->fd, "  Answered incoming calls     : %u\n", PVT_STAT(pvt, calls_answered[CALL_DIR_INCOMING]));
-		ast_cli (a->fd, "  Seconds of outgoing calls   : %u\n", PVT_STAT(pvt, calls_duration[CALL_DIR_OUTGOING]));
-		ast_cli (a->fd, "  Seconds of incoming calls   : %u\n", PVT_STAT(pvt, calls_duration[CALL_DIR_INCOMING]));
+		ast_cli (a->fd, "  Write buffer overflow count : %llu\n", (unsigned long long int)PVT_STAT(pvt, write_rb_overflow));
+		ast_cli (a->fd, "  Audio tap frames            : %llu\n", (unsigned long long int)PVT_STAT(pvt, tap_frames));
+		ast_cli (a->fd, "  Audio tap dropped frames    : %llu\n", (unsigned long long int)PVT_STAT(pvt, tap_dropped));
+		ast_cli (a->fd, "  SMS sent from spool         : %llu\n", (unsigned long long int)PVT_STAT(pvt, smsq_sent));
+		ast_cli (a->fd, "  SMS dropped from spool      : %llu\n", (unsigned long long int)PVT_STAT(pvt, smsq_failed));
+		ast_cli (a->fd, "  SMS parts received          : %lu\n", pvt->concat.stat.parts);
+		ast_cli (a->fd, "  SMS assembled from parts    : %lu\n", pvt->concat.stat.completed);
+		ast_cli (a->fd, "  SMS incomplete by timeout   : %lu\n", pvt->concat.stat.expired);
+		ast_cli (a->fd, "  SMS incomplete by limits    : %lu\n", pvt->concat.stat.evicted);
+		ast_cli (a->fd, "  SMS parts lost              : %lu\n", pvt->concat.stat.lost);
+		ast_cli (a->fd, "  SMS parts duplicated        : %lu\n", pvt->concat.stat.duplicates);
+		ast_cli (a->fd, "  SMS waiting for parts       : %u (%lu bytes)\n", pvt->concat.count, (unsigned long)pvt->concat.bytes);
+		ast_cli (a->fd, "  SMS scratch high water      : %lu of %lu bytes, heap %lu bytes\n", (unsigned long)pvt->sms_scratch.stat.high_water, (unsigned long)pvt->sms_scratch.size, (unsigned long)pvt->sms_scratch.stat.heap_high_water);
+		ast_cli (a->fd, "  SMS scratch heap allocations: %lu (%lu failed)\n", pvt->sms_scratch.stat.heap_allocs, pvt->sms_scratch.stat.failures);
+		ast_cli (a->fd, "  SMS receive stack depth     : %lu bytes\n", (unsigned long)pvt->sms_scratch.stat.stack_high_water);
+		ast_cli (a->fd, "  Incoming calls              : %llu\n", (unsigned long long int)PVT_STAT(pvt, in_calls));
+		ast_cli (a->fd, "  Waiting calls               : %llu\n", (unsigned long long int)PVT_STAT(pvt, cw_calls));
+		ast_cli (a->fd, "  Handled input calls         : %llu\n", (unsigned long long int)PVT_STAT(pvt, in_calls_handled));
+		ast_cli (a->fd, "  Fails to PBX run            : %llu\n", (unsigned long long int)PVT_STAT(pvt, in_pbx_fails));
+		ast_cli (a->fd, "  Attempts to outgoing calls  : %llu\n", (unsigned long long int)PVT_STAT(pvt, out_calls));
+		ast_cli (a->fd, "  Answered outgoing calls     : %llu\n", (unsigned long long int)PVT_STAT(pvt, calls_answered[CALL_DIR_OUTGOING]));
+		ast_cli (a->fd, "  Answered incoming calls     : %llu\n", (unsigned long long int)PVT_STAT(pvt, calls_answered[CALL_DIR_INCOMING]));
+		ast_cli (a->fd, "  Seconds of outgoing calls   : %llu\n", (unsigned long long int)PVT_STAT(pvt, calls_duration[CALL_DIR_OUTGOING]));
+		ast_cli (a->fd, "  Seconds of incoming calls   : %llu\n", (unsigned long long int)PVT_STAT(pvt, calls_duration[CALL_DIR_INCOMING]));
 		ast_cli (a->fd, "  ACD for incoming calls      : %d\n", getACD(PVT_STAT(pvt, calls_answered[CALL_DIR_INCOMING]), PVT_STAT(pvt, calls_duration[CALL_DIR_INCOMING])));
 		ast_cli (a->fd, "  ACD for outgoing calls      : %d\n", getACD(PVT_STAT(pvt, calls_answered[CALL_DIR_OUTGOING]), PVT_STAT(pvt, calls_duration[CALL_DIR_OUTGOING])));
 /*
@@ -390,6 +416,101 @@ static char* cli_show_version (struct ast_cli_entry* e, int cmd, struct ast_cli_
 	return CLI_SUCCESS;
 }
 
+#/* */
+static void cli_show_spool_queue(void * arg, const char * target, unsigned count)
+{
+	ast_cli (*(const int *)arg, "  Pending for %-17s: %u\n", target, count);
+}
+
+static char* cli_show_spool (struct ast_cli_entry* e, int cmd, struct ast_cli_args* a)
+{
+	struct smsq_stat stat;
+	const char * path;
+
+	switch (cmd)
+	{
+		case CLI_INIT:
+			e->command =	"dongle show spool";
+			e->usage   =	"Usage: dongle show spool\n"
+					"       Shows the state of outgoing SMS spool.\n";
+			return NULL;
+
+		case CLI_GENERATE:
+			return NULL;
+	}
+
+	if (a->argc != 3)
+	{
+		return CLI_SHOWUSAGE;
+	}
+
+	path = smsq_path();
+	if (!path)
+	{
+		ast_cli (a->fd, "SMS spool disabled, SMS sent directly\n");
+		return CLI_SUCCESS;
+	}
+
+	smsq_stat_read(&stat);
+	ast_cli (a->fd, "-------------- SMS spool --------------\n");
+	ast_cli (a->fd, "  Journal                     : %s\n", path);
+	ast_cli (a->fd, "  Journal size                : %llu\n", (unsigned long long int)stat.journal_size);
+	ast_cli (a->fd, "  Pending                     : %u\n", stat.pending);
+	ast_cli (a->fd, "  In flight                   : %u\n", stat.inflight);
+	ast_cli (a->fd, "  Accepted                    : %llu\n", (unsigned long long int)stat.accepted);
+	ast_cli (a->fd, "  Sent                        : %llu\n", (unsigned long long int)stat.sent);
+	ast_cli (a->fd, "  Dropped                     : %llu\n", (unsigned long long int)stat.failed);
+	ast_cli (a->fd, "  Retries                     : %llu\n", (unsigned long long int)stat.retries);
+	ast_cli (a->fd, "  Sent during last minute     : %u\n", stat.last_minute);
+	smsq_queues_read(cli_show_spool_queue, (void *)&a->fd);
+	ast_cli (a->fd, "\n");
+
+	return CLI_SUCCESS;
+}
+
+#/* */
+static void cli_show_ussd_fanout(void * arg, uint64_t id, int group, unsigned count, unsigned finished, unsigned inflight)
+{
+	ast_cli (*(const int *)arg, "  Group %-4d request %-12p: %u of %u finished, %u in flight\n", group, USSD_ID(id), finished, count, inflight);
+}
+
+static char* cli_show_ussd (struct ast_cli_entry* e, int cmd, struct ast_cli_args* a)
+{
+	struct ussdq_stat stat;
+
+	switch (cmd)
+	{
+		case CLI_INIT:
+			e->command =	"dongle show ussd";
+			e->usage   =	"Usage: dongle show ussd\n"
+					"       Shows USSD requests, answer cache and group requests in progress.\n";
+			return NULL;
+
+		case CLI_GENERATE:
+			return NULL;
+	}
+
+	if (a->argc != 3)
+	{
+		return CLI_SHOWUSAGE;
+	}
+
+	ussdq_stat_read(&stat);
+	ast_cli (a->fd, "-------------- USSD --------------\n");
+	ast_cli (a->fd, "  Requests                    : %llu\n", (unsigned long long int)stat.requests);
+	ast_cli (a->fd, "  Answers                     : %llu\n", (unsigned long long int)stat.answers);
+	ast_cli (a->fd, "  Answered from cache         : %llu\n", (unsigned long long int)stat.cached);
+	ast_cli (a->fd, "  Not sent                    : %llu\n", (unsigned long long int)stat.failed);
+	ast_cli (a->fd, "  Sessions timed out          : %llu\n", (unsigned long long int)stat.timeouts);
+	ast_cli (a->fd, "  Answers in cache            : %u\n", stat.cache_entries);
+	ast_cli (a->fd, "  Cache time                  : %d\n", CONF_GLOBAL(ussdcache));
+	ast_cli (a->fd, "  Group requests              : %u\n", stat.fanouts);
+	ussdq_fanouts_read(cli_show_ussd_fanout, (void *)&a->fd);
+	ast_cli (a->fd, "\n");
+
+	return CLI_SUCCESS;
+}
+
 static char* cli_cmd (struct ast_cli_entry* e, int cmd, struct ast_cli_args* a)
 {
 	const char * msg;
@@ -433,9 +554,10 @@ static char* cli_ussd (struct ast_cli_entry* e, int cmd, struct ast_cli_args* a)
 		case CLI_INIT:
 			e->command = "dongle ussd";
 			e->usage =
-				"Usage: dongle ussd <device> <command>\n"
+				"Usage: dongle ussd <device> <command> [session]\n"
 				"       Send ussd <command> to the dongle\n"
-				"       with the specified <device>.\n";
+				"       with the specified <device> or to all dongles of g<group>,\n"
+				"       with [session] id as next step of open menu session.\n";
 			return NULL;
 
 		case CLI_GENERATE:
@@ -446,14 +568,17 @@ static char* cli_ussd (struct ast_cli_entry* e, int cmd, struct ast_cli_args* a)
 			return NULL;
 	}
 
-	if (a->argc != 4)
+	if (a->argc != 4 && a->argc != 5)
 	{
 		return CLI_SHOWUSAGE;
 	}
 
-	msg = send_ussd(a->argv[2], a->argv[3], &status, &msgid);
+	msg = send_ussd(a->argv[2], a->argv[3], a->argc == 5 ? a->argv[4] : NULL, NULL, &status, &msgid);
 	if(status)
+	{
 		ast_cli (a->fd, "[%s] %s with id %p\n", a->argv[2], msg, msgid);
+		ussdq_release((uintptr_t)msgid);
+	}
 	else
 		ast_cli (a->fd, "[%s] %s\n", a->argv[2], msg);
 
@@ -908,7 +1033,122 @@ static char * cli_discovery(struct ast_cli_entry * e, int cmd, struct ast_cli_ar
 	return CLI_SUCCESS;
 }
 
+#ifdef BUILD_TRACE
+
+static char* cli_trace (struct ast_cli_entry* e, int cmd, struct ast_cli_args* a)
+{
+	static const char * const choices[] = { "off", "ring", "debug", "dump", NULL };
+	unsigned count;
+	int mode;
+	int err;
+
+	switch (cmd)
+	{
+		case CLI_INIT:
+			e->command = "dongle trace";
+			e->usage =
+				"Usage: dongle trace off|ring|debug\n"
+				"       dongle trace dump <file>\n"
+				"       Control per frame trace of audio and AT read paths:\n"
+				"       off   - no trace, default\n"
+				"       ring  - store binary records in memory ring\n"
+				"       debug - write records to debug log as text\n"
+				"       dump  - save ring to <file> for decode by tracedump tool\n";
+			return NULL;
+
+		case CLI_GENERATE:
+			if (a->pos == 2)
+			{
+				return ast_cli_complete(a->word, (ast_cli_complete2_t)choices, a->n);
+			}
+			return NULL;
+	}
+
+	if (a->argc == 4 && strcasecmp("dump", a->argv[2]) == 0)
+	{
+		err = trace_dump(a->argv[3], &count);
+		if(err)
+			ast_cli (a->fd, "Can't save trace to %s: %s\n", a->argv[3], strerror(err));
+		else
+			ast_cli (a->fd, "Saved %u records to %s\n", count, a->argv[3]);
+		return CLI_SUCCESS;
+	}
+
+	if (a->argc != 3)
+	{
+		return CLI_SHOWUSAGE;
+	}
+	for(mode = TRACE_OFF; mode <= TRACE_DEBUG; ++mode)
+	{
+		if(strcasecmp(trace_mode2str(mode), a->argv[2]) == 0)
+			break;
+	}
+	if(mode > TRACE_DEBUG)
+		return CLI_SHOWUSAGE;
+
+	ast_cli (a->fd, "Trace mode changed from %s to %s\n", trace_mode2str(trace_set_mode(mode)), trace_mode2str(mode));
+
+	return CLI_SUCCESS;
+}
+
+#endif /* BUILD_TRACE */
+
+#ifdef BUILD_ATREC
+
+static char* cli_record (struct ast_cli_entry* e, int cmd, struct ast_cli_args* a)
+{
+	static const char * const choices[] = { "start", "stop", "status", NULL };
+	unsigned long bytes, dropped;
+	const char * path;
+	int err;
+
+	switch (cmd)
+	{
+		case CLI_INIT:
+			e->command = "dongle record";
+			e->usage =
+				"Usage: dongle record start <file>|stop|status\n"
+				"       Record all AT traffic of devices to <file> for replay by atreplay tool\n";
+			return NULL;
+
+		case CLI_GENERATE:
+			if (a->pos == 2)
+			{
+				return ast_cli_complete(a->word, (ast_cli_complete2_t)choices, a->n);
+			}
+			return NULL;
+	}
+
+	if (a->argc == 4 && strcasecmp("start", a->argv[2]) == 0)
+	{
+		err = atrec_start(a->argv[3]);
+		if(err)
+			ast_cli (a->fd, "Can't start recording to %s: %s\n", a->argv[3], strerror(err));
+		else
+			ast_cli (a->fd, "Recording to %s\n", a->argv[3]);
+	}
+	else if (a->argc == 3 && strcasecmp("stop", a->argv[2]) == 0)
+	{
+		err = atrec_stop(&bytes, &dropped);
+		if(err)
+			ast_cli (a->fd, "Can't stop recording: %s\n", strerror(err));
+		else
+			ast_cli (a->fd, "Recording stopped, %lu bytes saved, %lu records dropped\n", bytes, dropped);
+	}
+	else if (a->argc == 3 && strcasecmp("status", a->argv[2]) == 0)
+	{
+		path = atrec_path();
+		ast_cli (a->fd, "%s%s\n", path ? "Recording to " : "Not recording", path ? path : "");
+	}
+	else
+	{
+		return CLI_SHOWUSAGE;
+	}
+
+	return CLI_SUCCESS;
+}
 
+#endif /* BUILD_ATREC */
 
 static struct ast_cli_entry cli[] = {
 	AST_CLI_DEFINE (cli_show_devices,	"Show Dongle devices state"),
@@ -916,6 +1156,8 @@ static struct ast_cli_entry cli[] = {
 	AST_CLI_DEFINE (cli_show_device_state,	 "Show Dongle device state"),
 	AST_CLI_DEFINE (cli_show_device_statistics,"Show Dongle device statistics"),
 	AST_CLI_DEFINE (cli_show_version,	"Show module version"),
+	AST_CLI_DEFINE (cli_show_spool,		"Show outgoing SMS spool"),
+	AST_CLI_DEFINE (cli_show_ussd,		"Show USSD requests and cache"),
 	AST_CLI_DEFINE (cli_cmd,		"Send commands to port for debugging"),
 	AST_CLI_DEFINE (cli_ussd,		"Send USSD commands to the dongle"),
 	AST_CLI_DEFINE (cli_sms,		"Send SMS from the dongle"),
@@ -930,6 +1172,12 @@ static struct ast_cli_entry cli[] = {
 
 	AST_CLI_DEFINE (cli_start,		"Start dongle"),
 	AST_CLI_DEFINE (cli_discovery,		"Discovery devices and create config"),
+#ifdef BUILD_TRACE
+	AST_CLI_DEFINE (cli_trace,		"Control per frame trace"),
+#endif /* BUILD_TRACE */
+#ifdef BUILD_ATREC
+	AST_CLI_DEFINE (cli_record,		"Record AT traffic"),
+#endif /* BUILD_ATREC */
 };
 
 #/* */
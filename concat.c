@@ -0,0 +1,209 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>			/* malloc() free() */
+#include <string.h>			/* memcpy() memset() strcmp() strlen() */
+
+#include "concat.h"
+
+struct concat_msg
+{
+	struct concat_msg	* next;				/*!< next younger message */
+	time_t			expire;				/*!< time of delivery with missing parts */
+	unsigned		ref;				/*!< reference number from UDH */
+	unsigned		total;				/*!< number of parts from UDH */
+	unsigned		received;			/*!< number of stored parts */
+	size_t			size;				/*!< bytes of stored parts */
+	char			* number;			/*!< originator, stored after parts */
+	char			* parts[1];			/*!< total texts in order of sequence, NULL for missing */
+};
+
+#/* */
+EXPORT_DEF void concat_init(struct concat * cc)
+{
+	memset(cc, 0, sizeof(*cc));
+}
+
+#/* unlink message from cache and free it */
+static void concat_free(struct concat * cc, struct concat_msg * msg)
+{
+	struct concat_msg ** prev;
+	unsigned idx;
+
+	for(prev = &cc->msgs; *prev; prev = &(*prev)->next)
+	{
+		if(*prev == msg)
+		{
+			*prev = msg->next;
+			break;
+		}
+	}
+
+	for(idx = 0; idx < msg->total; ++idx)
+		free(msg->parts[idx]);
+	cc->bytes -= msg->size;
+	cc->count--;
+	free(msg);
+}
+
+#/* deliver stored parts in order and free message */
+static void concat_deliver(struct concat * cc, struct concat_msg * msg, concat_deliver_t deliver, void * arg)
+{
+	unsigned missing = msg->total - msg->received;
+	size_t length = 0;
+	size_t part_len;
+	unsigned idx;
+	char * text;
+
+	cc->stat.lost += missing;
+
+	text = malloc(msg->size + 1);
+	if(text)
+	{
+		for(idx = 0; idx < msg->total; ++idx)
+		{
+			if(msg->parts[idx])
+			{
+				part_len = strlen(msg->parts[idx]);
+				memcpy(text + length, msg->parts[idx], part_len);
+				length += part_len;
+			}
+		}
+		text[length] = 0;
+		deliver(arg, msg->number, text, length, missing);
+		free(text);
+	}
+	else
+	{
+		/* better separately than never */
+		for(idx = 0; idx < msg->total; ++idx)
+			if(msg->parts[idx])
+				deliver(arg, msg->number, msg->parts[idx], strlen(msg->parts[idx]), missing);
+	}
+
+	concat_free(cc, msg);
+}
+
+#/* deliver oldest incomplete message except keep, return 0 if no such message */
+static int concat_evict(struct concat * cc, const struct concat_msg * keep, concat_deliver_t deliver, void * arg)
+{
+	struct concat_msg * msg;
+
+	for(msg = cc->msgs; msg; msg = msg->next)
+	{
+		if(msg != keep)
+		{
+			cc->stat.evicted++;
+			concat_deliver(cc, msg, deliver, arg);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+#/* */
+EXPORT_DEF void concat_destroy(struct concat * cc)
+{
+	while(cc->msgs)
+		concat_free(cc, cc->msgs);
+}
+
+#/* */
+EXPORT_DEF int concat_add(struct concat * cc, const char * number, unsigned ref, unsigned total, unsigned seq, const char * text, size_t length, time_t now, concat_deliver_t deliver, void * arg)
+{
+	struct concat_msg ** tail;
+	struct concat_msg * msg;
+	size_t number_len;
+	char * part;
+
+	if(total < 2 || seq < 1 || seq > total || length > CONCAT_MAX_BYTES)
+		return -1;
+
+	cc->stat.parts++;
+	for(tail = &cc->msgs; *tail; tail = &(*tail)->next)
+	{
+		msg = *tail;
+		if(msg->ref == ref && msg->total == total && strcmp(msg->number, number) == 0)
+			break;
+	}
+	msg = *tail;
+
+	if(msg && msg->parts[seq - 1])
+	{
+		cc->stat.duplicates++;
+		return 0;
+	}
+
+	/* make room, message of this part stay in cache */
+	while((cc->count >= CONCAT_MAX_MESSAGES && !msg) || cc->bytes + length > CONCAT_MAX_BYTES)
+	{
+		if(!concat_evict(cc, msg, deliver, arg))
+			break;
+	}
+	if(msg && cc->bytes + length > CONCAT_MAX_BYTES)
+	{
+		/* rest of this message too big, give it up */
+		cc->stat.evicted++;
+		concat_deliver(cc, msg, deliver, arg);
+		return -1;
+	}
+
+	part = malloc(length + 1);
+	if(!part)
+		return -1;
+	memcpy(part, text, length);
+	part[length] = 0;
+
+	if(!msg)
+	{
+		number_len = strlen(number);
+		msg = calloc(1, sizeof(*msg) + (total - 1) * sizeof(msg->parts[0]) + number_len + 1);
+		if(!msg)
+		{
+			free(part);
+			return -1;
+		}
+		msg->expire = now + CONCAT_TIMEOUT;
+		msg->ref = ref;
+		msg->total = total;
+		msg->number = (char *)&msg->parts[total];
+		memcpy(msg->number, number, number_len + 1);
+
+		/* eviction may change tail */
+		for(tail = &cc->msgs; *tail; tail = &(*tail)->next)
+			;
+		*tail = msg;
+		cc->count++;
+	}
+
+	msg->parts[seq - 1] = part;
+	msg->received++;
+	msg->size += length;
+	cc->bytes += length;
+
+	if(msg->received < total)
+		return 0;
+
+	cc->stat.completed++;
+	concat_deliver(cc, msg, deliver, arg);
+	return 1;
+}
+
+#/* */
+EXPORT_DEF int concat_expire(struct concat * cc, time_t now, concat_deliver_t deliver, void * arg)
+{
+	int delivered = 0;
+
+	/* same timeout for all, oldest expire first */
+	while(cc->msgs && cc->msgs->expire <= now)
+	{
+		cc->stat.expired++;
+		concat_deliver(cc, cc->msgs, deliver, arg);
+		delivered++;
+	}
+	return delivered;
+}
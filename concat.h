@@ -0,0 +1,65 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifndef CHAN_DONGLE_CONCAT_H_INCLUDED
+#define CHAN_DONGLE_CONCAT_H_INCLUDED
+
+#include <sys/types.h>			/* size_t */
+#include <time.h>			/* time_t */
+
+#include "export.h"			/* EXPORT_DECL EXPORT_DEF */
+
+/*
+   Reassembly of received concatenated SMS.
+   Each device own cache, parts keyed by originator, reference number and
+   number of parts. Parts may arrive in any order, repeated part ignored.
+   Message delivered once when all parts received. Incomplete message
+   delivered with missing parts after CONCAT_TIMEOUT or when new message
+   not fit to CONCAT_MAX_MESSAGES or CONCAT_MAX_BYTES, oldest first.
+   Caller must serialize calls, chan_dongle hold lock of device.
+*/
+
+#define CONCAT_MAX_MESSAGES	16			/* incomplete messages per device */
+#define CONCAT_MAX_BYTES	(64 * 1024)		/* text of stored parts per device */
+#define CONCAT_TIMEOUT		120			/* seconds to wait missing parts since first part */
+
+/* deliver assembled text of length bytes with 0 terminator, missing is number of lost parts */
+typedef void (*concat_deliver_t)(void * arg, const char * number, const char * text, size_t length, unsigned missing);
+
+struct concat_msg;
+
+struct concat_stat
+{
+	unsigned long		parts;				/*!< parts received */
+	unsigned long		completed;			/*!< messages delivered with all parts */
+	unsigned long		expired;			/*!< incomplete messages delivered by timeout */
+	unsigned long		evicted;			/*!< incomplete messages delivered by limits */
+	unsigned long		duplicates;			/*!< parts received again and ignored */
+	unsigned long		lost;				/*!< parts missing in delivered messages */
+};
+
+typedef struct concat
+{
+	struct concat_msg	* msgs;				/*!< incomplete messages, oldest first */
+	unsigned		count;				/*!< number of incomplete messages */
+	size_t			bytes;				/*!< bytes of stored parts */
+	struct concat_stat	stat;
+} concat_t;
+
+/* initialize empty cache */
+EXPORT_DECL void concat_init(struct concat * cc);
+
+/* drop all incomplete messages without delivery */
+EXPORT_DECL void concat_destroy(struct concat * cc);
+
+/*
+   add part seq of total, deliver message if all parts received
+   return 1 if message delivered, 0 if part stored or ignored,
+   -1 if part invalid or no memory, caller should deliver part as single message
+*/
+EXPORT_DECL int concat_add(struct concat * cc, const char * number, unsigned ref, unsigned total, unsigned seq, const char * text, size_t length, time_t now, concat_deliver_t deliver, void * arg);
+
+/* deliver incomplete messages expired at now, return number of delivered messages */
+EXPORT_DECL int concat_expire(struct concat * cc, time_t now, concat_deliver_t deliver, void * arg);
+
+#endif /* CHAN_DONGLE_CONCAT_H_INCLUDED */
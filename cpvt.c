@@ -65,8 +65,7 @@ EXPORT_DEF struct cpvt * cpvt_alloc(struct pvt * pvt, int call_idx, unsigned dir
 				pvt_on_create_1st_channel(pvt);
 			PVT_STATE(pvt, chansno)++;
 			PVT_STATE(pvt, chan_count[cpvt->state])++;
-			
-
+			pvt_state_publish(pvt);
 
 			ast_debug (3, "[%s] create cpvt for call_idx %d dir %d state '%s'\n",  PVT_ID(pvt), call_idx, dir, call_state2str(state));
 			return cpvt;
@@ -115,6 +114,7 @@ EXPORT_DEF void cpvt_free(struct cpvt* cpvt)
 		pvt_on_remove_last_channel(pvt);
 		pvt_try_restate(pvt);
 		}
+	pvt_state_publish(pvt);
 
 	ast_free(cpvt);
 }
@@ -131,6 +131,79 @@ EXPORT_DEF struct cpvt * pvt_find_cpvt(struct pvt * pvt, int call_idx)
 	return 0;
 }
 
+#/* difference in ms between audio readed and time elapsed, positive if device faster than our clock */
+EXPORT_DEF int cpvt_stat_drift(const struct cpvt_stat * stat)
+{
+	if(ast_tvzero(stat->read_first))
+		return 0;
+	return (int)(stat->read_bytes / 16) - (int)ast_tvdiff_ms(stat->read_last, stat->read_first);
+}
+
+#/* average write buffer depth in bytes */
+EXPORT_DEF unsigned cpvt_stat_depth_avg(const struct cpvt_stat * stat)
+{
+	if(stat->write_frames == 0)
+		return 0;
+	return stat->depth_sum / stat->write_frames;
+}
+
+#/* format one field by name or all fields as name=value list for name "audiostats", return 0 on success */
+EXPORT_DEF int cpvt_stat_field(const struct cpvt_stat * stat, const char * name, char * buf, size_t len)
+{
+	static const char * const names[] = {
+		"readframes",
+		"shortreads",
+		"jitter",
+		"jittermax",
+		"drift",
+		"writeframes",
+		"silenceframes",
+		"truncatedframes",
+		"overflows",
+		"overflowbytes",
+		"bufmax",
+		"bufavg",
+		"vadsilent",
+	};
+	long long values[ITEMS_OF(names)];
+	unsigned i;
+	int all = strcasecmp(name, "audiostats") == 0;
+	int written = 0;
+
+	values[0] = stat->read_frames;
+	values[1] = stat->read_sframes;
+	values[2] = stat->jitter;
+	values[3] = stat->jitter_max;
+	values[4] = cpvt_stat_drift(stat);
+	values[5] = stat->write_frames;
+	values[6] = stat->write_sframes;
+	values[7] = stat->write_tframes;
+	values[8] = stat->write_rb_overflow;
+	values[9] = stat->write_rb_overflow_bytes;
+	values[10] = stat->depth_max;
+	values[11] = cpvt_stat_depth_avg(stat);
+	values[12] = stat->read_vad_silent;
+
+	if(len)
+		buf[0] = 0;
+
+	for(i = 0; i < ITEMS_OF(names); ++i)
+	{
+		if(all)
+		{
+			if((size_t)written < len)
+				written += snprintf(buf + written, len - written, "%s%s=%lld", written ? "," : "", names[i], values[i]);
+		}
+		else if(strcasecmp(name, names[i]) == 0)
+		{
+			snprintf(buf, len, "%lld", values[i]);
+			return 0;
+		}
+	}
+
+	return all ? 0 : -1;
+}
+
 #/* */
 EXPORT_DEF const char * pvt_call_dir(const struct pvt * pvt)
 {
@@ -4,6 +4,9 @@
 #ifndef CHAN_DONGLE_CPVT_H_INCLUDED
 #define CHAN_DONGLE_CPVT_H_INCLUDED
 
+#include <sys/uio.h>				/* struct iovec */
+#include <sys/time.h>				/* struct timeval */
+
 #include <asterisk.h>
 #include <asterisk/linkedlists.h>		/* AST_LIST_ENTRY() */
 #include <asterisk/frame.h>			/* AST_FRIENDLY_OFFSET */
@@ -13,6 +16,7 @@
 #include "mutils.h"				/* enum2str() ITEMS_OF() */
 
 #define FRAME_SIZE		320
+#define CPVT_READ_FRAMES	3				/* max number of frames readed by one syscall */
 
 typedef enum {
 	CALL_STATE_MIN		= 0,
@@ -45,6 +49,30 @@ typedef enum {
 } call_flag_t;
 
 
+/* per call audio statistics */
+typedef struct cpvt_stat
+{
+	uint32_t		read_frames;			/*!< number of frames readed from device */
+	uint32_t		read_sframes;			/*!< number of short frames readed from device */
+	uint64_t		read_bytes;			/*!< bytes readed after first read, for drift estimation */
+	struct timeval		read_first;			/*!< time of first read */
+	struct timeval		read_last;			/*!< time of last read */
+	size_t			read_last_bytes;		/*!< bytes of last read, define expected interval to next */
+	uint32_t		jitter;				/*!< interarrival jitter of reads in usec, as RFC 3550 */
+	uint32_t		jitter_max;			/*!< maximal interarrival deviation in usec */
+	uint32_t		read_vad_silent;		/*!< number of readed frames classified as silence by VAD */
+
+	uint32_t		write_frames;			/*!< number of frames written to device while master */
+	uint32_t		write_tframes;			/*!< number of truncated frames written */
+	uint32_t		write_sframes;			/*!< number of silence frames written */
+	uint32_t		write_rb_overflow;		/*!< number of write buffer overflows */
+	uint64_t		write_rb_overflow_bytes;	/*!< number of overflow bytes */
+	uint32_t		depth_max;			/*!< maximal write buffer depth in bytes */
+	uint64_t		depth_sum;			/*!< sum of write buffer depth on each write, for average */
+} cpvt_stat_t;
+
+#define CPVT_STAT(cpvt, name)		((cpvt)->stat.name)
+
 /* */
 typedef struct cpvt {
 	AST_LIST_ENTRY (cpvt)	entry;				/*!< linked list pointers */
@@ -69,8 +97,15 @@ typedef struct cpvt {
 #define PIPE_WRITE		1
 
 	struct mixstream	mixstream;			/*!< mix stream */
-	char			a_read_buf[FRAME_SIZE + AST_FRIENDLY_OFFSET];/*!< audio read buffer */
-	struct ast_frame	a_read_frame;			/*!< readed frame buffer */
+	char			a_read_buf[CPVT_READ_FRAMES][FRAME_SIZE + AST_FRIENDLY_OFFSET];/*!< audio read buffers */
+	struct ast_frame	a_read_frame[CPVT_READ_FRAMES];	/*!< readed frames, initialized on activation */
+	struct iovec		a_read_iov[CPVT_READ_FRAMES];	/*!< readv() vector over a_read_buf */
+	int			a_read_seqno;			/*!< sequence number of next readed frame */
+	long			a_read_ts;			/*!< timestamp of next readed frame, ms */
+	unsigned int		vad_hangover;			/*!< VAD: frames left before speech switched to silence, 0 when silence */
+	unsigned int		vad_cng_sent:1;			/*!< VAD: CNG frame for current silence period already queued */
+
+	cpvt_stat_t		stat;				/*!< audio statistics of call */
 
 //	size_t			write;				/*!< write position in pvt->a_write_buf */
 //	size_t			used;				/*!< bytes used in pvt->a_write_buf */
@@ -92,6 +127,9 @@ EXPORT_DECL struct cpvt * cpvt_alloc(struct pvt * pvt, int call_idx, unsigned di
 EXPORT_DECL void cpvt_free(struct cpvt* cpvt);
 
 EXPORT_DECL struct cpvt * pvt_find_cpvt(struct pvt * pvt, int call_idx);
+EXPORT_DECL int cpvt_stat_drift(const struct cpvt_stat * stat);
+EXPORT_DECL unsigned cpvt_stat_depth_avg(const struct cpvt_stat * stat);
+EXPORT_DECL int cpvt_stat_field(const struct cpvt_stat * stat, const char * name, char * buf, size_t len);
 EXPORT_DECL const char * pvt_call_dir(const struct pvt * pvt);
 
 #/* */
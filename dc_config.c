@@ -30,6 +30,18 @@ EXPORT_DEF const char * dc_dtmf_setting2str(dc_dtmf_setting_t dtmf)
 	return enum2str(dtmf, dtmf_values, ITEMS_OF(dtmf_values));
 }
 
+static const char * const dispatch_values[] = { "local", "message", "manager" };
+
+EXPORT_DEF int dc_dispatch_str2setting(const char * value)
+{
+	return str2enum(value, dispatch_values, ITEMS_OF(dispatch_values));
+}
+
+EXPORT_DEF const char * dc_dispatch_setting2str(dc_dispatch_t dispatch)
+{
+	return enum2str(dispatch, dispatch_values, ITEMS_OF(dispatch_values));
+}
+
 #/* assume config is zerofill */
 static int dc_uconfig_fill(struct ast_config * cfg, const char * cat, struct dc_uconfig * config)
 {
@@ -99,6 +111,9 @@ EXPORT_DEF void dc_sconfig_fill_defaults(struct dc_sconfig * config)
 	config->mindtmfgap		= DEFAULT_MINDTMFGAP;
 	config->mindtmfduration		= DEFAULT_MINDTMFDURATION;
 	config->mindtmfinterval		= DEFAULT_MINDTMFINTERVAL;
+
+	config->vadthreshold		= DEFAULT_VADTHRESHOLD;
+	config->vadhangover		= DEFAULT_VADHANGOVER;
 }
 
 #/* */
@@ -175,6 +190,14 @@ EXPORT_DEF void dc_sconfig_fill(struct ast_config * cfg, const char * cat, struc
 		{
 			config->smsaspdu = ast_true (v->value);			/* send_sms_as_pdu us set to 0 if invalid */
 		}
+		else if (!strcasecmp (v->name, "smsdirect"))
+		{
+			config->smsdirect = ast_true (v->value);		/* smsdirect is set to 0 if invalid */
+		}
+		else if (!strcasecmp (v->name, "smsref16"))
+		{
+			config->smsref16 = ast_true (v->value);			/* smsref16 is set to 0 if invalid */
+		}
 		else if (!strcasecmp (v->name, "disable"))
 		{
 			config->initstate = ast_true (v->value) ? DEV_STATE_REMOVED : DEV_STATE_STARTED;
@@ -230,6 +253,117 @@ EXPORT_DEF void dc_sconfig_fill(struct ast_config * cfg, const char * cat, struc
 				config->mindtmfduration = DEFAULT_MINDTMFINTERVAL;
 			}
 		}
+		else if (!strcasecmp (v->name, "audiotap"))
+		{
+			ast_copy_string (config->audiotap, v->value, sizeof (config->audiotap));
+		}
+		else if (!strcasecmp (v->name, "vad"))
+		{
+			config->vad = ast_true (v->value);
+		}
+		else if (!strcasecmp (v->name, "cng"))
+		{
+			config->cng = ast_true (v->value);
+		}
+		else if (!strcasecmp (v->name, "vadthreshold"))
+		{
+			errno = 0;
+			config->vadthreshold = (int) strtol (v->value, (char**) NULL, 10);
+			if ((config->vadthreshold == 0 && errno == EINVAL) || config->vadthreshold <= 0 || config->vadthreshold > 32767)
+			{
+				ast_log(LOG_ERROR, "Invalid value for 'vadthreshold' '%s', setting default %d\n", v->value, DEFAULT_VADTHRESHOLD);
+				config->vadthreshold = DEFAULT_VADTHRESHOLD;
+			}
+		}
+		else if (!strcasecmp (v->name, "vadhangover"))
+		{
+			errno = 0;
+			config->vadhangover = (int) strtol (v->value, (char**) NULL, 10);
+			if ((config->vadhangover == 0 && errno == EINVAL) || config->vadhangover < 0)
+			{
+				ast_log(LOG_ERROR, "Invalid value for 'vadhangover' '%s', setting default %d\n", v->value, DEFAULT_VADHANGOVER);
+				config->vadhangover = DEFAULT_VADHANGOVER;
+			}
+		}
+		else if (!strcasecmp (v->name, "minutebudget"))
+		{
+			errno = 0;
+			config->minutebudget = (int) strtol (v->value, (char**) NULL, 10);
+			if ((config->minutebudget == 0 && errno == EINVAL) || config->minutebudget < 0)
+			{
+				ast_log(LOG_ERROR, "Invalid value for 'minutebudget' '%s', setting default 0 (unlimited)\n", v->value);
+				config->minutebudget = 0;
+			}
+		}
+		else if (!strcasecmp (v->name, "smsrate"))
+		{
+			errno = 0;
+			config->smsrate = (int) strtol (v->value, (char**) NULL, 10);
+			if ((config->smsrate == 0 && errno == EINVAL) || config->smsrate < 0)
+			{
+				ast_log(LOG_ERROR, "Invalid value for 'smsrate' '%s', setting default 0 (unlimited)\n", v->value);
+				config->smsrate = 0;
+			}
+		}
+		else if (!strcasecmp (v->name, "dispatch"))
+		{
+			int val = dc_dispatch_str2setting(v->value);
+#ifndef HAVE_AST_MSG_QUEUE
+			if(val == DC_DISPATCH_MESSAGE)
+			{
+				ast_log(LOG_ERROR, "Value 'message' for 'dispatch' require asterisk with message API, setting default 'local'\n");
+				val = DC_DISPATCH_LOCAL;
+			}
+#endif /* HAVE_AST_MSG_QUEUE */
+#ifndef BUILD_MANAGER
+			if(val == DC_DISPATCH_MANAGER)
+			{
+				ast_log(LOG_ERROR, "Value 'manager' for 'dispatch' require build with manager, setting default 'local'\n");
+				val = DC_DISPATCH_LOCAL;
+			}
+#endif /* BUILD_MANAGER */
+			if(val >= 0)
+				config->dispatch = val;
+			else
+				ast_log(LOG_ERROR, "Invalid value for 'dispatch': '%s', setting default 'local'\n", v->value);
+		}
+	}
+}
+
+#/* read non-negative weight of w<group> device score, keep default if absent or invalid */
+static void dc_gconfig_weight(struct ast_config * cfg, const char * cat, const char * name, int * weight)
+{
+	const char * stmp;
+	int tmp;
+
+	stmp = ast_variable_retrieve (cfg, cat, name);
+	if(stmp)
+	{
+		errno = 0;
+		tmp = (int) strtol (stmp, (char**) NULL, 10);
+		if ((tmp == 0 && errno == EINVAL) || tmp < 0)
+			ast_log (LOG_NOTICE, "Error parsing '%s' in general section, using default value %d\n", name, *weight);
+		else
+			*weight = tmp;
+	}
+}
+
+#/* read integer option of general section in range min..max, keep default if absent or invalid */
+static void dc_gconfig_int(struct ast_config * cfg, const char * cat, const char * name, int min, int max, int * value)
+{
+	const char * stmp;
+	char * end;
+	long tmp;
+
+	stmp = ast_variable_retrieve (cfg, cat, name);
+	if(stmp)
+	{
+		errno = 0;
+		tmp = strtol (stmp, &end, 10);
+		if (errno || end == stmp || *end || tmp < min || tmp > max)
+			ast_log (LOG_NOTICE, "Invalid value '%s' of '%s' in general section, must be from %d to %d, using default value %d\n", stmp, name, min, max, *value);
+		else
+			*value = (int) tmp;
 	}
 }
 
@@ -243,6 +377,13 @@ EXPORT_DEF void dc_gconfig_fill(struct ast_config * cfg, const char * cat, struc
 	/* set default values */
 	memcpy(&config->jbconf, &jbconf_default, sizeof(config->jbconf));
 	config->discovery_interval = DEFAULT_DISCOVERY_INT;
+	config->weight_rssi = DEFAULT_WEIGHT_RSSI;
+	config->weight_asr = DEFAULT_WEIGHT_ASR;
+	config->weight_queue = DEFAULT_WEIGHT_QUEUE;
+	config->weight_budget = DEFAULT_WEIGHT_BUDGET;
+	config->smsspool[0] = 0;
+	config->smsspoolretries = DEFAULT_SMSSPOOLRETRIES;
+	config->ussdcache = DEFAULT_USSDCACHE;
 
 	stmp = ast_variable_retrieve (cfg, cat, "interval");
 	if(stmp)
@@ -255,6 +396,16 @@ EXPORT_DEF void dc_gconfig_fill(struct ast_config * cfg, const char * cat, struc
 			config->discovery_interval = tmp;
 	}
 
+	dc_gconfig_weight(cfg, cat, "weightrssi", &config->weight_rssi);
+	dc_gconfig_weight(cfg, cat, "weightasr", &config->weight_asr);
+	dc_gconfig_weight(cfg, cat, "weightqueue", &config->weight_queue);
+	dc_gconfig_weight(cfg, cat, "weightbudget", &config->weight_budget);
+
+	stmp = ast_variable_retrieve (cfg, cat, "smsspool");
+	if(stmp)
+		ast_copy_string (config->smsspool, stmp, sizeof (config->smsspool));
+	dc_gconfig_int(cfg, cat, "smsspoolretries", 1, 1000, &config->smsspoolretries);
+	dc_gconfig_int(cfg, cat, "ussdcache", 0, 86400, &config->ussdcache);
 
 	for (v = ast_variable_browse (cfg, cat); v; v = v->next)
 		/* handle jb conf */
@@ -42,6 +42,12 @@ typedef enum {
 	DC_DTMF_SETTING_RELAX,
 } dc_dtmf_setting_t;
 
+typedef enum {
+	DC_DISPATCH_LOCAL = 0,
+	DC_DISPATCH_MESSAGE,
+	DC_DISPATCH_MANAGER,
+} dc_dispatch_t;
+
 /*
  Config API
  Operations
@@ -76,6 +82,8 @@ typedef struct dc_sconfig
 	unsigned int		resetdongle:1;			/*! 1 */
 	unsigned int		disablesms:1;			/*! 0 */
 	unsigned int		smsaspdu:1;			/*! 0 */
+	unsigned int		smsdirect:1;			/*!< route incoming SMS as +CMT instead of SIM storage, PDU mode only 0 */
+	unsigned int		smsref16:1;			/*!< 16 bit reference of concatenated SMS instead of 8 bit 0 */
 	dev_state_t		initstate;			/*! DEV_STATE_STARTED */
 //	unsigned int		disable:1;			/*! 0 */
 
@@ -90,6 +98,20 @@ typedef struct dc_sconfig
 
 	int			mindtmfinterval;		/*!< minimal DTMF interval beetween ends in ms, applied only on same digit */
 #define DEFAULT_MINDTMFINTERVAL	200
+
+	char			audiotap[DEVPATHLEN];		/*!< unix socket path for copy of call audio, empty for disable */
+
+	unsigned int		vad:1;				/*!< skip processing of silent frames readed from device 0 */
+	unsigned int		cng:1;				/*!< on silence send one CNG frame to asterisk instead of voice frames 0 */
+	int			vadthreshold;			/*!< VAD speech threshold, mean absolute sample value */
+#define DEFAULT_VADTHRESHOLD	200
+
+	int			vadhangover;			/*!< VAD frames of 20 ms for keep speech state after level drop */
+#define DEFAULT_VADHANGOVER	15
+
+	int			minutebudget;			/*!< outgoing call minutes for w<group> selection, 0 unlimited */
+	int			smsrate;			/*!< SMS per minute sent from spool, 0 unlimited */
+	dc_dispatch_t		dispatch;			/*!< local/message/manager delivery of received SMS and USSD, default DC_DISPATCH_LOCAL */
 } dc_sconfig_t;
 
 /* Global settings */
@@ -98,6 +120,21 @@ typedef struct dc_gconfig
 	struct ast_jb_conf	jbconf;				/*!< jitter buffer settings, disabled by default */
 	int			discovery_interval;		/*!< The device discovery interval */
 #define DEFAULT_DISCOVERY_INT	60
+
+	int			weight_rssi;			/*!< weight of signal level in w<group> device score */
+	int			weight_asr;			/*!< weight of answer seizure ratio of outgoing calls */
+	int			weight_queue;			/*!< weight of AT command queue depth, less is better */
+	int			weight_budget;			/*!< weight of remaining part of minutebudget */
+#define DEFAULT_WEIGHT_RSSI	1
+#define DEFAULT_WEIGHT_ASR	2
+#define DEFAULT_WEIGHT_QUEUE	1
+#define DEFAULT_WEIGHT_BUDGET	1
+
+	char			smsspool[DEVPATHLEN];		/*!< journal of outgoing SMS spool, empty for send directly */
+	int			smsspoolretries;		/*!< attempts of send SMS from spool before drop */
+#define DEFAULT_SMSSPOOLRETRIES	3
+	int			ussdcache;			/*!< seconds of USSD answers in cache, 0 disabled */
+#define DEFAULT_USSDCACHE	0
 } dc_gconfig_t;
 
 /* Local required (unique) settings */
@@ -122,6 +159,8 @@ typedef struct pvt_config
 
 EXPORT_DECL int dc_dtmf_str2setting(const char * str);
 EXPORT_DECL const char * dc_dtmf_setting2str(dc_dtmf_setting_t dtmf);
+EXPORT_DECL int dc_dispatch_str2setting(const char * str);
+EXPORT_DECL const char * dc_dispatch_setting2str(dc_dispatch_t dispatch);
 EXPORT_DECL void dc_sconfig_fill_defaults(struct dc_sconfig * config);
 EXPORT_DECL void dc_sconfig_fill(struct ast_config * cfg, const char * cat, struct dc_sconfig * config);
 EXPORT_DECL void dc_gconfig_fill(struct ast_config * cfg, const char * cat, struct dc_gconfig * config);
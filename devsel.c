@@ -0,0 +1,430 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>			/* calloc() realloc() free() */
+#include <string.h>			/* memset() strcmp() strncmp() */
+
+#include "devsel.h"
+
+/* use libc allocator, index also linked to test programs without asterisk */
+
+#define DEVSEL_MIN_BUCKETS	64
+
+#/* FNV-1a */
+static unsigned devsel_hash(const char * value)
+{
+	unsigned hash = 2166136261u;
+
+	for(; *value; ++value)
+	{
+		hash ^= (unsigned char)*value;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+#/* */
+static void devsel_hash_link(struct devsel * ds, int slot, devsel_hash_t hash)
+{
+	const char * value = DEVSEL_KEY(ds, slot, hash);
+	unsigned bucket;
+
+	DEVSEL_NEXT(ds, slot, hash) = -1;
+	if(value[0])
+	{
+		bucket = devsel_hash(value) & (ds->nbuckets - 1);
+		DEVSEL_NEXT(ds, slot, hash) = ds->buckets[hash][bucket];
+		ds->buckets[hash][bucket] = slot;
+	}
+}
+
+#/* */
+static void devsel_hash_unlink(struct devsel * ds, int slot, devsel_hash_t hash)
+{
+	const char * value = DEVSEL_KEY(ds, slot, hash);
+	int * link;
+
+	if(value[0])
+	{
+		for(link = &ds->buckets[hash][devsel_hash(value) & (ds->nbuckets - 1)]; *link >= 0; link = &DEVSEL_NEXT(ds, *link, hash))
+		{
+			if(*link == slot)
+			{
+				*link = DEVSEL_NEXT(ds, slot, hash);
+				break;
+			}
+		}
+	}
+}
+
+#/* resize hash tables, return 0 on success */
+static int devsel_rehash(struct devsel * ds, unsigned nbuckets)
+{
+	int * buckets[DEVSEL_HASH_NUMBER];
+	unsigned hash;
+	unsigned i;
+	int slot;
+
+	for(hash = 0; hash < DEVSEL_HASH_NUMBER; ++hash)
+	{
+		buckets[hash] = malloc(nbuckets * sizeof(int));
+		if(!buckets[hash])
+		{
+			while(hash--)
+				free(buckets[hash]);
+			return -1;
+		}
+		for(i = 0; i < nbuckets; ++i)
+			buckets[hash][i] = -1;
+	}
+
+	for(hash = 0; hash < DEVSEL_HASH_NUMBER; ++hash)
+	{
+		free(ds->buckets[hash]);
+		ds->buckets[hash] = buckets[hash];
+	}
+	ds->nbuckets = nbuckets;
+
+	for(slot = 0; slot < (int)(ds->nchunks * DEVSEL_CHUNK_SLOTS); ++slot)
+	{
+		if(DEVSEL_OWNER(ds, slot))
+		{
+			for(hash = 0; hash < DEVSEL_HASH_NUMBER; ++hash)
+				devsel_hash_link(ds, slot, hash);
+		}
+	}
+	return 0;
+}
+
+#/* find key by group or provider name if provider not NULL, allocate if not found and create */
+static struct devsel_key * devsel_key_get(struct devsel_key ** keys, int group, const char * provider, int create)
+{
+	struct devsel_key * free_key = NULL;
+	struct devsel_key * key;
+
+	for(key = *keys; key; key = key->next)
+	{
+		if(key->members_count == 0)
+		{
+			if(!free_key)
+				free_key = key;
+		}
+		else if(provider ? strcmp(key->provider, provider) == 0 : key->group == group)
+			return key;
+	}
+
+	if(!create)
+		return NULL;
+
+	if(free_key)
+	{
+		key = free_key;
+		memset(key->members, 0, key->words * sizeof(*key->members));
+	}
+	else
+	{
+		key = calloc(1, sizeof(*key));
+		if(!key)
+			return NULL;
+		key->next = *keys;
+		*keys = key;
+	}
+
+	key->group = group;
+	key->provider[0] = 0;
+	if(provider)
+		strncpy(key->provider, provider, sizeof(key->provider) - 1);
+	key->last_used = -1;
+	return key;
+}
+
+#/* return 0 on success */
+static int devsel_key_join(struct devsel_key * key, int slot)
+{
+	unsigned words = slot / DEVSEL_WORD_BITS + 1;
+	devsel_word_t * members;
+
+	if(!key)
+		return -1;
+
+	if(words > key->words)
+	{
+		members = realloc(key->members, words * sizeof(*members));
+		if(!members)
+			return -1;
+		memset(members + key->words, 0, (words - key->words) * sizeof(*members));
+		key->members = members;
+		key->words = words;
+	}
+
+	key->members[slot / DEVSEL_WORD_BITS] |= (devsel_word_t)1 << (slot % DEVSEL_WORD_BITS);
+	key->members_count++;
+	return 0;
+}
+
+#/* */
+static void devsel_key_leave(struct devsel_key * key, int slot)
+{
+	key->members[slot / DEVSEL_WORD_BITS] &= ~((devsel_word_t)1 << (slot % DEVSEL_WORD_BITS));
+	key->members_count--;
+}
+
+#/* */
+static void devsel_keys_free(struct devsel_key * key)
+{
+	struct devsel_key * next;
+
+	for(; key; key = next)
+	{
+		next = key->next;
+		free(key->members);
+		free(key);
+	}
+}
+
+#/* */
+EXPORT_DEF void devsel_init(struct devsel * ds)
+{
+	memset(ds, 0, sizeof(*ds));
+	ds->imsi_last_used = -1;
+}
+
+#/* */
+EXPORT_DEF void devsel_destroy(struct devsel * ds)
+{
+	unsigned i;
+
+	for(i = 0; i < ds->nchunks; ++i)
+		free(ds->chunks[i]);
+	for(i = 0; i < DEVSEL_HASH_NUMBER; ++i)
+		free(ds->buckets[i]);
+	devsel_keys_free(ds->groups);
+	devsel_keys_free(ds->providers);
+	devsel_init(ds);
+}
+
+#/* */
+EXPORT_DEF int devsel_add(struct devsel * ds, void * owner, const char * id, int group)
+{
+	int slot;
+	unsigned hash;
+	unsigned kind;
+
+	if(ds->used == ds->nchunks * DEVSEL_CHUNK_SLOTS)
+	{
+		if(ds->nchunks == DEVSEL_MAX_CHUNKS)
+			return -1;
+		ds->chunks[ds->nchunks] = calloc(1, sizeof(struct devsel_chunk));
+		if(!ds->chunks[ds->nchunks])
+			return -1;
+		ds->nchunks++;
+	}
+
+	/* keep load factor of hash tables under 1 */
+	if(ds->used >= ds->nbuckets && devsel_rehash(ds, ds->nbuckets ? ds->nbuckets * 2 : DEVSEL_MIN_BUCKETS))
+		return -1;
+
+	for(slot = 0; DEVSEL_OWNER(ds, slot); ++slot)
+		;
+
+	if(devsel_key_join(devsel_key_get(&ds->groups, group, NULL, 1), slot))
+		return -1;
+
+	DEVSEL_OWNER(ds, slot) = owner;
+	DEVSEL_FIELD(ds, slot, group) = group;
+	DEVSEL_FIELD(ds, slot, provider)[0] = 0;
+	DEVSEL_FIELD(ds, slot, score) = 0;
+	for(kind = 0; kind < DEVSEL_READY_NUMBER; ++kind)
+		devsel_set_ready(ds, slot, kind, 0);
+
+	for(hash = 0; hash < DEVSEL_HASH_NUMBER; ++hash)
+		DEVSEL_KEY(ds, slot, hash)[0] = 0;
+	strncpy(DEVSEL_KEY(ds, slot, DEVSEL_HASH_ID), id, DEVSEL_ID_SIZE - 1);
+	for(hash = 0; hash < DEVSEL_HASH_NUMBER; ++hash)
+		devsel_hash_link(ds, slot, hash);
+
+	ds->used++;
+	return slot;
+}
+
+#/* */
+EXPORT_DEF void devsel_remove(struct devsel * ds, int slot)
+{
+	unsigned hash;
+	unsigned kind;
+
+	for(kind = 0; kind < DEVSEL_READY_NUMBER; ++kind)
+		devsel_set_ready(ds, slot, kind, 0);
+
+	devsel_key_leave(devsel_key_get(&ds->groups, DEVSEL_FIELD(ds, slot, group), NULL, 0), slot);
+	devsel_set_provider(ds, slot, "");
+
+	for(hash = 0; hash < DEVSEL_HASH_NUMBER; ++hash)
+	{
+		devsel_hash_unlink(ds, slot, hash);
+		DEVSEL_KEY(ds, slot, hash)[0] = 0;
+	}
+
+	DEVSEL_OWNER(ds, slot) = NULL;
+	ds->used--;
+}
+
+#/* */
+EXPORT_DEF int devsel_set_group(struct devsel * ds, int slot, int group)
+{
+	int old = DEVSEL_FIELD(ds, slot, group);
+
+	if(old != group)
+	{
+		if(devsel_key_join(devsel_key_get(&ds->groups, group, NULL, 1), slot))
+			return -1;
+		devsel_key_leave(devsel_key_get(&ds->groups, old, NULL, 0), slot);
+		DEVSEL_FIELD(ds, slot, group) = group;
+	}
+	return 0;
+}
+
+#/* empty provider name mean not member of any provider key */
+EXPORT_DEF int devsel_set_provider(struct devsel * ds, int slot, const char * provider)
+{
+	char * current = DEVSEL_FIELD(ds, slot, provider);
+
+	if(devsel_provider_changed(ds, slot, provider))
+	{
+		if(provider[0] && devsel_key_join(devsel_key_get(&ds->providers, 0, provider, 1), slot))
+			return -1;
+
+		if(current[0])
+			devsel_key_leave(devsel_key_get(&ds->providers, 0, current, 0), slot);
+
+		strncpy(current, provider, DEVSEL_PROVIDER_SIZE - 1);
+		current[DEVSEL_PROVIDER_SIZE - 1] = 0;
+	}
+	return 0;
+}
+
+#/* */
+EXPORT_DEF void devsel_set_key(struct devsel * ds, int slot, devsel_hash_t hash, const char * value)
+{
+	char * current = DEVSEL_KEY(ds, slot, hash);
+
+	if(devsel_key_changed(ds, slot, hash, value))
+	{
+		devsel_hash_unlink(ds, slot, hash);
+		strncpy(current, value, DEVSEL_ID_SIZE - 1);
+		current[DEVSEL_ID_SIZE - 1] = 0;
+		devsel_hash_link(ds, slot, hash);
+	}
+}
+
+#/* */
+EXPORT_DEF int devsel_lookup(const struct devsel * ds, devsel_hash_t hash, const char * value)
+{
+	int slot;
+
+	if(ds->nbuckets == 0 || value[0] == 0)
+		return -1;
+
+	for(slot = ds->buckets[hash][devsel_hash(value) & (ds->nbuckets - 1)]; slot >= 0; slot = DEVSEL_NEXT(ds, slot, hash))
+	{
+		if(strcmp(DEVSEL_KEY(ds, slot, hash), value) == 0)
+			break;
+	}
+	return slot;
+}
+
+#/* */
+EXPORT_DEF struct devsel_key * devsel_find_group(struct devsel * ds, int group)
+{
+	return devsel_key_get(&ds->groups, group, NULL, 0);
+}
+
+#/* */
+EXPORT_DEF struct devsel_key * devsel_find_provider(struct devsel * ds, const char * provider)
+{
+	return devsel_key_get(&ds->providers, 0, provider, 0);
+}
+
+#/* */
+EXPORT_DEF unsigned devsel_match_imsi(const struct devsel * ds, const char * prefix, devsel_word_t * members)
+{
+	size_t len = strlen(prefix);
+	unsigned count = 0;
+	int slot;
+
+	memset(members, 0, ds->nchunks * sizeof(*members));
+	for(slot = 0; slot < (int)(ds->nchunks * DEVSEL_CHUNK_SLOTS); ++slot)
+	{
+		if(DEVSEL_OWNER(ds, slot) && strncmp(DEVSEL_KEY(ds, slot, DEVSEL_HASH_IMSI), prefix, len) == 0)
+		{
+			members[slot / DEVSEL_WORD_BITS] |= (devsel_word_t)1 << (slot % DEVSEL_WORD_BITS);
+			count++;
+		}
+	}
+	return count;
+}
+
+#/* */
+EXPORT_DEF int devsel_candidates(const struct devsel * ds, const devsel_word_t * members, unsigned members_words, devsel_ready_t kind, devsel_word_t * candidates)
+{
+	devsel_word_t any = 0;
+	unsigned i;
+
+	for(i = 0; i < ds->nchunks; ++i)
+	{
+		candidates[i] = i < members_words ? members[i] & ds->chunks[i]->ready[kind] : 0;
+		any |= candidates[i];
+	}
+	return any != 0;
+}
+
+#/* */
+EXPORT_DEF int devsel_next(const devsel_word_t * set, unsigned words, int after)
+{
+	unsigned start = (after < 0 || (unsigned)after + 1 >= words * DEVSEL_WORD_BITS) ? 0 : (unsigned)after + 1;
+	unsigned word = start / DEVSEL_WORD_BITS;
+	devsel_word_t bits;
+	unsigned i;
+
+	if(words == 0)
+		return -1;
+
+	/* last iteration revisit first word completely for wrap around */
+	bits = set[word] & (~(devsel_word_t)0 << (start % DEVSEL_WORD_BITS));
+	for(i = 0; i <= words; ++i)
+	{
+		if(bits)
+			return word * DEVSEL_WORD_BITS + __builtin_ctzl(bits);
+		word = (word + 1) % words;
+		bits = set[word];
+	}
+	return -1;
+}
+
+#/* */
+EXPORT_DEF int devsel_best(const struct devsel * ds, const devsel_word_t * set, unsigned words, int after)
+{
+	int best = -1;
+	int best_score = 0;
+	int first = -1;
+	int slot = after;
+	int score;
+
+	while((slot = devsel_next(set, words, slot)) >= 0 && slot != first)
+	{
+		if(first < 0)
+			first = slot;
+
+		score = DEVSEL_FIELD(ds, slot, score);
+		if(score != DEVSEL_SCORE_EXCLUDED && (best < 0 || score > best_score))
+		{
+			best = slot;
+			best_score = score;
+		}
+	}
+	return best;
+}
@@ -0,0 +1,178 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifndef CHAN_DONGLE_DEVSEL_H_INCLUDED
+#define CHAN_DONGLE_DEVSEL_H_INCLUDED
+
+#include <sys/types.h>			/* size_t */
+#include <string.h>			/* strncmp() */
+
+#include "export.h"			/* EXPORT_DECL EXPORT_DEF */
+
+/*
+   Device index for lookup by id, IMEI, IMSI and for Dial(Dongle/g1/...) r<N> w<N> p:<provider> s:<imsi prefix>
+   Each device own one slot, slots allocated by chunks what never moved until destroy.
+   Exact keys hashed, group and provider keys hold bitmap of member slots,
+   ready bitmaps maintained atomically by device owner so selection is bitmap scan
+   without locking of each device, only found candidate must be locked and rechecked.
+   Device owner also publish score of device for weighted w<N> selection.
+   All functions except devsel_set_ready() and devsel_set_score() must be called with lock of index owner hold.
+*/
+
+#define DEVSEL_ID_SIZE		32
+#define DEVSEL_PROVIDER_SIZE	32
+#define DEVSEL_SCORE_EXCLUDED	(-2147483647 - 1)
+
+typedef unsigned long devsel_word_t;
+
+#define DEVSEL_WORD_BITS	(sizeof(devsel_word_t) * 8)
+#define DEVSEL_CHUNK_SLOTS	DEVSEL_WORD_BITS	/* one ready word per chunk */
+#define DEVSEL_MAX_CHUNKS	1024
+
+typedef enum {
+	DEVSEL_READY_VOICE	= 0,			/* ready for call without hold other */
+	DEVSEL_READY_HOLD,				/* ready for call with hold other calls */
+	DEVSEL_READY_NUMBER
+} devsel_ready_t;
+
+typedef enum {
+	DEVSEL_HASH_ID		= 0,
+	DEVSEL_HASH_IMEI,
+	DEVSEL_HASH_IMSI,
+	DEVSEL_HASH_NUMBER
+} devsel_hash_t;
+
+typedef struct devsel_key {
+	struct devsel_key	* next;					/*!< next key of same kind, keys freed only by devsel_destroy() */
+	int			group;					/*!< group number for group key */
+	char			provider[DEVSEL_PROVIDER_SIZE];		/*!< provider name for provider key */
+	unsigned		members_count;				/*!< number of slots in members, 0 for free key */
+	unsigned		words;					/*!< size of members, missing words are empty */
+	devsel_word_t		* members;				/*!< bitmap of member slots */
+	int			last_used;				/*!< last selected slot for round robin */
+} devsel_key_t;
+
+typedef struct devsel_chunk {
+	void			* owners[DEVSEL_CHUNK_SLOTS];		/*!< device of slot, NULL for free slot */
+	int			group[DEVSEL_CHUNK_SLOTS];		/*!< group of device in slot */
+	char			provider[DEVSEL_CHUNK_SLOTS][DEVSEL_PROVIDER_SIZE];		/*!< provider name of device in slot */
+	char			keys[DEVSEL_HASH_NUMBER][DEVSEL_CHUNK_SLOTS][DEVSEL_ID_SIZE];	/*!< id IMEI IMSI of device in slot */
+	int			hash_next[DEVSEL_HASH_NUMBER][DEVSEL_CHUNK_SLOTS];		/*!< next slot in hash bucket, -1 for last */
+	volatile int		score[DEVSEL_CHUNK_SLOTS];		/*!< weighted score for w<group> selection */
+	volatile devsel_word_t	ready[DEVSEL_READY_NUMBER];		/*!< bitmaps of devices ready for call */
+} devsel_chunk_t;
+
+typedef struct devsel {
+	struct devsel_chunk	* chunks[DEVSEL_MAX_CHUNKS];		/*!< slot storage, allocated on demand */
+	unsigned		nchunks;				/*!< number of allocated chunks, also size of bitmaps */
+	unsigned		used;					/*!< number of used slots */
+	int			* buckets[DEVSEL_HASH_NUMBER];		/*!< hash bucket heads, -1 for empty */
+	unsigned		nbuckets;				/*!< number of buckets, power of 2 */
+	struct devsel_key	* groups;				/*!< group keys */
+	struct devsel_key	* providers;				/*!< provider keys */
+	int			imsi_last_used;				/*!< last selected slot by IMSI prefix */
+} devsel_t;
+
+#define DEVSEL_CHUNK(ds, slot)		((ds)->chunks[(unsigned)(slot) / DEVSEL_CHUNK_SLOTS])
+#define DEVSEL_FIELD(ds, slot, name)	(DEVSEL_CHUNK(ds, slot)->name[(unsigned)(slot) % DEVSEL_CHUNK_SLOTS])
+#define DEVSEL_KEY(ds, slot, hash)	(DEVSEL_CHUNK(ds, slot)->keys[hash][(unsigned)(slot) % DEVSEL_CHUNK_SLOTS])
+#define DEVSEL_NEXT(ds, slot, hash)	(DEVSEL_CHUNK(ds, slot)->hash_next[hash][(unsigned)(slot) % DEVSEL_CHUNK_SLOTS])
+#define DEVSEL_OWNER(ds, slot)		DEVSEL_FIELD(ds, slot, owners)
+
+/* initialize empty index */
+EXPORT_DECL void devsel_init(struct devsel * ds);
+
+/* free all memory of index */
+EXPORT_DECL void devsel_destroy(struct devsel * ds);
+
+/* allocate slot for device, return slot number or -1 on memory allocation error */
+EXPORT_DECL int devsel_add(struct devsel * ds, void * owner, const char * id, int group);
+
+/* release slot */
+EXPORT_DECL void devsel_remove(struct devsel * ds, int slot);
+
+/* move slot to other group or provider key, return 0 on success or -1 on memory allocation error */
+EXPORT_DECL int devsel_set_group(struct devsel * ds, int slot, int group);
+EXPORT_DECL int devsel_set_provider(struct devsel * ds, int slot, const char * provider);
+
+/* update hashed id IMEI or IMSI of slot */
+EXPORT_DECL void devsel_set_key(struct devsel * ds, int slot, devsel_hash_t hash, const char * value);
+
+/* return slot of device with exactly matched id IMEI or IMSI or -1 */
+EXPORT_DECL int devsel_lookup(const struct devsel * ds, devsel_hash_t hash, const char * value);
+
+/* find key, return NULL if no devices in group or with provider name */
+EXPORT_DECL struct devsel_key * devsel_find_group(struct devsel * ds, int group);
+EXPORT_DECL struct devsel_key * devsel_find_provider(struct devsel * ds, const char * provider);
+
+/* fill bitmap of devsel_words() size with slots of IMSI started by prefix, return number of matched slots */
+EXPORT_DECL unsigned devsel_match_imsi(const struct devsel * ds, const char * prefix, devsel_word_t * members);
+
+/* intersect members with ready bitmap to candidates of devsel_words() size, return non-zero if any candidate */
+EXPORT_DECL int devsel_candidates(const struct devsel * ds, const devsel_word_t * members, unsigned members_words, devsel_ready_t kind, devsel_word_t * candidates);
+
+/* return next set slot after slot 'after' with wrap around, -1 for start from begin; -1 if set is empty */
+EXPORT_DECL int devsel_next(const devsel_word_t * set, unsigned words, int after);
+
+/* return slot with highest score, equal scores selected round robin after slot 'after'; -1 if none or all excluded */
+EXPORT_DECL int devsel_best(const struct devsel * ds, const devsel_word_t * set, unsigned words, int after);
+
+/* return non-zero if provider differ from stored and possible truncated provider of slot */
+INLINE_DECL int devsel_provider_changed(const struct devsel * ds, int slot, const char * provider)
+{
+	return strncmp(DEVSEL_FIELD(ds, slot, provider), provider, DEVSEL_PROVIDER_SIZE - 1) != 0;
+}
+
+/* return non-zero if value differ from stored and possible truncated id IMEI or IMSI of slot */
+INLINE_DECL int devsel_key_changed(const struct devsel * ds, int slot, devsel_hash_t hash, const char * value)
+{
+	return strncmp(DEVSEL_KEY(ds, slot, hash), value, DEVSEL_ID_SIZE - 1) != 0;
+}
+
+/* number of words in bitmaps for all slots */
+INLINE_DECL unsigned devsel_words(const struct devsel * ds)
+{
+	return ds->nchunks;
+}
+
+/* remove slot from set */
+INLINE_DECL void devsel_clear(devsel_word_t * set, int slot)
+{
+	set[slot / DEVSEL_WORD_BITS] &= ~((devsel_word_t)1 << (slot % DEVSEL_WORD_BITS));
+}
+
+/* return non-zero if slot in set */
+INLINE_DECL int devsel_test(const devsel_word_t * set, int slot)
+{
+	return (set[slot / DEVSEL_WORD_BITS] >> (slot % DEVSEL_WORD_BITS)) & 1;
+}
+
+/* return non-zero if slot ready */
+INLINE_DECL int devsel_ready(const struct devsel * ds, int slot, devsel_ready_t kind)
+{
+	return (DEVSEL_CHUNK(ds, slot)->ready[kind] >> (slot % DEVSEL_WORD_BITS)) & 1;
+}
+
+/* update score of slot without lock, called by device owner */
+INLINE_DECL void devsel_set_score(struct devsel * ds, int slot, int score)
+{
+	DEVSEL_FIELD(ds, slot, score) = score;
+}
+
+/* set or clear ready bit of slot without lock, called by device owner on state changes */
+INLINE_DECL void devsel_set_ready(struct devsel * ds, int slot, devsel_ready_t kind, int ready)
+{
+	volatile devsel_word_t * word = &DEVSEL_CHUNK(ds, slot)->ready[kind];
+	devsel_word_t mask = (devsel_word_t)1 << (slot % DEVSEL_WORD_BITS);
+
+	/* avoid locked bus operation if nothing changed */
+	if(!(*word & mask) == !ready)
+		return;
+
+	if(ready)
+		__sync_fetch_and_or(word, mask);
+	else
+		__sync_fetch_and_and(word, ~mask);
+}
+
+#endif /* CHAN_DONGLE_DEVSEL_H_INCLUDED */
@@ -0,0 +1,173 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <pthread.h>			/* pthread_create() pthread_join() pthread_mutex_t pthread_cond_t */
+#include <stdlib.h>			/* calloc() free() */
+#include <string.h>			/* memcpy() memset() */
+
+#include "dispatch.h"
+
+static struct
+{
+	pthread_mutex_t		lock;
+	pthread_cond_t		cond;				/*!< wakeup of workers */
+	struct dispatch_job	* head;
+	struct dispatch_job	** tail;
+	unsigned		limit;
+	int			running;
+	pthread_t		* threads;
+	struct dispatch_stat	stat;
+} dispatch = {
+	.lock	= PTHREAD_MUTEX_INITIALIZER,
+	.cond	= PTHREAD_COND_INITIALIZER,
+	.tail	= &dispatch.head,
+};
+
+#/* run jobs by batches until stopped and queue empty */
+static void * dispatch_worker(void * arg)
+{
+	unsigned batch_size = *(const unsigned *)arg;
+	struct dispatch_job * batch;
+	struct dispatch_job * job;
+	unsigned count;
+
+	pthread_mutex_lock(&dispatch.lock);
+	for(;;)
+	{
+		while(!dispatch.head && dispatch.running)
+			pthread_cond_wait(&dispatch.cond, &dispatch.lock);
+		if(!dispatch.head)
+			break;
+
+		/* unlink up to DISPATCH_BATCH jobs from head */
+		batch = job = dispatch.head;
+		for(count = 1; count < batch_size && job->next; ++count)
+			job = job->next;
+		dispatch.head = job->next;
+		job->next = NULL;
+		if(!dispatch.head)
+			dispatch.tail = &dispatch.head;
+		dispatch.stat.depth -= count;
+		dispatch.stat.done += count;
+		pthread_mutex_unlock(&dispatch.lock);
+
+		while(batch)
+		{
+			job = batch;
+			batch = batch->next;
+			job->run(job);
+		}
+
+		pthread_mutex_lock(&dispatch.lock);
+	}
+	pthread_mutex_unlock(&dispatch.lock);
+
+	return NULL;
+}
+
+#/* */
+EXPORT_DEF int dispatch_init(unsigned workers, unsigned limit)
+{
+	static const unsigned batch_size = DISPATCH_BATCH;
+	pthread_t * threads;
+	unsigned idx;
+
+	threads = calloc(workers, sizeof(threads[0]));
+	if(!threads)
+		return -1;
+
+	pthread_mutex_lock(&dispatch.lock);
+	memset(&dispatch.stat, 0, sizeof(dispatch.stat));
+	dispatch.threads = threads;
+	dispatch.limit = limit;
+	dispatch.running = 1;
+	pthread_mutex_unlock(&dispatch.lock);
+
+	for(idx = 0; idx < workers; ++idx)
+	{
+		if(pthread_create(&threads[idx], NULL, dispatch_worker, (void *)&batch_size))
+			break;
+	}
+
+	pthread_mutex_lock(&dispatch.lock);
+	dispatch.stat.workers = idx;
+	pthread_mutex_unlock(&dispatch.lock);
+
+	if(idx == 0)
+	{
+		dispatch_fini();
+		return -1;
+	}
+	return 0;
+}
+
+#/* */
+EXPORT_DEF void dispatch_fini()
+{
+	unsigned idx;
+	unsigned workers;
+
+	pthread_mutex_lock(&dispatch.lock);
+	dispatch.running = 0;
+	workers = dispatch.stat.workers;
+	pthread_cond_broadcast(&dispatch.cond);
+	pthread_mutex_unlock(&dispatch.lock);
+
+	for(idx = 0; idx < workers; ++idx)
+		pthread_join(dispatch.threads[idx], NULL);
+
+	pthread_mutex_lock(&dispatch.lock);
+	free(dispatch.threads);
+	dispatch.threads = NULL;
+	dispatch.stat.workers = 0;
+	pthread_mutex_unlock(&dispatch.lock);
+}
+
+#/* */
+EXPORT_DEF int dispatch_push(struct dispatch_job * job)
+{
+	int rv = -1;
+
+	job->next = NULL;
+
+	pthread_mutex_lock(&dispatch.lock);
+	if(dispatch.running && dispatch.stat.workers)
+	{
+		if(dispatch.stat.depth < dispatch.limit)
+		{
+			*dispatch.tail = job;
+			dispatch.tail = &job->next;
+			dispatch.stat.pushed++;
+			if(++dispatch.stat.depth > dispatch.stat.high_water)
+				dispatch.stat.high_water = dispatch.stat.depth;
+			pthread_cond_signal(&dispatch.cond);
+			rv = 0;
+		}
+		else
+		{
+			dispatch.stat.overflows++;
+		}
+	}
+	pthread_mutex_unlock(&dispatch.lock);
+
+	return rv;
+}
+
+#/* */
+EXPORT_DEF void dispatch_run(struct dispatch_job * job)
+{
+	if(dispatch_push(job))
+		job->run(job);
+}
+
+#/* */
+EXPORT_DEF void dispatch_stat_read(struct dispatch_stat * stat)
+{
+	pthread_mutex_lock(&dispatch.lock);
+	memcpy(stat, &dispatch.stat, sizeof(*stat));
+	pthread_mutex_unlock(&dispatch.lock);
+}
@@ -0,0 +1,59 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifndef CHAN_DONGLE_DISPATCH_H_INCLUDED
+#define CHAN_DONGLE_DISPATCH_H_INCLUDED
+
+#include "export.h"			/* EXPORT_DECL EXPORT_DEF */
+
+/*
+   Bounded pool of worker threads for delivery of received SMS and USSD
+   without Local channel (dispatch=manager).
+   Device thread only link job into queue and signal, workers take up to
+   DISPATCH_BATCH jobs under one lock and run them without lock.
+   Queue limited by DISPATCH_LIMIT jobs, push to full or stopped pool fail
+   and caller run job itself, so job never lost and memory bounded.
+   Jobs of one device may run by different workers, order not guaranteed.
+   Pool is not depend on asterisk and may be used by tests and benchmarks.
+*/
+
+#define DISPATCH_WORKERS	2			/* threads of pool */
+#define DISPATCH_LIMIT		1024			/* jobs in queue */
+#define DISPATCH_BATCH		16			/* jobs taken by worker at once */
+
+struct dispatch_job;
+
+/* do the work and free job */
+typedef void (*dispatch_run_t)(struct dispatch_job * job);
+
+typedef struct dispatch_job
+{
+	struct dispatch_job	* next;
+	dispatch_run_t		run;
+} dispatch_job_t;
+
+struct dispatch_stat
+{
+	unsigned long		pushed;				/*!< jobs queued */
+	unsigned long		done;				/*!< jobs run by workers */
+	unsigned long		overflows;			/*!< jobs not queued because queue full */
+	unsigned		depth;				/*!< jobs in queue now */
+	unsigned		high_water;			/*!< maximum of depth */
+	unsigned		workers;			/*!< running threads */
+};
+
+/* start workers threads, return 0 on success */
+EXPORT_DECL int dispatch_init(unsigned workers, unsigned limit);
+
+/* run queued jobs and stop workers */
+EXPORT_DECL void dispatch_fini();
+
+/* queue job, return 0 on success, -1 if queue full or pool not running */
+EXPORT_DECL int dispatch_push(struct dispatch_job * job);
+
+/* queue job or run it in caller thread if not queued */
+EXPORT_DECL void dispatch_run(struct dispatch_job * job);
+
+EXPORT_DECL void dispatch_stat_read(struct dispatch_stat * stat);
+
+#endif /* CHAN_DONGLE_DISPATCH_H_INCLUDED */
@@ -12,6 +12,9 @@
 #include <config.h>
 #endif /* HAVE_CONFIG_H */
 
+#include <stdio.h>				/* sscanf() snprintf() */
+#include <stdlib.h>				/* strtoul() strtoull() */
+#include <errno.h>				/* EBUSY ENODEV ENOENT */
 #include <signal.h>				/* SIGURG */
 
 #include <asterisk.h>
@@ -21,6 +24,9 @@
 #include "chan_dongle.h"			/* devices */
 #include "at_command.h"
 #include "pdu.h"				/* pdu_digit2code() */
+#include "smsq.h"				/* smsq_enabled() smsq_enqueue() SMSQ_ID() */
+#include "ussdq.h"				/* ussdq_send() ussdq_fanout() */
+#include "ussd.h"				/* USSD_ID() */
 
 static int is_valid_ussd_string(const char* number)
 {
@@ -115,13 +121,96 @@ static const char* send2(const char* dev_name, int * status, int online, const c
 }
 
 #/* */
-EXPORT_DEF const char* send_ussd(const char* dev_name, const char* ussd, int * status, void ** id)
+EXPORT_DEF const char* send_ussd(const char* dev_name, const char* ussd, const char * session, const char * limit, int * status, void ** id)
 {
-	if(is_valid_ussd_string(ussd))
-		return send2(dev_name, status, 1, "Error adding USSD command to queue", "USSD queued for send", (at_cmd_f)at_enque_ussd, ussd, 0, 0, 0, id);
+	struct pvt * pvt;
+	const char * msg;
+	uint64_t ussd_id = 0;
+	int group;
+	char end;
+	int res;
+
+	if(status)
+		*status = 0;
+	if(!is_valid_ussd_string(ussd))
+		return "Invalid USSD";
+
+	if(sscanf(dev_name, "g%d%c", &group, &end) == 1)
+	{
+		res = ussdq_fanout(group, ussd, limit ? strtoul(limit, NULL, 10) : 0, &ussd_id);
+		if(res == -ENODEV)
+			return "No ready devices in group";
+		if(res)
+			return "Error adding USSD to queue of group";
+		msg = "USSD queued for send to devices of group";
+	}
+	else
+	{
+		pvt = find_device_ext(dev_name, &msg);
+		if(!pvt)
+			return msg;
+		res = ussdq_send(pvt, ussd, session ? strtoull(session, NULL, 0) : 0, &ussd_id);
+		ast_mutex_unlock (&pvt->lock);
+
+		switch(res)
+		{
+			case 0:
+				msg = "USSD queued for send";
+				break;
+			case 1:
+				msg = "USSD answered from cache";
+				break;
+			case -ENODEV:
+				return "Device not connected / initialized / registered";
+			case -ENOENT:
+				return "No open USSD session with this ID";
+			case -EBUSY:
+				return "Device has USSD session in progress";
+			default:
+				ast_log (LOG_ERROR, "[%s] Error adding USSD command to queue\n", dev_name);
+				return "Error adding USSD command to queue";
+		}
+	}
+
+	if(status)
+		*status = 1;
+	if(id)
+		*id = USSD_ID(ussd_id);
+	return msg;
+}
+
+#/* append SMS to spool for device or g<group>, device may be not ready now */
+static const char * send_spool(const char * dev_name, const char * number, const char * message, unsigned validity, int report, int * status, void ** id)
+{
+	struct pvt * pvt;
+	char target[DEVNAMELEN];
+	uint64_t spool_id;
+	int group;
+	char end;
+
 	if(status)
 		*status = 0;
-	return "Invalid USSD";
+	if(sscanf(dev_name, "g%d%c", &group, &end) == 1)
+	{
+		snprintf(target, sizeof(target), "g%d", group);
+	}
+	else
+	{
+		pvt = find_device(dev_name);
+		if(!pvt)
+			return "no such device";
+		ast_copy_string(target, PVT_ID(pvt), sizeof(target));
+		ast_mutex_unlock (&pvt->lock);
+	}
+
+	if(smsq_enqueue(target, number, message, validity, report, &spool_id))
+		return "Error adding SMS to spool";
+
+	if(status)
+		*status = 1;
+	if(id)
+		*id = SMSQ_ID(spool_id);
+	return "SMS queued to spool for send";
 }
 
 #/* */
@@ -142,6 +231,8 @@ EXPORT_DEF const char * send_sms(const char * dev_name, const char * number, con
 		if(report)
 			srr = ast_true (report);
 
+		if(smsq_enabled())
+			return send_spool(dev_name, number, message, val, srr, status, id);
 		return send2(dev_name, status, 1, "Error adding SMS commands to queue", "SMS queued for send", at_enque_sms, number, message, val, srr, id);
 	}
 	if(status)
@@ -184,6 +275,7 @@ EXPORT_DEF const char* schedule_restart_event(dev_state_t event, restate_time_t
 		pvt->restart_time = when;
 
 		pvt_try_restate(pvt);
+		pvt_state_publish(pvt);
 		ast_mutex_unlock (&pvt->lock);
 
 		msg = dev_state2str_msg(event);
@@ -11,7 +11,7 @@
 EXPORT_DECL int get_at_clir_value (struct pvt* pvt, int clir);
 
 /* return status string of sending, status arg is optional */
-EXPORT_DECL const char * send_ussd(const char * dev_name, const char* ussd, int * status, void ** id);
+EXPORT_DECL const char * send_ussd(const char * dev_name, const char* ussd, const char * session, const char * limit, int * status, void ** id);
 EXPORT_DECL const char * send_sms(const char * dev_name, const char* number, const char* message, const char * validity, const char * report, int * status, void ** id);
 EXPORT_DECL const char * send_pdu(const char * dev_name, const char * pdu, int * status, void ** id);
 EXPORT_DECL const char * send_reset(const char * dev_name, int * status);
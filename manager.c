@@ -23,6 +23,9 @@
 #include "manager.h"
 #include "chan_dongle.h"			/* devices */
 #include "helpers.h"				/* ITEMS_OF() send_ccwa_set() send_reset() send_sms() send_ussd() */
+#include "dispatch.h"				/* struct dispatch_job dispatch_run() */
+#include "char_conv.h"				/* BASE64_SIZE() base64_encode() */
+#include "ussdq.h"				/* ussdq_release() */
 
 static char * espace_newlines(const char * text);
 
@@ -31,6 +34,7 @@ static int manager_show_devices (struct mansession* s, const struct message* m)
 	const char * id = astman_get_header (m, "ActionID");
 	const char * device = astman_get_header (m, "Device");
 	struct pvt * pvt;
+	pvt_status_t status;
 	size_t count = 0;
 	char buf[40];
 
@@ -39,79 +43,83 @@ static int manager_show_devices (struct mansession* s, const struct message* m)
 	AST_RWLIST_RDLOCK (&gpublic->devices);
 	AST_RWLIST_TRAVERSE (&gpublic->devices, pvt, entry)
 	{
-		ast_mutex_lock (&pvt->lock);
+		/* device id never changed, other from snapshot without lock of device */
 		if(ast_strlen_zero(device) || strcmp(device, PVT_ID(pvt)) == 0)
 		{
+			pvt_status_read(pvt, &status);
+
 			astman_append (s, "Event: DongleDeviceEntry\r\n");
 			if(!ast_strlen_zero (id))
 				astman_append (s, "ActionID: %s\r\n", id);
 			astman_append (s, "Device: %s\r\n", PVT_ID(pvt));
 /* settings */
-			astman_append (s, "AudioSetting: %s\r\n", CONF_UNIQ(pvt, audio_tty));
-			astman_append (s, "DataSetting: %s\r\n", CONF_UNIQ(pvt, data_tty));
-			astman_append (s, "IMEISetting: %s\r\n", CONF_UNIQ(pvt, imei));
-			astman_append (s, "IMSISetting: %s\r\n", CONF_UNIQ(pvt, imsi));
-			astman_append (s, "ChannelLanguage: %s\r\n", CONF_SHARED(pvt, language));
-			astman_append (s, "Context: %s\r\n", CONF_SHARED(pvt, context));
-			astman_append (s, "Exten: %s\r\n", CONF_SHARED(pvt, exten));
-			astman_append (s, "Group: %d\r\n", CONF_SHARED(pvt, group));
-			astman_append (s, "RXGain: %d\r\n", CONF_SHARED(pvt, rxgain));
-			astman_append (s, "TXGain: %d\r\n", CONF_SHARED(pvt, txgain));
-			astman_append (s, "U2DIAG: %d\r\n", CONF_SHARED(pvt, u2diag));
-			astman_append (s, "UseCallingPres: %s\r\n", CONF_SHARED(pvt, usecallingpres) ? "Yes" : "No");
-			astman_append (s, "DefaultCallingPres: %s\r\n", CONF_SHARED(pvt, callingpres) < 0 ? "<Not set>" : ast_describe_caller_presentation (CONF_SHARED(pvt, callingpres)));
-			astman_append (s, "AutoDeleteSMS: %s\r\n", CONF_SHARED(pvt, autodeletesms) ? "Yes" : "No");
-			astman_append (s, "DisableSMS: %s\r\n", CONF_SHARED(pvt, disablesms) ? "Yes" : "No");
-			astman_append (s, "ResetDongle: %s\r\n", CONF_SHARED(pvt, resetdongle) ? "Yes" : "No");
-			astman_append (s, "SMSPDU: %s\r\n", CONF_SHARED(pvt, smsaspdu) ? "Yes" : "No");
-			astman_append (s, "CallWaitingSetting: %s\r\n", dc_cw_setting2str(CONF_SHARED(pvt, callwaiting)));
-			astman_append (s, "DTMF: %s\r\n", dc_dtmf_setting2str(CONF_SHARED(pvt, dtmf)));
-			astman_append (s, "MinimalDTMFGap: %d\r\n", CONF_SHARED(pvt, mindtmfgap));
-			astman_append (s, "MinimalDTMFDuration: %d\r\n", CONF_SHARED(pvt, mindtmfduration));
-			astman_append (s, "MinimalDTMFInterval: %d\r\n", CONF_SHARED(pvt, mindtmfinterval));
+			astman_append (s, "AudioSetting: %s\r\n", UCONFIG(&status.settings, audio_tty));
+			astman_append (s, "DataSetting: %s\r\n", UCONFIG(&status.settings, data_tty));
+			astman_append (s, "IMEISetting: %s\r\n", UCONFIG(&status.settings, imei));
+			astman_append (s, "IMSISetting: %s\r\n", UCONFIG(&status.settings, imsi));
+			astman_append (s, "ChannelLanguage: %s\r\n", SCONFIG(&status.settings, language));
+			astman_append (s, "Context: %s\r\n", SCONFIG(&status.settings, context));
+			astman_append (s, "Exten: %s\r\n", SCONFIG(&status.settings, exten));
+			astman_append (s, "Group: %d\r\n", SCONFIG(&status.settings, group));
+			astman_append (s, "RXGain: %d\r\n", SCONFIG(&status.settings, rxgain));
+			astman_append (s, "TXGain: %d\r\n", SCONFIG(&status.settings, txgain));
+			astman_append (s, "U2DIAG: %d\r\n", SCONFIG(&status.settings, u2diag));
+			astman_append (s, "UseCallingPres: %s\r\n", SCONFIG(&status.settings, usecallingpres) ? "Yes" : "No");
+			astman_append (s, "DefaultCallingPres: %s\r\n", SCONFIG(&status.settings, callingpres) < 0 ? "<Not set>" : ast_describe_caller_presentation (SCONFIG(&status.settings, callingpres)));
+			astman_append (s, "AutoDeleteSMS: %s\r\n", SCONFIG(&status.settings, autodeletesms) ? "Yes" : "No");
+			astman_append (s, "DisableSMS: %s\r\n", SCONFIG(&status.settings, disablesms) ? "Yes" : "No");
+			astman_append (s, "ResetDongle: %s\r\n", SCONFIG(&status.settings, resetdongle) ? "Yes" : "No");
+			astman_append (s, "SMSPDU: %s\r\n", SCONFIG(&status.settings, smsaspdu) ? "Yes" : "No");
+			astman_append (s, "SMSDirect: %s\r\n", SCONFIG(&status.settings, smsdirect) ? "Yes" : "No");
+			astman_append (s, "SMSRef16: %s\r\n", SCONFIG(&status.settings, smsref16) ? "Yes" : "No");
+			astman_append (s, "Dispatch: %s\r\n", dc_dispatch_setting2str(SCONFIG(&status.settings, dispatch)));
+			astman_append (s, "CallWaitingSetting: %s\r\n", dc_cw_setting2str(SCONFIG(&status.settings, callwaiting)));
+			astman_append (s, "DTMF: %s\r\n", dc_dtmf_setting2str(SCONFIG(&status.settings, dtmf)));
+			astman_append (s, "MinimalDTMFGap: %d\r\n", SCONFIG(&status.settings, mindtmfgap));
+			astman_append (s, "MinimalDTMFDuration: %d\r\n", SCONFIG(&status.settings, mindtmfduration));
+			astman_append (s, "MinimalDTMFInterval: %d\r\n", SCONFIG(&status.settings, mindtmfinterval));
 /* state */
-			astman_append (s, "State: %s\r\n", pvt_str_state(pvt));
-			astman_append (s, "AudioState: %s\r\n", PVT_STATE(pvt, audio_tty));
-			astman_append (s, "DataState: %s\r\n", PVT_STATE(pvt, data_tty));
-			astman_append (s, "Voice: %s\r\n", (pvt->has_voice) ? "Yes" : "No");
-			astman_append (s, "SMS: %s\r\n", (pvt->has_sms) ? "Yes" : "No");
-			astman_append (s, "Manufacturer: %s\r\n", pvt->manufacturer);
-			astman_append (s, "Model: %s\r\n", pvt->model);
-			astman_append (s, "Firmware: %s\r\n", pvt->firmware);
-			astman_append (s, "IMEIState: %s\r\n", pvt->imei);
-			astman_append (s, "IMSIState: %s\r\n", pvt->imsi);
-			astman_append (s, "GSMRegistrationStatus: %s\r\n", GSM_regstate2str(pvt->gsm_reg_status));
-			astman_append (s, "RSSI: %d, %s\r\n", pvt->rssi, rssi2dBm(pvt->rssi, buf, sizeof(buf)));
-			astman_append (s, "Mode: %s\r\n", sys_mode2str(pvt->linkmode));
-			astman_append (s, "Submode: %s\r\n", sys_submode2str(pvt->linksubmode));
-			astman_append (s, "ProviderName: %s\r\n", pvt->provider_name);
-			astman_append (s, "LocationAreaCode: %s\r\n", pvt->location_area_code);
-			astman_append (s, "CellID: %s\r\n", pvt->cell_id);
-			astman_append (s, "SubscriberNumber: %s\r\n", pvt->subscriber_number);
-			astman_append (s, "SMSServiceCenter: %s\r\n", pvt->sms_scenter);
-			astman_append (s, "UseUCS2Encoding: %s\r\n", pvt->use_ucs2_encoding ? "Yes" : "No");
-			astman_append (s, "USSDUse7BitEncoding: %s\r\n", pvt->cusd_use_7bit_encoding ? "Yes" : "No");
-			astman_append (s, "USSDUseUCS2Decoding: %s\r\n", pvt->cusd_use_ucs2_decoding ? "Yes" : "No");
-			astman_append (s, "TasksInQueue: %u\r\n", PVT_STATE(pvt, at_tasks));
-			astman_append (s, "CommandsInQueue: %u\r\n", PVT_STATE(pvt, at_cmds));
-			astman_append (s, "CallWaitingState: %s\r\n", pvt->has_call_waiting ? "Enabled" : "Disabled");
-			astman_append (s, "CurrentDeviceState: %s\r\n", dev_state2str(pvt->current_state));
-			astman_append (s, "DesiredDeviceState: %s\r\n", dev_state2str(pvt->desired_state));
-			astman_append (s, "CallsChannels: %u\r\n", PVT_STATE(pvt, chansno));
-			astman_append (s, "Active: %u\r\n", PVT_STATE(pvt, chan_count[CALL_STATE_ACTIVE]));
-			astman_append (s, "Held: %u\r\n", PVT_STATE(pvt, chan_count[CALL_STATE_ONHOLD]));
-			astman_append (s, "Dialing: %u\r\n", PVT_STATE(pvt, chan_count[CALL_STATE_DIALING]));
-			astman_append (s, "Alerting: %u\r\n", PVT_STATE(pvt, chan_count[CALL_STATE_ALERTING]));
-			astman_append (s, "Incoming: %u\r\n", PVT_STATE(pvt, chan_count[CALL_STATE_INCOMING]));
-			astman_append (s, "Waiting: %u\r\n", PVT_STATE(pvt, chan_count[CALL_STATE_WAITING]));
-			astman_append (s, "Releasing: %u\r\n", PVT_STATE(pvt, chan_count[CALL_STATE_RELEASED]));
-			astman_append (s, "Initializing: %u\r\n", PVT_STATE(pvt, chan_count[CALL_STATE_INIT]));
+			astman_append (s, "State: %s\r\n", status.str_state);
+			astman_append (s, "AudioState: %s\r\n", PVT_STATE_T(&status.state, audio_tty));
+			astman_append (s, "DataState: %s\r\n", PVT_STATE_T(&status.state, data_tty));
+			astman_append (s, "Voice: %s\r\n", status.has_voice ? "Yes" : "No");
+			astman_append (s, "SMS: %s\r\n", status.has_sms ? "Yes" : "No");
+			astman_append (s, "Manufacturer: %s\r\n", status.manufacturer);
+			astman_append (s, "Model: %s\r\n", status.model);
+			astman_append (s, "Firmware: %s\r\n", status.firmware);
+			astman_append (s, "IMEIState: %s\r\n", status.imei);
+			astman_append (s, "IMSIState: %s\r\n", status.imsi);
+			astman_append (s, "GSMRegistrationStatus: %s\r\n", GSM_regstate2str(status.gsm_reg_status));
+			astman_append (s, "RSSI: %d, %s\r\n", status.rssi, rssi2dBm(status.rssi, buf, sizeof(buf)));
+			astman_append (s, "Mode: %s\r\n", sys_mode2str(status.linkmode));
+			astman_append (s, "Submode: %s\r\n", sys_submode2str(status.linksubmode));
+			astman_append (s, "ProviderName: %s\r\n", status.provider_name);
+			astman_append (s, "LocationAreaCode: %s\r\n", status.location_area_code);
+			astman_append (s, "CellID: %s\r\n", status.cell_id);
+			astman_append (s, "SubscriberNumber: %s\r\n", status.subscriber_number);
+			astman_append (s, "SMSServiceCenter: %s\r\n", status.sms_scenter);
+			astman_append (s, "UseUCS2Encoding: %s\r\n", status.use_ucs2_encoding ? "Yes" : "No");
+			astman_append (s, "USSDUse7BitEncoding: %s\r\n", status.cusd_use_7bit_encoding ? "Yes" : "No");
+			astman_append (s, "USSDUseUCS2Decoding: %s\r\n", status.cusd_use_ucs2_decoding ? "Yes" : "No");
+			astman_append (s, "TasksInQueue: %u\r\n", PVT_STATE_T(&status.state, at_tasks));
+			astman_append (s, "CommandsInQueue: %u\r\n", PVT_STATE_T(&status.state, at_cmds));
+			astman_append (s, "CallWaitingState: %s\r\n", status.has_call_waiting ? "Enabled" : "Disabled");
+			astman_append (s, "CurrentDeviceState: %s\r\n", dev_state2str(status.current_state));
+			astman_append (s, "DesiredDeviceState: %s\r\n", dev_state2str(status.desired_state));
+			astman_append (s, "CallsChannels: %u\r\n", PVT_STATE_T(&status.state, chansno));
+			astman_append (s, "Active: %u\r\n", PVT_STATE_T(&status.state, chan_count[CALL_STATE_ACTIVE]));
+			astman_append (s, "Held: %u\r\n", PVT_STATE_T(&status.state, chan_count[CALL_STATE_ONHOLD]));
+			astman_append (s, "Dialing: %u\r\n", PVT_STATE_T(&status.state, chan_count[CALL_STATE_DIALING]));
+			astman_append (s, "Alerting: %u\r\n", PVT_STATE_T(&status.state, chan_count[CALL_STATE_ALERTING]));
+			astman_append (s, "Incoming: %u\r\n", PVT_STATE_T(&status.state, chan_count[CALL_STATE_INCOMING]));
+			astman_append (s, "Waiting: %u\r\n", PVT_STATE_T(&status.state, chan_count[CALL_STATE_WAITING]));
+			astman_append (s, "Releasing: %u\r\n", PVT_STATE_T(&status.state, chan_count[CALL_STATE_RELEASED]));
+			astman_append (s, "Initializing: %u\r\n", PVT_STATE_T(&status.state, chan_count[CALL_STATE_INIT]));
 /* TODO: stats */
 
 			astman_append (s, "\r\n");
 			count++;
 		}
-		ast_mutex_unlock (&pvt->lock);
 	}
 	AST_RWLIST_UNLOCK (&gpublic->devices);
 
@@ -132,6 +140,8 @@ static int manager_send_ussd (struct mansession* s, const struct message* m)
 {
 	const char*	device	= astman_get_header (m, "Device");
 	const char*	ussd	= astman_get_header (m, "USSD");
+	const char*	session	= astman_get_header (m, "Session");
+	const char*	limit	= astman_get_header (m, "Concurrency");
 
 	char		buf[256];
 	const char*	msg;
@@ -150,11 +160,13 @@ static int manager_send_ussd (struct mansession* s, const struct message* m)
 		return 0;
 	}
 
-	msg = send_ussd(device, ussd, &status, &msgid);
+	msg = send_ussd(device, ussd, session, limit, &status, &msgid);
 	snprintf(buf, sizeof (buf), "[%s] %s\r\nID: %p", device, msg, msgid);
 	if(status)
 	{
 		astman_send_ack(s, m, buf);
+		/* DongleNewUSSD of answer from cache after response */
+		ussdq_release((uintptr_t)msgid);
 	}
 	else
 	{
@@ -261,15 +273,34 @@ EXPORT_DEF void manager_event_sent_notify(const char * devname, const char * typ
 	);
 }
 
+#/* */
+EXPORT_DEF void manager_event_ussd_group(const void * id, int group, unsigned devices, unsigned answered, unsigned failed)
+{
+	manager_event (EVENT_FLAG_CALL, "DongleUSSDGroupComplete",
+		"ID: %p\r\n"
+		"Group: %d\r\n"
+		"Devices: %u\r\n"
+		"Answered: %u\r\n"
+		"Failed: %u\r\n",
+		id,
+		group,
+		devices,
+		answered,
+		failed
+	);
+}
+
 /*!
  * \brief Send a DongleNewUSSD event to the manager
  * This function splits the message in multiple lines, so multi-line
  * USSD messages can be send over the manager API.
- * \param pvt a pvt structure
+ * \param devname a name of device
+ * \param id an id of request, NULL for message not requested
+ * \param type a type of +CUSD
  * \param message a null terminated buffer containing the message
  */
 
-EXPORT_DEF void manager_event_new_ussd (const char * devname, char* message)
+EXPORT_DEF void manager_event_new_ussd (const char * devname, const void * id, int type, char* message)
 {
 	struct ast_str*	buf;
 	char*		s = message;
@@ -289,11 +320,13 @@ EXPORT_DEF void manager_event_new_ussd (const char * devname, char* message)
 
 	manager_event (EVENT_FLAG_CALL, "DongleNewUSSD",
 		"Device: %s\r\n"
+		"ID: %p\r\n"
+		"Type: %d\r\n"
 		"LineCount: %zu\r\n"
 /* FIXME: empty lines inserted */
 //		"%s\r\n",
 		"%s",
-		devname, linecount, ast_str_buffer (buf)
+		devname, id, type, linecount, ast_str_buffer (buf)
 	);
 
 	ast_free (buf);
@@ -351,19 +384,45 @@ static char * espace_newlines(const char * text)
 }
 
 #/* */
-EXPORT_DEF void manager_event_cend(const char * devname, int call_index, int duration, int end_status, int cc_cause)
+EXPORT_DEF void manager_event_cend(const char * devname, int call_index, int duration, int end_status, int cc_cause, const struct cpvt_stat * stat)
 {
 	manager_event( EVENT_FLAG_CALL, "DongleCEND",
 		"Device: %s\r\n"
 		"CallIdx: %d\r\n"
 		"Duration: %d\r\n"
 		"EndStatus: %d\r\n"
-		"CCCause: %d\r\n",
+		"CCCause: %d\r\n"
+		"AudioReadFrames: %u\r\n"
+		"AudioShortReads: %u\r\n"
+		"AudioJitter: %u\r\n"
+		"AudioJitterMax: %u\r\n"
+		"AudioDrift: %d\r\n"
+		"AudioWriteFrames: %u\r\n"
+		"AudioSilenceFrames: %u\r\n"
+		"AudioTruncatedFrames: %u\r\n"
+		"AudioOverflows: %u\r\n"
+		"AudioOverflowBytes: %llu\r\n"
+		"AudioBufferMax: %u\r\n"
+		"AudioBufferAvg: %u\r\n"
+		"AudioVADSilentFrames: %u\r\n",
 		devname,
 		call_index,
 		duration,
 		end_status,
-		cc_cause
+		cc_cause,
+		stat->read_frames,
+		stat->read_sframes,
+		stat->jitter,
+		stat->jitter_max,
+		cpvt_stat_drift(stat),
+		stat->write_frames,
+		stat->write_sframes,
+		stat->write_tframes,
+		stat->write_rb_overflow,
+		(unsigned long long int)stat->write_rb_overflow_bytes,
+		stat->depth_max,
+		cpvt_stat_depth_avg(stat),
+		stat->read_vad_silent
 		);
 }
 
@@ -447,6 +506,98 @@ EXPORT_DEF void manager_event_new_sms_base64 (const char * devname, char * numbe
 	);
 }
 
+/* events of received SMS or USSD for dispatch pool, strings stored after struct */
+struct manager_job
+{
+	struct dispatch_job	job;
+	char			* number;			/*!< originator of SMS, NULL for USSD */
+	const void		* id;				/*!< request of USSD */
+	int			type;				/*!< type of USSD */
+	char			* message;
+	char			* message_base64;
+	char			devname[1];
+};
+
+#/* dispatch_run_t, send events and free job */
+static void manager_job_run (struct dispatch_job * job)
+{
+	struct manager_job * mj = (struct manager_job *)job;
+
+	if (mj->number)
+	{
+		manager_event_new_sms (mj->devname, mj->number, mj->message);
+		manager_event_new_sms_base64 (mj->devname, mj->number, mj->message_base64);
+	}
+	else
+	{
+		manager_event_new_ussd (mj->devname, mj->id, mj->type, mj->message);
+		manager_event_message ("DongleNewUSSDBase64", mj->devname, mj->message_base64);
+	}
+	ast_free (mj);
+}
+
+#/* copy strings and encode base64 to job and pass to pool, if pool full run in caller thread */
+static void manager_dispatch (const char * devname, const char * number, const void * id, int type, const char * message, size_t length)
+{
+	struct manager_job * mj;
+	size_t devname_len = strlen (devname) + 1;
+	size_t number_len = number ? strlen (number) + 1 : 0;
+	size_t message_len = length + 1;
+	size_t base64_len = BASE64_SIZE (length);
+
+	mj = ast_malloc (sizeof (*mj) + devname_len + number_len + message_len + base64_len);
+	if (!mj)
+		return;
+
+	mj->job.run = manager_job_run;
+	mj->id = id;
+	mj->type = type;
+	memcpy (mj->devname, devname, devname_len);
+	mj->message = mj->devname + devname_len;
+	memcpy (mj->message, message, length);
+	mj->message[length] = 0;
+	mj->message_base64 = mj->message + message_len;
+	base64_encode (message, length, mj->message_base64, base64_len);
+	if (number)
+	{
+		mj->number = mj->message_base64 + base64_len;
+		memcpy (mj->number, number, number_len);
+	}
+	else
+	{
+		mj->number = NULL;
+	}
+
+	dispatch_run (&mj->job);
+}
+
+/*!
+ * \brief Send DongleNewSMS and DongleNewSMSBase64 events by dispatch pool
+ * \param devname a name of device
+ * \param number a null terminated buffer containing the from number
+ * \param message a buffer containing the message
+ * \param length a length of message
+ */
+
+EXPORT_DEF void manager_dispatch_new_sms (const char * devname, const char * number, const char * message, size_t length)
+{
+	manager_dispatch (devname, number, NULL, 0, message, length);
+}
+
+/*!
+ * \brief Send DongleNewUSSD and DongleNewUSSDBase64 events by dispatch pool
+ * \param devname a name of device
+ * \param id an id of request, NULL for message not requested
+ * \param type a type of +CUSD
+ * \param message a buffer containing the message
+ * \param length a length of message
+ */
+
+EXPORT_DEF void manager_dispatch_new_ussd (const char * devname, const void * id, int type, const char * message, size_t length)
+{
+	manager_dispatch (devname, NULL, id, type, message, length);
+}
+
 static int manager_ccwa_set (struct mansession* s, const struct message* m)
 {
 	const char*	device	= astman_get_header (m, "Device");
@@ -626,8 +777,10 @@ static const struct dongle_manager
 	"Description: Send a ussd message to a dongle.\n\n"
 	"Variables: (Names marked with * are required)\n"
 	"	ActionID: <id>		Action ID for this transaction. Will be returned.\n"
-	"	*Device:  <device>	The dongle to which the ussd code will be send.\n"
+	"	*Device:  <device>	The dongle or g<group> to which the ussd code will be send.\n"
 	"	*USSD:    <code>	The ussd code that will be send to the device.\n"
+	"	Session:  <id>		ID of open menu session for reply, USSD is the next step.\n"
+	"	Concurrency: <n>	Devices of group queried at once, default 4.\n"
 	 },
 	{
 	manager_send_sms, 
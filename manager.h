@@ -6,21 +6,27 @@
 
 #ifdef BUILD_MANAGER
 
+#include <sys/types.h>			/* size_t */
 #include "export.h"			/* EXPORT_DECL EXPORT_DEF */
 
+struct cpvt_stat;
+
 EXPORT_DECL void manager_register();
 EXPORT_DECL void manager_unregister();
 
 EXPORT_DECL void manager_event_message(const char * event, const char * devname, const char * message);
 EXPORT_DECL void manager_event_message_raw(const char * event, const char * devname, const char * message);
 
-EXPORT_DECL void manager_event_new_ussd(const char * devname, char * message);
+EXPORT_DECL void manager_event_new_ussd(const char * devname, const void * id, int type, char * message);
 EXPORT_DECL void manager_event_new_sms(const char * devname, char * number, char * message);
 EXPORT_DECL void manager_event_new_sms_base64 (const char * devname, char * number, char * message_base64);
-EXPORT_DECL void manager_event_cend(const char * devname, int call_index, int duration, int end_status, int cc_cause);
+EXPORT_DECL void manager_dispatch_new_sms(const char * devname, const char * number, const char * message, size_t length);
+EXPORT_DECL void manager_dispatch_new_ussd(const char * devname, const void * id, int type, const char * message, size_t length);
+EXPORT_DECL void manager_event_cend(const char * devname, int call_index, int duration, int end_status, int cc_cause, const struct cpvt_stat * stat);
 EXPORT_DECL void manager_event_call_state_change(const char * devname, int call_index, const char * newstate);
 EXPORT_DECL void manager_event_device_status(const char * devname, const char * newstatus);
 EXPORT_DECL void manager_event_sent_notify(const char * devname, const char * type, const void * id, const char * result);
+EXPORT_DECL void manager_event_ussd_group(const void * id, int group, unsigned devices, unsigned answered, unsigned failed);
 
 #else  /* BUILD_MANAGER */
 
@@ -29,13 +35,16 @@ EXPORT_DECL void manager_event_sent_notify(const char * devname, const char * ty
 
 #define manager_event_message(event, devname, message)
 #define manager_event_message_raw(event, devname, message)
-#define manager_event_new_ussd(devname, message)
+#define manager_event_new_ussd(devname, id, type, message)
 #define manager_event_new_sms(devname, number, message)
 #define manager_event_new_sms_base64(devname, number, message_base64)
-#define manager_event_cend(devname, call_index, duration, end_status, cc_cause)
+#define manager_dispatch_new_sms(devname, number, message, length)
+#define manager_dispatch_new_ussd(devname, id, type, message, length)
+#define manager_event_cend(devname, call_index, duration, end_status, cc_cause, stat)
 #define manager_event_call_state_change(devname, call_index, newstate)
 #define manager_event_device_status(devname, newstatus)
 #define manager_event_sent_notify(devname, type, id, result)
+#define manager_event_ussd_group(id, group, devices, answered, failed)
 
 #endif /* BUILD_MANAGER */
 
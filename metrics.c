@@ -0,0 +1,349 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#ifdef BUILD_METRICS
+
+#include <stddef.h>				/* offsetof() */
+#include <string.h>				/* strcmp() */
+
+#include <asterisk.h>
+#include <asterisk/version.h>			/* ASTERISK_VERSION_NUM */
+#include <asterisk/http.h>			/* ast_http_uri_link() ast_http_uri_unlink() ast_http_send() */
+#include <asterisk/strings.h>			/* ast_str_create() ast_str_append() */
+#include <asterisk/utils.h>			/* ast_calloc() ast_free() */
+
+#include "metrics.h"
+#include "chan_dongle.h"			/* gpublic pvt_status_read() pvt_stat_read() */
+#include "cpvt.h"				/* call_state2str() */
+#include "mutils.h"				/* ITEMS_OF() */
+#include "smsq.h"				/* smsq_enabled() smsq_stat_read() */
+#include "dispatch.h"				/* dispatch_stat_read() */
+
+#if ASTERISK_VERSION_NUM >= 10800 /* 1.8+ */
+
+/* copy of device state and counters */
+struct metrics_device
+{
+	pvt_status_t		status;
+	pvt_stat_t		stat;
+};
+
+/* counters from pvt_stat_t, families with same name must be adjacent */
+static const struct metrics_counter
+{
+	const char	* name;
+	const char	* help;
+	const char	* label;		/*!< additional label or NULL */
+	size_t		offset;			/*!< offset of uint64_t counter in pvt_stat_t */
+} counters[] = {
+	{ "dongle_at_tasks_total", "AT command tasks added to queue", NULL, offsetof(pvt_stat_t, at_tasks) },
+	{ "dongle_at_commands_total", "AT commands added to queue", NULL, offsetof(pvt_stat_t, at_cmds) },
+	{ "dongle_at_responses_total", "AT responses handled", NULL, offsetof(pvt_stat_t, at_responces) },
+	{ "dongle_data_read_bytes_total", "Bytes of responses read from data port", NULL, offsetof(pvt_stat_t, d_read_bytes) },
+	{ "dongle_data_written_bytes_total", "Bytes of commands written to data port", NULL, offsetof(pvt_stat_t, d_write_bytes) },
+	{ "dongle_audio_read_bytes_total", "Bytes of audio read from audio port", NULL, offsetof(pvt_stat_t, a_read_bytes) },
+	{ "dongle_audio_written_bytes_total", "Bytes of audio written to audio port", NULL, offsetof(pvt_stat_t, a_write_bytes) },
+	{ "dongle_read_frames_total", "Audio frames read from device", NULL, offsetof(pvt_stat_t, read_frames) },
+	{ "dongle_read_short_frames_total", "Truncated audio frames read from device", NULL, offsetof(pvt_stat_t, read_sframes) },
+	{ "dongle_write_frames_total", "Audio frame writes", NULL, offsetof(pvt_stat_t, write_frames) },
+	{ "dongle_write_short_frames_total", "Truncated audio frame writes", NULL, offsetof(pvt_stat_t, write_tframes) },
+	{ "dongle_write_silence_frames_total", "Silence audio frame writes", NULL, offsetof(pvt_stat_t, write_sframes) },
+	{ "dongle_write_overflow_bytes_total", "Bytes dropped by write buffer overflow", NULL, offsetof(pvt_stat_t, write_rb_overflow_bytes) },
+	{ "dongle_write_overflows_total", "Write buffer overflows", NULL, offsetof(pvt_stat_t, write_rb_overflow) },
+	{ "dongle_tap_frames_total", "Audio frames sent to audio tap", NULL, offsetof(pvt_stat_t, tap_frames) },
+	{ "dongle_tap_dropped_frames_total", "Audio frames not sent to audio tap", NULL, offsetof(pvt_stat_t, tap_dropped) },
+	{ "dongle_sms_spool_sent_total", "SMS from spool sent", NULL, offsetof(pvt_stat_t, smsq_sent) },
+	{ "dongle_sms_spool_dropped_total", "SMS from spool dropped after last attempt", NULL, offsetof(pvt_stat_t, smsq_failed) },
+	{ "dongle_incoming_calls_total", "Incoming calls", NULL, offsetof(pvt_stat_t, in_calls) },
+	{ "dongle_waiting_calls_total", "Waiting calls", NULL, offsetof(pvt_stat_t, cw_calls) },
+	{ "dongle_outgoing_calls_total", "Outgoing call attempts", NULL, offsetof(pvt_stat_t, out_calls) },
+	{ "dongle_incoming_calls_handled_total", "Incoming and waiting calls passed to dialplan", NULL, offsetof(pvt_stat_t, in_calls_handled) },
+	{ "dongle_pbx_fails_total", "Failures of PBX start for incoming calls", NULL, offsetof(pvt_stat_t, in_pbx_fails) },
+	{ "dongle_calls_answered_total", "Answered calls", "direction=\"outgoing\"", offsetof(pvt_stat_t, calls_answered[CALL_DIR_OUTGOING]) },
+	{ "dongle_calls_answered_total", "Answered calls", "direction=\"incoming\"", offsetof(pvt_stat_t, calls_answered[CALL_DIR_INCOMING]) },
+	{ "dongle_calls_duration_seconds_total", "Duration of calls", "direction=\"outgoing\"", offsetof(pvt_stat_t, calls_duration[CALL_DIR_OUTGOING]) },
+	{ "dongle_calls_duration_seconds_total", "Duration of calls", "direction=\"incoming\"", offsetof(pvt_stat_t, calls_duration[CALL_DIR_INCOMING]) },
+};
+
+#/* append label value with escaping of backslash, double quote and new line */
+static void metrics_label(struct ast_str ** out, const char * value)
+{
+	for(; *value; ++value)
+	{
+		switch(*value)
+		{
+			case '\\':
+				ast_str_append(out, 0, "\\\\");
+				break;
+			case '"':
+				ast_str_append(out, 0, "\\\"");
+				break;
+			case '\n':
+				ast_str_append(out, 0, "\\n");
+				break;
+			default:
+				ast_str_append(out, 0, "%c", *value);
+		}
+	}
+}
+
+#/* append sample name and labels up to value */
+static void metrics_sample(struct ast_str ** out, const char * name, const struct metrics_device * dev, const char * label)
+{
+	ast_str_append(out, 0, "%s{device=\"", name);
+	metrics_label(out, UCONFIG(&dev->status.settings, id));
+	ast_str_append(out, 0, "\"%s%s} ", label ? "," : "", label ? label : "");
+}
+
+#/* */
+static void metrics_family(struct ast_str ** out, const char * name, const char * type, const char * help)
+{
+	ast_str_append(out, 0, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+#/* */
+static void metrics_gauge(struct ast_str ** out, const char * name, const char * help, const struct metrics_device * devs, unsigned count, size_t offset)
+{
+	unsigned i;
+
+	metrics_family(out, name, "gauge", help);
+	for(i = 0; i < count; ++i)
+	{
+		metrics_sample(out, name, &devs[i], NULL);
+		ast_str_append(out, 0, "%d\n", *(const int *)((const char *)&devs[i].status + offset));
+	}
+}
+
+#/* */
+static void metrics_render(struct ast_str ** out, const struct metrics_device * devs, unsigned count)
+{
+	static const unsigned bounds[] = AT_LATENCY_BOUNDS;
+	static const call_state_t states[] = {
+		CALL_STATE_ACTIVE, CALL_STATE_ONHOLD, CALL_STATE_DIALING, CALL_STATE_ALERTING,
+		CALL_STATE_INCOMING, CALL_STATE_WAITING, CALL_STATE_RELEASED, CALL_STATE_INIT
+		};
+	const pvt_status_t * status;
+	struct smsq_stat spool;
+	struct dispatch_stat pool;
+	uint64_t total;
+	unsigned i, j;
+
+	/* device info and state */
+	metrics_family(out, "dongle_device_info", "gauge", "Device identity, value always 1");
+	for(i = 0; i < count; ++i)
+	{
+		status = &devs[i].status;
+		metrics_sample(out, "dongle_device_info", &devs[i], NULL);
+		ast_str_truncate(*out, ast_str_strlen(*out) - 2);
+		ast_str_append(out, 0, ",imei=\"");
+		metrics_label(out, status->imei);
+		ast_str_append(out, 0, "\",imsi=\"");
+		metrics_label(out, status->imsi);
+		ast_str_append(out, 0, "\",provider=\"");
+		metrics_label(out, status->provider_name);
+		ast_str_append(out, 0, "\",model=\"");
+		metrics_label(out, status->model);
+		ast_str_append(out, 0, "\",firmware=\"");
+		metrics_label(out, status->firmware);
+		ast_str_append(out, 0, "\"} 1\n");
+	}
+
+	metrics_family(out, "dongle_connected", "gauge", "Device connected");
+	for(i = 0; i < count; ++i)
+	{
+		metrics_sample(out, "dongle_connected", &devs[i], NULL);
+		ast_str_append(out, 0, "%d\n", devs[i].status.connected);
+	}
+
+	metrics_family(out, "dongle_enabled", "gauge", "Device started and not scheduled for stop");
+	for(i = 0; i < count; ++i)
+	{
+		metrics_sample(out, "dongle_enabled", &devs[i], NULL);
+		ast_str_append(out, 0, "%d\n", devs[i].status.enabled);
+	}
+
+	metrics_gauge(out, "dongle_rssi", "Signal level as reported by +CSQ, 0..31, 99 unknown", devs, count, offsetof(pvt_status_t, rssi));
+	metrics_gauge(out, "dongle_gsm_registration_status", "GSM registration status as reported by +CREG", devs, count, offsetof(pvt_status_t, gsm_reg_status));
+	metrics_gauge(out, "dongle_link_mode", "Network mode as reported by ^SYSINFO", devs, count, offsetof(pvt_status_t, linkmode));
+	metrics_gauge(out, "dongle_link_submode", "Network submode as reported by ^SYSINFO", devs, count, offsetof(pvt_status_t, linksubmode));
+
+	metrics_family(out, "dongle_at_queue_tasks", "gauge", "AT command tasks in queue");
+	for(i = 0; i < count; ++i)
+	{
+		metrics_sample(out, "dongle_at_queue_tasks", &devs[i], NULL);
+		ast_str_append(out, 0, "%u\n", PVT_STATE_T(&devs[i].status.state, at_tasks));
+	}
+
+	metrics_family(out, "dongle_at_queue_commands", "gauge", "AT commands in queue");
+	for(i = 0; i < count; ++i)
+	{
+		metrics_sample(out, "dongle_at_queue_commands", &devs[i], NULL);
+		ast_str_append(out, 0, "%u\n", PVT_STATE_T(&devs[i].status.state, at_cmds));
+	}
+
+	metrics_family(out, "dongle_channels", "gauge", "Calls and channels by state");
+	for(i = 0; i < count; ++i)
+	{
+		for(j = 0; j < ITEMS_OF(states); ++j)
+		{
+			metrics_sample(out, "dongle_channels", &devs[i], NULL);
+			ast_str_truncate(*out, ast_str_strlen(*out) - 2);
+			ast_str_append(out, 0, ",state=\"%s\"} %u\n", call_state2str(states[j]), PVT_STATE_T(&devs[i].status.state, chan_count[states[j]]));
+		}
+	}
+
+	/* counters */
+	for(j = 0; j < ITEMS_OF(counters); ++j)
+	{
+		if(j == 0 || strcmp(counters[j].name, counters[j - 1].name))
+			metrics_family(out, counters[j].name, "counter", counters[j].help);
+		for(i = 0; i < count; ++i)
+		{
+			metrics_sample(out, counters[j].name, &devs[i], counters[j].label);
+			ast_str_append(out, 0, "%llu\n", (unsigned long long int)*(const uint64_t *)((const char *)&devs[i].stat + counters[j].offset));
+		}
+	}
+
+	/* latency histogram */
+	metrics_family(out, "dongle_at_latency_milliseconds", "histogram", "AT command response latency");
+	for(i = 0; i < count; ++i)
+	{
+		total = 0;
+		for(j = 0; j < AT_LATENCY_BUCKETS; ++j)
+		{
+			total += PVT_STAT_T(&devs[i].stat, at_latency[j]);
+			metrics_sample(out, "dongle_at_latency_milliseconds_bucket", &devs[i], NULL);
+			ast_str_truncate(*out, ast_str_strlen(*out) - 2);
+			if(j < ITEMS_OF(bounds))
+				ast_str_append(out, 0, ",le=\"%u\"} %llu\n", bounds[j], (unsigned long long int)total);
+			else
+				ast_str_append(out, 0, ",le=\"+Inf\"} %llu\n", (unsigned long long int)total);
+		}
+		metrics_sample(out, "dongle_at_latency_milliseconds_sum", &devs[i], NULL);
+		ast_str_append(out, 0, "%llu\n", (unsigned long long int)PVT_STAT_T(&devs[i].stat, at_latency_sum));
+		metrics_sample(out, "dongle_at_latency_milliseconds_count", &devs[i], NULL);
+		ast_str_append(out, 0, "%llu\n", (unsigned long long int)total);
+	}
+
+	/* SMS spool is not per device */
+	if(smsq_enabled())
+	{
+		smsq_stat_read(&spool);
+		metrics_family(out, "dongle_sms_spool_pending", "gauge", "SMS in spool waiting for device");
+		ast_str_append(out, 0, "dongle_sms_spool_pending %u\n", spool.pending);
+		metrics_family(out, "dongle_sms_spool_inflight", "gauge", "SMS from spool in AT queue of devices");
+		ast_str_append(out, 0, "dongle_sms_spool_inflight %u\n", spool.inflight);
+		metrics_family(out, "dongle_sms_spool_retries_total", "counter", "Failed SMS attempts scheduled again");
+		ast_str_append(out, 0, "dongle_sms_spool_retries_total %llu\n", (unsigned long long int)spool.retries);
+		metrics_family(out, "dongle_sms_spool_journal_bytes", "gauge", "Size of SMS spool journal");
+		ast_str_append(out, 0, "dongle_sms_spool_journal_bytes %llu\n", (unsigned long long int)spool.journal_size);
+	}
+
+	/* dispatch pool of dispatch=manager is not per device */
+	dispatch_stat_read(&pool);
+	metrics_family(out, "dongle_dispatch_jobs_total", "counter", "Received SMS and USSD events passed to dispatch pool");
+	ast_str_append(out, 0, "dongle_dispatch_jobs_total %lu\n", pool.pushed);
+	metrics_family(out, "dongle_dispatch_overflows_total", "counter", "Events sent from device thread because dispatch queue full");
+	ast_str_append(out, 0, "dongle_dispatch_overflows_total %lu\n", pool.overflows);
+	metrics_family(out, "dongle_dispatch_queue_depth", "gauge", "Events waiting in dispatch queue");
+	ast_str_append(out, 0, "dongle_dispatch_queue_depth %u\n", pool.depth);
+	metrics_family(out, "dongle_dispatch_queue_high_water", "gauge", "Maximum of events waiting in dispatch queue since load");
+	ast_str_append(out, 0, "dongle_dispatch_queue_high_water %u\n", pool.high_water);
+}
+
+#/* */
+static int metrics_http_callback(struct ast_tcptls_session_instance * ser, attribute_unused const struct ast_http_uri * urih,
+	attribute_unused const char * uri, enum ast_http_method method, attribute_unused struct ast_variable * get_params, attribute_unused struct ast_variable * headers)
+{
+	struct metrics_device * devs;
+	struct pvt * pvt;
+	struct ast_str * out;
+	struct ast_str * http_header;
+	unsigned count = 0;
+	unsigned allocated;
+
+	if(method != AST_HTTP_GET && method != AST_HTTP_HEAD)
+	{
+		ast_http_error(ser, 405, "Method Not Allowed", "Only GET and HEAD supported");
+		return -1;
+	}
+
+	/* copy snapshots and counters, list read lock hold while copy, counters under device lock */
+	AST_RWLIST_RDLOCK(&gpublic->devices);
+	allocated = 0;
+	AST_RWLIST_TRAVERSE(&gpublic->devices, pvt, entry)
+		allocated++;
+	devs = ast_calloc(allocated ? allocated : 1, sizeof(*devs));
+	if(devs)
+	{
+		AST_RWLIST_TRAVERSE(&gpublic->devices, pvt, entry)
+		{
+			if(count >= allocated)
+				break;
+			pvt_status_read(pvt, &devs[count].status);
+			pvt_stat_read(pvt, &devs[count].stat);
+			count++;
+		}
+	}
+	AST_RWLIST_UNLOCK(&gpublic->devices);
+
+	out = ast_str_create(1024 + count * 8192);
+	http_header = ast_str_create(64);
+	if(!devs || !out || !http_header)
+	{
+		ast_free(devs);
+		ast_free(out);
+		ast_free(http_header);
+		ast_http_error(ser, 500, "Server Error", "Out of memory");
+		return -1;
+	}
+
+	metrics_render(&out, devs, count);
+	ast_free(devs);
+
+	ast_str_set(&http_header, 0, "Content-Type: text/plain; version=0.0.4\r\n");
+	ast_http_send(ser, method, 200, NULL, http_header, out, 0, 0);
+	return 0;
+}
+
+static struct ast_http_uri metrics_uri = {
+	.callback	= metrics_http_callback,
+	.description	= "Dongle devices metrics",
+	.uri		= "dongle/metrics",
+	.has_subtree	= 0,
+	.data		= NULL,
+	.key		= __FILE__,
+};
+
+#/* */
+EXPORT_DEF void metrics_register()
+{
+	ast_http_uri_link(&metrics_uri);
+}
+
+#/* */
+EXPORT_DEF void metrics_unregister()
+{
+	ast_http_uri_unlink(&metrics_uri);
+}
+
+#else /* ASTERISK_VERSION_NUM >= 10800 */
+
+#/* */
+EXPORT_DEF void metrics_register()
+{
+	ast_log (LOG_NOTICE, "Metrics endpoint require asterisk 1.8 or later, disabled\n");
+}
+
+#/* */
+EXPORT_DEF void metrics_unregister()
+{
+}
+
+#endif /* ASTERISK_VERSION_NUM >= 10800 */
+
+#endif /* BUILD_METRICS */
@@ -0,0 +1,22 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifndef CHAN_DONGLE_METRICS_H_INCLUDED
+#define CHAN_DONGLE_METRICS_H_INCLUDED
+
+#ifdef BUILD_METRICS
+
+#include "export.h"			/* EXPORT_DECL EXPORT_DEF */
+
+/* Prometheus text exposition of devices state and statistics on asterisk HTTP server at <prefix>/dongle/metrics */
+EXPORT_DECL void metrics_register();
+EXPORT_DECL void metrics_unregister();
+
+#else  /* BUILD_METRICS */
+
+#define metrics_register()
+#define metrics_unregister()
+
+#endif /* BUILD_METRICS */
+
+#endif /* CHAN_DONGLE_METRICS_H_INCLUDED */
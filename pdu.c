@@ -6,10 +6,11 @@
 #endif /* HAVE_CONFIG_H */
 
 #include <errno.h>			/* EINVAL ENOMEM E2BIG */
+#include <stdio.h>			/* NULL snprintf() */
+#include <string.h>			/* strlen() */
 
 #include "pdu.h"
-#include "helpers.h"			/* dial_digit_code() */
-#include "char_conv.h"			/* utf8_to_hexstr_ucs2() */
+#include "char_conv.h"			/* str_recode() gsm7_encode_hex() gsm7_char_septets() */
 
 /* SMS-SUBMIT format
 	SCA		1..12 octet(s)		Service Center Address information element
@@ -230,6 +231,10 @@
 #define PDU_PID_SMS				0x00		/* bit5 No interworking, but SME-to-SME protocol = SMS */
 #define PDU_PID_EMAIL				0x32		/* bit5 Telematic interworking, bits 4..0 0x 12  = email */
 
+/* UDH Information Element Identifiers */
+#define PDU_IEI_CONCAT8				0x00		/* Concatenated short messages, 8 bit reference number */
+#define PDU_IEI_CONCAT16			0x08		/* Concatenated short messages, 16 bit reference number */
+
 /* DCS */
 /*   bits 1..0 Class */
 #define PDU_DCS_CLASS_SHIFT			0
@@ -520,20 +525,104 @@ static int check_encoding(const char* msg, unsigned length)
 	return PDU_DCS_ALPABET_UCS2;
 }
 
+/* bytes of UTF-8 sequence by high nibble of first byte, stray continuation bytes counted alone */
+static const unsigned char pdu_utf8_length[16] = {
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 3, 4,
+};
+
+#/* return septets or UCS-2 units of character, set bytes of character */
+static unsigned pdu_char_units(const char * msg, size_t left, int dcs, unsigned * bytes)
+{
+	unsigned char c = msg[0];
+
+	/* 2 septets for escaped characters of extension table */
+	if(dcs == PDU_DCS_ALPABET_7BIT)
+		return gsm7_char_septets(msg, left, bytes);
+
+	*bytes = pdu_utf8_length[c >> 4];
+	if(*bytes > left)
+		*bytes = left;
+
+	/* character out of BMP is surrogate pair */
+	return *bytes == 4 ? 2 : 1;
+}
+
 /*!
- * \brief Build PDU text for SMS
- * \param buffer -- pointer to place where PDU will be stored
- * \param length -- length of buffer
- * \param sca -- number of SMS center may be with leading '+' in International format
- * \param dst -- destination number for SMS may be with leading '+' in International format
+ * \brief Split message to parts of concatenated SMS
  * \param msg -- SMS message in utf-8
- * \param valid_minutes -- Validity period
- * \param srr -- Status Report Request
- * \param sca_len -- pointer where length of SCA header (in bytes) will be stored
- * \return number of bytes written to buffer w/o trailing 0x1A or 0, -ENOMEM if buffer too short, -EINVAL on iconv recode errors, -E2BIG if message too long
+ * \param ref16 -- use 16 bit reference number in UDH of parts
+ * \param parts -- place for encoding and byte offsets of parts in msg
+ * \return number of parts, -E2BIG if message require more than PDU_MAX_PARTS parts
  */
 #/* */
-EXPORT_DEF int pdu_build(char* buffer, size_t length, const char* sca, const char* dst, const char* msg, unsigned valid_minutes, int srr)
+EXPORT_DEF int pdu_split(const char * msg, int ref16, pdu_parts_t * parts)
+{
+	size_t msg_len = strlen(msg);
+	size_t pos;
+	unsigned total = 0;
+	unsigned used = 0;
+	unsigned capacity;
+	unsigned units;
+	unsigned bytes;
+
+	/* detect msg encoding and use 7Bit or UCS-2, not use 8Bit */
+	parts->dcs = check_encoding(msg, msg_len);
+	parts->ref16 = ref16 ? 1 : 0;
+	parts->count = 1;
+	parts->offset[0] = 0;
+	parts->offset[1] = msg_len;
+
+	for(pos = 0; pos < msg_len; pos += bytes)
+		total += pdu_char_units(msg + pos, msg_len - pos, parts->dcs, &bytes);
+
+	/* cannot exceed 140 octets for not compressed or cannot exceed 160 septets for compressed */
+	if(parts->dcs == PDU_DCS_ALPABET_UCS2)
+	{
+		if(total <= PDU_UCS2_SINGLE)
+			return 1;
+		capacity = ref16 ? PDU_UCS2_PART16 : PDU_UCS2_PART;
+	}
+	else
+	{
+		if(total <= PDU_7BIT_SINGLE)
+			return 1;
+		capacity = ref16 ? PDU_7BIT_PART16 : PDU_7BIT_PART;
+	}
+
+	/* escapes and surrogate pairs never splitted */
+	parts->count = 0;
+	for(pos = 0; pos < msg_len; pos += bytes)
+	{
+		units = pdu_char_units(msg + pos, msg_len - pos, parts->dcs, &bytes);
+		if(used + units > capacity)
+		{
+			if(++parts->count >= PDU_MAX_PARTS)
+				return -E2BIG;
+			parts->offset[parts->count] = pos;
+			used = 0;
+		}
+		used += units;
+	}
+	parts->offset[++parts->count] = msg_len;
+
+	return parts->count;
+}
+
+#/* write octets as hex digits without terminating zero */
+static void pdu_store_octets(char * buffer, const unsigned char * octets, unsigned count)
+{
+	static const char digits[] = "0123456789ABCDEF";
+	unsigned i;
+
+	for(i = 0; i < count; ++i)
+	{
+		*buffer++ = digits[octets[i] >> 4];
+		*buffer++ = digits[octets[i] & 0x0F];
+	}
+}
+
+#/* build SMS-SUBMIT with optional UDH before msg_len bytes of msg */
+static int pdu_build_submit(char * buffer, size_t length, const char * sca, const char * dst, int dcs, const unsigned char * udh, unsigned udh_len, const char * msg, unsigned msg_len, unsigned valid_minutes, int srr)
 {
 	char tmp;
 	int len = 0;
@@ -542,23 +631,12 @@ EXPORT_DEF int pdu_build(char* buffer, size_t length, const char* sca, const cha
 	int sca_toa = NUMBER_TYPE_INTERNATIONAL;
 	int dst_toa = NUMBER_TYPE_INTERNATIONAL;
 	int pdutype = PDUTYPE_MTI_SMS_SUBMIT | PDUTYPE_RD_ACCEPT | PDUTYPE_VPF_RELATIVE | PDUTYPE_SRR_NOT_REQUESTED | PDUTYPE_UDHI_NO_HEADER | PDUTYPE_RP_IS_NOT_SET;
-	int dcs;
 
 	unsigned dst_len;
 	unsigned sca_len;
-	unsigned msg_len;
-
-	/* detect msg encoding and use 7Bit or UCS-2, not use 8Bit */
-	msg_len = strlen(msg);
-	dcs = check_encoding(msg, msg_len);
+	unsigned udl;
+	unsigned udh_septets;
 
-	/* cannot exceed 140 octets for not compressed or cannot exceed 160 septets for compressed */
-/*
-	if(((PDU_DCS_ALPABET(dcs) == PDU_DCS_ALPABET_UCS2) && msg_len > 70) || (PDU_DCS_ALPABET(dcs) == PDU_DCS_ALPABET_8BIT && msg_len > 140) || msg_len > 160)
-	{
-		return -E2BIG;
-	}
-*/
 	if(sca[0] == '+')
 		sca++;
 
@@ -570,7 +648,7 @@ EXPORT_DEF int pdu_build(char* buffer, size_t length, const char* sca, const cha
 	dst_len = strlen(dst);
 
 	/* check buffer has enougth space */
-	if(length < ((sca_len == 0 ? 2 : 4 + ROUND_UP2(sca_len)) + 8 + ROUND_UP2(dst_len) + 8 + msg_len * 4 + 4))
+	if(length < ((sca_len == 0 ? 2 : 4 + ROUND_UP2(sca_len)) + 8 + ROUND_UP2(dst_len) + 8 + udh_len * 2 + msg_len * 4 + 4))
 		return -ENOMEM;
 
 	/* SCA Length */
@@ -590,6 +668,8 @@ EXPORT_DEF int pdu_build(char* buffer, size_t length, const char* sca, const cha
 
 	if(srr)
 		pdutype |= PDUTYPE_SRR_REQUESTED;
+	if(udh_len)
+		pdutype |= PDUTYPE_UDHI_HAS_HEADER;
 
 	/* PDU-type */
 	/* TP-Message-Reference. The "00" value here lets the phone set the message reference number itself */
@@ -600,27 +680,41 @@ EXPORT_DEF int pdu_build(char* buffer, size_t length, const char* sca, const cha
 	/*  Destination address */
 	len += pdu_store_number(buffer + len, dst, dst_len);
 
-	/* forward TP-User-Data */
-	data_len = str_recode(RECODE_ENCODE, dcs == PDU_DCS_ALPABET_UCS2 ? STR_ENCODING_UCS2_HEX : STR_ENCODING_7BIT_HEX, msg, msg_len, buffer + len + 8, length - len - 11);
-	if(data_len < 0)
+	/* forward TP-User-Data, UDH first */
+	if(dcs == PDU_DCS_ALPABET_UCS2)
 	{
-		return -EINVAL;
+		pdu_store_octets(buffer + len + 8, udh, udh_len);
+		data_len = str_recode(RECODE_ENCODE, STR_ENCODING_UCS2_HEX, msg, msg_len, buffer + len + 8 + udh_len * 2, length - len - 11 - udh_len * 2);
+		if(data_len < 0)
+			return -EINVAL;
+
+		/* UDL in octets */
+		udl = udh_len + data_len / 2;
+		data_len += udh_len * 2;
+	}
+	else
+	{
+		/* UDH padded to septet boundary: pack zero septets in place of UDH and overwrite them */
+		udh_septets = (udh_len * 8 + 6) / 7;
+		data_len = gsm7_encode_hex(msg, msg_len, udh_septets, buffer + len + 8, length - len - 11, &udl);
+		if(data_len < 0)
+			return -EINVAL;
+		/* UDL in septets with escapes */
+		if(udl > PDU_7BIT_SINGLE)
+			return -E2BIG;
+		pdu_store_octets(buffer + len + 8, udh, udh_len);
 	}
-	else if(data_len > 160 * 2)
+	if(data_len > 160 * 2)
 	{
 		return -E2BIG;
 	}
 
-	/* calc UDL */
-	if(dcs == PDU_DCS_ALPABET_UCS2)
-		msg_len = data_len / 2;
-
 	/* TP-PID. Protocol identifier  */
 	/* TP-DCS. Data coding scheme */
 	/* TP-Validity-Period */
 	/* TP-User-Data-Length */
 	tmp = buffer[len + 8];
-	len += snprintf(buffer + len, length - len, "%02X%02X%02X%02X", PDU_PID_SMS, dcs, pdu_relative_validity(valid_minutes), msg_len);
+	len += snprintf(buffer + len, length - len, "%02X%02X%02X%02X", PDU_PID_SMS, dcs, pdu_relative_validity(valid_minutes), udl);
 	buffer[len] = tmp;
 
 	len += data_len;
@@ -634,6 +728,77 @@ EXPORT_DEF int pdu_build(char* buffer, size_t length, const char* sca, const cha
 	return len;
 }
 
+/*!
+ * \brief Build PDU text for part of SMS splitted by pdu_split()
+ * \param buffer -- pointer to place where PDU will be stored
+ * \param length -- length of buffer
+ * \param sca -- number of SMS center may be with leading '+' in International format
+ * \param dst -- destination number for SMS may be with leading '+' in International format
+ * \param msg -- SMS message in utf-8 same as passed to pdu_split()
+ * \param valid_minutes -- Validity period
+ * \param srr -- Status Report Request
+ * \param parts -- result of pdu_split()
+ * \param part -- part number from 0
+ * \param ref -- reference number of concatenated SMS, same for all parts
+ * \return number of bytes written to buffer w/o trailing 0x1A or 0, -ENOMEM if buffer too short, -EINVAL on recode errors, -E2BIG if part too long
+ */
+#/* */
+EXPORT_DEF int pdu_build_part(char * buffer, size_t length, const char * sca, const char * dst, const char * msg, unsigned valid_minutes, int srr, const pdu_parts_t * parts, unsigned part, unsigned ref)
+{
+	unsigned char udh[7];
+	unsigned udh_len = 0;
+
+	if(part >= parts->count)
+		return -EINVAL;
+
+	/* UDHL, IEI of concatenated SMS, IEDL, reference, total parts, part sequence from 1 */
+	if(parts->count > 1)
+	{
+		if(parts->ref16)
+		{
+			udh[udh_len++] = 6;
+			udh[udh_len++] = PDU_IEI_CONCAT16;
+			udh[udh_len++] = 4;
+			udh[udh_len++] = (ref >> 8) & 0xFF;
+		}
+		else
+		{
+			udh[udh_len++] = 5;
+			udh[udh_len++] = PDU_IEI_CONCAT8;
+			udh[udh_len++] = 3;
+		}
+		udh[udh_len++] = ref & 0xFF;
+		udh[udh_len++] = parts->count;
+		udh[udh_len++] = part + 1;
+	}
+
+	return pdu_build_submit(buffer, length, sca, dst, parts->dcs, udh, udh_len, msg + parts->offset[part], parts->offset[part + 1] - parts->offset[part], valid_minutes, srr);
+}
+
+/*!
+ * \brief Build PDU text for SMS
+ * \param buffer -- pointer to place where PDU will be stored
+ * \param length -- length of buffer
+ * \param sca -- number of SMS center may be with leading '+' in International format
+ * \param dst -- destination number for SMS may be with leading '+' in International format
+ * \param msg -- SMS message in utf-8
+ * \param valid_minutes -- Validity period
+ * \param srr -- Status Report Request
+ * \return number of bytes written to buffer w/o trailing 0x1A or 0, -ENOMEM if buffer too short, -EINVAL on recode errors, -E2BIG if message not fit to single SMS
+ */
+#/* */
+EXPORT_DEF int pdu_build(char* buffer, size_t length, const char* sca, const char* dst, const char* msg, unsigned valid_minutes, int srr)
+{
+	pdu_parts_t parts;
+	int res = pdu_split(msg, 0, &parts);
+
+	if(res < 0)
+		return res;
+	if(res > 1)
+		return -E2BIG;
+	return pdu_build_part(buffer, length, sca, dst, msg, valid_minutes, srr, &parts, 0, 0);
+}
+
 
 #/* */
 static str_encoding_t pdu_dcs_alpabet2encoding(int alpabet)
@@ -657,18 +822,61 @@ static str_encoding_t pdu_dcs_alpabet2encoding(int alpabet)
 	return rv;
 }
 
+#/* find concatenation IE in UDH of udhl octets, UDH not consumed */
+static const char * pdu_parse_udh(const char * pdu, size_t length, unsigned udhl, pdu_udh_t * udh)
+{
+	unsigned char ie[256];
+	char * ptr = (char *) pdu;
+	unsigned pos;
+	unsigned iedl;
+	int octet;
+
+	for(pos = 0; pos < udhl; ++pos)
+	{
+		octet = pdu_parse_byte(&ptr, &length);
+		if(octet < 0)
+			return "Can't parse UDH";
+		ie[pos] = octet;
+	}
+
+	/* IEI, IEDL, IED; last concatenation IE win */
+	for(pos = 0; pos + 2 <= udhl; pos += 2 + iedl)
+	{
+		iedl = ie[pos + 1];
+		if(pos + 2 + iedl > udhl)
+			return "Invalid IE in UDH";
+		if(ie[pos] == PDU_IEI_CONCAT8 && iedl == 3)
+		{
+			udh->ref = ie[pos + 2];
+			udh->total = ie[pos + 3];
+			udh->seq = ie[pos + 4];
+		}
+		else if(ie[pos] == PDU_IEI_CONCAT16 && iedl == 4)
+		{
+			udh->ref = (ie[pos + 2] << 8) | ie[pos + 3];
+			udh->total = ie[pos + 4];
+			udh->seq = ie[pos + 5];
+		}
+	}
+
+	return NULL;
+}
+
 /*!
  * \brief Parse PDU
  * \param pdu -- SCA + TPDU
  * \param tpdu_length -- length of TPDU in octets
+ * \param udh -- place for concatenation info from UDH
  * \return 0 on success
  */
 /* TODO: split long function */
-EXPORT_DEF const char * pdu_parse(char ** pdu, size_t tpdu_length, char * oa, size_t oa_len, str_encoding_t * oa_enc, char ** msg, str_encoding_t * msg_enc)
+EXPORT_DEF const char * pdu_parse(char ** pdu, size_t tpdu_length, char * oa, size_t oa_len, str_encoding_t * oa_enc, char ** msg, str_encoding_t * msg_enc, pdu_udh_t * udh)
 {
 	const char * err = NULL;
 	size_t pdu_length = strlen(*pdu);
 
+	memset(udh, 0, sizeof(*udh));
+
 	/* decode SCA */
 	int field_len = pdu_parse_sca(pdu, &pdu_length);
 	if(field_len > 0)
@@ -721,21 +929,33 @@ EXPORT_DEF const char * pdu_parse(char ** pdu, size_t tpdu_length, char * oa, si
 									{
 										/* calculate number of octets in UD */
 										if(PDU_DCS_ALPABET(dcs) == PDU_DCS_ALPABET_7BIT)
+										{
+											udh->septets = udl;
 											udl = ((udl + 1) * 7) >> 3;
+										}
 										if((size_t)udl * 2 == pdu_length)
 										{
 											if(PDUTYPE_UDHI(pdu_type) == PDUTYPE_UDHI_HAS_HEADER)
 											{
-												/* TODO: implement header parse */
 												int udhl = pdu_parse_byte(pdu, &pdu_length);
 												if(udhl >= 0)
 												{
 													/* NOTE: UDHL count octets no need calculation */
 													if(pdu_length >= (size_t)(udhl * 2))
 													{
-														/* skip UDH */
-														*pdu += udhl * 2;
-														pdu_length -= udhl * 2;
+														err = pdu_parse_udh(*pdu, pdu_length, udhl, udh);
+														if(PDU_DCS_ALPABET(dcs) == PDU_DCS_ALPABET_7BIT)
+														{
+															/* text aligned to septet after UDH, decode from UDHL and skip septets of UDH */
+															*pdu -= 2;
+															udh->skip = ((udhl + 1) * 8 + 6) / 7;
+														}
+														else
+														{
+															/* skip UDH */
+															*pdu += udhl * 2;
+															pdu_length -= udhl * 2;
+														}
 													}
 													else
 													{
@@ -8,9 +8,38 @@
 #include "export.h"			/* EXPORT_DECL EXPORT_DEF */
 #include "char_conv.h"			/* str_encoding_t */
 
+#define PDU_MAX_PARTS		32		/* limit of parts in concatenated SMS */
+
+/* septets or UCS-2 characters of single SMS and of part with 8 bit or 16 bit reference in UDH */
+#define PDU_7BIT_SINGLE		160
+#define PDU_7BIT_PART		153
+#define PDU_7BIT_PART16		152
+#define PDU_UCS2_SINGLE		70
+#define PDU_UCS2_PART		67
+#define PDU_UCS2_PART16		66
+
+typedef struct pdu_parts
+{
+	int		dcs;				/*!< alphabet of all parts */
+	unsigned	count;				/*!< number of parts, 1 when message fit to single SMS without UDH */
+	unsigned	ref16:1;			/*!< 16 bit reference number in UDH */
+	unsigned	offset[PDU_MAX_PARTS + 1];	/*!< byte offset of each part in message and message length */
+} pdu_parts_t;
+
+typedef struct pdu_udh
+{
+	unsigned	ref;				/*!< reference number of concatenated SMS */
+	unsigned	total;				/*!< number of parts, 0 if message is not part of concatenated SMS */
+	unsigned	seq;				/*!< part number from 1 */
+	unsigned	skip;				/*!< septets of UDH to drop on decoding of 7-bit message */
+	unsigned	septets;			/*!< septets of 7-bit UD with UDH, 0 for other alphabets */
+} pdu_udh_t;
+
 EXPORT_DECL char pdu_digit2code(char digit);
+EXPORT_DECL int pdu_split(const char * msg, int ref16, pdu_parts_t * parts);
+EXPORT_DECL int pdu_build_part(char * buffer, size_t length, const char * sca, const char * dst, const char * msg, unsigned valid_minutes, int srr, const pdu_parts_t * parts, unsigned part, unsigned ref);
 EXPORT_DECL int pdu_build(char * buffer, size_t length, const char * csca, const char * dst, const char * msg, unsigned valid_minutes, int srr);
-EXPORT_DECL const char * pdu_parse(char ** pdu, size_t tpdu_length, char * oa, size_t oa_len, str_encoding_t * oa_enc, char ** msg, str_encoding_t * msg_enc);
+EXPORT_DECL const char * pdu_parse(char ** pdu, size_t tpdu_length, char * oa, size_t oa_len, str_encoding_t * oa_enc, char ** msg, str_encoding_t * msg_enc, pdu_udh_t * udh);
 EXPORT_DECL int pdu_parse_sca(char ** pdu, size_t * length);
 
 #endif /* CHAN_DONGLE_PDU_H_INCLUDED */
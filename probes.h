@@ -0,0 +1,57 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifndef CHAN_DONGLE_PROBES_H_INCLUDED
+#define CHAN_DONGLE_PROBES_H_INCLUDED
+
+/*
+   Static tracepoints of provider "dongle" for perf, bpftrace, SystemTap and LTTng UST
+   (via sdt.h compatibility), see tools/dongle_latency.bt and tools/dongle_probes.sh
+   When disabled all macros expand to nothing and probe arguments are not evaluated,
+   when enabled each probe is a nop instruction until a tracer attached.
+
+   Probe			Arguments
+   channel_read		device, call idx, fd, bytes, lock wait us
+   channel_write		device, call idx, fd, bytes, lock wait us
+   timing_write		device, mix buffer used bytes, frame kind (0 full, 1 truncated, 2 silence)
+   at_command		device, command, expected response, length
+   at_response		device, response, command, handle us
+   state_change		device, call idx, old state, new state, cause
+*/
+
+#ifdef BUILD_PROBES
+
+#include <time.h>			/* clock_gettime() */
+#include <sys/sdt.h>			/* DTRACE_PROBEn() */
+
+#include "export.h"			/* INLINE_DECL */
+
+INLINE_DECL long probe_usec()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000L + ts.tv_nsec / 1000;
+}
+
+#define PROBE_TIMER(var)			long var
+#define PROBE_START(var)			var = probe_usec()
+#define PROBE_STOP(var)				var = probe_usec() - var
+
+#define PROBE3(name, a1, a2, a3)		DTRACE_PROBE3(dongle, name, a1, a2, a3)
+#define PROBE4(name, a1, a2, a3, a4)		DTRACE_PROBE4(dongle, name, a1, a2, a3, a4)
+#define PROBE5(name, a1, a2, a3, a4, a5)	DTRACE_PROBE5(dongle, name, a1, a2, a3, a4, a5)
+
+#else /* BUILD_PROBES */
+
+#define PROBE_TIMER(var)
+#define PROBE_START(var)
+#define PROBE_STOP(var)
+
+#define PROBE3(name, a1, a2, a3)
+#define PROBE4(name, a1, a2, a3, a4)
+#define PROBE5(name, a1, a2, a3, a4, a5)
+
+#endif /* BUILD_PROBES */
+
+#endif /* CHAN_DONGLE_PROBES_H_INCLUDED */
@@ -0,0 +1,107 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>			/* malloc() free() */
+#include <string.h>			/* memcpy() memset() */
+
+#include "scratch.h"
+
+struct scratch_heap
+{
+	struct scratch_heap	* next;
+	size_t			size;
+	char			data[1];
+};
+
+#/* */
+EXPORT_DEF void scratch_init(struct scratch * sc, void * buf, size_t size)
+{
+	memset(sc, 0, sizeof(*sc));
+	sc->buf = buf;
+	sc->size = size;
+}
+
+#/* */
+EXPORT_DEF void * scratch_alloc(struct scratch * sc, size_t size)
+{
+	struct scratch_heap * block;
+	void * ptr;
+
+	if(size <= sc->size - sc->used)
+	{
+		ptr = sc->buf + sc->used;
+		sc->used += size;
+		return ptr;
+	}
+
+	sc->stat.heap_allocs++;
+	block = size < (size_t)-1 - sizeof(*block) ? malloc(sizeof(*block) + size) : NULL;
+	if(!block)
+	{
+		sc->stat.failures++;
+		return NULL;
+	}
+	block->next = sc->heap_list;
+	block->size = size;
+	sc->heap_list = block;
+	sc->heap += size;
+	return block->data;
+}
+
+#/* */
+EXPORT_DEF char * scratch_strndup(struct scratch * sc, const char * str, size_t length)
+{
+	char * copy = scratch_alloc(sc, length + 1);
+
+	if(copy)
+	{
+		memcpy(copy, str, length);
+		copy[length] = 0;
+	}
+	return copy;
+}
+
+#/* */
+EXPORT_DEF void scratch_reset(struct scratch * sc)
+{
+	struct scratch_heap * block;
+
+	if(sc->used > sc->stat.high_water)
+		sc->stat.high_water = sc->used;
+	if(sc->heap > sc->stat.heap_high_water)
+		sc->stat.heap_high_water = sc->heap;
+
+	while(sc->heap_list)
+	{
+		block = sc->heap_list;
+		sc->heap_list = block->next;
+		free(block);
+	}
+	sc->used = 0;
+	sc->heap = 0;
+}
+
+#/* */
+EXPORT_DEF void scratch_stack_base(struct scratch * sc, const void * base)
+{
+	sc->stack_base = base;
+}
+
+#/* */
+EXPORT_DEF void scratch_stack_mark(struct scratch * sc, const void * mark)
+{
+	const char * ptr = mark;
+	size_t depth;
+
+	if(!sc->stack_base)
+		return;
+
+	/* stack may grow to lower or higher addresses */
+	depth = ptr < sc->stack_base ? (size_t)(sc->stack_base - ptr) : (size_t)(ptr - sc->stack_base);
+	if(depth > sc->stat.stack_high_water)
+		sc->stat.stack_high_water = depth;
+}
@@ -0,0 +1,61 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifndef CHAN_DONGLE_SCRATCH_H_INCLUDED
+#define CHAN_DONGLE_SCRATCH_H_INCLUDED
+
+#include <sys/types.h>			/* size_t */
+
+#include "export.h"			/* EXPORT_DECL EXPORT_DEF */
+
+/*
+   Scratch memory of one received message.
+   Buffers of all stages taken in order from arena by moving offset and
+   released at once by scratch_reset() after message delivered. Request not
+   fit to arena served by heap and freed by scratch_reset() too, so memory
+   of stage never copied or reallocated. High water of arena, heap and stack
+   depth of receiving thread kept for sizing.
+   Caller must serialize calls, chan_dongle hold lock of device.
+*/
+
+struct scratch_heap;
+
+struct scratch_stat
+{
+	size_t			high_water;			/*!< maximum of arena bytes per message */
+	size_t			heap_high_water;		/*!< maximum of heap bytes per message */
+	size_t			stack_high_water;		/*!< maximum of stack depth at marks */
+	unsigned long		heap_allocs;			/*!< requests not fit to arena */
+	unsigned long		failures;			/*!< requests failed by heap */
+};
+
+typedef struct scratch
+{
+	char			* buf;				/*!< arena */
+	size_t			size;				/*!< bytes of arena */
+	size_t			used;				/*!< bytes taken from arena */
+	size_t			heap;				/*!< bytes taken from heap */
+	struct scratch_heap	* heap_list;			/*!< heap blocks, last first */
+	const char		* stack_base;			/*!< address in bottom frame of thread, NULL if unknown */
+	struct scratch_stat	stat;
+} scratch_t;
+
+/* use size bytes of buf as arena */
+EXPORT_DECL void scratch_init(struct scratch * sc, void * buf, size_t size);
+
+/* return buffer of size bytes for text, not aligned, NULL if no memory */
+EXPORT_DECL void * scratch_alloc(struct scratch * sc, size_t size);
+
+/* copy length bytes and add 0 terminator */
+EXPORT_DECL char * scratch_strndup(struct scratch * sc, const char * str, size_t length);
+
+/* release all buffers and update high water */
+EXPORT_DECL void scratch_reset(struct scratch * sc);
+
+/* set address of variable in bottom frame of thread for stack depth */
+EXPORT_DECL void scratch_stack_base(struct scratch * sc, const void * base);
+
+/* update stack high water by address of variable in current frame */
+EXPORT_DECL void scratch_stack_mark(struct scratch * sc, const void * mark);
+
+#endif /* CHAN_DONGLE_SCRATCH_H_INCLUDED */
@@ -0,0 +1,55 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifndef CHAN_DONGLE_SEQLOCK_H_INCLUDED
+#define CHAN_DONGLE_SEQLOCK_H_INCLUDED
+
+#include <sched.h>			/* sched_yield() */
+
+#include "export.h"			/* INLINE_DECL */
+
+/*
+   Sequence lock for data with one writer (serialized by other lock) and many readers.
+   Readers never block writer, copy protected data and retry if writer was active meanwhile:
+
+	do {
+		seq = seqlock_read_begin(&lock);
+		memcpy(&copy, &data, sizeof(copy));
+	} while(seqlock_read_retry(&lock, seq));
+*/
+
+typedef struct seqlock
+{
+	volatile unsigned	seq;				/*!< odd while writer active */
+} seqlock_t;
+
+INLINE_DECL void seqlock_write_begin(seqlock_t * lock)
+{
+	lock->seq++;
+	__sync_synchronize();
+}
+
+INLINE_DECL void seqlock_write_end(seqlock_t * lock)
+{
+	__sync_synchronize();
+	lock->seq++;
+}
+
+INLINE_DECL unsigned seqlock_read_begin(const seqlock_t * lock)
+{
+	unsigned seq;
+
+	while((seq = lock->seq) & 1)
+		sched_yield();
+	__sync_synchronize();
+	return seq;
+}
+
+/* return non-zero if data readed after seqlock_read_begin() may be inconsistent */
+INLINE_DECL int seqlock_read_retry(const seqlock_t * lock, unsigned seq)
+{
+	__sync_synchronize();
+	return lock->seq != seq;
+}
+
+#endif /* CHAN_DONGLE_SEQLOCK_H_INCLUDED */
@@ -5,6 +5,7 @@
 
 #include "app.c"
 #include "at_command.c"
+#include "at_frame.c"
 #include "at_parse.c"
 #include "at_queue.c"
 #include "at_read.c"
@@ -17,8 +18,20 @@
 #include "helpers.c"
 #include "manager.c"
 #include "memmem.c"
+#include "metrics.c"
 #include "ringbuffer.c"
 #include "dc_config.c"
 #include "pdu.c"
 #include "mixbuffer.c"
 #include "pdiscovery.c"
+#include "audiotap.c"
+#include "devsel.c"
+#include "trace.c"
+#include "atrec.c"
+#include "smsq.c"
+#include "concat.c"
+#include "dispatch.c"
+#include "scratch.c"
+#include "ussd.c"
+#include "ussdq.c"
+#include "status.c"
@@ -0,0 +1,872 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdio.h>				/* rename() snprintf() */
+#include <stdlib.h>				/* qsort() */
+#include <string.h>				/* memcpy() memset() strlen() */
+#include <stddef.h>				/* offsetof() */
+#include <errno.h>				/* errno */
+#include <fcntl.h>				/* open() O_RDWR O_CREAT O_APPEND */
+#include <unistd.h>				/* read() write() fdatasync() ftruncate() close() */
+#include <sys/stat.h>				/* fstat() */
+#include <sys/uio.h>				/* writev() */
+#include <pthread.h>				/* pthread_t pthread_join() */
+
+#include <asterisk.h>
+#include <asterisk/utils.h>			/* ast_malloc() ast_free() ast_pthread_create_background() */
+#include <asterisk/lock.h>			/* AST_MUTEX_DEFINE_STATIC ast_cond_t */
+#include <asterisk/linkedlists.h>		/* AST_LIST_HEAD_NOLOCK AST_LIST_INSERT_TAIL() ... */
+#include <asterisk/time.h>			/* ast_tvnow() ast_tvadd() ast_samp2tv() */
+
+#include "smsq.h"
+#include "chan_dongle.h"			/* gpublic struct pvt pvt_enabled() */
+#include "at_command.h"				/* at_enque_sms_ref() at_sms_ref_t */
+#include "manager.h"				/* manager_event_sent_notify() */
+#include "mutils.h"				/* ITEMS_OF() */
+
+struct smsq_queue;
+
+struct smsq_msg
+{
+	AST_LIST_ENTRY(smsq_msg) entry;
+	struct smsq_queue	* queue;			/*!< queue of target, live until spool freed */
+	uint64_t		id;
+	int64_t			created;
+	time_t			next_try;			/*!< not send before */
+	unsigned		validity;
+	unsigned		report:1;
+	unsigned		sent:1;				/*!< result of message in done list */
+	int			attempts;
+	at_sms_ref_t		ref;				/*!< reference and parts sent of concatenated SMS, retry resend only rest */
+	uint32_t		length;				/*!< bytes of payload */
+	const char		* number;
+	const char		* message;
+	char			target[1];			/*!< payload: target\0number\0message\0 */
+};
+
+AST_LIST_HEAD_NOLOCK(smsq_msgs, smsq_msg);
+
+struct smsq_queue
+{
+	AST_LIST_ENTRY(smsq_queue) entry;
+	struct smsq_msgs	msgs;
+	unsigned		count;
+	char			target[DEVNAMELEN];
+};
+
+static struct smsq
+{
+	AST_LIST_HEAD_NOLOCK(, smsq_queue) queues;		/*!< pending messages by target */
+	struct smsq_msgs	inflight;			/*!< messages given to devices */
+	struct smsq_msgs	done;				/*!< completed messages without DONE record */
+	ast_cond_t		cond;				/*!< wakeup of spool thread */
+	pthread_t		thread;
+	volatile int		running;
+	int			wakeup;
+	int			fd;				/*!< journal, -1 when spool disabled */
+	char			path[DEVPATHLEN];
+	int			retries;
+	uint64_t		next_id;
+	unsigned		dead;				/*!< records of completed messages in journal */
+	struct smsq_stat	stat;
+	time_t			sent_time[60];			/*!< second of sent_count by second % 60 */
+	unsigned		sent_count[60];
+} smsq = { .fd = -1, .thread = AST_PTHREADT_NULL };
+
+AST_MUTEX_DEFINE_STATIC(smsq_journal_lock);		/* journal file and next_id, taken before smsq_lock */
+AST_MUTEX_DEFINE_STATIC(smsq_lock);			/* queues, lists and counters, taken after pvt lock */
+
+#/* */
+static uint32_t smsq_crc32(uint32_t crc, const void * data, size_t length)
+{
+	const unsigned char * ptr = data;
+	int bit;
+
+	crc = ~crc;
+	while(length--)
+	{
+		crc ^= *ptr++;
+		for(bit = 0; bit < 8; ++bit)
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+#/* */
+static uint32_t smsq_record_crc(const struct smsq_record * rec, const void * payload)
+{
+	uint32_t crc = smsq_crc32(0, &rec->length, sizeof(*rec) - offsetof(struct smsq_record, length));
+	return smsq_crc32(crc, payload, rec->length);
+}
+
+#/* fill record of message */
+static void smsq_record_fill(struct smsq_record * rec, smsq_rec_t type, const struct smsq_msg * msg)
+{
+	memset(rec, 0, sizeof(*rec));
+	rec->magic = SMSQ_MAGIC;
+	rec->type = type;
+	rec->id = msg->id;
+	if(type == SMSQ_REC_ADD)
+	{
+		rec->length = msg->length;
+		rec->flags = msg->report;
+		rec->created = msg->created;
+		rec->validity = msg->validity;
+		rec->crc = smsq_record_crc(rec, msg->target);
+	}
+	else
+	{
+		rec->flags = msg->sent;
+		rec->crc = smsq_record_crc(rec, NULL);
+	}
+}
+
+#/* append record to journal, on error remove written part; return 0 or errno */
+static int smsq_journal_write(smsq_rec_t type, const struct smsq_msg * msg)
+{
+	struct smsq_record rec;
+	struct iovec iov[2];
+	ssize_t written;
+
+	smsq_record_fill(&rec, type, msg);
+	iov[0].iov_base = &rec;
+	iov[0].iov_len = sizeof(rec);
+	iov[1].iov_base = (void *)msg->target;
+	iov[1].iov_len = rec.length;
+
+	written = writev(smsq.fd, iov, rec.length ? 2 : 1);
+	if(written != (ssize_t)(sizeof(rec) + rec.length))
+	{
+		int err = written < 0 ? errno : ENOSPC;
+		if(ftruncate(smsq.fd, smsq.stat.journal_size))
+			ast_log (LOG_ERROR, "SMS spool journal %s may be corrupted: %s\n", smsq.path, strerror(errno));
+		return err;
+	}
+	smsq.stat.journal_size += written;
+	return 0;
+}
+
+#/* allocate message with payload */
+static struct smsq_msg * smsq_msg_alloc(const char * payload, uint32_t length)
+{
+	struct smsq_msg * msg = ast_malloc(sizeof(*msg) + length);
+	if(msg)
+	{
+		memset(msg, 0, sizeof(*msg));
+		memcpy(msg->target, payload, length);
+		msg->length = length;
+		msg->number = msg->target + strlen(msg->target) + 1;
+		msg->message = msg->number + strlen(msg->number) + 1;
+	}
+	return msg;
+}
+
+#/* smsq_lock must be held */
+static struct smsq_queue * smsq_queue_get(const char * target, int create)
+{
+	struct smsq_queue * queue;
+
+	AST_LIST_TRAVERSE(&smsq.queues, queue, entry)
+	{
+		if(strcmp(queue->target, target) == 0)
+			return queue;
+	}
+	if(create && (queue = ast_calloc(1, sizeof(*queue))))
+	{
+		ast_copy_string(queue->target, target, sizeof(queue->target));
+		AST_LIST_INSERT_TAIL(&smsq.queues, queue, entry);
+	}
+	return queue;
+}
+
+#/* smsq_lock must be held, return 0 or errno */
+static int smsq_queue_add(struct smsq_msg * msg)
+{
+	msg->queue = smsq_queue_get(msg->target, 1);
+	if(!msg->queue)
+		return ENOMEM;
+	AST_LIST_INSERT_TAIL(&msg->queue->msgs, msg, entry);
+	msg->queue->count++;
+	smsq.stat.pending++;
+	return 0;
+}
+
+#/* smsq_lock must be held, first message of queue allowed to send now */
+static struct smsq_msg * smsq_queue_due(struct smsq_queue * queue, time_t now)
+{
+	struct smsq_msg * msg;
+	int scan = SMSQ_SCAN_LIMIT;
+
+	if(queue)
+	{
+		AST_LIST_TRAVERSE(&queue->msgs, msg, entry)
+		{
+			if(msg->next_try <= now)
+				return msg;
+			if(--scan == 0)
+				break;
+		}
+	}
+	return NULL;
+}
+
+#/* */
+static void smsq_wakeup()
+{
+	smsq.wakeup = 1;
+	ast_cond_signal(&smsq.cond);
+}
+
+#/* */
+static int smsq_msg_cmp(const void * a, const void * b)
+{
+	const struct smsq_msg * ma = *(const struct smsq_msg * const *)a;
+	const struct smsq_msg * mb = *(const struct smsq_msg * const *)b;
+
+	return ma->id < mb->id ? -1 : ma->id > mb->id;
+}
+
+#/* return completed messages taken by failed rewrite before ones completed meanwhile */
+static void smsq_done_restore(struct smsq_msgs * done)
+{
+	struct smsq_msg * msg;
+
+	ast_mutex_lock(&smsq_lock);
+	while((msg = AST_LIST_REMOVE_HEAD(&smsq.done, entry)))
+		AST_LIST_INSERT_TAIL(done, msg, entry);
+	smsq.done = *done;
+	ast_mutex_unlock(&smsq_lock);
+}
+
+#/* replace journal by pending and inflight messages, smsq_journal_lock must be held; return 0 or errno */
+static int smsq_compact()
+{
+	struct smsq_queue * queue;
+	struct smsq_msg * msg;
+	struct smsq_msg ** msgs;
+	struct smsq_record rec;
+	char tmp[DEVPATHLEN + 8];
+	unsigned count = 0;
+	unsigned i;
+	uint64_t size = 0;
+	int fd;
+	int err = 0;
+	FILE * file;
+	struct smsq_msgs done;
+
+	snprintf(tmp, sizeof(tmp), "%s.tmp", smsq.path);
+	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if(fd < 0)
+		return errno;
+	file = fdopen(fd, "wb");
+	if(!file)
+	{
+		err = errno;
+		close(fd);
+		unlink(tmp);
+		return err;
+	}
+
+	/* messages not freed while smsq_lock held, DONE records of completed messages not needed in new journal */
+	ast_mutex_lock(&smsq_lock);
+	done = smsq.done;
+	AST_LIST_HEAD_INIT_NOLOCK(&smsq.done);
+	msgs = ast_malloc((smsq.stat.pending + smsq.stat.inflight + 1) * sizeof(*msgs));
+	if(msgs)
+	{
+		AST_LIST_TRAVERSE(&smsq.queues, queue, entry)
+		{
+			AST_LIST_TRAVERSE(&queue->msgs, msg, entry)
+				msgs[count++] = msg;
+		}
+		AST_LIST_TRAVERSE(&smsq.inflight, msg, entry)
+			msgs[count++] = msg;
+		qsort(msgs, count, sizeof(*msgs), smsq_msg_cmp);
+
+		for(i = 0; i < count; ++i)
+		{
+			smsq_record_fill(&rec, SMSQ_REC_ADD, msgs[i]);
+			fwrite(&rec, sizeof(rec), 1, file);
+			fwrite(msgs[i]->target, 1, msgs[i]->length, file);
+			size += sizeof(rec) + msgs[i]->length;
+		}
+		ast_free(msgs);
+	}
+	else
+	{
+		err = ENOMEM;
+	}
+	ast_mutex_unlock(&smsq_lock);
+
+	if(fflush(file) || fdatasync(fd))
+		err = errno;
+	if(fclose(file) && !err)
+		err = errno;
+	if(!err && rename(tmp, smsq.path))
+		err = errno;
+	if(err)
+	{
+		/* old journal still in use, DONE records will be written by next flush */
+		unlink(tmp);
+		smsq_done_restore(&done);
+		return err;
+	}
+
+	/* old descriptor point to unlinked journal, appends to it are lost */
+	if(smsq.fd >= 0)
+		close(smsq.fd);
+	smsq.fd = open(smsq.path, O_WRONLY | O_APPEND);
+	if(smsq.fd < 0)
+	{
+		err = errno;
+		ast_log (LOG_ERROR, "SMS spool journal %s: can't reopen after rewrite, spool disabled: %s\n", smsq.path, strerror(err));
+		smsq_done_restore(&done);
+		return err;
+	}
+	smsq.stat.journal_size = size;
+	smsq.dead = 0;
+
+	while((msg = AST_LIST_REMOVE_HEAD(&done, entry)))
+		ast_free(msg);
+	return 0;
+}
+
+#/* read journal to index, stop on first bad record; return 0 or errno */
+static int smsq_load()
+{
+	struct smsq_record rec;
+	struct smsq_msg ** msgs = NULL;
+	struct smsq_msg * msg;
+	struct stat st;
+	char * buf;
+	size_t offset = 0;
+	unsigned count = 0;
+	unsigned done = 0;
+	unsigned lo, hi, mid, i;
+	int fd;
+	int err = 0;
+
+	fd = open(smsq.path, O_RDONLY | O_CREAT, 0600);
+	if(fd < 0)
+		return errno;
+	if(fstat(fd, &st))
+	{
+		err = errno;
+		close(fd);
+		return err;
+	}
+	buf = ast_malloc(st.st_size + 1);
+	/* not more ADD records than maximal records in file */
+	msgs = ast_malloc((st.st_size / sizeof(rec) + 1) * sizeof(*msgs));
+	if(!buf || !msgs)
+	{
+		err = ENOMEM;
+	}
+	else if(read(fd, buf, st.st_size) != st.st_size)
+	{
+		err = EIO;
+	}
+	close(fd);
+
+	while(!err && offset + sizeof(rec) <= (size_t)st.st_size)
+	{
+		memcpy(&rec, buf + offset, sizeof(rec));
+		if(rec.magic != SMSQ_MAGIC || rec.length > SMSQ_PAYLOAD_MAX || offset + sizeof(rec) + rec.length > (size_t)st.st_size
+			|| rec.crc != smsq_record_crc(&rec, buf + offset + sizeof(rec)))
+			break;
+
+		if(rec.type == SMSQ_REC_ADD)
+		{
+			/* ids grow in journal, keep sorted for lookup by DONE */
+			if(rec.length < 3 || buf[offset + sizeof(rec) + rec.length - 1] != 0 || (count && rec.id <= msgs[count - 1]->id))
+				break;
+			msg = smsq_msg_alloc(buf + offset + sizeof(rec), rec.length);
+			if(!msg)
+			{
+				err = ENOMEM;
+				break;
+			}
+			msg->id = rec.id;
+			msg->created = rec.created;
+			msg->validity = rec.validity;
+			msg->report = rec.flags & 1;
+			msgs[count++] = msg;
+		}
+		else if(rec.type == SMSQ_REC_DONE)
+		{
+			for(lo = 0, hi = count; lo < hi; )
+			{
+				mid = (lo + hi) / 2;
+				if(msgs[mid]->id < rec.id)
+					lo = mid + 1;
+				else
+					hi = mid;
+			}
+			/* mark completed, freed after load */
+			if(lo < count && msgs[lo]->id == rec.id && !msgs[lo]->sent)
+			{
+				msgs[lo]->sent = 1;
+				done++;
+			}
+		}
+		if(rec.id >= smsq.next_id)
+			smsq.next_id = rec.id + 1;
+		offset += sizeof(rec) + rec.length;
+	}
+
+	if(!err && offset != (size_t)st.st_size)
+		ast_log (LOG_WARNING, "SMS spool journal %s: ignore %lu bytes of torn or corrupted tail\n", smsq.path, (unsigned long)(st.st_size - offset));
+
+	for(i = 0; i < count; ++i)
+	{
+		if(msgs[i]->sent || err || smsq_queue_add(msgs[i]))
+			ast_free(msgs[i]);
+	}
+	if(!err)
+		ast_verb (3, "SMS spool journal %s: %u pending messages, %u completed\n", smsq.path, count - done, done);
+
+	ast_free(msgs);
+	ast_free(buf);
+	return err;
+}
+
+#/* write DONE records of completed messages, rewrite journal when needed */
+static void smsq_flush()
+{
+	struct smsq_msgs done;
+	struct smsq_msg * msg;
+	unsigned live;
+	int err;
+
+	ast_mutex_lock(&smsq_journal_lock);
+	/* spool disabled by failed rewrite, completed messages freed by smsq_fini() */
+	if(smsq.fd < 0)
+	{
+		ast_mutex_unlock(&smsq_journal_lock);
+		return;
+	}
+	ast_mutex_lock(&smsq_lock);
+	done = smsq.done;
+	AST_LIST_HEAD_INIT_NOLOCK(&smsq.done);
+	ast_mutex_unlock(&smsq_lock);
+
+	while((msg = AST_LIST_REMOVE_HEAD(&done, entry)))
+	{
+		err = smsq_journal_write(SMSQ_REC_DONE, msg);
+		if(err)
+			ast_log (LOG_ERROR, "SMS spool journal %s: can't write result of %llu: %s\n", smsq.path, (unsigned long long)msg->id, strerror(err));
+		/* ADD and DONE */
+		smsq.dead += 2;
+		ast_free(msg);
+	}
+
+	ast_mutex_lock(&smsq_lock);
+	live = smsq.stat.pending + smsq.stat.inflight;
+	ast_mutex_unlock(&smsq_lock);
+	if(smsq.dead >= SMSQ_COMPACT_MIN && smsq.dead > live * 2)
+	{
+		err = smsq_compact();
+		if(err)
+			ast_log (LOG_ERROR, "SMS spool journal %s: can't rewrite: %s\n", smsq.path, strerror(err));
+	}
+	ast_mutex_unlock(&smsq_journal_lock);
+}
+
+#/* pvt lock must be held, remove from inflight and retry or complete */
+static void smsq_finish(struct pvt * pvt, struct smsq_msg * msg, int sent, int retry)
+{
+	uint64_t id = msg->id;
+	int attempts = msg->attempts;
+	time_t now = time(NULL);
+	unsigned slot = now % ITEMS_OF(smsq.sent_time);
+
+	ast_mutex_lock(&smsq_lock);
+	AST_LIST_REMOVE(&smsq.inflight, msg, entry);
+	smsq.stat.inflight--;
+
+	if(!sent && retry && msg->attempts < smsq.retries)
+	{
+		msg->next_try = now + SMSQ_RETRY_DELAY * msg->attempts;
+		AST_LIST_INSERT_TAIL(&msg->queue->msgs, msg, entry);
+		msg->queue->count++;
+		smsq.stat.pending++;
+		smsq.stat.retries++;
+		ast_mutex_unlock(&smsq_lock);
+
+		ast_verb (3, "[%s] SMS message %llu from spool not sent, attempt %d of %d\n", PVT_ID(pvt), (unsigned long long)id, attempts, smsq.retries);
+		return;
+	}
+
+	msg->sent = sent;
+	AST_LIST_INSERT_TAIL(&smsq.done, msg, entry);
+	if(sent)
+	{
+		smsq.stat.sent++;
+		if(smsq.sent_time[slot] != now)
+		{
+			smsq.sent_time[slot] = now;
+			smsq.sent_count[slot] = 0;
+		}
+		smsq.sent_count[slot]++;
+	}
+	else
+	{
+		smsq.stat.failed++;
+	}
+	smsq_wakeup();
+	ast_mutex_unlock(&smsq_lock);
+
+	if(sent)
+	{
+		PVT_STAT(pvt, smsq_sent) ++;
+		ast_verb (3, "[%s] Successfully sent SMS message %llu from spool\n", PVT_ID(pvt), (unsigned long long)id);
+	}
+	else
+	{
+		PVT_STAT(pvt, smsq_failed) ++;
+		ast_log (LOG_ERROR, "[%s] Error sending SMS message %llu from spool, dropped\n", PVT_ID(pvt), (unsigned long long)id);
+	}
+	manager_event_sent_notify(PVT_ID(pvt), "SMS", SMSQ_ID(id), sent ? "Sent" : "NotSent");
+}
+
+#/* pvt lock must be held */
+static int smsq_device_ready(const struct pvt * pvt, struct timeval now)
+{
+	return pvt->connected && pvt->initialized && pvt->gsm_registered && pvt->has_sms && pvt_enabled(pvt)
+		&& !pvt->smsq_msg && ast_tvcmp(now, pvt->smsq_next) >= 0;
+}
+
+#/* pvt lock must be held, give older due message of device or device group to device */
+static void smsq_device_pull(struct pvt * pvt, struct timeval now)
+{
+	char group[DEVNAMELEN];
+	struct smsq_msg * msg;
+	struct smsq_msg * gmsg;
+	void * task;
+	int err;
+
+	snprintf(group, sizeof(group), "g%d", CONF_SHARED(pvt, group));
+
+	ast_mutex_lock(&smsq_lock);
+	msg = smsq_queue_due(smsq_queue_get(PVT_ID(pvt), 0), now.tv_sec);
+	gmsg = smsq_queue_due(smsq_queue_get(group, 0), now.tv_sec);
+	if(!msg || (gmsg && gmsg->id < msg->id))
+		msg = gmsg;
+	if(msg)
+	{
+		AST_LIST_REMOVE(&msg->queue->msgs, msg, entry);
+		msg->queue->count--;
+		smsq.stat.pending--;
+		AST_LIST_INSERT_TAIL(&smsq.inflight, msg, entry);
+		smsq.stat.inflight++;
+	}
+	ast_mutex_unlock(&smsq_lock);
+
+	if(!msg)
+		return;
+
+	msg->attempts++;
+	err = at_enque_sms_ref(&pvt->sys_chan, msg->number, msg->message, msg->validity, msg->report, &msg->ref, &task);
+	if(err)
+	{
+		/* message not fit to PDU never fit on other attempt */
+		ast_log (LOG_ERROR, "[%s] Error adding SMS message %llu from spool to queue\n", PVT_ID(pvt), (unsigned long long)msg->id);
+		smsq_finish(pvt, msg, 0, err != -E2BIG);
+		return;
+	}
+
+	pvt->smsq_msg = msg;
+	pvt->smsq_task = task;
+	if(CONF_SHARED(pvt, smsrate) > 0)
+		pvt->smsq_next = ast_tvadd(now, ast_samp2tv(60, CONF_SHARED(pvt, smsrate)));
+	ast_debug (1, "[%s] SMS message %llu from spool queued as %p\n", PVT_ID(pvt), (unsigned long long)msg->id, task);
+}
+
+#/* */
+static void smsq_dispatch()
+{
+	struct pvt * pvt;
+	struct timeval now;
+
+	if(!smsq.stat.pending)
+		return;
+
+	AST_RWLIST_RDLOCK(&gpublic->devices);
+	AST_RWLIST_TRAVERSE(&gpublic->devices, pvt, entry)
+	{
+		ast_mutex_lock(&pvt->lock);
+		now = ast_tvnow();
+		if(smsq_device_ready(pvt, now))
+			smsq_device_pull(pvt, now);
+		ast_mutex_unlock(&pvt->lock);
+	}
+	AST_RWLIST_UNLOCK(&gpublic->devices);
+}
+
+#/* */
+static void * smsq_run(attribute_unused void * arg)
+{
+	struct timespec ts;
+	struct timeval tv;
+
+	while(smsq.running)
+	{
+		smsq_dispatch();
+		smsq_flush();
+
+		ast_mutex_lock(&smsq_lock);
+		if(smsq.running && !smsq.wakeup)
+		{
+			tv = ast_tvadd(ast_tvnow(), ast_samp2tv(SMSQ_INTERVAL, 1));
+			ts.tv_sec = tv.tv_sec;
+			ts.tv_nsec = tv.tv_usec * 1000;
+			ast_cond_timedwait(&smsq.cond, &smsq_lock, &ts);
+		}
+		smsq.wakeup = 0;
+		ast_mutex_unlock(&smsq_lock);
+	}
+	smsq_flush();
+	return NULL;
+}
+
+#/* load journal and start spool thread; return 0 or errno */
+EXPORT_DEF int smsq_init(const char * path, int retries)
+{
+	int err;
+
+	ast_copy_string(smsq.path, path, sizeof(smsq.path));
+	smsq.retries = retries > 0 ? retries : 1;
+	smsq.next_id = 1;
+	ast_cond_init(&smsq.cond, NULL);
+
+	ast_mutex_lock(&smsq_journal_lock);
+	err = smsq_load();
+	if(!err)
+		err = smsq_compact();
+	ast_mutex_unlock(&smsq_journal_lock);
+
+	if(!err)
+	{
+		smsq.running = 1;
+		if(ast_pthread_create_background(&smsq.thread, NULL, smsq_run, NULL) < 0)
+		{
+			err = errno;
+			smsq.running = 0;
+		}
+	}
+	if(err)
+	{
+		ast_log (LOG_ERROR, "Unable to start SMS spool with journal %s: %s\n", smsq.path, strerror(err));
+		smsq_fini();
+	}
+	return err;
+}
+
+#/* stop spool thread, devices keep inflight messages until smsq_device_reset() */
+EXPORT_DEF void smsq_stop()
+{
+	if(smsq.running)
+	{
+		ast_mutex_lock(&smsq_lock);
+		smsq.running = 0;
+		smsq_wakeup();
+		ast_mutex_unlock(&smsq_lock);
+
+		pthread_join(smsq.thread, NULL);
+		smsq.thread = AST_PTHREADT_NULL;
+	}
+}
+
+#/* after devices destroyed */
+EXPORT_DEF void smsq_fini()
+{
+	struct smsq_queue * queue;
+	struct smsq_msg * msg;
+
+	smsq_stop();
+	if(smsq.path[0] == 0)
+		return;
+
+	/* results of devices destroyed after thread stop */
+	ast_mutex_lock(&smsq_journal_lock);
+	ast_mutex_lock(&smsq_lock);
+	while((msg = AST_LIST_REMOVE_HEAD(&smsq.done, entry)))
+	{
+		if(smsq.fd >= 0)
+			smsq_journal_write(SMSQ_REC_DONE, msg);
+		ast_free(msg);
+	}
+	ast_mutex_unlock(&smsq_lock);
+	if(smsq.fd >= 0)
+	{
+		close(smsq.fd);
+		smsq.fd = -1;
+	}
+	ast_mutex_unlock(&smsq_journal_lock);
+
+	while((queue = AST_LIST_REMOVE_HEAD(&smsq.queues, entry)))
+	{
+		while((msg = AST_LIST_REMOVE_HEAD(&queue->msgs, entry)))
+			ast_free(msg);
+		ast_free(queue);
+	}
+	while((msg = AST_LIST_REMOVE_HEAD(&smsq.inflight, entry)))
+		ast_free(msg);
+	ast_cond_destroy(&smsq.cond);
+	memset(&smsq.stat, 0, sizeof(smsq.stat));
+	smsq.path[0] = 0;
+	smsq.dead = 0;
+}
+
+#/* */
+EXPORT_DEF int smsq_enabled()
+{
+	return smsq.running;
+}
+
+#/* */
+EXPORT_DEF const char * smsq_path()
+{
+	return smsq.running ? smsq.path : NULL;
+}
+
+#/* append message to journal and queue of target; return 0 or errno */
+EXPORT_DEF int smsq_enqueue(const char * target, const char * number, const char * message, unsigned validity, int report, uint64_t * id)
+{
+	struct smsq_msg * msg;
+	size_t tlen = strlen(target) + 1;
+	size_t nlen = strlen(number) + 1;
+	size_t mlen = strlen(message) + 1;
+	char payload[SMSQ_PAYLOAD_MAX];
+	int err;
+
+	if(tlen > DEVNAMELEN || tlen + nlen + mlen > sizeof(payload))
+		return E2BIG;
+
+	memcpy(payload, target, tlen);
+	memcpy(payload + tlen, number, nlen);
+	memcpy(payload + tlen + nlen, message, mlen);
+	msg = smsq_msg_alloc(payload, tlen + nlen + mlen);
+	if(!msg)
+		return ENOMEM;
+	msg->created = time(NULL);
+	msg->validity = validity;
+	msg->report = report ? 1 : 0;
+
+	ast_mutex_lock(&smsq_journal_lock);
+	if(smsq.fd < 0)
+	{
+		err = ENOENT;
+	}
+	else
+	{
+		msg->id = smsq.next_id++;
+		err = smsq_journal_write(SMSQ_REC_ADD, msg);
+		if(!err && fdatasync(smsq.fd))
+			err = errno;
+		if(!err)
+		{
+			/* journal lock held, so compaction see message in index */
+			ast_mutex_lock(&smsq_lock);
+			err = smsq_queue_add(msg);
+			if(!err)
+			{
+				smsq.stat.accepted++;
+				smsq_wakeup();
+			}
+			ast_mutex_unlock(&smsq_lock);
+		}
+	}
+	ast_mutex_unlock(&smsq_journal_lock);
+
+	if(err)
+	{
+		ast_free(msg);
+		return err;
+	}
+	*id = msg->id;
+	return 0;
+}
+
+#/* pvt lock must be held, return non-zero if task is message of spool */
+EXPORT_DEF int smsq_result(struct pvt * pvt, const void * task, int sent)
+{
+	struct smsq_msg * msg = pvt->smsq_msg;
+
+	if(!msg || pvt->smsq_task != task)
+		return 0;
+
+	pvt->smsq_msg = NULL;
+	pvt->smsq_task = NULL;
+	smsq_finish(pvt, msg, sent, 1);
+	return 1;
+}
+
+#/* pvt lock must be held, part of concatenated message accepted, retry start after it */
+EXPORT_DEF void smsq_part_sent(struct pvt * pvt, const void * task)
+{
+	struct smsq_msg * msg = pvt->smsq_msg;
+
+	if(msg && pvt->smsq_task == task)
+		msg->ref.sent++;
+}
+
+#/* pvt lock must be held, return inflight message of device to head of queue */
+EXPORT_DEF void smsq_device_reset(struct pvt * pvt)
+{
+	struct smsq_msg * msg = pvt->smsq_msg;
+
+	if(!msg)
+		return;
+
+	pvt->smsq_msg = NULL;
+	pvt->smsq_task = NULL;
+	/* attempt not completed */
+	msg->attempts--;
+
+	ast_mutex_lock(&smsq_lock);
+	AST_LIST_REMOVE(&smsq.inflight, msg, entry);
+	smsq.stat.inflight--;
+	AST_LIST_INSERT_HEAD(&msg->queue->msgs, msg, entry);
+	msg->queue->count++;
+	smsq.stat.pending++;
+	smsq_wakeup();
+	ast_mutex_unlock(&smsq_lock);
+
+	ast_debug (1, "[%s] SMS message %llu returned to spool\n", PVT_ID(pvt), (unsigned long long)msg->id);
+}
+
+#/* */
+EXPORT_DEF void smsq_stat_read(struct smsq_stat * stat)
+{
+	time_t now = time(NULL);
+	unsigned i;
+
+	ast_mutex_lock(&smsq_lock);
+	memcpy(stat, &smsq.stat, sizeof(*stat));
+	stat->last_minute = 0;
+	for(i = 0; i < ITEMS_OF(smsq.sent_time); ++i)
+	{
+		if(now - smsq.sent_time[i] < (time_t)ITEMS_OF(smsq.sent_time))
+			stat->last_minute += smsq.sent_count[i];
+	}
+	ast_mutex_unlock(&smsq_lock);
+}
+
+#/* call callback for each target with pending messages under spool lock */
+EXPORT_DEF void smsq_queues_read(void (*callback)(void * arg, const char * target, unsigned count), void * arg)
+{
+	struct smsq_queue * queue;
+
+	ast_mutex_lock(&smsq_lock);
+	AST_LIST_TRAVERSE(&smsq.queues, queue, entry)
+	{
+		if(queue->count)
+			callback(arg, queue->target, queue->count);
+	}
+	ast_mutex_unlock(&smsq_lock);
+}
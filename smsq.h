@@ -0,0 +1,86 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifndef CHAN_DONGLE_SMSQ_H_INCLUDED
+#define CHAN_DONGLE_SMSQ_H_INCLUDED
+
+#include <stdint.h>			/* uint16_t uint32_t uint64_t */
+
+#include "export.h"			/* EXPORT_DECL EXPORT_DEF */
+
+/*
+   Persistent spool of outgoing SMS.
+
+   Messages addressed to device id or to g<group> appended to journal and
+   synced before accepted, journal replayed on module load. Spool thread
+   give each registered device at most one message at time from queue of
+   device or queue of device group, so group load balanced by free devices.
+   Per device rate limited by smsrate, failed message retried with growing
+   delay up to smsspoolretries attempts. Retry of concatenated SMS keep its
+   reference and send only parts not accepted before, reference not kept
+   over module reload.
+
+   Journal is sequence of struct smsq_record followed by length bytes of
+   payload: ADD payload is "target\0number\0message\0", DONE has no payload.
+   DONE records not synced, message sent before crash may be sent again.
+   Journal rewritten with pending messages only on load and when completed
+   records dominate.
+*/
+
+#define SMSQ_MAGIC			0x51534344		/* 'DCSQ' */
+#define SMSQ_PAYLOAD_MAX		8192			/* limit of target, number and message with terminators */
+#define SMSQ_INTERVAL			1			/* seconds between spool thread runs without wakeup */
+#define SMSQ_RETRY_DELAY		30			/* seconds before retry, multiplied by attempts */
+#define SMSQ_SCAN_LIMIT			32			/* messages checked for due retry time from queue head */
+#define SMSQ_COMPACT_MIN		1024			/* records of completed messages before journal rewrite */
+
+/* spool id as id of manager events and CLI */
+#define SMSQ_ID(id)			((void *)(uintptr_t)(id))
+
+typedef enum {
+	SMSQ_REC_ADD = 1,					/*!< message accepted */
+	SMSQ_REC_DONE,						/*!< message sent or dropped */
+} smsq_rec_t;
+
+struct smsq_record
+{
+	uint32_t		magic;				/*!< SMSQ_MAGIC */
+	uint32_t		crc;				/*!< CRC-32 of rest of record and payload */
+	uint32_t		length;				/*!< bytes of payload after record */
+	uint16_t		type;				/*!< see smsq_rec_t */
+	uint16_t		flags;				/*!< ADD: status report requested, DONE: message sent */
+	uint64_t		id;				/*!< message id, grow in journal */
+	int64_t			created;			/*!< time of accept */
+	uint32_t		validity;			/*!< validity period in minutes, 0 default */
+	uint32_t		reserved;
+};
+
+struct smsq_stat
+{
+	unsigned		pending;			/*!< messages waiting for device */
+	unsigned		inflight;			/*!< messages in AT queue of devices */
+	uint64_t		accepted;			/*!< messages accepted since load */
+	uint64_t		sent;				/*!< messages sent since load */
+	uint64_t		failed;				/*!< messages dropped since load */
+	uint64_t		retries;			/*!< attempts failed and scheduled again */
+	unsigned		last_minute;			/*!< messages sent during last 60 seconds */
+	uint64_t		journal_size;			/*!< bytes of journal */
+};
+
+struct pvt;
+
+EXPORT_DECL int smsq_init(const char * path, int retries);
+EXPORT_DECL void smsq_stop();
+EXPORT_DECL void smsq_fini();
+EXPORT_DECL int smsq_enabled();
+EXPORT_DECL const char * smsq_path();
+
+EXPORT_DECL int smsq_enqueue(const char * target, const char * number, const char * message, unsigned validity, int report, uint64_t * id);
+EXPORT_DECL int smsq_result(struct pvt * pvt, const void * task, int sent);
+EXPORT_DECL void smsq_part_sent(struct pvt * pvt, const void * task);
+EXPORT_DECL void smsq_device_reset(struct pvt * pvt);
+
+EXPORT_DECL void smsq_stat_read(struct smsq_stat * stat);
+EXPORT_DECL void smsq_queues_read(void (*callback)(void * arg, const char * target, unsigned count), void * arg);
+
+#endif /* CHAN_DONGLE_SMSQ_H_INCLUDED */
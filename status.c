@@ -0,0 +1,78 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <string.h>			/* memcpy() memcmp() memset() */
+
+#include <asterisk.h>
+#include <asterisk/utils.h>		/* ast_copy_string() */
+
+#include "chan_dongle.h"		/* struct pvt pvt_status_t pvt_str_state() pvt_enabled() is_dial_possible() */
+#include "seqlock.h"			/* seqlock_write_begin() seqlock_read_begin() */
+
+#/* */
+EXPORT_DEF void pvt_status_fill(const struct pvt * pvt, pvt_status_t * status)
+{
+	/* zero also padding for compare by memcmp() */
+	memset(status, 0, sizeof(*status));
+
+	memcpy(&status->settings, &pvt->settings, sizeof(status->settings));
+	memcpy(&status->state, &pvt->state, sizeof(status->state));
+	status->str_state = pvt_str_state(pvt);
+	status->gsm_reg_status = pvt->gsm_reg_status;
+	status->rssi = pvt->rssi;
+	status->linkmode = pvt->linkmode;
+	status->linksubmode = pvt->linksubmode;
+	ast_copy_string(status->provider_name, pvt->provider_name, sizeof(status->provider_name));
+	ast_copy_string(status->manufacturer, pvt->manufacturer, sizeof(status->manufacturer));
+	ast_copy_string(status->model, pvt->model, sizeof(status->model));
+	ast_copy_string(status->firmware, pvt->firmware, sizeof(status->firmware));
+	ast_copy_string(status->imei, pvt->imei, sizeof(status->imei));
+	ast_copy_string(status->imsi, pvt->imsi, sizeof(status->imsi));
+	ast_copy_string(status->subscriber_number, pvt->subscriber_number, sizeof(status->subscriber_number));
+	ast_copy_string(status->location_area_code, pvt->location_area_code, sizeof(status->location_area_code));
+	ast_copy_string(status->cell_id, pvt->cell_id, sizeof(status->cell_id));
+	ast_copy_string(status->sms_scenter, pvt->sms_scenter, sizeof(status->sms_scenter));
+	status->current_state = pvt->current_state;
+	status->desired_state = pvt->desired_state;
+
+	status->connected = pvt->connected;
+	status->enabled = pvt_enabled(pvt);
+	status->dial_possible = is_dial_possible(pvt, CALL_FLAG_NONE);
+	status->has_voice = pvt->has_voice;
+	status->has_sms = pvt->has_sms;
+	status->has_call_waiting = pvt->has_call_waiting;
+	status->use_ucs2_encoding = pvt->use_ucs2_encoding;
+	status->cusd_use_7bit_encoding = pvt->cusd_use_7bit_encoding;
+	status->cusd_use_ucs2_decoding = pvt->cusd_use_ucs2_decoding;
+}
+
+#/* publish status snapshot if changed */
+EXPORT_DEF void pvt_status_update(struct pvt * pvt)
+{
+	pvt_status_t status;
+
+	pvt_status_fill(pvt, &status);
+
+	/* only writer, own snapshot may be compared without seqlock */
+	if(memcmp(&status, &pvt->status, sizeof(status)))
+	{
+		seqlock_write_begin(&pvt->status_lock);
+		memcpy(&pvt->status, &status, sizeof(status));
+		seqlock_write_end(&pvt->status_lock);
+	}
+}
+
+#/* copy last published status, device lock not required */
+EXPORT_DEF void pvt_status_read(const struct pvt * pvt, pvt_status_t * status)
+{
+	unsigned seq;
+
+	do {
+		seq = seqlock_read_begin(&pvt->status_lock);
+		memcpy(status, &pvt->status, sizeof(*status));
+	} while(seqlock_read_retry(&pvt->status_lock, seq));
+}
@@ -0,0 +1,519 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Micro benchmarks of core modules
+     bench [milliseconds] [name prefix]
+   Modules included into one unit like single.c and build with asterisk headers
+   from test/stub, so full asterisk tree not required (make bench).
+   Each case repeated with doubled iterations until run at least given time
+   (default 200 ms), output is one tab separated line per case:
+     name	iterations	ns/op	bytes/s
+   bytes/s is 0 for cases without payload.
+*/
+#define BUILD_SINGLE
+
+#include "memmem.c"			/* first, define _GNU_SOURCE for memmem() */
+#include "ringbuffer.c"
+#include "mixbuffer.c"
+#include "char_conv.c"
+#include "pdu.c"
+#include "at_parse.c"
+#include "at_frame.c"
+#include "audiotap.c"
+#include "vad.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#define FRAME		320
+#define CALL_FRAMES	50				/* frames of one call per second */
+#define MAX_STREAMS	6
+
+typedef size_t (*bench_op_t)(const void * arg);		/* run one operation, return number of payload bytes */
+
+struct bench_case {
+	const char	* name;
+	bench_op_t	op;
+	const void	* arg;
+};
+
+static volatile size_t sink;				/* defeat dead code elimination */
+static char frame[FRAME];
+
+/* ringbuffer */
+static char rb_buf[2048];
+static struct ringbuffer rb;
+
+#/* write and read one audio frame like channel_write() and read path */
+static size_t op_rb_write_read(attribute_unused const void * arg)
+{
+	struct iovec iov[2];
+
+	rb_write(&rb, frame, FRAME);
+	sink += rb_read_all_iov(&rb, iov);
+	rb_read_upd(&rb, FRAME);
+	return FRAME;
+}
+
+#/* ring contain line crossed buffer end */
+static void rb_line_init()
+{
+	static const char line[] = "+CLCC: 1,1,4,0,0,\"+79139131234\",145\r\n";
+
+	rb_init(&rb, rb_buf, sizeof(rb_buf));
+	rb.read = rb.write = sizeof(rb_buf) - 16;
+	rb_write(&rb, line, STRLEN(line));
+}
+
+#/* */
+static size_t op_rb_read_until_mem(attribute_unused const void * arg)
+{
+	struct iovec iov[2];
+
+	sink += rb_read_until_mem_iov(&rb, iov, "\r\n", 2);
+	return iov[0].iov_len + iov[1].iov_len;
+}
+
+#/* */
+static size_t op_rb_memcmp(attribute_unused const void * arg)
+{
+	sink += rb_memcmp(&rb, "+CLCC:", 6);
+	return 6;
+}
+
+/* mixbuffer */
+static char mix_buf[FRAME * 8];
+static struct mixbuffer mix;
+static struct mixstream streams[MAX_STREAMS];
+
+#/* all attached streams write frame, then frame read */
+static size_t op_mixb(const void * arg)
+{
+	int n = *(const int *)arg;
+	struct iovec iov[2];
+	int i;
+
+	for(i = 0; i < n; ++i)
+		mixb_write(&mix, &streams[i], frame, FRAME);
+	sink += mixb_read_n_iov(&mix, iov, FRAME);
+	mixb_read_upd(&mix, FRAME);
+	return FRAME * n;
+}
+
+/* pdu */
+struct pdu_case {
+	const char	* msg;
+	const char	* pdu;
+	size_t		tpdu_length;
+};
+
+#/* */
+static size_t op_pdu_build(const void * arg)
+{
+	const struct pdu_case * c = arg;
+	char buf[1024];
+
+	sink += pdu_build(buf, sizeof(buf), "+79168999100", "+79139131234", c->msg, 1440, 0);
+	return strlen(c->msg);
+}
+
+#/* */
+static size_t op_pdu_parse(const void * arg)
+{
+	const struct pdu_case * c = arg;
+	char buf[512];
+	char oa[64];
+	char * pdu = buf;
+	char * msg;
+	str_encoding_t oa_enc, msg_enc;
+	pdu_udh_t udh;
+	size_t length = strlen(c->pdu) + 1;
+
+	memcpy(buf, c->pdu, length);
+	sink += pdu_parse(&pdu, c->tpdu_length, oa, sizeof(oa), &oa_enc, &msg, &msg_enc, &udh) == NULL;
+	return length - 1;
+}
+
+/* char_conv */
+struct recode_case {
+	recode_direction_t	dir;
+	str_encoding_t		encoding;
+	const char		* in;
+};
+
+#/* */
+static size_t op_recode(const void * arg)
+{
+	const struct recode_case * c = arg;
+	char out[2048];
+	size_t length = strlen(c->in);
+
+	sink += str_recode(c->dir, c->encoding, c->in, length, out, sizeof(out));
+	return length;
+}
+
+#/* base64 of SMS and USSD events */
+static size_t op_base64(const void * arg)
+{
+	const char * in = arg;
+	char out[8192];
+	size_t length = strlen(in);
+
+	sink += out[base64_encode(in, length, out, sizeof(out)) - 1];
+	return length;
+}
+
+/* idle call, one operation is one second of one call */
+static short quiet[FRAME / 2];
+static struct audiotap tap;
+static int tap_peer = -1;
+
+#/* VAD of incoming frames, cost added to each frame with vad=yes */
+static size_t op_idle_vad(attribute_unused const void * arg)
+{
+	unsigned hangover = 0;
+	int i;
+
+	for(i = 0; i < CALL_FRAMES; ++i)
+		sink += vad_silent(&hangover, vad_energy(quiet, FRAME / 2), 200, 15);
+	return CALL_FRAMES * FRAME;
+}
+
+#/* copy of incoming frames to tap consumer, skipped on silence with vad=yes; consumer recv() included */
+static size_t op_idle_tap(attribute_unused const void * arg)
+{
+	char buf[sizeof(struct audiotap_hdr) + FRAME];
+	struct iovec iov = { quiet, FRAME };
+	int i;
+
+	for(i = 0; i < CALL_FRAMES; ++i)
+	{
+		sink += audiotap_send(&tap, "", "dongle0", 1, "1400000000.1", AUDIOTAP_DIR_RX, &iov, 1);
+		sink += recv(tap_peer, buf, sizeof(buf), 0);
+	}
+	return CALL_FRAMES * FRAME;
+}
+
+#/* same with vad=yes: silence accounted, one frame without data each AUDIOTAP_GAP_FLUSH samples */
+static size_t op_idle_tap_gap(attribute_unused const void * arg)
+{
+	char buf[sizeof(struct audiotap_hdr)];
+	int i;
+
+	for(i = 0; i < CALL_FRAMES; ++i)
+	{
+		if(audiotap_gap(&tap, AUDIOTAP_DIR_RX, FRAME / 2))
+		{
+			sink += audiotap_send(&tap, "", "dongle0", 1, "1400000000.1", AUDIOTAP_DIR_RX, NULL, 0);
+			sink += recv(tap_peer, buf, sizeof(buf), 0);
+		}
+	}
+	return CALL_FRAMES * FRAME;
+}
+
+#/* tap connected to local peer */
+static void idle_tap_init()
+{
+	int fds[2];
+
+	if(tap_peer >= 0)
+		return;
+	audiotap_init(&tap);
+	if(socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == 0)
+	{
+		tap.fd = fds[0];
+		tap_peer = fds[1];
+	}
+}
+
+/* at_parse */
+struct parse_case {
+	int		(*parse)(char * str, size_t len);
+	const char	* str;
+};
+
+#/* */
+static int parse_clcc(char * str, attribute_unused size_t len)
+{
+	unsigned idx, dir, state, mode, mpty, toa;
+	char * number;
+
+	return at_parse_clcc(str, &idx, &dir, &state, &mode, &mpty, &number, &toa);
+}
+
+#/* */
+static int parse_cmgr(char * str, size_t len)
+{
+	char oa[64];
+	char * msg;
+	str_encoding_t oa_enc, msg_enc;
+	pdu_udh_t udh;
+
+	return at_parse_cmgr(&str, len, oa, sizeof(oa), &oa_enc, &msg, &msg_enc, &udh) != NULL;
+}
+
+#/* */
+static int parse_cusd(char * str, attribute_unused size_t len)
+{
+	int type, dcs;
+	char * cusd;
+
+	return at_parse_cusd(str, &type, &cusd, &dcs);
+}
+
+#/* */
+static int parse_creg(char * str, size_t len)
+{
+	int gsm_reg, gsm_reg_status;
+	char * lac, * ci;
+
+	return at_parse_creg(str, len, &gsm_reg, &gsm_reg_status, &lac, &ci);
+}
+
+#/* */
+static int parse_cops(char * str, attribute_unused size_t len)
+{
+	return at_parse_cops(str) == NULL;
+}
+
+#/* */
+static int parse_cnum(char * str, attribute_unused size_t len)
+{
+	return at_parse_cnum(str) == NULL;
+}
+
+#/* */
+static int parse_csq(char * str, attribute_unused size_t len)
+{
+	int rssi;
+
+	return at_parse_csq(str, &rssi);
+}
+
+#/* */
+static int parse_cmti(char * str, attribute_unused size_t len)
+{
+	return at_parse_cmti(str);
+}
+
+#/* parsers modify string, copy cost included */
+static size_t op_parse(const void * arg)
+{
+	const struct parse_case * c = arg;
+	char buf[512];
+	size_t length = strlen(c->str);
+
+	memcpy(buf, c->str, length + 1);
+	sink += c->parse(buf, length);
+	return length;
+}
+
+/* at_read framing and classification */
+static const char responses[] =
+	"\r\nOK\r\n"
+	"\r\n^RSSI:20\r\n"
+	"\r\n+CSQ: 20,99\r\n"
+	"\r\nRING\r\n"
+	"\r\n+CLCC: 1,1,4,0,0,\"+79139131234\",145\r\n\r\nOK\r\n"
+	"\r\n^BOOT:20952548,0,0,0,72\r\n"
+	"\r\n^CEND:1,0,104,16\r\n"
+	"\r\n+CMTI: \"ME\",0\r\n"
+	"\r\n+CUSD: 0,\"00420061006C0061006E00630065\",72\r\n"
+	"\r\n^CONN:1,0\r\n";
+static int read_result;
+
+#/* */
+static size_t op_classification(attribute_unused const void * arg)
+{
+	struct iovec iov[2];
+	size_t len;
+
+	if(at_read_result_iov("bench", &read_result, &rb, iov) <= 0)
+	{
+		rb_init(&rb, rb_buf, sizeof(rb_buf));
+		rb_write(&rb, responses, STRLEN(responses));
+		read_result = 0;
+		if(at_read_result_iov("bench", &read_result, &rb, iov) <= 0)
+			return 0;
+	}
+	len = iov[0].iov_len + iov[1].iov_len;
+	sink += at_read_result_classification(&rb, len);
+	return len;
+}
+
+#/* */
+static double now_ns()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+#/* */
+static void bench_run(const struct bench_case * c, double min_ns)
+{
+	unsigned long iterations, i;
+	double start, elapsed;
+	size_t bytes;
+
+	/* warm up */
+	c->op(c->arg);
+
+	for(iterations = 16; ; iterations *= 2)
+	{
+		bytes = 0;
+		start = now_ns();
+		for(i = 0; i < iterations; ++i)
+			bytes += c->op(c->arg);
+		elapsed = now_ns() - start;
+		if(elapsed >= min_ns)
+			break;
+	}
+	printf("%s\t%lu\t%.1f\t%.0f\n", c->name, iterations, elapsed / iterations, bytes * 1e9 / elapsed);
+	fflush(stdout);
+}
+
+#/* */
+int main(int argc, char * argv[])
+{
+	static const int nstreams[MAX_STREAMS] = { 1, 2, 3, 4, 5, 6 };
+	static const struct pdu_case pdus[] = {
+		{ "Hello, this is a test message of 7 bit alphabet for benchmark", NULL, 0 },
+		{ "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82, \xd1\x8d\xd1\x82\xd0\xbe \xd1\x82\xd0\xb5\xd1\x81\xd1\x82", NULL, 0 },
+		{ NULL, "07911234567890F3040B911234556780F20008012150220040210C041F04400438043204350442", 31 },
+	};
+	static const char ascii[] = "Hello, this is a test message of 7 bit alphabet for benchmark";
+	static const char utf8[] = "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82, \xd1\x8d\xd1\x82\xd0\xbe \xd1\x82\xd0\xb5\xd1\x81\xd1\x82";
+	static const char gsm[] = "Caf\xc3\xa9 {menu} [\xe2\x82\xac" "5] \xc3\x9c" "ber \xce\xa9 ~ 100% f\xc3\xbcr dich | \xc3\xa0 per\xc3\xb2";
+	static char sms160[161];
+	static char sms140hex[281];
+	static char concat[4097];
+	static char encoded[6][1024];
+	static const struct recode_case recodes[] = {
+		{ RECODE_ENCODE, STR_ENCODING_7BIT_HEX, ascii },
+		{ RECODE_ENCODE, STR_ENCODING_8BIT_HEX, ascii },
+		{ RECODE_ENCODE, STR_ENCODING_UCS2_HEX, utf8 },
+		{ RECODE_ENCODE, STR_ENCODING_7BIT, ascii },
+		{ RECODE_DECODE, STR_ENCODING_7BIT_HEX, encoded[0] },
+		{ RECODE_DECODE, STR_ENCODING_8BIT_HEX, encoded[1] },
+		{ RECODE_DECODE, STR_ENCODING_UCS2_HEX, encoded[2] },
+		{ RECODE_DECODE, STR_ENCODING_7BIT, ascii },
+		{ RECODE_ENCODE, STR_ENCODING_7BIT_HEX, gsm },
+		{ RECODE_DECODE, STR_ENCODING_7BIT_HEX, encoded[3] },
+		{ RECODE_ENCODE, STR_ENCODING_UCS2_HEX, ascii },
+		{ RECODE_DECODE, STR_ENCODING_UCS2_HEX, encoded[4] },
+		{ RECODE_ENCODE, STR_ENCODING_7BIT_HEX, sms160 },
+		{ RECODE_DECODE, STR_ENCODING_7BIT_HEX, encoded[5] },
+		{ RECODE_DECODE, STR_ENCODING_8BIT_HEX, sms140hex },
+	};
+	static const struct parse_case parses[] = {
+		{ parse_clcc, "+CLCC: 1,1,4,0,0,\"+79139131234\",145" },
+		{ parse_cmgr, "+CMGR: 0,,31\r\n07911234567890F3040B911234556780F20008012150220040210C041F04400438043204350442\r\n" },
+		{ parse_cusd, "+CUSD: 0,\"00420061006C0061006E00630065\",72" },
+		{ parse_creg, "+CREG: 2,1,\"00FF\",\"0FFF\"" },
+		{ parse_cops, "+COPS: 0,0,\"TELE2\",0" },
+		{ parse_cnum, "+CNUM: \"Subscriber Number\",\"+79139131234\",145" },
+		{ parse_csq, "+CSQ: 20,99" },
+		{ parse_cmti, "+CMTI: \"ME\",41" },
+	};
+	const struct bench_case cases[] = {
+		{ "rb_write_read", op_rb_write_read, NULL },
+		{ "rb_read_until_mem_iov", op_rb_read_until_mem, NULL },
+		{ "rb_memcmp", op_rb_memcmp, NULL },
+		{ "mixb_write_read_1", op_mixb, &nstreams[0] },
+		{ "mixb_write_read_2", op_mixb, &nstreams[1] },
+		{ "mixb_write_read_3", op_mixb, &nstreams[2] },
+		{ "mixb_write_read_4", op_mixb, &nstreams[3] },
+		{ "mixb_write_read_5", op_mixb, &nstreams[4] },
+		{ "mixb_write_read_6", op_mixb, &nstreams[5] },
+		{ "pdu_build_7bit", op_pdu_build, &pdus[0] },
+		{ "pdu_build_ucs2", op_pdu_build, &pdus[1] },
+		{ "pdu_parse_ucs2", op_pdu_parse, &pdus[2] },
+		{ "str_recode_encode_7bit_hex", op_recode, &recodes[0] },
+		{ "str_recode_encode_8bit_hex", op_recode, &recodes[1] },
+		{ "str_recode_encode_ucs2_hex", op_recode, &recodes[2] },
+		{ "str_recode_encode_7bit", op_recode, &recodes[3] },
+		{ "str_recode_decode_7bit_hex", op_recode, &recodes[4] },
+		{ "str_recode_decode_8bit_hex", op_recode, &recodes[5] },
+		{ "str_recode_decode_ucs2_hex", op_recode, &recodes[6] },
+		{ "str_recode_decode_7bit", op_recode, &recodes[7] },
+		{ "str_recode_encode_7bit_hex_gsm", op_recode, &recodes[8] },
+		{ "str_recode_decode_7bit_hex_gsm", op_recode, &recodes[9] },
+		{ "str_recode_encode_ucs2_hex_ascii", op_recode, &recodes[10] },
+		{ "str_recode_decode_ucs2_hex_ascii", op_recode, &recodes[11] },
+		{ "str_recode_encode_7bit_hex_160", op_recode, &recodes[12] },
+		{ "str_recode_decode_7bit_hex_160", op_recode, &recodes[13] },
+		{ "str_recode_decode_8bit_hex_140", op_recode, &recodes[14] },
+		{ "base64_encode_ascii", op_base64, ascii },
+		{ "base64_encode_utf8", op_base64, utf8 },
+		{ "base64_encode_4k", op_base64, concat },
+		{ "at_parse_clcc", op_parse, &parses[0] },
+		{ "at_parse_cmgr", op_parse, &parses[1] },
+		{ "at_parse_cusd", op_parse, &parses[2] },
+		{ "at_parse_creg", op_parse, &parses[3] },
+		{ "at_parse_cops", op_parse, &parses[4] },
+		{ "at_parse_cnum", op_parse, &parses[5] },
+		{ "at_parse_csq", op_parse, &parses[6] },
+		{ "at_parse_cmti", op_parse, &parses[7] },
+		{ "at_read_result_classification", op_classification, NULL },
+		{ "idle_call_vad", op_idle_vad, NULL },
+		{ "idle_call_tap", op_idle_tap, NULL },
+		{ "idle_call_tap_gap", op_idle_tap_gap, NULL },
+	};
+	double min_ns = (argc > 1 ? atoi(argv[1]) : 200) * 1e6;
+	const char * prefix = argc > 2 ? argv[2] : "";
+	unsigned i;
+	int s;
+
+	memset(frame, 1, sizeof(frame));
+	/* line noise below vadthreshold */
+	for(i = 0; i < ITEMS_OF(quiet); ++i)
+		quiet[i] = (i % 7) - 3;
+	for(i = 0; i < 3; ++i)
+		if(str_recode(RECODE_ENCODE, recodes[i].encoding, recodes[i].in, strlen(recodes[i].in), encoded[i], sizeof(encoded[i])) < 0)
+			fprintf(stderr, "Can't encode input of %s\n", cases[12 + i].name);
+	if(str_recode(RECODE_ENCODE, recodes[8].encoding, recodes[8].in, strlen(recodes[8].in), encoded[3], sizeof(encoded[3])) < 0)
+		fprintf(stderr, "Can't encode input of %s\n", cases[20].name);
+	if(str_recode(RECODE_ENCODE, recodes[10].encoding, recodes[10].in, strlen(recodes[10].in), encoded[4], sizeof(encoded[4])) < 0)
+		fprintf(stderr, "Can't encode input of %s\n", cases[22].name);
+	/* single SMS of maximal length */
+	for(i = 0; i < sizeof(sms160) - 1; ++i)
+		sms160[i] = ascii[i % (sizeof(ascii) - 1)];
+	if(str_recode(RECODE_ENCODE, recodes[12].encoding, recodes[12].in, strlen(recodes[12].in), encoded[5], sizeof(encoded[5])) < 0)
+		fprintf(stderr, "Can't encode input of %s\n", cases[24].name);
+	/* user data of single 8 bit SMS and text of long concatenated SMS */
+	for(i = 0; i < sizeof(sms140hex) - 1; ++i)
+		sms140hex[i] = "0123456789ABCDEF"[(i * 7) % 16];
+	for(i = 0; i < sizeof(concat) - 1; ++i)
+		concat[i] = utf8[i % (sizeof(utf8) - 1)];
+
+	printf("# name\titerations\tns/op\tbytes/s\n");
+	for(i = 0; i < ITEMS_OF(cases); ++i)
+	{
+		if(strncmp(cases[i].name, prefix, strlen(prefix)))
+			continue;
+
+		/* per group state */
+		if(strncmp(cases[i].name, "rb_write", 8) == 0)
+			rb_init(&rb, rb_buf, sizeof(rb_buf));
+		else if(strncmp(cases[i].name, "rb_", 3) == 0)
+			rb_line_init();
+		else if(strncmp(cases[i].name, "mixb_", 5) == 0)
+		{
+			mixb_init(&mix, mix_buf, sizeof(mix_buf));
+			for(s = 0; s < *(const int *)cases[i].arg; ++s)
+				mixb_attach(&mix, &streams[s]);
+		}
+		else if(strncmp(cases[i].name, "at_read", 7) == 0)
+			rb_init(&rb, rb_buf, sizeof(rb_buf));
+		else if(strncmp(cases[i].name, "idle_call_tap", 13) == 0)
+			idle_tap_init();
+
+		bench_run(&cases[i], min_ns);
+	}
+	return 0;
+}
@@ -0,0 +1,55 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Common harness of test programs: counters, checks and summary line.
+   Include once from test program.
+*/
+#ifndef CHAN_DONGLE_TEST_CHECK_H_INCLUDED
+#define CHAN_DONGLE_TEST_CHECK_H_INCLUDED
+
+#include <stdio.h>			/* fprintf() */
+#include <string.h>			/* strcmp() */
+
+#include "export.h"			/* INLINE_DECL */
+
+static int ok = 0;
+static int faults = 0;
+
+#/* count result of check, return 1 when passed */
+INLINE_DECL int check_result(int passed)
+{
+	if(passed)
+		ok++;
+	else
+		faults++;
+	return passed;
+}
+
+#/* */
+INLINE_DECL const char * check_msg(int passed)
+{
+	return passed ? "OK" : "FAIL";
+}
+
+#/* */
+INLINE_DECL void check(const char * name, long result, long expected)
+{
+	int passed = check_result(result == expected);
+	fprintf(stderr, "%s = %ld expected %ld\t%s\n", name, result, expected, check_msg(passed));
+}
+
+#/* NULL result never match */
+INLINE_DECL void check_str(const char * name, const char * result, const char * expected)
+{
+	int passed = check_result(result && strcmp(result, expected) == 0);
+	fprintf(stderr, "%s = '%s' expected '%s'\t%s\n", name, result ? result : "(null)", expected, check_msg(passed));
+}
+
+#/* print summary, return exit code of test program */
+INLINE_DECL int check_done()
+{
+	fprintf(stderr, "done %d tests: %d OK %d FAILS\n", ok + faults, ok, faults);
+	return faults != 0;
+}
+
+#endif /* CHAN_DONGLE_TEST_CHECK_H_INCLUDED */
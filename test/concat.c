@@ -0,0 +1,211 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Test vectors of concatenated SMS reassembly
+     concat
+   Each vector is sequence of received parts with expected deliveries,
+   texts of parts are single letters so delivered text show order of parts.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "concat.h"
+#include "mutils.h"			/* ITEMS_OF() */
+#include "check.h"			/* check_str() check_done() */
+
+struct part {
+	const char	* number;
+	unsigned	ref;
+	unsigned	total;
+	unsigned	seq;
+	const char	* text;
+	time_t		now;			/*!< time of receive, expire check only when text is NULL */
+	int		res;			/*!< expected result of concat_add() */
+};
+
+struct vector {
+	const char	* name;
+	struct part	parts[24];
+	const char	* delivered;		/*!< expected deliveries as "number:text/missing " */
+};
+
+static char delivered[4096];
+
+#/* */
+static void deliver(void * arg, const char * number, const char * text, size_t length, unsigned missing)
+{
+	size_t used = strlen(delivered);
+
+	(*(unsigned *)arg)++;
+	snprintf(delivered + used, sizeof(delivered) - used, "%s:%.*s/%u ", number, (int)length, text, missing);
+}
+
+static const struct vector vectors[] = {
+	{ "in order",
+		{
+			{ "+7913", 1, 3, 1, "a", 0, 0 },
+			{ "+7913", 1, 3, 2, "b", 0, 0 },
+			{ "+7913", 1, 3, 3, "c", 0, 1 },
+		},
+		"+7913:abc/0 "
+	},
+	{ "out of order",
+		{
+			{ "+7913", 7, 4, 3, "c", 0, 0 },
+			{ "+7913", 7, 4, 1, "a", 1, 0 },
+			{ "+7913", 7, 4, 4, "d", 2, 0 },
+			{ "+7913", 7, 4, 2, "b", 3, 1 },
+		},
+		"+7913:abcd/0 "
+	},
+	{ "duplicate part",
+		{
+			{ "+7913", 2, 2, 1, "a", 0, 0 },
+			{ "+7913", 2, 2, 1, "x", 0, 0 },
+			{ "+7913", 2, 2, 2, "b", 0, 1 },
+		},
+		"+7913:ab/0 "
+	},
+	{ "same reference from other originator or other total",
+		{
+			{ "+7913", 5, 2, 1, "a", 0, 0 },
+			{ "+7914", 5, 2, 2, "y", 0, 0 },
+			{ "+7913", 5, 3, 2, "z", 0, 0 },
+			{ "+7913", 5, 2, 2, "b", 0, 1 },
+			{ "+7914", 5, 2, 1, "x", 0, 1 },
+			{ NULL, 0, 0, 0, NULL, 1000, 1 },
+		},
+		"+7913:ab/0 +7914:xy/0 +7913:z/2 "
+	},
+	{ "16 bit reference",
+		{
+			{ "Bank", 0x1234, 2, 2, "b", 0, 0 },
+			{ "Bank", 0x0034, 2, 1, "x", 0, 0 },
+			{ "Bank", 0x1234, 2, 1, "a", 0, 1 },
+		},
+		"Bank:ab/0 "
+	},
+	{ "timeout",
+		{
+			{ "+7913", 3, 3, 1, "a", 0, 0 },
+			{ "+7913", 3, 3, 3, "c", 10, 0 },
+			{ "+7915", 3, 2, 1, "x", 60, 0 },
+			{ NULL, 0, 0, 0, NULL, CONCAT_TIMEOUT - 1, 0 },
+			{ NULL, 0, 0, 0, NULL, CONCAT_TIMEOUT, 1 },
+			{ "+7913", 3, 3, 2, "b", CONCAT_TIMEOUT, 0 },
+			{ NULL, 0, 0, 0, NULL, 60 + CONCAT_TIMEOUT, 1 },
+			{ NULL, 0, 0, 0, NULL, CONCAT_TIMEOUT * 2, 1 },
+		},
+		"+7913:ac/1 +7915:x/1 +7913:b/2 "
+	},
+	{ "invalid parts",
+		{
+			{ "+7913", 1, 1, 1, "a", 0, -1 },
+			{ "+7913", 1, 3, 0, "a", 0, -1 },
+			{ "+7913", 1, 3, 4, "a", 0, -1 },
+			{ "+7913", 1, 0, 0, "a", 0, -1 },
+		},
+		""
+	},
+	{ "message limit evict oldest",
+		{
+			{ "1", 1, 2, 1, "a", 0, 0 },
+			{ "2", 1, 2, 1, "b", 0, 0 },
+			{ "3", 1, 2, 1, "c", 0, 0 },
+			{ "4", 1, 2, 1, "d", 0, 0 },
+			{ "5", 1, 2, 1, "e", 0, 0 },
+			{ "6", 1, 2, 1, "f", 0, 0 },
+			{ "7", 1, 2, 1, "g", 0, 0 },
+			{ "8", 1, 2, 1, "h", 0, 0 },
+			{ "9", 1, 2, 1, "i", 0, 0 },
+			{ "10", 1, 2, 1, "j", 0, 0 },
+			{ "11", 1, 2, 1, "k", 0, 0 },
+			{ "12", 1, 2, 1, "l", 0, 0 },
+			{ "13", 1, 2, 1, "m", 0, 0 },
+			{ "14", 1, 2, 1, "n", 0, 0 },
+			{ "15", 1, 2, 1, "o", 0, 0 },
+			{ "16", 1, 2, 1, "p", 0, 0 },
+			{ "16", 1, 2, 2, "q", 0, 1 },
+			{ "17", 1, 2, 1, "r", 0, 0 },
+			{ "18", 1, 2, 1, "s", 0, 0 },
+			{ "2", 1, 2, 2, "t", 0, 1 },
+			{ NULL, 0, 0, 0, NULL, CONCAT_TIMEOUT, 15 },
+		},
+		"16:pq/0 1:a/1 2:bt/0 3:c/1 4:d/1 5:e/1 6:f/1 7:g/1 8:h/1 9:i/1 10:j/1 11:k/1 12:l/1 13:m/1 14:n/1 15:o/1 17:r/1 18:s/1 "
+	},
+};
+
+#/* */
+void test_vectors()
+{
+	struct concat cc;
+	const struct part * part;
+	unsigned idx;
+	unsigned step;
+	unsigned count;
+	int res;
+
+	for(idx = 0; idx < ITEMS_OF(vectors); ++idx) {
+		concat_init(&cc);
+		delivered[0] = 0;
+		for(step = 0; step < ITEMS_OF(vectors[idx].parts); ++step) {
+			part = &vectors[idx].parts[step];
+			count = 0;
+			if(part->text)
+				res = concat_add(&cc, part->number, part->ref, part->total, part->seq, part->text, strlen(part->text), part->now, deliver, &count);
+			else if(part->now)
+				res = concat_expire(&cc, part->now, deliver, &count);
+			else
+				break;
+			if(res != part->res) {
+				fprintf(stderr, "%s step %u = %d expected %d\tFAIL\n", vectors[idx].name, step, res, part->res);
+				faults++;
+			}
+		}
+		check_str(vectors[idx].name, delivered, vectors[idx].delivered);
+		concat_destroy(&cc);
+		if(cc.count || cc.bytes) {
+			fprintf(stderr, "%s cache not empty after destroy\tFAIL\n", vectors[idx].name);
+			faults++;
+		}
+	}
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_bytes_limit()
+{
+	struct concat cc;
+	static char text[CONCAT_MAX_BYTES];
+	unsigned count = 0;
+	char result[64];
+
+	concat_init(&cc);
+	memset(text, 'a', sizeof(text));
+	delivered[0] = 0;
+
+	/* part of limit size evict all other */
+	concat_add(&cc, "1", 1, 2, 1, "x", 1, 0, deliver, &count);
+	concat_add(&cc, "2", 1, 2, 1, text, sizeof(text), 0, deliver, &count);
+	snprintf(result, sizeof(result), "%u %u %lu", count, cc.count, (unsigned long)cc.bytes);
+	check_str("bytes limit evict", result, "1 1 65536");
+
+	/* next part of same message not fit, message delivered incomplete */
+	snprintf(result, sizeof(result), "%d", concat_add(&cc, "2", 1, 2, 2, "yy", 2, 0, deliver, &count));
+	check_str("bytes limit self", result, "-1");
+	snprintf(result, sizeof(result), "%u %u %lu %lu %lu", count, cc.count, (unsigned long)cc.bytes, cc.stat.evicted, cc.stat.lost);
+	check_str("bytes limit stat", result, "2 0 0 2 2");
+
+	concat_destroy(&cc);
+	fprintf(stderr, "\n");
+}
+
+#/* */
+int main()
+{
+	test_vectors();
+	test_bytes_limit();
+
+	return check_done();
+}
@@ -0,0 +1,454 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Tests of device selection index, dial burst benchmark and scaling test
+     devsel [dialer threads] [seconds] [scale devices]
+   Benchmark compare old style selection (lock each device of group while scan)
+   with index selection (bitmap scan, lock only candidate) while monitor threads
+   hold device locks like at_response() handling does.
+   Scaling test compare lookup by id with linear strcmp() walk of device list
+   and measure time of reload (remove and add again all devices).
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "devsel.h"
+#include "mutils.h"			/* ITEMS_OF() */
+#include "check.h"			/* check() check_done() */
+
+#define BENCH_GROUPS		8
+#define BENCH_MONITORS		4
+#define BENCH_HOLD_USEC		50
+#define BENCH_DEVICES		128
+#define SCALE_LOOKUPS		200000
+
+#/* */
+static void set_bit(devsel_word_t * set, int slot)
+{
+	set[slot / DEVSEL_WORD_BITS] |= (devsel_word_t)1 << (slot % DEVSEL_WORD_BITS);
+}
+
+#/* */
+void test_devsel_next()
+{
+	devsel_word_t set[2];
+	int last = ITEMS_OF(set) * DEVSEL_WORD_BITS - 1;
+
+	memset(set, 0, sizeof(set));
+	check("next(empty, -1)", devsel_next(set, ITEMS_OF(set), -1), -1);
+	check("next(no words, -1)", devsel_next(set, 0, -1), -1);
+
+	set_bit(set, 3);
+	set_bit(set, 70);
+	set_bit(set, last);
+	check("next(set, -1)", devsel_next(set, ITEMS_OF(set), -1), 3);
+	check("next(set, 3)", devsel_next(set, ITEMS_OF(set), 3), 70);
+	check("next(set, 70)", devsel_next(set, ITEMS_OF(set), 70), last);
+	check("next(set, last)", devsel_next(set, ITEMS_OF(set), last), 3);
+	check("next(set, 100)", devsel_next(set, ITEMS_OF(set), 100), last);
+	check("next(one word, 3)", devsel_next(set, 1, 3), 3);
+
+	memset(set, 0, sizeof(set));
+	set_bit(set, 5);
+	check("next(single, 5)", devsel_next(set, ITEMS_OF(set), 5), 5);
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_devsel_keys()
+{
+	static struct devsel ds;
+	devsel_word_t members[1];
+	devsel_word_t candidates[1];
+	struct devsel_key * key;
+	int owners[4];
+	int slots[4];
+	char id[DEVSEL_ID_SIZE];
+	unsigned i;
+
+	devsel_init(&ds);
+	for(i = 0; i < ITEMS_OF(slots); ++i)
+	{
+		snprintf(id, sizeof(id), "dongle%u", i);
+		slots[i] = devsel_add(&ds, &owners[i], id, i % 2);
+	}
+
+	check("add slot 3", slots[3], 3);
+	check("words", devsel_words(&ds), 1);
+	key = devsel_find_group(&ds, 1);
+	check("group 1 members", key ? (long)key->members_count : -1, 2);
+	check("group 7 absent", devsel_find_group(&ds, 7) == NULL, 1);
+
+	check("group 1 no ready", devsel_candidates(&ds, key->members, key->words, DEVSEL_READY_VOICE, candidates), 0);
+	devsel_set_ready(&ds, slots[3], DEVSEL_READY_VOICE, 1);
+	check("group 1 ready", devsel_candidates(&ds, key->members, key->words, DEVSEL_READY_VOICE, candidates), 1);
+	check("group 1 candidate", devsel_next(candidates, 1, -1), 3);
+	check("group 1 hold not ready", devsel_candidates(&ds, key->members, key->words, DEVSEL_READY_HOLD, candidates), 0);
+
+	devsel_set_group(&ds, slots[3], 0);
+	check("group 1 after move", (long)key->members_count, 1);
+	check("group 0 after move", (long)devsel_find_group(&ds, 0)->members_count, 3);
+
+	devsel_set_provider(&ds, slots[0], "TELE2");
+	devsel_set_provider(&ds, slots[1], "TELE2");
+	devsel_set_provider(&ds, slots[2], "MTS");
+	check("provider TELE2", (long)devsel_find_provider(&ds, "TELE2")->members_count, 2);
+	devsel_set_provider(&ds, slots[1], "MTS");
+	check("provider TELE2 after change", (long)devsel_find_provider(&ds, "TELE2")->members_count, 1);
+	check("provider MTS", (long)devsel_find_provider(&ds, "MTS")->members_count, 2);
+	check("provider same", devsel_provider_changed(&ds, slots[1], "MTS"), 0);
+	check("provider changed", devsel_provider_changed(&ds, slots[1], "MTS RUS"), 1);
+	devsel_set_provider(&ds, slots[3], "Mobile TeleSystems Russia Federation Operator");
+	check("long provider truncated", (long)strlen(DEVSEL_FIELD(&ds, slots[3], provider)), DEVSEL_PROVIDER_SIZE - 1);
+	check("long provider same", devsel_provider_changed(&ds, slots[3], "Mobile TeleSystems Russia Federation Operator"), 0);
+	check("long provider changed", devsel_provider_changed(&ds, slots[3], "Mobile TeleSystems"), 1);
+	devsel_set_provider(&ds, slots[3], "");
+
+	check("lookup id", devsel_lookup(&ds, DEVSEL_HASH_ID, "dongle2"), 2);
+	check("lookup id absent", devsel_lookup(&ds, DEVSEL_HASH_ID, "dongle9"), -1);
+	check("lookup empty", devsel_lookup(&ds, DEVSEL_HASH_IMEI, ""), -1);
+	devsel_set_key(&ds, slots[1], DEVSEL_HASH_IMEI, "351234567890123");
+	check("lookup imei", devsel_lookup(&ds, DEVSEL_HASH_IMEI, "351234567890123"), 1);
+	devsel_set_key(&ds, slots[1], DEVSEL_HASH_IMEI, "351234567890124");
+	check("lookup old imei", devsel_lookup(&ds, DEVSEL_HASH_IMEI, "351234567890123"), -1);
+	check("imei same", devsel_key_changed(&ds, slots[1], DEVSEL_HASH_IMEI, "351234567890124"), 0);
+	check("imei changed", devsel_key_changed(&ds, slots[1], DEVSEL_HASH_IMEI, "351234567890125"), 1);
+
+	devsel_set_key(&ds, slots[0], DEVSEL_HASH_IMSI, "250011234567890");
+	devsel_set_key(&ds, slots[2], DEVSEL_HASH_IMSI, "250021234567890");
+	check("lookup imsi", devsel_lookup(&ds, DEVSEL_HASH_IMSI, "250021234567890"), 2);
+	check("imsi prefix 2500", devsel_match_imsi(&ds, "2500", members), 2);
+	check("imsi prefix 25001", devsel_match_imsi(&ds, "25001", members), 1);
+	check("imsi prefix slot", devsel_next(members, 1, -1), 0);
+
+	devsel_set_score(&ds, slots[0], 10);
+	devsel_set_score(&ds, slots[1], 30);
+	devsel_set_score(&ds, slots[3], 30);
+	members[0] = 0xB;
+	check("best score", devsel_best(&ds, members, 1, -1), 1);
+	check("best score round robin", devsel_best(&ds, members, 1, 1), 3);
+	devsel_set_score(&ds, slots[1], DEVSEL_SCORE_EXCLUDED);
+	devsel_set_score(&ds, slots[3], DEVSEL_SCORE_EXCLUDED);
+	check("best score excluded", devsel_best(&ds, members, 1, -1), 0);
+	devsel_clear(members, 0);
+	check("best score none", devsel_best(&ds, members, 1, -1), -1);
+
+	devsel_remove(&ds, slots[2]);
+	check("provider MTS after remove", (long)devsel_find_provider(&ds, "MTS")->members_count, 1);
+	check("imsi after remove", devsel_match_imsi(&ds, "25002", members), 0);
+	check("lookup id after remove", devsel_lookup(&ds, DEVSEL_HASH_ID, "dongle2"), -1);
+	check("lookup imsi after remove", devsel_lookup(&ds, DEVSEL_HASH_IMSI, "250021234567890"), -1);
+	check("reuse slot", devsel_add(&ds, &owners[2], "dongle2", 5), 2);
+	check("lookup id after reuse", devsel_lookup(&ds, DEVSEL_HASH_ID, "dongle2"), 2);
+
+	devsel_destroy(&ds);
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_devsel_grow()
+{
+	static struct devsel ds;
+	static int owners[1000];
+	char id[DEVSEL_ID_SIZE];
+	devsel_word_t * candidates;
+	struct devsel_key * key;
+	unsigned i;
+	unsigned found = 0;
+
+	devsel_init(&ds);
+	for(i = 0; i < ITEMS_OF(owners); ++i)
+	{
+		snprintf(id, sizeof(id), "dongle%u", i);
+		devsel_add(&ds, &owners[i], id, i % 3);
+		devsel_set_ready(&ds, i, DEVSEL_READY_VOICE, 1);
+	}
+
+	check("grow words", devsel_words(&ds), (ITEMS_OF(owners) + DEVSEL_CHUNK_SLOTS - 1) / DEVSEL_CHUNK_SLOTS);
+	for(i = 0; i < ITEMS_OF(owners); ++i)
+	{
+		snprintf(id, sizeof(id), "dongle%u", i);
+		found += DEVSEL_OWNER(&ds, devsel_lookup(&ds, DEVSEL_HASH_ID, id)) == &owners[i];
+	}
+	check("grow lookup all", found, ITEMS_OF(owners));
+
+	key = devsel_find_group(&ds, 2);
+	candidates = calloc(devsel_words(&ds), sizeof(*candidates));
+	check("grow group members", key->members_count, ITEMS_OF(owners) / 3);
+	check("grow group candidates", devsel_candidates(&ds, key->members, key->words, DEVSEL_READY_VOICE, candidates), 1);
+	check("grow last candidate", devsel_next(candidates, devsel_words(&ds), ITEMS_OF(owners) - 5), 998);
+	free(candidates);
+
+	devsel_destroy(&ds);
+	fprintf(stderr, "\n");
+}
+
+struct bench_dev {
+	pthread_mutex_t		lock;
+	int			group;
+	int			ready;
+	int			slot;
+};
+
+static struct bench_dev devs[BENCH_DEVICES];
+static struct devsel bench_ds;
+static pthread_mutex_t bench_ds_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile int bench_stop;
+static int bench_indexed;
+
+#/* */
+static long usec_now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000L + tv.tv_usec;
+}
+
+#/* emulate monitor threads: hold device lock while handle response and change readiness */
+static void * bench_monitor(void * arg)
+{
+	unsigned seed = (unsigned)(long)arg;
+	struct bench_dev * dev;
+	long until;
+
+	while(!bench_stop)
+	{
+		dev = &devs[rand_r(&seed) % BENCH_DEVICES];
+		pthread_mutex_lock(&dev->lock);
+		until = usec_now() + BENCH_HOLD_USEC;
+		while(usec_now() < until)
+			;
+		dev->ready = rand_r(&seed) % 4 != 0;
+		devsel_set_ready(&bench_ds, dev->slot, DEVSEL_READY_VOICE, dev->ready);
+		pthread_mutex_unlock(&dev->lock);
+	}
+	return NULL;
+}
+
+#/* old style: lock each device of group in turn */
+static struct bench_dev * bench_select_scan(int group)
+{
+	unsigned i;
+
+	for(i = 0; i < BENCH_DEVICES; ++i)
+	{
+		pthread_mutex_lock(&devs[i].lock);
+		if(devs[i].group == group && devs[i].ready)
+			return &devs[i];
+		pthread_mutex_unlock(&devs[i].lock);
+	}
+	return NULL;
+}
+
+#/* new style: bitmap scan, lock and recheck candidate only */
+static struct bench_dev * bench_select_index(int group)
+{
+	devsel_word_t candidates[BENCH_DEVICES / DEVSEL_CHUNK_SLOTS];
+	unsigned words = devsel_words(&bench_ds);
+	struct devsel_key * key;
+	struct bench_dev * dev;
+	int any = 0;
+	int first = -1;
+	int slot = -1;
+
+	pthread_mutex_lock(&bench_ds_lock);
+	key = devsel_find_group(&bench_ds, group);
+	if(key)
+		any = devsel_candidates(&bench_ds, key->members, key->words, DEVSEL_READY_VOICE, candidates);
+	pthread_mutex_unlock(&bench_ds_lock);
+
+	while(any && (slot = devsel_next(candidates, words, slot)) >= 0 && slot != first)
+	{
+		if(first < 0)
+			first = slot;
+		dev = DEVSEL_OWNER(&bench_ds, slot);
+		pthread_mutex_lock(&dev->lock);
+		if(dev->ready)
+			return dev;
+		pthread_mutex_unlock(&dev->lock);
+	}
+	return NULL;
+}
+
+#/* */
+static void * bench_dialer(void * arg)
+{
+	unsigned long * count = arg;
+	unsigned seed = (unsigned)(long)count;
+	struct bench_dev * dev;
+	int group;
+
+	while(!bench_stop)
+	{
+		group = rand_r(&seed) % BENCH_GROUPS;
+		dev = bench_indexed ? bench_select_index(group) : bench_select_scan(group);
+		if(dev)
+			pthread_mutex_unlock(&dev->lock);
+		(*count)++;
+	}
+	return NULL;
+}
+
+#/* */
+static double bench_run(int indexed, int dialers, int seconds)
+{
+	pthread_t monitors[BENCH_MONITORS];
+	pthread_t * threads = calloc(dialers, sizeof(*threads));
+	unsigned long * counts = calloc(dialers, sizeof(*counts));
+	unsigned long total = 0;
+	int i;
+
+	bench_stop = 0;
+	bench_indexed = indexed;
+	for(i = 0; i < BENCH_MONITORS; ++i)
+		pthread_create(&monitors[i], NULL, bench_monitor, (void*)(long)(i + 1));
+	for(i = 0; i < dialers; ++i)
+		pthread_create(&threads[i], NULL, bench_dialer, &counts[i]);
+
+	sleep(seconds);
+	bench_stop = 1;
+
+	for(i = 0; i < dialers; ++i)
+	{
+		pthread_join(threads[i], NULL);
+		total += counts[i];
+	}
+	for(i = 0; i < BENCH_MONITORS; ++i)
+		pthread_join(monitors[i], NULL);
+
+	free(counts);
+	free(threads);
+	return (double)total / seconds;
+}
+
+#/* */
+void bench_dial_burst(int dialers, int seconds)
+{
+	double scan, indexed;
+	char id[DEVSEL_ID_SIZE];
+	int i;
+
+	devsel_init(&bench_ds);
+	for(i = 0; i < BENCH_DEVICES; ++i)
+	{
+		pthread_mutex_init(&devs[i].lock, NULL);
+		devs[i].group = i % BENCH_GROUPS;
+		devs[i].ready = 1;
+		snprintf(id, sizeof(id), "dongle%d", i);
+		devs[i].slot = devsel_add(&bench_ds, &devs[i], id, devs[i].group);
+		devsel_set_ready(&bench_ds, devs[i].slot, DEVSEL_READY_VOICE, 1);
+	}
+
+	scan = bench_run(0, dialers, seconds);
+	indexed = bench_run(1, dialers, seconds);
+	fprintf(stderr, "dial burst %d devices %d groups %d dialers %d monitors: scan %.0f/s index %.0f/s (x%.1f)\n",
+		BENCH_DEVICES, BENCH_GROUPS, dialers, BENCH_MONITORS, scan, indexed, scan > 0 ? indexed / scan : 0);
+	devsel_destroy(&bench_ds);
+}
+
+struct scale_dev {
+	struct scale_dev	* next;
+	char			id[DEVSEL_ID_SIZE];
+	char			imei[16];
+	char			imsi[16];
+	int			slot;
+};
+
+#/* like find_device_ex() before index */
+static struct scale_dev * scale_find_scan(struct scale_dev * list, const char * id)
+{
+	for(; list; list = list->next)
+	{
+		if(!strcmp(list->id, id))
+			break;
+	}
+	return list;
+}
+
+#/* emulate reload_config() add and discovery keys update of all devices */
+static void scale_add_all(struct devsel * ds, struct scale_dev * devs, int count)
+{
+	int i;
+
+	for(i = 0; i < count; ++i)
+	{
+		devs[i].slot = devsel_add(ds, &devs[i], devs[i].id, i % BENCH_GROUPS);
+		devsel_set_key(ds, devs[i].slot, DEVSEL_HASH_IMEI, devs[i].imei);
+		devsel_set_key(ds, devs[i].slot, DEVSEL_HASH_IMSI, devs[i].imsi);
+	}
+}
+
+#/* */
+void bench_scale(int count)
+{
+	static struct devsel ds;
+	struct scale_dev * devs = calloc(count, sizeof(*devs));
+	struct scale_dev * found;
+	unsigned long hits = 0;
+	long start, add, scan, hash, reload;
+	unsigned seed = 1;
+	int i;
+
+	for(i = 0; i < count; ++i)
+	{
+		snprintf(devs[i].id, sizeof(devs[i].id), "dongle%d", i);
+		snprintf(devs[i].imei, sizeof(devs[i].imei), "35%013d", i);
+		snprintf(devs[i].imsi, sizeof(devs[i].imsi), "25001%010d", i);
+		devs[i].next = i + 1 < count ? &devs[i + 1] : NULL;
+	}
+
+	devsel_init(&ds);
+	start = usec_now();
+	scale_add_all(&ds, devs, count);
+	add = usec_now() - start;
+
+	start = usec_now();
+	for(i = 0; i < SCALE_LOOKUPS; ++i)
+		hits += scale_find_scan(devs, devs[rand_r(&seed) % count].id) != NULL;
+	scan = usec_now() - start;
+
+	start = usec_now();
+	for(i = 0; i < SCALE_LOOKUPS; ++i)
+	{
+		found = &devs[rand_r(&seed) % count];
+		hits += DEVSEL_OWNER(&ds, devsel_lookup(&ds, DEVSEL_HASH_ID, found->id)) == found;
+	}
+	hash = usec_now() - start;
+
+	/* reload: all devices removed and loaded again */
+	start = usec_now();
+	for(i = 0; i < count; ++i)
+		devsel_remove(&ds, devs[i].slot);
+	scale_add_all(&ds, devs, count);
+	reload = usec_now() - start;
+
+	check("scale lookup hits", hits, 2L * SCALE_LOOKUPS);
+	check("scale imsi lookup", devsel_lookup(&ds, DEVSEL_HASH_IMSI, devs[count - 1].imsi), devs[count - 1].slot);
+	fprintf(stderr, "scale %d devices: add %ld us, %d lookups scan %ld us hash %ld us (x%.1f), reload %ld us\n",
+		count, add, SCALE_LOOKUPS, scan, hash, hash > 0 ? (double)scan / hash : 0, reload);
+
+	devsel_destroy(&ds);
+	free(devs);
+}
+
+#/* */
+int main(int argc, char * argv[])
+{
+	int dialers = argc > 1 ? atoi(argv[1]) : 16;
+	int seconds = argc > 2 ? atoi(argv[2]) : 1;
+	int scale = argc > 3 ? atoi(argv[3]) : 2000;
+
+	test_devsel_next();
+	test_devsel_keys();
+	test_devsel_grow();
+	if(scale > 0)
+		bench_scale(scale);
+
+	if(dialers > 0 && seconds > 0)
+		bench_dial_burst(dialers, seconds);
+	return check_done();
+}
@@ -0,0 +1,257 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Tests of dispatch pool and benchmark of received SMS delivery
+     dispatch [messages]
+   Each message is job formatting manager events of SMS with base64 copy.
+   Delivered by thread per message like Local channel of dispatch=local
+   (without cost of channels pair and dialplan), in device thread like
+   events of dispatch=local and dispatch=message, and by dispatch pool of
+   dispatch=manager. Output is messages per second of device thread and
+   until all delivered.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "dispatch.h"
+#include "check.h"			/* check() check_done() */
+
+#define BENCH_TEXT		"Your code 123456. Do not share it with anyone. Bank"
+
+struct test_job {
+	struct dispatch_job	job;
+	char			number[16];
+	char			text[160];
+};
+
+static volatile unsigned long jobs_done;
+static pthread_mutex_t gate_lock = PTHREAD_MUTEX_INITIALIZER;
+static volatile unsigned long sink;
+
+#/* */
+static long usec_now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000L + tv.tv_usec;
+}
+
+#/* like manager_event_new_sms() and manager_event_new_sms_base64() */
+static void job_events(struct dispatch_job * job)
+{
+	static const char b64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	struct test_job * tj = (struct test_job *)job;
+	char base64[256];
+	char event[1024];
+	size_t len = strlen(tj->text);
+	size_t i, o = 0;
+
+	for(i = 0; i < len; i += 3)
+	{
+		unsigned v = (unsigned char)tj->text[i] << 16;
+		if(i + 1 < len)
+			v |= (unsigned char)tj->text[i + 1] << 8;
+		if(i + 2 < len)
+			v |= (unsigned char)tj->text[i + 2];
+		base64[o++] = b64[(v >> 18) & 63];
+		base64[o++] = b64[(v >> 12) & 63];
+		base64[o++] = i + 1 < len ? b64[(v >> 6) & 63] : '=';
+		base64[o++] = i + 2 < len ? b64[v & 63] : '=';
+	}
+	base64[o] = 0;
+
+	sink += snprintf(event, sizeof(event), "Event: DongleNewSMS\r\nDevice: dongle0\r\nFrom: %s\r\nLineCount: 1\r\nMessageLine0: %s\r\n\r\n", tj->number, tj->text);
+	sink += snprintf(event, sizeof(event), "Event: DongleNewSMSBase64\r\nDevice: dongle0\r\nFrom: %s\r\nMessage: %s\r\n\r\n", tj->number, base64);
+
+	free(tj);
+	__sync_fetch_and_add(&jobs_done, 1);
+}
+
+#/* wait in worker until gate unlocked */
+static void job_gate(struct dispatch_job * job)
+{
+	pthread_mutex_lock(&gate_lock);
+	pthread_mutex_unlock(&gate_lock);
+	free(job);
+	__sync_fetch_and_add(&jobs_done, 1);
+}
+
+#/* */
+static struct dispatch_job * job_new(dispatch_run_t run, unsigned seq)
+{
+	struct test_job * tj = calloc(1, sizeof(*tj));
+
+	tj->job.run = run;
+	snprintf(tj->number, sizeof(tj->number), "+7913%06u", seq);
+	snprintf(tj->text, sizeof(tj->text), "%s %u", BENCH_TEXT, seq);
+	return &tj->job;
+}
+
+#/* */
+static void wait_done(unsigned long count)
+{
+	while(jobs_done < count)
+		usleep(100);
+}
+
+#/* */
+void test_pool()
+{
+	struct dispatch_stat stat;
+	unsigned i;
+
+	jobs_done = 0;
+	check("init", dispatch_init(DISPATCH_WORKERS, DISPATCH_LIMIT), 0);
+	for(i = 0; i < 10000; ++i)
+		dispatch_run(job_new(job_events, i));
+	dispatch_fini();
+	dispatch_stat_read(&stat);
+	check("all jobs run", jobs_done, 10000);
+	check("pushed and overflows", stat.pushed + stat.overflows, 10000);
+	check("done by workers", stat.done, stat.pushed);
+	check("queue empty", stat.depth, 0);
+	check("high water in limit", stat.high_water <= DISPATCH_LIMIT, 1);
+	check("workers stopped", stat.workers, 0);
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_overflow()
+{
+	struct dispatch_stat stat;
+	struct dispatch_job * job;
+	unsigned i;
+
+	jobs_done = 0;
+	check("init limit 4", dispatch_init(1, 4), 0);
+
+	/* worker blocked by first job, then queue filled */
+	pthread_mutex_lock(&gate_lock);
+	dispatch_run(job_new(job_gate, 0));
+	do {
+		usleep(100);
+		dispatch_stat_read(&stat);
+	} while(stat.depth);
+	for(i = 1; i <= 4; ++i)
+		check("push", dispatch_push(job_new(job_gate, i)), 0);
+	job = job_new(job_events, 5);
+	check("push to full queue", dispatch_push(job), -1);
+	job->run(job);
+	dispatch_stat_read(&stat);
+	check("depth", stat.depth, 4);
+	check("high water", stat.high_water, 4);
+	check("overflows", stat.overflows, 1);
+	check("run by caller", jobs_done, 1);
+	pthread_mutex_unlock(&gate_lock);
+
+	dispatch_fini();
+	check("all jobs run", jobs_done, 6);
+
+	job = job_new(job_events, 6);
+	check("push after fini", dispatch_push(job), -1);
+	job->run(job);
+	fprintf(stderr, "\n");
+}
+
+#/* pool stopped and started again by reload like dispatch_reconfigure() */
+void test_restart()
+{
+	struct dispatch_stat stat;
+	unsigned i, job;
+
+	jobs_done = 0;
+	dispatch_fini();
+	dispatch_stat_read(&stat);
+	check("fini of stopped pool", stat.workers, 0);
+
+	for(i = 0; i < 3; ++i)
+	{
+		check("restart", dispatch_init(DISPATCH_WORKERS, DISPATCH_LIMIT), 0);
+		dispatch_stat_read(&stat);
+		check("workers started", stat.workers, DISPATCH_WORKERS);
+		for(job = 0; job < 100; ++job)
+			dispatch_run(job_new(job_events, job));
+		dispatch_fini();
+	}
+	check("all jobs run", jobs_done, 300);
+	fprintf(stderr, "\n");
+}
+
+#/* emulate pbx thread of Local channel */
+static void * bench_thread(void * arg)
+{
+	struct dispatch_job * job = arg;
+	job->run(job);
+	return NULL;
+}
+
+#/* */
+static void bench_report(const char * name, unsigned count, long start, long queued, long delivered)
+{
+	fprintf(stderr, "%-20s %8u messages: device thread %10.0f msg/s, delivered %10.0f msg/s\n",
+		name, count, count * 1e6 / (queued - start + 1), count * 1e6 / (delivered - start + 1));
+}
+
+#/* */
+void bench_delivery(unsigned count)
+{
+	pthread_attr_t attr;
+	pthread_t thread;
+	long start, queued;
+	unsigned i;
+
+	/* thread per message */
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	jobs_done = 0;
+	start = usec_now();
+	for(i = 0; i < count; ++i)
+	{
+		while(pthread_create(&thread, &attr, bench_thread, job_new(job_events, i)))
+			usleep(100);
+	}
+	queued = usec_now();
+	wait_done(count);
+	bench_report("thread per message", count, start, queued, usec_now());
+	pthread_attr_destroy(&attr);
+
+	/* in device thread */
+	jobs_done = 0;
+	start = usec_now();
+	for(i = 0; i < count; ++i)
+	{
+		struct dispatch_job * job = job_new(job_events, i);
+		job->run(job);
+	}
+	queued = usec_now();
+	bench_report("device thread", count, start, queued, queued);
+
+	/* pool */
+	jobs_done = 0;
+	dispatch_init(DISPATCH_WORKERS, DISPATCH_LIMIT);
+	start = usec_now();
+	for(i = 0; i < count; ++i)
+		dispatch_run(job_new(job_events, i));
+	queued = usec_now();
+	wait_done(count);
+	bench_report("dispatch pool", count, start, queued, usec_now());
+	dispatch_fini();
+}
+
+#/* */
+int main(int argc, char * argv[])
+{
+	int count = argc > 1 ? atoi(argv[1]) : 20000;
+
+	test_pool();
+	test_overflow();
+	test_restart();
+	if(count > 0)
+		bench_delivery(count);
+
+	return check_done();
+}
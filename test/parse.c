@@ -3,6 +3,7 @@
 #include <stdlib.h>
 
 #include "at_parse.h"			/* at_parse_*() */
+#include "pdu.h"			/* pdu_split() pdu_build_part() */
 #include "mutils.h"			/* ITEMS_OF() */
 
 
@@ -171,6 +172,7 @@ void test_parse_cmgr()
 		str_encoding_t	oa_enc;
 		char		* msg;
 		str_encoding_t	msg_enc;
+		pdu_udh_t	udh;
 	};
 	static const struct test_case {
 		const char	* input;
@@ -183,7 +185,8 @@ void test_parse_cmgr()
 				"+79139131234",
 				STR_ENCODING_7BIT,
 				"041F04400438043204350442",
-				STR_ENCODING_UNKNOWN
+				STR_ENCODING_UNKNOWN,
+				{ 0, 0, 0, 0, 0 }
 			}
 		},
 		{ "+CMGR: \"REC READ\",\"002B00370039003500330037003600310032003000350032\",,\"10/12/05,22:00:04+12\"\r\n041F04400438043204350442", 
@@ -193,7 +196,8 @@ void test_parse_cmgr()
 				"002B00370039003500330037003600310032003000350032", 
 				STR_ENCODING_UNKNOWN,
 				"041F04400438043204350442",
-				STR_ENCODING_UNKNOWN
+				STR_ENCODING_UNKNOWN,
+				{ 0, 0, 0, 0, 0 }
 			}
 		},
 		{ "+CMGR: 0,,106\r\n07911111111100F3040B911111111111F200000121702214952163B1582C168BC562B1984C2693C96432994C369BCD66B3D96C369BD168341A8D46A3D168B55AAD56ABD56AB59ACD66B3D96C369BCD76BBDD6EB7DBED76BBE170381C0E87C3E170B95C2E97CBE572B91C0C0683C16030180C",
@@ -203,7 +207,8 @@ void test_parse_cmgr()
 				"+11111111112",
 				STR_ENCODING_7BIT,
 				"B1582C168BC562B1984C2693C96432994C369BCD66B3D96C369BD168341A8D46A3D168B55AAD56ABD56AB59ACD66B3D96C369BCD76BBDD6EB7DBED76BBE170381C0E87C3E170B95C2E97CBE572B91C0C0683C16030180C",
-				STR_ENCODING_7BIT_HEX
+				STR_ENCODING_7BIT_HEX,
+				{ 0, 0, 0, 0, 99 }
 			} 
 		},
 		{ "+CMGR: 0,,159\r\n07919740430900F3440B912222222220F20008012180004390218C0500030003010031003100310031003100310031003100310031003200320032003200320032003200320032003200330033003300330033003300330033003300330034003400340034003400340034003400340034003500350035003500350035003500350035003500360036003600360036003600360036003600360037003700370037003700370037",
@@ -213,7 +218,19 @@ void test_parse_cmgr()
 				"+22222222022",
 				STR_ENCODING_7BIT,
 				"0031003100310031003100310031003100310031003200320032003200320032003200320032003200330033003300330033003300330033003300330034003400340034003400340034003400340034003500350035003500350035003500350035003500360036003600360036003600360036003600360037003700370037003700370037",
-				STR_ENCODING_UCS2_HEX
+				STR_ENCODING_UCS2_HEX,
+				{ 0, 3, 1, 0, 0 }
+			} 
+		},
+		{ "+CMGR: 0,,30\r\n07911111111100F3440B911111111111F20000012170221495210C050003420201D06536FB0D",
+			{
+				NULL,
+				"050003420201D06536FB0D",
+				"+11111111112",
+				STR_ENCODING_7BIT,
+				"050003420201D06536FB0D",
+				STR_ENCODING_7BIT_HEX,
+				{ 0x42, 2, 1, 7, 12 }
 			} 
 		},
 
@@ -229,7 +246,7 @@ void test_parse_cmgr()
 	for(; idx < ITEMS_OF(cases); ++idx) {
 		result.str = input = strdup(cases[idx].input);
 		fprintf(stderr, "%s(\"%s\")...", "at_parse_cmgr", input);
-		result.res = at_parse_cmgr(&result.str, strlen(result.str), result.oa, sizeof(oa), &result.oa_enc, &result.msg, &result.msg_enc);
+		result.res = at_parse_cmgr(&result.str, strlen(result.str), result.oa, sizeof(oa), &result.oa_enc, &result.msg, &result.msg_enc, &result.udh);
 		if( ((result.res == NULL && result.res == cases[idx].result.res) || strcmp(result.res, cases[idx].result.res) == 0)
 			&&
 		   strcmp(result.str, cases[idx].result.str) == 0
@@ -241,6 +258,172 @@ void test_parse_cmgr()
 		   strcmp(result.msg, cases[idx].result.msg) == 0
 			&&
 		   result.msg_enc == cases[idx].result.msg_enc
+			&&
+		   memcmp(&result.udh, &cases[idx].result.udh, sizeof(result.udh)) == 0
+			) {
+			msg = "OK";
+			ok++;
+		} else {
+			msg = "FAIL";
+			faults++;
+		}
+		fprintf(stderr, " = '%s' ('%s','%s',%d,'%s',%d,%u/%u/%u/%u/%u)\t%s\n", result.res, result.str, result.oa, result.oa_enc, result.msg, result.msg_enc, result.udh.ref, result.udh.seq, result.udh.total, result.udh.skip, result.udh.septets, msg);
+		free(input);
+	}
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_parse_cmgl()
+{
+	static const struct test_case {
+		const char	* input;
+		const char	* res;
+		int		index;
+		const char	* oa;
+		const char	* msg;
+		str_encoding_t	msg_enc;
+	} cases[] = {
+		{ "+CMGL: 3,0,,31\r\n07911234567890F3040B911234556780F20008012150220040210C041F04400438043204350442",
+			NULL,
+			3,
+			"+21435576082",
+			"041F04400438043204350442",
+			STR_ENCODING_UCS2_HEX
+		},
+		{ "+CMGL: 17,\"REC UNREAD\",\"+79139131234\",,\"10/12/05,22:00:04+12\"\r\n041F04400438043204350442",
+			NULL,
+			17,
+			"+79139131234",
+			"041F04400438043204350442",
+			STR_ENCODING_UNKNOWN
+		},
+		{ "+CMGL: ,0,,31\r\n07911234567890F3040B911234556780F20008012150220040210C041F04400438043204350442",
+			"Can't parse index in +CMGL response line",
+			-1,
+			"",
+			NULL,
+			STR_ENCODING_UNKNOWN
+		},
+	};
+
+	unsigned idx = 0;
+	char * input;
+	char * str;
+	const char * res;
+	int index;
+	char oa[200];
+	str_encoding_t oa_enc;
+	char * text;
+	str_encoding_t msg_enc;
+	pdu_udh_t udh;
+	const char * msg;
+
+	for(; idx < ITEMS_OF(cases); ++idx) {
+		str = input = strdup(cases[idx].input);
+		index = -1;
+		oa[0] = 0;
+		text = NULL;
+		msg_enc = STR_ENCODING_UNKNOWN;
+		fprintf(stderr, "%s(\"%s\")...", "at_parse_cmgl", input);
+		res = at_parse_cmgl(&str, strlen(str), &index, oa, sizeof(oa), &oa_enc, &text, &msg_enc, &udh);
+		if( ((res == NULL && cases[idx].res == NULL) || (res && cases[idx].res && strcmp(res, cases[idx].res) == 0))
+			&&
+		   index == cases[idx].index
+			&&
+		   strcmp(oa, cases[idx].oa) == 0
+			&&
+		   ((text == NULL && cases[idx].msg == NULL) || (text && cases[idx].msg && strcmp(text, cases[idx].msg) == 0))
+			&&
+		   msg_enc == cases[idx].msg_enc
+			) {
+			msg = "OK";
+			ok++;
+		} else {
+			msg = "FAIL";
+			faults++;
+		}
+		fprintf(stderr, " = '%s' (%d,'%s','%s',%d)\t%s\n", res, index, oa, text, msg_enc, msg);
+		free(input);
+	}
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_parse_cmt()
+{
+	static const struct test_case {
+		const char	* input;
+		const char	* res;
+		const char	* oa;
+		const char	* msg;
+		str_encoding_t	msg_enc;
+		pdu_udh_t	udh;
+	} cases[] = {
+		{ "+CMT: ,31\r\n07911234567890F3040B911234556780F20008012150220040210C041F04400438043204350442",
+			NULL,
+			"+21435576082",
+			"041F04400438043204350442",
+			STR_ENCODING_UCS2_HEX,
+			{ 0, 0, 0, 0, 0 }
+		},
+		{ "+CMT: \"Ivan, Petrov\",30\r\n07911111111100F3440B911111111111F20000012170221495210C050003420201D06536FB0D",
+			NULL,
+			"+11111111112",
+			"050003420201D06536FB0D",
+			STR_ENCODING_7BIT_HEX,
+			{ 0x42, 2, 1, 7, 12 }
+		},
+		{ "+CMT: ,32\r\n07911234567890F3040B911234556780F20008012150220040210C041F04400438043204350442",
+			"TPDU length not matched with actual length",
+			"",
+			NULL,
+			STR_ENCODING_UNKNOWN,
+			{ 0, 0, 0, 0, 0 }
+		},
+		{ "+CMT: ,x31\r\n07911234567890F3040B911234556780F20008012150220040210C041F04400438043204350442",
+			"Invalid TPDU length in CMT PDU status line",
+			"",
+			NULL,
+			STR_ENCODING_UNKNOWN,
+			{ 0, 0, 0, 0, 0 }
+		},
+		{ "+CMT: 31",
+			"Can't parse +CMT response line",
+			"",
+			NULL,
+			STR_ENCODING_UNKNOWN,
+			{ 0, 0, 0, 0, 0 }
+		},
+	};
+
+	unsigned idx = 0;
+	char * input;
+	char * str;
+	const char * res;
+	char oa[200];
+	str_encoding_t oa_enc;
+	char * text;
+	str_encoding_t msg_enc;
+	pdu_udh_t udh;
+	const char * msg;
+
+	for(; idx < ITEMS_OF(cases); ++idx) {
+		str = input = strdup(cases[idx].input);
+		oa[0] = 0;
+		text = NULL;
+		msg_enc = STR_ENCODING_UNKNOWN;
+		fprintf(stderr, "%s(\"%s\")...", "at_parse_cmt", input);
+		res = at_parse_cmt(&str, strlen(str), oa, sizeof(oa), &oa_enc, &text, &msg_enc, &udh);
+		if( ((res == NULL && cases[idx].res == NULL) || (res && cases[idx].res && strcmp(res, cases[idx].res) == 0))
+			&&
+		   strcmp(oa, cases[idx].oa) == 0
+			&&
+		   ((text == NULL && cases[idx].msg == NULL) || (text && cases[idx].msg && strcmp(text, cases[idx].msg) == 0))
+			&&
+		   msg_enc == cases[idx].msg_enc
+			&&
+		   memcmp(&udh, &cases[idx].udh, sizeof(udh)) == 0
 			) {
 			msg = "OK";
 			ok++;
@@ -248,7 +431,7 @@ void test_parse_cmgr()
 			msg = "FAIL";
 			faults++;
 		}
-		fprintf(stderr, " = '%s' ('%s','%s',%d,'%s',%d)\t%s\n", result.res, result.str, result.oa, result.oa_enc, result.msg, result.msg_enc, msg);
+		fprintf(stderr, " = '%s' ('%s','%s',%d,%u/%u/%u/%u/%u)\t%s\n", res, oa, text, msg_enc, udh.ref, udh.seq, udh.total, udh.skip, udh.septets, msg);
 		free(input);
 	}
 	fprintf(stderr, "\n");
@@ -390,6 +573,106 @@ void test_parse_ccwa()
 {
 }
 
+#/* append count copies of unit */
+static char * repeat(char * buf, const char * unit, unsigned count)
+{
+	size_t len = strlen(unit);
+
+	for(; count; --count, buf += len)
+		memcpy(buf, unit, len);
+	*buf = 0;
+	return buf;
+}
+
+#/* */
+void test_pdu_split()
+{
+	static const struct test_case {
+		const char	* head;
+		unsigned	head_count;
+		const char	* middle;
+		unsigned	tail_count;
+		int		ref16;
+		int		parts;
+		unsigned	offset1;
+	} cases[] = {
+		{ "a", 160, "", 0, 0, 1, 160 },
+		{ "a", 161, "", 0, 0, 2, 153 },
+		{ "a", 161, "", 0, 1, 2, 152 },
+		{ "a", 152, "{", 10, 0, 2, 152 },
+		{ "a", 150, "^", 8, 0, 1, 159 },
+		{ "\xD1\x8F", 70, "", 0, 0, 1, 140 },
+		{ "\xD1\x8F", 71, "", 0, 0, 2, 134 },
+		{ "\xD1\x8F", 71, "", 0, 1, 2, 132 },
+		{ "\xD1\x8F", 66, "\xF0\x9F\x98\x80", 10, 0, 2, 132 },
+		{ "a", 153 * PDU_MAX_PARTS, "", 0, 0, PDU_MAX_PARTS, 153 },
+		{ "a", 153 * PDU_MAX_PARTS + 1, "", 0, 0, -7, 0 },
+	};
+	static char input[8192];
+	unsigned idx = 0;
+	pdu_parts_t parts;
+	int res;
+	const char * msg;
+
+	for(; idx < ITEMS_OF(cases); ++idx) {
+		repeat(repeat(repeat(input, cases[idx].head, cases[idx].head_count), cases[idx].middle, 1), "a", cases[idx].tail_count);
+		fprintf(stderr, "%s(%u x \"%s\" \"%s\" %u x \"a\", %d)...", "pdu_split", cases[idx].head_count, cases[idx].head, cases[idx].middle, cases[idx].tail_count, cases[idx].ref16);
+		res = pdu_split(input, cases[idx].ref16, &parts);
+		if(res == cases[idx].parts && (res < 0 || parts.offset[1] == cases[idx].offset1)) {
+			msg = "OK";
+			ok++;
+		} else {
+			msg = "FAIL";
+			faults++;
+		}
+		fprintf(stderr, " = %d (%u)\t%s\n", res, res < 0 ? 0 : parts.offset[1], msg);
+	}
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_pdu_build()
+{
+	static const struct test_case {
+		const char	* head;
+		unsigned	head_count;
+		int		ref16;
+		unsigned	part;
+		const char	* result;
+	} cases[] = {
+		{ "a", 10, 0, 0, "0011000B919731191332F40000A90AE170381C0E87C3E130" },
+		{ "a", 161, 0, 0, "0051000B919731191332F40000A9A0050003420201C2E170381C0E87C3E170381C0E87C3E1" },
+		{ "a", 161, 0, 1, "0051000B919731191332F40000A90F050003420202C2E170" },
+		{ "a", 161, 1, 0, "0051000B919731191332F40000A9A006080401420201E170381C0E87C3E170" },
+		{ "a", 161, 1, 1, "0051000B919731191332F40000A91106080401420202E170" },
+		{ "\xD1\x8F", 71, 1, 0, "0051000B919731191332F40008A98B06080401420201044F044F" },
+		{ "\xD1\x8F", 71, 0, 1, "0051000B919731191332F40008A90E050003420202044F044F044F044F" },
+	};
+	static char input[8192];
+	char pdu[2048];
+	unsigned idx = 0;
+	pdu_parts_t parts;
+	int res;
+	const char * msg;
+
+	for(; idx < ITEMS_OF(cases); ++idx) {
+		repeat(input, cases[idx].head, cases[idx].head_count);
+		fprintf(stderr, "%s(%u x \"%s\", %d, %u)...", "pdu_build_part", cases[idx].head_count, cases[idx].head, cases[idx].ref16, cases[idx].part);
+		res = pdu_split(input, cases[idx].ref16, &parts);
+		if(res > 0)
+			res = pdu_build_part(pdu, sizeof(pdu), "", "+79139131234", input, 3 * 24 * 60, 0, &parts, cases[idx].part, 0x0142);
+		if(res > 0 && strncmp(pdu, cases[idx].result, strlen(cases[idx].result)) == 0) {
+			msg = "OK";
+			ok++;
+		} else {
+			msg = "FAIL";
+			faults++;
+		}
+		fprintf(stderr, " = %d \"%.*s\"\t%s\n", res, res > 0 ? (int)strlen(cases[idx].result) : 0, pdu, msg);
+	}
+	fprintf(stderr, "\n");
+}
+
 #/* */
 int main()
 {
@@ -398,6 +681,8 @@ int main()
 	test_parse_creg();
 	test_parse_cmti();
 	test_parse_cmgr();
+	test_parse_cmgl();
+	test_parse_cmt();
 	test_parse_cusd();
 	test_parse_cpin();
 	test_parse_csq();
@@ -406,6 +691,8 @@ int main()
 	test_parse_csca();
 	test_parse_clcc();
 	test_parse_ccwa();
+	test_pdu_split();
+	test_pdu_build();
 	
 	fprintf(stderr, "done %d tests: %d OK %d FAILS\n", ok + faults, ok, faults);
 	return 0;
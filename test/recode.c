@@ -0,0 +1,415 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Tests of GSM 03.38 7-bit, UCS-2 and base64 codecs
+     recode [iterations]
+   Vectors of packing, escapes, padding and surrogate pairs, then round trip
+   fuzz: random septets packed by reference bit loop decoded and encoded
+   back, random UTF-8 text encoded and decoded back and compared with
+   reference UTF-16, random bytes compared with reference base64, random
+   hex digits decoded.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "char_conv.h"
+#include "mutils.h"			/* ITEMS_OF() */
+#include "check.h"			/* check_str() check_done() */
+
+#/* */
+static void fail(const char * name, unsigned iteration, const char * what)
+{
+	fprintf(stderr, "%s iteration %u: %s\tFAIL\n", name, iteration, what);
+	faults++;
+}
+
+#/* */
+void test_vectors()
+{
+	static const struct {
+		recode_direction_t	dir;
+		const char		* in;
+		const char		* out;
+	} cases[] = {
+		{ RECODE_ENCODE, "hellohello", "E8329BFD4697D9EC37" },
+		{ RECODE_DECODE, "E8329BFD4697D9EC37", "hellohello" },
+		{ RECODE_ENCODE, "@", "00" },
+		{ RECODE_ENCODE, "\xE2\x82\xAC", "9B32" },				/* euro sign escaped */
+		{ RECODE_DECODE, "9B32", "\xE2\x82\xAC" },
+		{ RECODE_ENCODE, "$_[", "82C88607" },
+		{ RECODE_DECODE, "82C88607", "$_[" },
+		{ RECODE_ENCODE, "\xC3\xA9\xCE\xA9\xC3\x9C", "858A17" },		/* e acute, omega, U umlaut */
+		{ RECODE_DECODE, "858A17", "\xC3\xA9\xCE\xA9\xC3\x9C" },
+		{ RECODE_ENCODE, "1234567", "31D98C56B3DD1A" },			/* 7 spare bits padded by CR */
+		{ RECODE_DECODE, "31D98C56B3DD1A", "1234567" },
+		{ RECODE_DECODE, "31D98C56B3DD00", "1234567@" },			/* '@' of zero septet kept */
+		{ RECODE_DECODE, "9B20", "A" },					/* escape not in extension table */
+		{ RECODE_DECODE, "1B", "" },						/* escape at end */
+	};
+	char out[256];
+	char name[64];
+	unsigned idx;
+	ssize_t res;
+
+	for(idx = 0; idx < ITEMS_OF(cases); ++idx)
+	{
+		res = str_recode(cases[idx].dir, STR_ENCODING_7BIT_HEX, cases[idx].in, strlen(cases[idx].in), out, sizeof(out));
+		if(res < 0)
+			snprintf(out, sizeof(out), "error %d", (int)res);
+		snprintf(name, sizeof(name), "%s %s", cases[idx].dir == RECODE_ENCODE ? "encode" : "decode", cases[idx].in);
+		check_str(name, out, cases[idx].out);
+	}
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_ucs2()
+{
+	static const struct {
+		recode_direction_t	dir;
+		const char		* in;
+		size_t			out_size;
+		const char		* out;
+	} cases[] = {
+		{ RECODE_ENCODE, "Hi", 256, "00480069" },
+		{ RECODE_ENCODE, "123456789", 256, "003100320033003400350036003700380039" },
+		{ RECODE_ENCODE, "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82", 256, "041F04400438043204350442" },
+		{ RECODE_ENCODE, "\xe2\x82\xac", 256, "20AC" },
+		{ RECODE_ENCODE, "a\xf0\x9f\x98\x80", 256, "0061D83DDE00" },			/* surrogate pair */
+		{ RECODE_DECODE, "041F04400438043204350442", 256, "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82" },
+		{ RECODE_DECODE, "041f0440", 256, "\xd0\x9f\xd1\x80" },
+		{ RECODE_DECODE, "0061D83DDE00", 256, "a\xf0\x9f\x98\x80" },
+		{ RECODE_DECODE, "00480069", 256, "Hi" },
+		{ RECODE_DECODE, "D83D", 256, "error -22" },					/* high surrogate at end */
+		{ RECODE_DECODE, "DE000041", 256, "error -22" },				/* low surrogate first */
+		{ RECODE_DECODE, "D83D0041", 256, "error -22" },				/* high surrogate without low */
+		{ RECODE_DECODE, "004", 256, "error -22" },
+		{ RECODE_DECODE, "00G1", 256, "error -22" },
+		{ RECODE_ENCODE, "\xc3", 256, "error -22" },
+		{ RECODE_ENCODE, "\xed\xa0\x80", 256, "error -22" },				/* surrogate in UTF-8 */
+		{ RECODE_ENCODE, "Hi", 8, "error -12" },
+		{ RECODE_ENCODE, "Hi", 9, "00480069" },
+		{ RECODE_ENCODE, "123456789", 36, "error -12" },
+		{ RECODE_DECODE, "041F", 2, "error -12" },
+		{ RECODE_DECODE, "041F", 3, "\xd0\x9f" },
+		{ RECODE_DECODE, "D83DDE00", 4, "error -12" },
+	};
+	char out[256];
+	char name[64];
+	unsigned idx;
+	ssize_t res;
+
+	for(idx = 0; idx < ITEMS_OF(cases); ++idx)
+	{
+		res = str_recode(cases[idx].dir, STR_ENCODING_UCS2_HEX, cases[idx].in, strlen(cases[idx].in), out, cases[idx].out_size);
+		if(res < 0)
+			snprintf(out, sizeof(out), "error %d", (int)res);
+		snprintf(name, sizeof(name), "ucs2 %s %s", cases[idx].dir == RECODE_ENCODE ? "encode" : "decode", cases[idx].in);
+		check_str(name, out, cases[idx].out);
+	}
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_base64()
+{
+	static const struct {
+		const char	* in;
+		size_t		out_size;
+		const char	* out;
+	} cases[] = {
+		{ "", 1, "" },
+		{ "f", 5, "Zg==" },
+		{ "fo", 5, "Zm8=" },
+		{ "foo", 5, "Zm9v" },
+		{ "foob", 9, "Zm9vYg==" },
+		{ "fooba", 9, "Zm9vYmE=" },
+		{ "foobar", 9, "Zm9vYmFy" },
+		{ "foobar!", 13, "Zm9vYmFyIQ==" },
+		{ "\xff\xfe\xfd\xfc\xfb\xfa\xf9\xf8", 13, "//79/Pv6+fg=" },
+		{ "\xd0\x9f\xd1\x80\xd0\xb8\xd0\xb2\xd0\xb5\xd1\x82", 17, "0J/RgNC40LLQtdGC" },
+		{ "foobar", 8, "error -12" },
+		{ "f", 4, "error -12" },
+		{ "", 0, "error -12" },
+	};
+	char out[256];
+	char name[64];
+	unsigned idx;
+	ssize_t res;
+
+	for(idx = 0; idx < ITEMS_OF(cases); ++idx)
+	{
+		res = base64_encode(cases[idx].in, strlen(cases[idx].in), out, cases[idx].out_size);
+		if(res < 0)
+			snprintf(out, sizeof(out), "error %d", (int)res);
+		else if((size_t)res + 1 != BASE64_SIZE(strlen(cases[idx].in)))
+			snprintf(out, sizeof(out), "size %d", (int)res);
+		snprintf(name, sizeof(name), "base64 '%s' size %u", cases[idx].in, (unsigned)cases[idx].out_size);
+		check_str(name, out, cases[idx].out);
+	}
+	fprintf(stderr, "\n");
+}
+
+#/* reference base64 by 3 octets */
+static void base64_reference(const unsigned char * in, size_t len, char * out)
+{
+	static const char chars[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t idx;
+	unsigned v;
+
+	for(idx = 0; idx < len; idx += 3)
+	{
+		v = in[idx] << 16;
+		if(idx + 1 < len)
+			v |= in[idx + 1] << 8;
+		if(idx + 2 < len)
+			v |= in[idx + 2];
+		*out++ = chars[(v >> 18) & 63];
+		*out++ = chars[(v >> 12) & 63];
+		*out++ = idx + 1 < len ? chars[(v >> 6) & 63] : '=';
+		*out++ = idx + 2 < len ? chars[v & 63] : '=';
+	}
+	*out = 0;
+}
+
+#/* */
+void test_udh()
+{
+	char out[256];
+	unsigned septets;
+	ssize_t res;
+
+	/* UDH of concatenated SMS take 7 septets, text after it */
+	res = gsm7_decode_hex("050003420201D06536FB0D", 22, 7, 12, out, sizeof(out));
+	if(res < 0)
+		snprintf(out, sizeof(out), "error %d", (int)res);
+	check_str("decode skip UDH", out, "hello");
+
+	res = gsm7_encode_hex("hello", 5, 7, out, sizeof(out), &septets);
+	if(res < 0)
+		snprintf(out, sizeof(out), "error %d", (int)res);
+	check_str("encode after UDH", out, "000000000000D06536FB0D");
+	snprintf(out, sizeof(out), "%u", septets);
+	check_str("septets with UDH", out, "12");
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_errors()
+{
+	static const struct {
+		const char	* name;
+		recode_direction_t	dir;
+		const char	* in;
+		size_t		out_size;
+		ssize_t		res;
+	} cases[] = {
+		{ "not in alphabet", RECODE_ENCODE, "`", 16, -EINVAL },
+		{ "cyrillic", RECODE_ENCODE, "\xD1\x8F", 16, -EINVAL },
+		{ "invalid UTF-8", RECODE_ENCODE, "\xC3", 16, -EINVAL },
+		{ "invalid hex", RECODE_DECODE, "E832XB", 16, -EINVAL },
+		{ "encode no space", RECODE_ENCODE, "hellohello", 18, -ENOMEM },
+		{ "encode fit", RECODE_ENCODE, "hellohello", 19, 18 },
+		{ "decode no space", RECODE_DECODE, "E8329BFD4697D9EC37", 10, -ENOMEM },
+		{ "decode fit", RECODE_DECODE, "E8329BFD4697D9EC37", 11, 10 },
+	};
+	static const struct {
+		const char	* in;
+		str_encoding_t	encoding;
+	} encodings[] = {
+		{ "hello", STR_ENCODING_7BIT_HEX },
+		{ "\xC3\xA9\xE2\x82\xAC[", STR_ENCODING_7BIT_HEX },
+		{ "hello`", STR_ENCODING_UCS2_HEX },
+		{ "\xD1\x8F", STR_ENCODING_UCS2_HEX },
+	};
+	char out[256];
+	char result[32];
+	char expected[32];
+	unsigned idx;
+
+	for(idx = 0; idx < ITEMS_OF(cases); ++idx)
+	{
+		snprintf(result, sizeof(result), "%d", (int)str_recode(cases[idx].dir, STR_ENCODING_7BIT_HEX, cases[idx].in, strlen(cases[idx].in), out, cases[idx].out_size));
+		snprintf(expected, sizeof(expected), "%d", (int)cases[idx].res);
+		check_str(cases[idx].name, result, expected);
+	}
+	for(idx = 0; idx < ITEMS_OF(encodings); ++idx)
+	{
+		snprintf(result, sizeof(result), "%d", get_encoding(RECODE_ENCODE, encodings[idx].in, strlen(encodings[idx].in)));
+		snprintf(expected, sizeof(expected), "%d", encodings[idx].encoding);
+		check_str(encodings[idx].in, result, expected);
+	}
+	fprintf(stderr, "\n");
+}
+
+#/* reference packing bit by bit */
+static void pack_reference(const unsigned char * septets, unsigned count, char * out)
+{
+	unsigned char octets[512];
+	unsigned bits = count * 7;
+	unsigned bit;
+	unsigned idx;
+
+	memset(octets, 0, sizeof(octets));
+	for(bit = 0; bit < bits; ++bit)
+		if(septets[bit / 7] & (1 << (bit % 7)))
+			octets[bit / 8] |= 1 << (bit % 8);
+	for(idx = 0; idx < (bits + 7) / 8; ++idx)
+		sprintf(out + idx * 2, "%02X", octets[idx]);
+	out[idx * 2] = 0;
+}
+
+#/* random septets, escape only before character of extension table */
+static unsigned random_septets(unsigned char * septets, unsigned max)
+{
+	static const unsigned char extension[] = { 0x0A, 0x14, 0x28, 0x29, 0x2F, 0x3C, 0x3D, 0x3E, 0x40, 0x65 };
+	unsigned count = rand() % (max + 1);
+	unsigned idx;
+
+	for(idx = 0; idx < count; ++idx)
+	{
+		septets[idx] = rand() % 128;
+		if(septets[idx] == 0x1B)
+		{
+			if(idx + 1 < count)
+				septets[++idx] = extension[rand() % ITEMS_OF(extension)];
+			else
+				septets[idx] = ' ';
+		}
+	}
+	return count;
+}
+
+#/* */
+void test_fuzz(unsigned iterations)
+{
+	unsigned char septets[320];
+	char packed[1024];
+	char text[1024];
+	char encoded[1024];
+	char decoded[1024];
+	char utf16[1024];
+	unsigned count;
+	unsigned encoded_septets;
+	unsigned iteration;
+	unsigned idx;
+	unsigned bytes;
+	unsigned ucs;
+	unsigned failed = faults;
+	size_t len;
+	ssize_t res;
+
+	srand(20101205);
+	for(iteration = 0; iteration < iterations; ++iteration)
+	{
+		/* septets -> reference hex -> UTF-8 -> hex */
+		count = random_septets(septets, 200);
+		pack_reference(septets, count, packed);
+		res = gsm7_decode_hex(packed, strlen(packed), 0, count, text, sizeof(text));
+		if(res < 0)
+		{
+			fail("septets", iteration, "decode error");
+			continue;
+		}
+		res = gsm7_encode_hex(text, res, 0, encoded, sizeof(encoded), &encoded_septets);
+		if(res < 0 || encoded_septets != count || strcmp(encoded, packed))
+			fail("septets", iteration, packed);
+
+		/* random UTF-8 -> hex -> UTF-8, reference UTF-16 */
+		len = 0;
+		utf16[0] = 0;
+		count = rand() % 100;
+		for(idx = 0; idx < count; ++idx)
+		{
+			ucs = rand() % 4 ? rand() % 0x100 : rand() % 8 ? rand() % 0x10000 : 0x10000 + rand() % 0x100000;
+			if(ucs == 0 || (ucs >= 0xD800 && ucs < 0xE000))
+				ucs = 'x';
+			if(ucs < 0x80)
+				text[len++] = ucs;
+			else if(ucs < 0x800)
+			{
+				text[len++] = 0xC0 | (ucs >> 6);
+				text[len++] = 0x80 | (ucs & 0x3F);
+			}
+			else if(ucs < 0x10000)
+			{
+				text[len++] = 0xE0 | (ucs >> 12);
+				text[len++] = 0x80 | ((ucs >> 6) & 0x3F);
+				text[len++] = 0x80 | (ucs & 0x3F);
+			}
+			else
+			{
+				text[len++] = 0xF0 | (ucs >> 18);
+				text[len++] = 0x80 | ((ucs >> 12) & 0x3F);
+				text[len++] = 0x80 | ((ucs >> 6) & 0x3F);
+				text[len++] = 0x80 | (ucs & 0x3F);
+			}
+			if(ucs < 0x10000)
+				sprintf(utf16 + strlen(utf16), "%04X", ucs);
+			else
+				sprintf(utf16 + strlen(utf16), "%04X%04X", 0xD800 + ((ucs - 0x10000) >> 10), 0xDC00 + ((ucs - 0x10000) & 0x3FF));
+		}
+		text[len] = 0;
+		res = str_recode(RECODE_ENCODE, STR_ENCODING_UCS2_HEX, text, len, encoded, sizeof(encoded));
+		if(res < 0 || strcmp(encoded, utf16))
+			fail("ucs2", iteration, "encoded text differ");
+		else if(str_recode(RECODE_DECODE, STR_ENCODING_UCS2_HEX, encoded, res, decoded, sizeof(decoded)) != (ssize_t)len || strcmp(decoded, text))
+			fail("ucs2", iteration, "decoded text differ");
+		res = gsm7_encode_hex(text, len, 0, encoded, sizeof(encoded), &encoded_septets);
+		if(get_encoding(RECODE_ENCODE, text, len) == STR_ENCODING_7BIT_HEX)
+		{
+			count = 0;
+			for(idx = 0; idx < len; idx += bytes)
+				count += gsm7_char_septets(text + idx, len - idx, &bytes);
+			if(res < 0 || encoded_septets != count)
+				fail("text", iteration, "encode error");
+			else if(gsm7_decode_hex(encoded, res, 0, encoded_septets, decoded, sizeof(decoded)) < 0 || strcmp(decoded, text))
+				fail("text", iteration, "decoded text differ");
+		}
+		else if(res != -EINVAL)
+		{
+			fail("text", iteration, "character not in alphabet encoded");
+		}
+
+		/* random bytes -> base64 */
+		len = rand() % 300;
+		for(idx = 0; idx < len; ++idx)
+			text[idx] = rand();
+		base64_reference((const unsigned char *)text, len, utf16);
+		res = base64_encode(text, len, encoded, BASE64_SIZE(len));
+		if(res < 0 || strcmp(encoded, utf16))
+			fail("base64", iteration, "encoded text differ");
+
+		/* random hex digits */
+		len = rand() % 400;
+		for(idx = 0; idx < len; ++idx)
+			packed[idx] = "0123456789ABCDEF"[rand() % 16];
+		res = gsm7_decode_hex(packed, len, rand() % 8, 0, decoded, 1 + rand() % 600);
+		if(res >= 0 && strlen(decoded) != (size_t)res)
+			fail("hex", iteration, "length of decoded text");
+		res = str_recode(RECODE_DECODE, STR_ENCODING_UCS2_HEX, packed, len & ~3, decoded, 1 + rand() % 600);
+		if(res >= 0 && strlen(decoded) > (size_t)res)
+			fail("hex", iteration, "length of decoded UCS-2");
+	}
+	if(faults == (int)failed)
+	{
+		fprintf(stderr, "fuzz %u iterations\tOK\n", iterations);
+		ok++;
+	}
+	fprintf(stderr, "\n");
+}
+
+#/* */
+int main(int argc, char * argv[])
+{
+	test_vectors();
+	test_ucs2();
+	test_base64();
+	test_udh();
+	test_errors();
+	test_fuzz(argc > 1 ? (unsigned)atoi(argv[1]) : 100000);
+
+	return check_done();
+}
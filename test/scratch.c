@@ -0,0 +1,109 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Tests of scratch memory of received message
+     scratch
+   Arena of 64 bytes filled by buffers of stages, requests not fit served
+   by heap, then all released by scratch_reset() and high water checked.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "scratch.h"
+#include "check.h"			/* check() check_done() */
+
+#/* */
+void test_arena()
+{
+	char buf[64];
+	struct scratch sc;
+	char * first;
+	char * second;
+	char * copy;
+
+	scratch_init(&sc, buf, sizeof(buf));
+	first = scratch_alloc(&sc, 16);
+	second = scratch_alloc(&sc, 32);
+	check("first at start of arena", first - buf, 0);
+	check("second after first", second - buf, 16);
+	copy = scratch_strndup(&sc, "0123456789", 5);
+	check("copy in arena", copy - buf, 48);
+	check("copy terminated", strcmp(copy, "01234"), 0);
+	check("used", sc.used, 54);
+	check("arena full", scratch_alloc(&sc, 10) == buf + 54, 1);
+	check("no heap", sc.stat.heap_allocs, 0);
+
+	scratch_reset(&sc);
+	check("used after reset", sc.used, 0);
+	check("high water", sc.stat.high_water, 64);
+	check("reused from start", scratch_alloc(&sc, 8) == buf, 1);
+	scratch_reset(&sc);
+	check("high water kept", sc.stat.high_water, 64);
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_heap()
+{
+	char buf[64];
+	struct scratch sc;
+	char * big;
+	char * small;
+	char * huge;
+
+	scratch_init(&sc, buf, sizeof(buf));
+	scratch_alloc(&sc, 40);
+	big = scratch_alloc(&sc, 1000);
+	check("big not in arena", big >= buf && big < buf + sizeof(buf), 0);
+	memset(big, 'x', 1000);
+	small = scratch_alloc(&sc, 24);
+	check("small still in arena", small - buf, 40);
+	scratch_strndup(&sc, big, 100);
+	check("heap allocations", sc.stat.heap_allocs, 2);
+	check("heap bytes", sc.heap, 1101);
+	huge = scratch_alloc(&sc, (size_t)-1);
+	check("huge failed", huge == NULL, 1);
+	check("failures", sc.stat.failures, 1);
+
+	scratch_reset(&sc);
+	check("heap after reset", sc.heap, 0);
+	check("heap high water", sc.stat.heap_high_water, 1101);
+	check("arena high water", sc.stat.high_water, 64);
+	fprintf(stderr, "\n");
+}
+
+#/* */
+static void stack_leaf(struct scratch * sc)
+{
+	char frame[512];
+
+	memset(frame, 0, sizeof(frame));
+	scratch_stack_mark(sc, frame);
+}
+
+#/* */
+void test_stack()
+{
+	int base;
+	struct scratch sc;
+
+	scratch_init(&sc, NULL, 0);
+	scratch_stack_mark(&sc, &sc);
+	check("no mark without base", sc.stat.stack_high_water, 0);
+	scratch_stack_base(&sc, &base);
+	stack_leaf(&sc);
+	check("depth of leaf frame", sc.stat.stack_high_water > 0, 1);
+	check("depth in range", sc.stat.stack_high_water < 4096, 1);
+	fprintf(stderr, "\n");
+}
+
+#/* */
+int main()
+{
+	test_arena();
+	test_heap();
+	test_stack();
+
+	return check_done();
+}
@@ -0,0 +1,325 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Tests of device status snapshots and monitoring poll benchmark
+     status [devices] [seconds]
+   pvt_status_fill(), pvt_status_update() and pvt_status_read() checked on
+   struct pvt, including read overlapped by writer.
+   Each device thread emulate call load: hold device lock while handle AT response
+   and audio frame, change state and publish snapshot like pvt_state_publish().
+   Monitor thread poll status of all devices at 1 kHz like frequent AMI DongleShowDevices,
+   devicestate and DongleStatus, first with lock of each device, then from snapshots.
+*/
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "chan_dongle.h"		/* struct pvt pvt_status_fill() pvt_status_update() pvt_status_read() */
+#include "check.h"			/* check() check_str() check_done() */
+
+#define BENCH_HOLD_USEC		200
+#define BENCH_POLL_USEC		1000
+
+struct bench_dev {
+	pthread_mutex_t		lock;				/*!< like pvt lock, ast_mutex_t need asterisk binary */
+	struct pvt		pvt;
+};
+
+static struct bench_dev * devs;
+static int ndevs;
+static volatile int bench_stop;
+
+#/* */
+EXPORT_DEF const char * pvt_str_state(const struct pvt * pvt)
+{
+	return pvt->connected ? "Free" : "Not connected";
+}
+
+#/* */
+EXPORT_DEF int pvt_enabled(const struct pvt * pvt)
+{
+	return pvt->current_state == DEV_STATE_STARTED;
+}
+
+#/* */
+EXPORT_DEF int is_dial_possible(const struct pvt * pvt, attribute_unused int opts)
+{
+	return pvt->connected && pvt->gsm_registered;
+}
+
+#/* */
+static long usec_now()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000000L + tv.tv_usec;
+}
+
+#/* change fields of device what must be seen together: imsi is sum of rssi and chansno */
+static void device_change(struct pvt * pvt, int rssi, unsigned chansno)
+{
+	pvt->rssi = rssi;
+	PVT_STATE(pvt, chansno) = chansno;
+	snprintf(pvt->provider_name, sizeof(pvt->provider_name), "PROVIDER%d", rssi);
+	snprintf(pvt->imsi, sizeof(pvt->imsi), "%u", rssi + chansno);
+}
+
+#/* return non-zero if fields of snapshot not from same device_change() */
+static int status_torn(const pvt_status_t * status)
+{
+	char provider[sizeof(status->provider_name)];
+
+	snprintf(provider, sizeof(provider), "PROVIDER%d", status->rssi);
+	return strcmp(provider, status->provider_name) || (unsigned)atoi(status->imsi) != status->rssi + status->state.chansno;
+}
+
+#/* */
+void test_seqlock()
+{
+	seqlock_t lock = { 0 };
+	unsigned seq;
+
+	seq = seqlock_read_begin(&lock);
+	check("read without writer", seqlock_read_retry(&lock, seq), 0);
+
+	seqlock_write_begin(&lock);
+	check("writer active", lock.seq & 1, 1);
+	seqlock_write_end(&lock);
+	check("retry after write", seqlock_read_retry(&lock, seq), 1);
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_status_fill()
+{
+	struct pvt * pvt = calloc(1, sizeof(*pvt));
+	pvt_status_t status;
+	unsigned seq;
+
+	device_change(pvt, 17, 2);
+	snprintf(pvt->imei, sizeof(pvt->imei), "351234567890123");
+	pvt->connected = 1;
+	pvt->gsm_registered = 1;
+	pvt->has_voice = 1;
+	pvt->current_state = DEV_STATE_STARTED;
+
+	pvt_status_fill(pvt, &status);
+	check("fill rssi", status.rssi, 17);
+	check("fill chansno", status.state.chansno, 2);
+	check_str("fill provider", status.provider_name, "PROVIDER17");
+	check_str("fill imei", status.imei, "351234567890123");
+	check_str("fill str_state", status.str_state, "Free");
+	check("fill enabled", status.enabled, 1);
+	check("fill dial possible", status.dial_possible, 1);
+	check("fill has voice", status.has_voice, 1);
+
+	check_str("read before publish", pvt->status.provider_name, "");
+	pvt_status_update(pvt);
+	seq = pvt->status_lock.seq;
+	check("publish", seq, 2);
+	pvt_status_update(pvt);
+	check("publish unchanged", pvt->status_lock.seq, seq);
+
+	pvt_status_read(pvt, &status);
+	check_str("read provider", status.provider_name, "PROVIDER17");
+	check("read torn", status_torn(&status), 0);
+
+	pvt->connected = 0;
+	pvt_status_update(pvt);
+	check("publish changed", pvt->status_lock.seq, seq + 2);
+	pvt_status_read(pvt, &status);
+	check_str("read changed str_state", status.str_state, "Not connected");
+	check("read changed dial possible", status.dial_possible, 0);
+
+	free(pvt);
+	fprintf(stderr, "\n");
+}
+
+struct overlap_reader {
+	const struct pvt	* pvt;
+	pvt_status_t		status;
+	volatile int		done;
+};
+
+#/* */
+static void * overlap_read(void * arg)
+{
+	struct overlap_reader * reader = arg;
+
+	pvt_status_read(reader->pvt, &reader->status);
+	reader->done = 1;
+	return NULL;
+}
+
+#/* reader started while writer in middle of update must wait and see new snapshot */
+void test_status_overlap()
+{
+	struct pvt * pvt = calloc(1, sizeof(*pvt));
+	struct overlap_reader reader;
+	pvt_status_t status;
+	pthread_t thread;
+
+	device_change(pvt, 5, 1);
+	pvt_status_update(pvt);
+
+	/* same steps as pvt_status_update(), stopped after first half of copy */
+	device_change(pvt, 25, 0);
+	pvt_status_fill(pvt, &status);
+	seqlock_write_begin(&pvt->status_lock);
+	memcpy(&pvt->status, &status, offsetof(pvt_status_t, provider_name));
+
+	memset(&reader, 0, sizeof(reader));
+	reader.pvt = pvt;
+	pthread_create(&thread, NULL, overlap_read, &reader);
+	usleep(20000);
+	check("reader wait for writer", reader.done, 0);
+
+	memcpy(&pvt->status, &status, sizeof(status));
+	seqlock_write_end(&pvt->status_lock);
+	pthread_join(thread, NULL);
+
+	check("reader done", reader.done, 1);
+	check("reader rssi", reader.status.rssi, 25);
+	check("reader torn", status_torn(&reader.status), 0);
+
+	free(pvt);
+	fprintf(stderr, "\n");
+}
+
+#/* emulate monitor thread of device with active call */
+static void * bench_device(void * arg)
+{
+	struct bench_dev * dev = arg;
+	unsigned seed = (unsigned)(long)arg;
+	long until;
+
+	while(!bench_stop)
+	{
+		pthread_mutex_lock(&dev->lock);
+		until = usec_now() + BENCH_HOLD_USEC;
+		while(usec_now() < until)
+			;
+		device_change(&dev->pvt, rand_r(&seed) % 32, rand_r(&seed) % 3);
+		pvt_status_update(&dev->pvt);
+		pthread_mutex_unlock(&dev->lock);
+		usleep(rand_r(&seed) % BENCH_HOLD_USEC);
+	}
+	return NULL;
+}
+
+struct bench_result {
+	int			snapshot;
+	unsigned long		polls;
+	unsigned long		torn;
+	long			total_usec;
+	long			max_usec;
+};
+
+#/* poll all devices at 1 kHz */
+static void * bench_monitor(void * arg)
+{
+	struct bench_result * result = arg;
+	pvt_status_t status;
+	unsigned long sum = 0;
+	long start, spent;
+	int i;
+
+	while(!bench_stop)
+	{
+		start = usec_now();
+		for(i = 0; i < ndevs; ++i)
+		{
+			if(result->snapshot)
+			{
+				pvt_status_read(&devs[i].pvt, &status);
+				result->torn += status_torn(&status);
+				sum += status.rssi + status.state.chansno;
+			}
+			else
+			{
+				pthread_mutex_lock(&devs[i].lock);
+				sum += devs[i].pvt.rssi + PVT_STATE(&devs[i].pvt, chansno);
+				pthread_mutex_unlock(&devs[i].lock);
+			}
+		}
+		spent = usec_now() - start;
+
+		result->polls++;
+		result->total_usec += spent;
+		if(spent > result->max_usec)
+			result->max_usec = spent;
+		if(spent < BENCH_POLL_USEC)
+			usleep(BENCH_POLL_USEC - spent);
+	}
+	return (void*)sum;
+}
+
+#/* */
+static void bench_run(struct bench_result * result, int seconds)
+{
+	pthread_t monitor;
+	pthread_t * threads = calloc(ndevs, sizeof(*threads));
+	int i;
+
+	bench_stop = 0;
+	for(i = 0; i < ndevs; ++i)
+		pthread_create(&threads[i], NULL, bench_device, &devs[i]);
+	pthread_create(&monitor, NULL, bench_monitor, result);
+
+	sleep(seconds);
+	bench_stop = 1;
+
+	pthread_join(monitor, NULL);
+	for(i = 0; i < ndevs; ++i)
+		pthread_join(threads[i], NULL);
+	free(threads);
+}
+
+#/* */
+void bench_polling(int seconds)
+{
+	struct bench_result locked, snapshot;
+	int i;
+
+	devs = calloc(ndevs, sizeof(*devs));
+	for(i = 0; i < ndevs; ++i)
+	{
+		pthread_mutex_init(&devs[i].lock, NULL);
+		device_change(&devs[i].pvt, 0, 0);
+		pvt_status_update(&devs[i].pvt);
+	}
+
+	memset(&locked, 0, sizeof(locked));
+	memset(&snapshot, 0, sizeof(snapshot));
+	snapshot.snapshot = 1;
+	bench_run(&locked, seconds);
+	bench_run(&snapshot, seconds);
+
+	check("torn snapshots", snapshot.torn, 0);
+	fprintf(stderr, "poll %d devices at 1 kHz: locked %lu polls avg %ld us max %ld us, snapshot %lu polls avg %ld us max %ld us\n",
+		ndevs,
+		locked.polls, locked.polls ? locked.total_usec / (long)locked.polls : 0, locked.max_usec,
+		snapshot.polls, snapshot.polls ? snapshot.total_usec / (long)snapshot.polls : 0, snapshot.max_usec);
+
+	free(devs);
+}
+
+#/* */
+int main(int argc, char * argv[])
+{
+	int seconds = argc > 2 ? atoi(argv[2]) : 1;
+
+	ndevs = argc > 1 ? atoi(argv[1]) : 100;
+
+	test_seqlock();
+	test_status_fill();
+	test_status_overlap();
+	if(ndevs > 0 && seconds > 0)
+		bench_polling(seconds);
+
+	return check_done();
+}
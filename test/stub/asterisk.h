@@ -0,0 +1,14 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Minimal replacement of asterisk headers for test/bench, only what core
+   modules included by test/bench.c use
+*/
+#ifndef CHAN_DONGLE_STUB_ASTERISK_H_INCLUDED
+#define CHAN_DONGLE_STUB_ASTERISK_H_INCLUDED
+
+#include <stddef.h>			/* NULL */
+
+#define attribute_unused		__attribute__ ((unused))
+
+#endif /* CHAN_DONGLE_STUB_ASTERISK_H_INCLUDED */
@@ -0,0 +1,57 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Subset of asterisk/linkedlists.h used by mixbuffer
+*/
+#ifndef CHAN_DONGLE_STUB_LINKEDLISTS_H_INCLUDED
+#define CHAN_DONGLE_STUB_LINKEDLISTS_H_INCLUDED
+
+#define AST_LIST_ENTRY(type)					\
+struct {							\
+	struct type *next;					\
+}
+
+#define AST_LIST_HEAD_NOLOCK(name, type)			\
+struct name {							\
+	struct type *first;					\
+	struct type *last;					\
+}
+
+#define AST_LIST_HEAD_INIT_NOLOCK(head)				\
+	do {							\
+		(head)->first = NULL;				\
+		(head)->last = NULL;				\
+	} while(0)
+
+#define AST_LIST_TRAVERSE(head, var, field)			\
+	for((var) = (head)->first; (var); (var) = (var)->field.next)
+
+#define AST_LIST_INSERT_TAIL(head, elm, field)			\
+	do {							\
+		if(!(head)->first)				\
+			(head)->first = (elm);			\
+		else						\
+			(head)->last->field.next = (elm);	\
+		(head)->last = (elm);				\
+	} while(0)
+
+#define AST_LIST_REMOVE(head, elm, field)			\
+	do {							\
+		__typeof__(elm) __prev = NULL;			\
+		__typeof__(elm) __cur = (head)->first;		\
+		while(__cur && __cur != (elm)) {		\
+			__prev = __cur;				\
+			__cur = __cur->field.next;		\
+		}						\
+		if(__cur) {					\
+			if(__prev)				\
+				__prev->field.next = __cur->field.next;	\
+			else					\
+				(head)->first = __cur->field.next;	\
+			if((head)->last == __cur)		\
+				(head)->last = __prev;		\
+			__cur->field.next = NULL;		\
+		}						\
+	} while(0)
+
+#endif /* CHAN_DONGLE_STUB_LINKEDLISTS_H_INCLUDED */
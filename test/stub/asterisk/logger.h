@@ -0,0 +1,11 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Subset of asterisk/logger.h used by audiotap
+*/
+#ifndef CHAN_DONGLE_STUB_LOGGER_H_INCLUDED
+#define CHAN_DONGLE_STUB_LOGGER_H_INCLUDED
+
+#define ast_debug(level, ...)		do { } while(0)
+
+#endif /* CHAN_DONGLE_STUB_LOGGER_H_INCLUDED */
@@ -0,0 +1,22 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Subset of asterisk/utils.h used by mixbuffer
+*/
+#ifndef CHAN_DONGLE_STUB_UTILS_H_INCLUDED
+#define CHAN_DONGLE_STUB_UTILS_H_INCLUDED
+
+static inline void ast_slinear_saturated_add(short *input, short *value)
+{
+	int res;
+
+	res = (int) *input + *value;
+	if (res > 32767)
+		*input = 32767;
+	else if (res < -32768)
+		*input = -32768;
+	else
+		*input = (short) res;
+}
+
+#endif /* CHAN_DONGLE_STUB_UTILS_H_INCLUDED */
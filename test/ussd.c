@@ -0,0 +1,252 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Tests of USSD sessions, answer cache and group fan-out
+     ussd
+   Session checked through request, result of AT+CUSD and +CUSD in both
+   orders, menu steps, menu started by network, send error and timeout.
+   Cache checked for key by SIM and code, expire, replace and limit of
+   entries. Fan-out of 6 devices with limit 2 finished in mixed order.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#include "ussd.h"
+#include "check.h"			/* check() check_str() check_done() */
+
+static const void * const task1 = &task1;
+static const void * const task2 = &task2;
+
+#/* request answered after OK of AT+CUSD */
+void test_session()
+{
+	struct ussd_session session;
+	uint64_t next_id = 10;
+
+	memset(&session, 0, sizeof(session));
+	check("idle request", ussd_session_check(&session, 0), 0);
+	check("idle step", ussd_session_check(&session, 5), -ENOENT);
+
+	ussd_session_queue(&session, 5, "*100#", task1, 1000);
+	check("queued", session.state, USSD_QUEUED);
+	check("queued steps", session.steps, 1);
+	check_str("queued code", session.code, "*100#");
+	check("queued deadline", session.deadline, 1000 + USSD_SESSION_TIMEOUT);
+	check("busy request", ussd_session_check(&session, 0), -EBUSY);
+	check("step of queued", ussd_session_check(&session, 5), -ENOENT);
+	check("not expired", ussd_session_expired(&session, 1000 + USSD_SESSION_TIMEOUT - 1), 0);
+
+	check("sent other task", ussd_session_sent(&session, task2, 1, 1010), 0);
+	check("sent", ussd_session_sent(&session, task1, 1, 1010), 1);
+	check("waiting", session.state, USSD_WAITING);
+	check("sent task cleared", session.task == NULL, 1);
+	check("waiting deadline", session.deadline, 1010 + USSD_SESSION_TIMEOUT);
+	check("sent twice", ussd_session_sent(&session, task1, 1, 1011), 0);
+
+	check("answer cacheable", ussd_session_cacheable(&session, 0), 1);
+	check("answer", ussd_session_answer(&session, 0, &next_id, 1020), USSD_ANSWER_DONE);
+	check("answer id", session.id, 5);
+	check("answer next id", next_id, 10);
+	fprintf(stderr, "\n");
+}
+
+#/* +CUSD arrive before OK of AT+CUSD */
+void test_session_early()
+{
+	struct ussd_session session;
+	uint64_t next_id = 10;
+
+	memset(&session, 0, sizeof(session));
+	ussd_session_queue(&session, 6, "*100#", task1, 1000);
+	check("early cacheable", ussd_session_cacheable(&session, 0), 1);
+	check("early answer", ussd_session_answer(&session, 0, &next_id, 1001), USSD_ANSWER_DONE);
+	/* caller close session */
+	memset(&session, 0, sizeof(session));
+	check("result after answer", ussd_session_sent(&session, task1, 1, 1002), 0);
+	check("result after answer idle", session.state, USSD_IDLE);
+
+	ussd_session_queue(&session, 7, "*111#", task2, 1000);
+	check("early menu", ussd_session_answer(&session, 1, &next_id, 1001), USSD_ANSWER_OPEN);
+	check("result after menu", ussd_session_sent(&session, task2, 1, 1002), 0);
+	check("menu kept open", session.state, USSD_OPEN);
+	check("menu deadline", session.deadline, 1001 + USSD_SESSION_TIMEOUT);
+	check("menu step", ussd_session_check(&session, 7), 0);
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_session_menu()
+{
+	struct ussd_session session;
+	uint64_t next_id = 10;
+
+	memset(&session, 0, sizeof(session));
+	ussd_session_queue(&session, 8, "*111#", task1, 1000);
+	ussd_session_sent(&session, task1, 1, 1000);
+	check("menu not cacheable", ussd_session_cacheable(&session, 1), 0);
+	check("menu", ussd_session_answer(&session, 1, &next_id, 1005), USSD_ANSWER_OPEN);
+	check("menu id", session.id, 8);
+	check("menu next id", next_id, 10);
+	check("request in menu", ussd_session_check(&session, 0), -EBUSY);
+	check("step of other id", ussd_session_check(&session, 9), -ENOENT);
+	check("step", ussd_session_check(&session, 8), 0);
+
+	ussd_session_queue(&session, 8, NULL, task2, 1010);
+	check("step queued", session.state, USSD_QUEUED);
+	check("step steps", session.steps, 2);
+	check_str("step keep code", session.code, "*111#");
+	check("step sent", ussd_session_sent(&session, task2, 1, 1011), 1);
+	check("step not cacheable", ussd_session_cacheable(&session, 0), 0);
+	check("step answer", ussd_session_answer(&session, 2, &next_id, 1012), USSD_ANSWER_DONE);
+	memset(&session, 0, sizeof(session));
+
+	check("network answer ignored", ussd_session_answer(&session, 0, &next_id, 1020), USSD_ANSWER_IGNORED);
+	check("network menu", ussd_session_answer(&session, 1, &next_id, 1020), USSD_ANSWER_OPEN);
+	check("network menu id", session.id, 10);
+	check("network menu next id", next_id, 11);
+	check("network menu steps", session.steps, 0);
+	check_str("network menu code", session.code, "");
+	check("network menu step", ussd_session_check(&session, 10), 0);
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_session_errors()
+{
+	struct ussd_session session;
+	uint64_t next_id = 10;
+
+	memset(&session, 0, sizeof(session));
+	ussd_session_queue(&session, 11, "*100#", task1, 1000);
+	check("not sent", ussd_session_sent(&session, task1, 0, 1001), 1);
+	check("not sent task cleared", session.task == NULL, 1);
+	memset(&session, 0, sizeof(session));
+
+	ussd_session_queue(&session, 12, "*100#", task1, 1000);
+	ussd_session_sent(&session, task1, 1, 1000);
+	check("not supported", ussd_session_answer(&session, 4, &next_id, 1001), USSD_ANSWER_FAILED);
+	check("error not cacheable", ussd_session_cacheable(&session, 4), 0);
+	memset(&session, 0, sizeof(session));
+
+	ussd_session_queue(&session, 13, "*100#", task1, 1000);
+	ussd_session_sent(&session, task1, 1, 1000);
+	check("waiting not expired", ussd_session_expired(&session, 1000 + USSD_SESSION_TIMEOUT - 1), 0);
+	check("waiting expired", ussd_session_expired(&session, 1000 + USSD_SESSION_TIMEOUT), 1);
+	ussd_session_answer(&session, 1, &next_id, 1030);
+	check("menu expired", ussd_session_expired(&session, 1030 + USSD_SESSION_TIMEOUT), 1);
+	memset(&session, 0, sizeof(session));
+	check("idle never expired", ussd_session_expired(&session, 1 << 30), 0);
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_cache()
+{
+	static const char balance[] = "Balance 12.50 RUB";
+	struct ussd_cache cache;
+	char sim[24];
+	char text[USSD_TEXT_MAX + 1];
+	size_t length = 0;
+	unsigned i;
+
+	ussd_cache_init(&cache);
+	check("get from empty", ussd_cache_get(&cache, "250011234567890", "*100#", 100, &length) == NULL, 1);
+	check("put", ussd_cache_put(&cache, "250011234567890", "*100#", balance, strlen(balance), 160), 0);
+	check_str("get", ussd_cache_get(&cache, "250011234567890", "*100#", 100, &length), balance);
+	check("length", length, strlen(balance));
+	check("other code", ussd_cache_get(&cache, "250011234567890", "*102#", 100, &length) == NULL, 1);
+	check("other sim", ussd_cache_get(&cache, "250019999999999", "*100#", 100, &length) == NULL, 1);
+	check("hits", cache.hits, 1);
+	check("misses", cache.misses, 3);
+
+	check("replace", ussd_cache_put(&cache, "250011234567890", "*100#", "Balance 3.00 RUB", 16, 200), 0);
+	check("count after replace", cache.count, 1);
+	check_str("get replaced", ussd_cache_get(&cache, "250011234567890", "*100#", 170, &length), "Balance 3.00 RUB");
+	check("expired", ussd_cache_get(&cache, "250011234567890", "*100#", 200, &length) == NULL, 1);
+	check("expired dropped", cache.count, 0);
+
+	memset(text, 'x', sizeof(text));
+	check("too long", ussd_cache_put(&cache, "sim", "*100#", text, USSD_TEXT_MAX, 100), -E2BIG);
+
+	for(i = 0; i < USSD_CACHE_MAX + 10; ++i)
+	{
+		snprintf(sim, sizeof(sim), "sim%u", i);
+		ussd_cache_put(&cache, sim, "*100#", balance, strlen(balance), 100 + i);
+	}
+	check("limited", cache.count, USSD_CACHE_MAX);
+	check("oldest dropped", ussd_cache_get(&cache, "sim9", "*100#", 0, &length) == NULL, 1);
+	check("newest kept", ussd_cache_get(&cache, "sim265", "*100#", 0, &length) != NULL, 1);
+
+	ussd_cache_expire(&cache, 100 + USSD_CACHE_MAX);
+	check("count after expire", cache.count, 9);
+	ussd_cache_destroy(&cache);
+	check("destroyed", cache.count, 0);
+	fprintf(stderr, "\n");
+}
+
+#/* */
+void test_fanout()
+{
+	struct ussd_fanout * fanout;
+	char name[16];
+	unsigned i;
+	int idx;
+
+	fanout = ussd_fanout_alloc(7, 1, "*100#", 2, 6);
+	for(i = 0; i < 6; ++i)
+	{
+		snprintf(name, sizeof(name), "dongle%u", i);
+		ussd_fanout_add(fanout, name);
+	}
+	check("add over capacity", ussd_fanout_add(fanout, "dongle6"), -1);
+
+	idx = ussd_fanout_next(fanout, 0);
+	check("first", idx, 0);
+	ussd_fanout_start(fanout, idx);
+	idx = ussd_fanout_next(fanout, 0);
+	check("second", idx, 1);
+	ussd_fanout_start(fanout, idx);
+	check("limit reached", ussd_fanout_next(fanout, 0), -1);
+
+	check("second answered", ussd_fanout_finish(fanout, 1, 1), 0);
+	idx = ussd_fanout_next(fanout, 0);
+	check("third", idx, 2);
+	check("skip busy device", ussd_fanout_next(fanout, 3), 3);
+	ussd_fanout_start(fanout, 3);
+	check("first failed", ussd_fanout_finish(fanout, 0, 0), 0);
+	check("third not started", ussd_fanout_next(fanout, 0), 2);
+	ussd_fanout_start(fanout, 2);
+	check("gone device failed", ussd_fanout_finish(fanout, 4, 0), 0);
+	check("inflight", fanout->inflight, 2);
+	ussd_fanout_finish(fanout, 2, 1);
+	ussd_fanout_finish(fanout, 3, 1);
+	check("twice finished ignored", ussd_fanout_finish(fanout, 3, 0), 0);
+	idx = ussd_fanout_next(fanout, 0);
+	check("last", idx, 5);
+	ussd_fanout_start(fanout, idx);
+	check("all finished", ussd_fanout_finish(fanout, 5, 1), 1);
+	check("answered", fanout->answered, 4);
+	check("failed", fanout->failed, 2);
+	check("inflight after all", fanout->inflight, 0);
+	free(fanout);
+
+	fanout = ussd_fanout_alloc(8, 1, "*100#", 0, 1);
+	check("default limit", fanout->limit, USSD_FANOUT_LIMIT);
+	free(fanout);
+	fprintf(stderr, "\n");
+}
+
+#/* */
+int main()
+{
+	test_session();
+	test_session_early();
+	test_session_menu();
+	test_session_errors();
+	test_cache();
+	test_fanout();
+
+	return check_done();
+}
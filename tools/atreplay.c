@@ -0,0 +1,333 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Offline replay of AT traffic recorded by 'dongle record start <file>'
+     atreplay [-v] [-r] [-n loops] <file> [device]
+   Feed readed bytes of each device through at_read_result_iov() and
+   at_read_result_classification() like monitor thread of device and parse
+   responses with at_parse_*() like at_response() do, print summary by response.
+     -v		print written commands and each response
+     -r		replay in real time by record timestamps, implies -v
+     -n loops	repeat replay and print parser throughput
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "atrec.h"
+#include "at_read.h"			/* at_read_result_iov() at_read_result_classification() */
+#include "at_response.h"		/* at_res2str() */
+#include "at_parse.h"			/* at_parse_*() */
+#include "ringbuffer.h"
+#include "mutils.h"			/* ITEMS_OF() */
+
+#define MAX_DEVICES	64
+#define RB_SIZE		(2*1024)	/* same as buffer of do_monitor_phone() */
+
+struct record {
+	struct atrec_record	hdr;
+	char			* data;
+	unsigned		order;
+};
+
+struct device {
+	char			name[ATREC_DEVICE_SIZE + 1];
+	char			buf[RB_SIZE];
+	struct ringbuffer	rb;
+	int			read_result;
+	unsigned long		overflows;
+};
+
+static struct record * records;
+static unsigned nrecords;
+static struct device devices[MAX_DEVICES];
+static int ndevices;
+
+static unsigned long responses[RES_MAX - RES_MIN + 1];
+static unsigned long parse_errors[RES_MAX - RES_MIN + 1];
+static unsigned long bytes;
+static int verbose;
+
+#/* */
+static int load(const char * path, const char * only)
+{
+	struct atrec_file_hdr fhdr;
+	struct atrec_record hdr;
+	unsigned allocated = 0;
+	FILE * file = fopen(path, "rb");
+
+	if(!file)
+	{
+		perror(path);
+		return -1;
+	}
+	if(fread(&fhdr, sizeof(fhdr), 1, file) != 1 || fhdr.magic != ATREC_MAGIC || fhdr.version != ATREC_VERSION || fhdr.record_size != sizeof(hdr))
+	{
+		fprintf(stderr, "%s: not a recording or unsupported version\n", path);
+		fclose(file);
+		return -1;
+	}
+
+	while(fread(&hdr, sizeof(hdr), 1, file) == 1)
+	{
+		if(nrecords == allocated)
+		{
+			allocated = allocated ? allocated * 2 : 1024;
+			records = realloc(records, allocated * sizeof(*records));
+		}
+		records[nrecords].hdr = hdr;
+		records[nrecords].data = malloc(hdr.length ? hdr.length : 1);
+		records[nrecords].order = nrecords;
+		if(fread(records[nrecords].data, 1, hdr.length, file) != hdr.length)
+		{
+			fprintf(stderr, "%s: truncated record %u\n", path, nrecords);
+			free(records[nrecords].data);
+			break;
+		}
+		records[nrecords].hdr.device[ATREC_DEVICE_SIZE - 1] = 0;
+		if(only && strcmp(records[nrecords].hdr.device, only))
+		{
+			free(records[nrecords].data);
+			continue;
+		}
+		nrecords++;
+	}
+	fclose(file);
+	return 0;
+}
+
+#/* rings of devices drained independently, restore order by time */
+static int record_cmp(const void * a, const void * b)
+{
+	const struct record * ra = a;
+	const struct record * rb = b;
+
+	if(ra->hdr.timestamp != rb->hdr.timestamp)
+		return ra->hdr.timestamp < rb->hdr.timestamp ? -1 : 1;
+	return ra->order < rb->order ? -1 : 1;
+}
+
+#/* */
+static struct device * device_get(const char * name)
+{
+	int i;
+
+	for(i = 0; i < ndevices; ++i)
+		if(strcmp(devices[i].name, name) == 0)
+			return &devices[i];
+	if(ndevices >= MAX_DEVICES)
+		return NULL;
+	strncpy(devices[ndevices].name, name, ATREC_DEVICE_SIZE);
+	return &devices[ndevices++];
+}
+
+#/* parse like at_response() without device state, return non-zero on parse error */
+static int response_parse(at_res_t res, char * str, size_t len)
+{
+	char oa[512];
+	str_encoding_t oa_enc, msg_enc;
+	pdu_udh_t udh;
+	char * msg;
+	char * pos;
+	char * next;
+	int i1, i2, i3;
+	unsigned u1, u2, u3, u4, u5, u6;
+
+	switch(res)
+	{
+		case RES_CREG:
+			return at_parse_creg(str, len, &i1, &i2, &pos, &msg) != 0;
+		case RES_CSQ:
+			return at_parse_csq(str, &i1) != 0;
+		case RES_RSSI:
+			return at_parse_rssi(str) < 0;
+		case RES_MODE:
+			return at_parse_mode(str, &i1, &i2) != 0;
+		case RES_COPS:
+			return at_parse_cops(str) == NULL;
+		case RES_CNUM:
+			return at_parse_cnum(str) == NULL;
+		case RES_CMTI:
+			return at_parse_cmti(str) < 0;
+		case RES_CMGR:
+			pos = str;
+			return at_parse_cmgr(&pos, len, oa, sizeof(oa), &oa_enc, &msg, &msg_enc, &udh) != NULL;
+		case RES_CMT:
+			pos = str;
+			return at_parse_cmt(&pos, len, oa, sizeof(oa), &oa_enc, &msg, &msg_enc, &udh) != NULL;
+		case RES_CMGL:
+			pos = str;
+			return at_parse_cmgl(&pos, len, &i1, oa, sizeof(oa), &oa_enc, &msg, &msg_enc, &udh) != NULL;
+		case RES_CUSD:
+			return at_parse_cusd(str, &i1, &msg, &i3) != 0;
+		case RES_CPIN:
+			return at_parse_cpin(str, len) < 0;
+		case RES_CSCA:
+			return at_parse_csca(str, &msg) != 0;
+		case RES_CCWA:
+			return at_parse_ccwa(str, &u1) != 0;
+		case RES_CLCC:
+			/* one line per call */
+			for(pos = str; pos; pos = next)
+			{
+				next = strchr(pos, '\r');
+				if(next)
+					*next++ = 0;
+				if(strncmp(pos, "+CLCC:", 6) == 0 && at_parse_clcc(pos, &u1, &u2, &u3, &u4, &u5, &msg, &u6) != 0)
+					return 1;
+				if(next && *next == '\n')
+					next++;
+			}
+			return 0;
+		default:
+			return 0;
+	}
+}
+
+#/* same as loop of do_monitor_phone() */
+static void device_feed(struct device * dev, const char * data, size_t length)
+{
+	struct iovec iov[2];
+	int iovcnt;
+	at_res_t at_res;
+	char str[RB_SIZE + 1];
+	size_t len;
+
+	if(rb_write(&dev->rb, data, length) != length)
+		dev->overflows++;
+	bytes += length;
+
+	while((iovcnt = at_read_result_iov(dev->name, &dev->read_result, &dev->rb, iov)) > 0)
+	{
+		len = iov[0].iov_len + iov[1].iov_len;
+		at_res = at_read_result_classification(&dev->rb, len);
+		responses[at_res - RES_MIN]++;
+
+		/* like at_response() */
+		if(len == 0)
+			continue;
+		len--;
+		memcpy(str, iov[0].iov_base, iov[0].iov_len);
+		if(iovcnt == 2)
+			memcpy(str + iov[0].iov_len, iov[1].iov_base, iov[1].iov_len);
+		str[len] = 0;
+
+		if(verbose)
+			printf("[%s] < %-12s '%s'\n", dev->name, at_res2str(at_res), str);
+		if(response_parse(at_res, str, len))
+		{
+			parse_errors[at_res - RES_MIN]++;
+			if(verbose)
+				printf("[%s] parse error of %s\n", dev->name, at_res2str(at_res));
+		}
+	}
+}
+
+#/* */
+static void replay(int realtime)
+{
+	struct device * dev;
+	struct timeval start, now;
+	long long elapsed, at;
+	size_t len;
+	unsigned i;
+	int d;
+
+	for(d = 0; d < ndevices; ++d)
+	{
+		rb_init(&devices[d].rb, devices[d].buf, sizeof(devices[d].buf));
+		devices[d].read_result = 0;
+	}
+
+	gettimeofday(&start, NULL);
+	for(i = 0; i < nrecords; ++i)
+	{
+		dev = device_get(records[i].hdr.device);
+		if(!dev)
+			continue;
+		if(realtime)
+		{
+			at = records[i].hdr.timestamp - records[0].hdr.timestamp;
+			gettimeofday(&now, NULL);
+			elapsed = (now.tv_sec - start.tv_sec) * 1000000LL + now.tv_usec - start.tv_usec;
+			if(at > elapsed)
+				usleep(at - elapsed);
+		}
+		if(records[i].hdr.dir == ATREC_DIR_TX)
+		{
+			if(verbose)
+			{
+				for(len = records[i].hdr.length; len > 0 && (records[i].data[len - 1] == '\r' || records[i].data[len - 1] == '\n'); --len)
+					;
+				printf("[%s] > '%.*s'\n", dev->name, (int)len, records[i].data);
+			}
+		}
+		else
+		{
+			device_feed(dev, records[i].data, records[i].hdr.length);
+		}
+	}
+}
+
+#/* */
+int main(int argc, char * argv[])
+{
+	struct timeval start, stop;
+	double seconds;
+	unsigned long total = 0;
+	int realtime = 0;
+	int loops = 1;
+	int opt, i;
+
+	while((opt = getopt(argc, argv, "vrn:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'v':
+				verbose = 1;
+				break;
+			case 'r':
+				realtime = verbose = 1;
+				break;
+			case 'n':
+				loops = atoi(optarg);
+				break;
+			default:
+				optind = argc;
+		}
+	}
+	if(optind >= argc || loops < 1)
+	{
+		fprintf(stderr, "Usage: %s [-v] [-r] [-n loops] <file> [device]\n", argv[0]);
+		return 1;
+	}
+	if(load(argv[optind], optind + 1 < argc ? argv[optind + 1] : NULL))
+		return 1;
+	qsort(records, nrecords, sizeof(*records), record_cmp);
+	for(i = 0; i < (int)nrecords; ++i)
+		device_get(records[i].hdr.device);
+
+	gettimeofday(&start, NULL);
+	for(i = 0; i < loops; ++i)
+		replay(realtime);
+	gettimeofday(&stop, NULL);
+
+	printf("\n%u records, %d devices\n%-12s %10s %10s\n", nrecords, ndevices, "response", "count", "errors");
+	for(i = 0; i < (int)ITEMS_OF(responses); ++i)
+	{
+		if(responses[i] == 0)
+			continue;
+		total += responses[i];
+		printf("%-12s %10lu %10lu\n", at_res2str(i + RES_MIN), responses[i], parse_errors[i]);
+	}
+	for(i = 0; i < ndevices; ++i)
+		if(devices[i].overflows)
+			printf("[%s] %lu receive buffer overflows\n", devices[i].name, devices[i].overflows);
+
+	seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_usec - start.tv_usec) / 1e6;
+	if(!realtime && seconds > 0)
+		printf("%lu responses %lu bytes in %.3f s: %.0f responses/s %.2f MB/s\n", total, bytes, seconds, total / seconds, bytes / seconds / 1e6);
+	return 0;
+}
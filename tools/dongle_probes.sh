@@ -0,0 +1,57 @@
+#!/bin/sh
+#
+# Record chan_dongle static tracepoints with perf and print per device summary
+# Module must be built with ./configure --enable-probes
+#
+#   dongle_probes.sh [seconds] [module]
+#
+
+SECONDS_TO_RECORD=${1:-10}
+MODULE=${2:-/usr/lib/asterisk/modules/chan_dongle.so}
+PROBES="channel_read channel_write timing_write at_command at_response state_change"
+DATA=/tmp/dongle_probes.$$.data
+
+trap 'perf probe -q -d "sdt_dongle:*" 2>/dev/null; rm -f $DATA' EXIT
+
+perf buildid-cache --add "$MODULE" || exit 1
+EVENTS=""
+for probe in $PROBES ; do
+	perf probe -q -x "$MODULE" "sdt_dongle:$probe" || exit 1
+	EVENTS="$EVENTS -e sdt_dongle:$probe"
+done
+
+perf record -q -a -o $DATA $EVENTS -- sleep "$SECONDS_TO_RECORD" || exit 1
+
+# perf script print probe arguments as arg1..argN, strings are addresses so group by call idx and fd
+perf script -i $DATA -F event,trace | awk '
+	function num(s,    n, i)
+	{
+		if(s !~ /^0x/)
+			return s + 0;
+		n = 0;
+		for(i = 3; i <= length(s); ++i)
+			n = n * 16 + index("0123456789abcdef", tolower(substr(s, i, 1))) - 1;
+		return n;
+	}
+	{
+		event = $1; sub(/^sdt_dongle:/, "", event); sub(/:$/, "", event);
+		delete a;
+		for(i = 2; i <= NF; ++i)
+			if(split($i, kv, "=") == 2)
+				a[kv[1]] = kv[2];
+	}
+	event == "channel_read"		{ key = "fd " num(a["arg3"]); rl[key] += num(a["arg5"]); rn[key]++; rb[key] += num(a["arg4"]); next }
+	event == "channel_write"	{ key = "fd " num(a["arg3"]); wl[key] += num(a["arg5"]); wn[key]++; next }
+	event == "timing_write"		{ tk[num(a["arg3"])]++; next }
+	event == "at_response"		{ ah += num(a["arg4"]); an++; next }
+	event == "state_change"		{ sc++; next }
+	END {
+		for(key in rn)
+			printf("%-12s reads %8d avg bytes %6.1f avg lock wait %6.1f us\n", key, rn[key], rb[key] / rn[key], rl[key] / rn[key]);
+		for(key in wn)
+			printf("%-12s writes %7d avg lock wait %6.1f us\n", key, wn[key], wl[key] / wn[key]);
+		printf("timer frames: full %d truncated %d silence %d\n", tk[0], tk[1], tk[2]);
+		if(an)
+			printf("AT responses %d avg handle %.1f us\n", an, ah / an);
+		printf("call state changes %d\n", sc);
+	}'
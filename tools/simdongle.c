@@ -0,0 +1,876 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Simulator of Huawei E1550 dongles on pty pairs for load testing without hardware
+     simdongle [-n devices] [-d dir] [-l latency] [-j jitter] [-e errors]
+               [-a answer] [-t duration] [-i incoming] [-s sms]
+   For each device create <dir>/simN-data and <dir>/simN-audio links to pty slaves,
+   print dongle.conf sections for them and answer AT commands used by driver.
+   Active calls stream 8 kHz 16 bit PCM to audio port in 20 ms frames.
+     -n devices		number of simulated devices, default 1
+     -d dir		directory for links, default /tmp/simdongle
+     -l latency		ms before response of command, default 10
+     -j jitter		max random ms added to responses and audio frames, default 0
+     -e errors		percent of commands answered by ERROR, default 0
+     -a answer		ms before remote side answer outgoing call, default 2000
+     -t duration	ms before remote side hangup active call, default 0 (never)
+     -i incoming	ms between incoming calls of each idle device, default 0 (off)
+     -s sms		ms between incoming SMS of each device, default 0 (off)
+   Statistics printed to stderr every 10 seconds and on exit by SIGINT.
+   Hundreds of devices may require increase of kernel.pty.max and ulimit -n.
+*/
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif /* _GNU_SOURCE */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <strings.h>				/* strncasecmp() */
+#include <unistd.h>
+#include <fcntl.h>				/* posix_openpt() O_RDWR O_NOCTTY O_NONBLOCK */
+#include <termios.h>				/* cfmakeraw() tcsetattr() */
+#include <signal.h>				/* signal() */
+#include <poll.h>				/* poll() */
+#include <errno.h>				/* errno */
+#include <math.h>				/* sin() */
+#include <time.h>				/* clock_gettime() */
+#include <stdint.h>				/* uint64_t int16_t */
+#include <sys/stat.h>				/* mkdir() */
+#include <sys/resource.h>			/* setrlimit() */
+
+#define MAX_CALLS		7		/* call idx 1..7 like E1550 */
+#define SMS_SLOTS		50		/* same as +CPMS answer */
+#define SMS_UNREAD		1		/* states of SMS slot, 0 free */
+#define SMS_READ		2
+#define OUT_QUEUE		16		/* pending responses of device, power of 2 */
+#define OUT_SIZE		512
+#define LINE_SIZE		1024
+#define AUDIO_SAMPLES		160		/* 20 ms of 8 kHz */
+#define AUDIO_PERIOD		20000		/* us */
+#define AUDIO_LATE		5000		/* us after due time counted as late frame */
+#define RING_PERIOD		3000000		/* us between RING of incoming call */
+#define RING_TIMEOUT		30000000	/* us before not answered incoming call ended */
+#define USSD_DELAY		1000000		/* us before +CUSD */
+#define STAT_PERIOD		10000000	/* us between statistics */
+
+/* +CLCC states */
+typedef enum {
+	CALL_ACTIVE = 0,
+	CALL_HELD,
+	CALL_DIALING,
+	CALL_ALERTING,
+	CALL_INCOMING,
+	CALL_WAITING,
+} call_state_t;
+
+struct call {
+	int		used;
+	int		dir;				/*!< 0 outgoing 1 incoming */
+	call_state_t	state;
+	char		number[32];
+	uint64_t	start;
+	uint64_t	answer_at;			/*!< remote answer of outgoing call, 0 if none */
+	uint64_t	hangup_at;			/*!< remote hangup or ring timeout, 0 if none */
+	uint64_t	ring_at;			/*!< next RING, 0 if none */
+};
+
+struct output {
+	uint64_t	due;
+	unsigned	length;
+	char		text[OUT_SIZE];
+};
+
+struct device {
+	int		index;
+	int		data_fd;			/* pty masters */
+	int		audio_fd;
+	int		data_slave;			/* hold slaves open, master read return EIO while no one open slave */
+	int		audio_slave;
+	char		data_link[256];
+	char		audio_link[256];
+
+	char		line[LINE_SIZE];
+	unsigned	line_length;
+	int		sms_prompt;
+	int		pdu_mode;
+	int		sms_direct;			/*!< +CNMI=2,2 new SMS sent as +CMT */
+	int		initialized;
+
+	struct output	out[OUT_QUEUE];
+	unsigned	out_head;
+	unsigned	out_tail;
+	uint64_t	out_last;
+
+	struct call	calls[MAX_CALLS + 1];
+	uint64_t	audio_base;			/* time of next frame without jitter, 0 if no active call */
+	uint64_t	audio_due;
+
+	char		sms[SMS_SLOTS];			/*!< SMS_UNREAD SMS_READ or 0 */
+	unsigned	sms_ref;
+	uint64_t	next_incoming;
+	uint64_t	next_sms;
+};
+
+struct sim_stat {
+	unsigned long	commands;
+	unsigned long	errors;
+	unsigned long	calls_out;
+	unsigned long	calls_in;
+	unsigned long	answered;
+	unsigned long	hangups;
+	unsigned long	sms_in;
+	unsigned long	sms_out;
+	unsigned long	ussd;
+	unsigned long	frames_out;
+	unsigned long	frames_late;
+	unsigned long	frames_dropped;
+	unsigned long	audio_in;
+	unsigned long	output_dropped;
+};
+
+static struct device * devices;
+static int ndevices = 1;
+static struct sim_stat stats;
+static int16_t audio_frame[AUDIO_SAMPLES];
+static volatile int stop;
+
+static uint64_t latency = 10000;
+static uint64_t jitter = 0;
+static int errors = 0;
+static uint64_t answer = 2000000;
+static uint64_t duration = 0;
+static uint64_t incoming = 0;
+static uint64_t sms = 0;
+
+/* sample from parse_cmgr_pdu(), TPDU of 31 bytes */
+static const char sms_pdu[] = "07911234567890F3040B911234556780F20008012150220040210C041F04400438043204350442";
+static const char sms_text[] = "00480065006C006C006F";		/* "Hello" in UCS-2 */
+static const char ussd_text[] = "Balance 100.00";
+
+#/* */
+static uint64_t now_us()
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+#/* */
+static uint64_t jitter_us()
+{
+	return jitter ? (uint64_t)random() % jitter : 0;
+}
+
+#/* queue text to data port after latency and delay, keep order of responses */
+static void __attribute__ ((format(printf, 3, 4))) device_send(struct device * dev, uint64_t delay, const char * format, ...)
+{
+	struct output * out;
+	va_list ap;
+	int length;
+
+	if(dev->out_tail - dev->out_head >= OUT_QUEUE)
+	{
+		stats.output_dropped++;
+		return;
+	}
+	out = &dev->out[dev->out_tail & (OUT_QUEUE - 1)];
+
+	va_start(ap, format);
+	length = vsnprintf(out->text, sizeof(out->text), format, ap);
+	va_end(ap);
+	if(length < 0)
+		return;
+	out->length = (unsigned)length < sizeof(out->text) ? (unsigned)length : sizeof(out->text) - 1;
+
+	out->due = now_us() + latency + jitter_us() + delay;
+	if(out->due < dev->out_last)
+		out->due = dev->out_last;
+	dev->out_last = out->due;
+	dev->out_tail++;
+}
+
+#/* */
+static int call_alloc(struct device * dev)
+{
+	int idx;
+
+	for(idx = 1; idx <= MAX_CALLS; ++idx)
+		if(!dev->calls[idx].used)
+			return idx;
+	return 0;
+}
+
+#/* */
+static int calls_count(struct device * dev, int state)
+{
+	int idx, count = 0;
+
+	for(idx = 1; idx <= MAX_CALLS; ++idx)
+		if(dev->calls[idx].used && (state < 0 || dev->calls[idx].state == (call_state_t)state))
+			count++;
+	return count;
+}
+
+#/* start or stop audio stream by active calls */
+static void audio_update(struct device * dev)
+{
+	if(calls_count(dev, CALL_ACTIVE) == 0)
+		dev->audio_base = 0;
+	else if(dev->audio_base == 0)
+	{
+		dev->audio_base = now_us() + AUDIO_PERIOD;
+		dev->audio_due = dev->audio_base + jitter_us();
+	}
+}
+
+#/* */
+static void call_answered(struct device * dev, int idx)
+{
+	struct call * call = &dev->calls[idx];
+
+	call->state = CALL_ACTIVE;
+	call->answer_at = 0;
+	call->ring_at = 0;
+	call->start = now_us();
+	call->hangup_at = duration ? call->start + duration : 0;
+	stats.answered++;
+	audio_update(dev);
+}
+
+#/* */
+static void call_end(struct device * dev, int idx, uint64_t delay)
+{
+	struct call * call = &dev->calls[idx];
+	unsigned seconds = call->state == CALL_ACTIVE || call->state == CALL_HELD ? (now_us() - call->start) / 1000000 : 0;
+
+	device_send(dev, delay, "\r\n^CEND:%d,%u,104,16\r\n", idx, seconds);
+	memset(call, 0, sizeof(*call));
+	stats.hangups++;
+	audio_update(dev);
+}
+
+#/* */
+static void sms_incoming(struct device * dev)
+{
+	int idx;
+
+	if(dev->sms_direct && dev->pdu_mode)
+	{
+		stats.sms_in++;
+		device_send(dev, 0, "\r\n+CMT: ,%d\r\n%s\r\n", (int)(strlen(sms_pdu) / 2 - 8), sms_pdu);
+		return;
+	}
+
+	for(idx = 0; idx < SMS_SLOTS; ++idx)
+	{
+		if(!dev->sms[idx])
+		{
+			dev->sms[idx] = SMS_UNREAD;
+			stats.sms_in++;
+			device_send(dev, 0, "\r\n+CMTI: \"ME\",%d\r\n", idx);
+			return;
+		}
+	}
+	device_send(dev, 0, "\r\n^SMMEMFULL: \"ME\"\r\n");
+}
+
+#/* +CMGL of unread messages, several messages per output */
+static void sms_list(struct device * dev)
+{
+	char list[OUT_SIZE];
+	char entry[OUT_SIZE];
+	size_t used = 0;
+	int first = 1;
+	int length;
+	int idx;
+
+	for(idx = 0; idx < SMS_SLOTS; ++idx)
+	{
+		if(dev->sms[idx] != SMS_UNREAD)
+			continue;
+		dev->sms[idx] = SMS_READ;
+
+		if(dev->pdu_mode)
+			length = snprintf(entry, sizeof(entry), "%s+CMGL: %d,0,,%d\r\n%s\r\n", first ? "\r\n" : "", idx, (int)(strlen(sms_pdu) / 2 - 8), sms_pdu);
+		else
+			length = snprintf(entry, sizeof(entry), "%s+CMGL: %d,\"REC UNREAD\",\"+79139131234\",,\"10/12/09,15:03:26+24\"\r\n%s\r\n", first ? "\r\n" : "", idx, sms_text);
+		if(used + length >= sizeof(list))
+		{
+			device_send(dev, 0, "%s", list);
+			used = 0;
+		}
+		memcpy(list + used, entry, length + 1);
+		used += length;
+		first = 0;
+	}
+	if(used)
+		device_send(dev, 0, "%s", list);
+	device_send(dev, 0, "\r\nOK\r\n");
+}
+
+#/* */
+static void call_incoming(struct device * dev)
+{
+	int idx = call_alloc(dev);
+	struct call * call = &dev->calls[idx];
+
+	if(!idx)
+		return;
+	call->used = 1;
+	call->dir = 1;
+	call->state = CALL_INCOMING;
+	snprintf(call->number, sizeof(call->number), "+7900%07d", dev->index);
+	call->start = now_us();
+	call->ring_at = call->start + RING_PERIOD;
+	call->hangup_at = call->start + RING_TIMEOUT;
+	stats.calls_in++;
+	device_send(dev, 0, "\r\nRING\r\n");
+}
+
+#/* +CLCC answer of all calls in one output */
+static void calls_list(struct device * dev)
+{
+	char buf[OUT_SIZE] = "";
+	int idx, length = 0;
+
+	for(idx = 1; idx <= MAX_CALLS; ++idx)
+	{
+		if(dev->calls[idx].used)
+			length += snprintf(buf + length, sizeof(buf) - length, "\r\n+CLCC: %d,%d,%d,0,0,\"%s\",145",
+				idx, dev->calls[idx].dir, dev->calls[idx].state, dev->calls[idx].number);
+	}
+	device_send(dev, 0, "%s%s\r\nOK\r\n", buf, length ? "\r\n" : "");
+}
+
+#/* */
+static int is(const char * cmd, const char * prefix)
+{
+	return strncasecmp(cmd, prefix, strlen(prefix)) == 0;
+}
+
+#/* */
+static void device_command(struct device * dev, const char * cmd)
+{
+	/* constant answers of queries */
+	static const struct {
+		const char	* cmd;
+		const char	* answer;
+	} queries[] = {
+		{ "AT+CGMI", "huawei" },
+		{ "AT+CGMM", "E1550" },
+		{ "AT+CGMR", "11.608.12.02.21" },
+		{ "AT+CPIN?", "+CPIN: READY" },
+		{ "AT+CREG?", "+CREG: 2,1,\"00FF\",\"0FFF\"" },
+		{ "AT+COPS?", "+COPS: 0,0,\"SimNet\",0" },
+		{ "AT^CVOICE?", "^CVOICE:0,8000,16,20" },
+		{ "AT+CSCA?", "+CSCA: \"+79168999100\",145" },
+		{ "AT+CSQ", "+CSQ: 20,99" },
+		{ "AT+CPMS=", "+CPMS: 0,50,0,50,0,50" },
+		{ "AT+CSMS=", "+CSMS: 1,1,1" },
+	};
+	char hex[4 * sizeof(ussd_text)];
+	unsigned i;
+	int idx;
+	int flag;
+
+	stats.commands++;
+	if(errors && random() % 100 < errors)
+	{
+		stats.errors++;
+		device_send(dev, 0, "\r\nERROR\r\n");
+		return;
+	}
+
+	for(i = 0; i < sizeof(queries) / sizeof(queries[0]); ++i)
+	{
+		if(is(cmd, queries[i].cmd))
+		{
+			device_send(dev, 0, "\r\n%s\r\n\r\nOK\r\n", queries[i].answer);
+			return;
+		}
+	}
+
+	if(is(cmd, "AT+CGSN"))
+		device_send(dev, 0, "\r\n35%013d\r\n\r\nOK\r\n", dev->index);
+	else if(is(cmd, "AT+CIMI"))
+		device_send(dev, 0, "\r\n25099%010d\r\n\r\nOK\r\n", dev->index);
+	else if(is(cmd, "AT+CNUM"))
+		device_send(dev, 0, "\r\n+CNUM: \"\",\"+7913%07d\",145\r\n\r\nOK\r\n", dev->index);
+	else if(is(cmd, "AT+CMGF="))
+	{
+		dev->pdu_mode = cmd[8] == '0';
+		device_send(dev, 0, "\r\nOK\r\n");
+	}
+	else if(is(cmd, "AT+CNMI="))
+	{
+		dev->initialized = 1;
+		dev->sms_direct = is(cmd, "AT+CNMI=2,2");
+		device_send(dev, 0, "\r\nOK\r\n");
+	}
+	else if(is(cmd, "ATD"))
+	{
+		idx = call_alloc(dev);
+		if(!idx)
+		{
+			device_send(dev, 0, "\r\nERROR\r\n");
+			return;
+		}
+		dev->calls[idx].used = 1;
+		dev->calls[idx].dir = 0;
+		dev->calls[idx].state = CALL_ALERTING;
+		i = strcspn(cmd + 3, ";");
+		if(i >= sizeof(dev->calls[idx].number))
+			i = sizeof(dev->calls[idx].number) - 1;
+		memcpy(dev->calls[idx].number, cmd + 3, i);
+		dev->calls[idx].start = now_us();
+		dev->calls[idx].answer_at = dev->calls[idx].start + answer;
+		stats.calls_out++;
+		device_send(dev, 0, "\r\nOK\r\n");
+		device_send(dev, 0, "\r\n^ORIG:%d,0\r\n", idx);
+		device_send(dev, 0, "\r\n^CONF:%d\r\n", idx);
+	}
+	else if(is(cmd, "ATA") || is(cmd, "AT+CHLD=2"))
+	{
+		/* answer incoming or waiting call, hold is not simulated */
+		for(idx = 1; idx <= MAX_CALLS; ++idx)
+			if(dev->calls[idx].used && (dev->calls[idx].state == CALL_INCOMING || dev->calls[idx].state == CALL_WAITING))
+				break;
+		device_send(dev, 0, "\r\nOK\r\n");
+		if(idx <= MAX_CALLS)
+		{
+			call_answered(dev, idx);
+			device_send(dev, 0, "\r\n^CONN:%d,0\r\n", idx);
+		}
+	}
+	else if(is(cmd, "AT+CHUP"))
+	{
+		device_send(dev, 0, "\r\nOK\r\n");
+		for(idx = 1; idx <= MAX_CALLS; ++idx)
+			if(dev->calls[idx].used)
+				call_end(dev, idx, 0);
+	}
+	else if(is(cmd, "AT+CHLD=1") && cmd[9] >= '1' && cmd[9] <= '0' + MAX_CALLS)
+	{
+		idx = cmd[9] - '0';
+		device_send(dev, 0, "\r\nOK\r\n");
+		if(dev->calls[idx].used)
+			call_end(dev, idx, 0);
+	}
+	else if(is(cmd, "AT+CMGR="))
+	{
+		idx = atoi(cmd + 8);
+		if(idx < 0 || idx >= SMS_SLOTS || !dev->sms[idx])
+			device_send(dev, 0, "\r\n+CMS ERROR: 321\r\n");
+		else
+		{
+			dev->sms[idx] = SMS_READ;
+			if(dev->pdu_mode)
+				device_send(dev, 0, "\r\n+CMGR: 0,,%d\r\n%s\r\n\r\nOK\r\n", (int)(strlen(sms_pdu) / 2 - 8), sms_pdu);
+			else
+				device_send(dev, 0, "\r\n+CMGR: \"REC UNREAD\",\"+79139131234\",,\"10/12/09,15:03:26+24\"\r\n%s\r\n\r\nOK\r\n", sms_text);
+		}
+	}
+	else if(is(cmd, "AT+CMGL="))
+		sms_list(dev);
+	else if(is(cmd, "AT+CMGD="))
+	{
+		/* AT+CMGD=<index>[,<delflag>], delflag 1-3 delete read, 4 all */
+		i = sscanf(cmd + 8, "%d,%d", &idx, &flag);
+		if(i == 2 && flag > 0)
+		{
+			for(idx = 0; idx < SMS_SLOTS; ++idx)
+				if(flag >= 4 || dev->sms[idx] == SMS_READ)
+					dev->sms[idx] = 0;
+		}
+		else if(i >= 1 && idx >= 0 && idx < SMS_SLOTS)
+			dev->sms[idx] = 0;
+		device_send(dev, 0, "\r\nOK\r\n");
+	}
+	else if(is(cmd, "AT+CMGS="))
+	{
+		dev->sms_prompt = 1;
+		device_send(dev, 0, "\r\n> ");
+	}
+	else if(is(cmd, "AT+CUSD="))
+	{
+		for(i = 0; ussd_text[i]; ++i)
+			sprintf(hex + i * 4, "%04X", (unsigned char)ussd_text[i]);
+		stats.ussd++;
+		device_send(dev, 0, "\r\nOK\r\n");
+		device_send(dev, USSD_DELAY, "\r\n+CUSD: 0,\"%s\",72\r\n", hex);
+	}
+	else if(is(cmd, "AT+CLCC"))
+		calls_list(dev);
+	else
+		/* ATZ ATE0 AT^U2DIAG AT+CMEE AT+COPS= AT+CREG= AT+CSSN AT+CSCS AT+CNMA AT^DDSETEX AT^DTMF AT+CLVL ... */
+		device_send(dev, 0, "\r\nOK\r\n");
+}
+
+#/* */
+static void device_input(struct device * dev, const char * data, size_t length)
+{
+	size_t i;
+
+	for(i = 0; i < length; ++i)
+	{
+		if(dev->sms_prompt)
+		{
+			/* PDU or text of message until Ctrl-Z, Esc cancel */
+			if(data[i] == 0x1a)
+			{
+				dev->sms_prompt = 0;
+				stats.sms_out++;
+				device_send(dev, 0, "\r\n+CMGS: %u\r\n\r\nOK\r\n", dev->sms_ref++ & 0xFF);
+			}
+			else if(data[i] == 0x1b)
+			{
+				dev->sms_prompt = 0;
+				device_send(dev, 0, "\r\nOK\r\n");
+			}
+		}
+		else if(data[i] == '\r' || data[i] == '\n')
+		{
+			if(dev->line_length)
+			{
+				dev->line[dev->line_length] = 0;
+				device_command(dev, dev->line);
+				dev->line_length = 0;
+			}
+		}
+		else if(dev->line_length < sizeof(dev->line) - 1)
+			dev->line[dev->line_length++] = data[i];
+	}
+}
+
+#/* run due events of device, update nearest event time */
+static void device_run(struct device * dev, uint64_t now, uint64_t * next)
+{
+	struct output * out;
+	struct call * call;
+	ssize_t written;
+	int idx;
+
+#define NEXT(t)	do { if((t) < *next) *next = (t); } while(0)
+
+	/* timers of calls */
+	for(idx = 1; idx <= MAX_CALLS; ++idx)
+	{
+		call = &dev->calls[idx];
+		if(!call->used)
+			continue;
+		if(call->answer_at && call->answer_at <= now)
+		{
+			call_answered(dev, idx);
+			device_send(dev, 0, "\r\n^CONN:%d,0\r\n", idx);
+		}
+		if(call->hangup_at && call->hangup_at <= now)
+		{
+			call_end(dev, idx, 0);
+			continue;
+		}
+		if(call->ring_at && call->ring_at <= now)
+		{
+			call->ring_at = now + RING_PERIOD;
+			device_send(dev, 0, "\r\nRING\r\n");
+		}
+		if(call->answer_at)
+			NEXT(call->answer_at);
+		if(call->hangup_at)
+			NEXT(call->hangup_at);
+		if(call->ring_at)
+			NEXT(call->ring_at);
+	}
+
+	/* traffic generators */
+	if(incoming && dev->initialized)
+	{
+		if(dev->next_incoming <= now)
+		{
+			if(calls_count(dev, -1) == 0)
+				call_incoming(dev);
+			dev->next_incoming = now + incoming;
+		}
+		NEXT(dev->next_incoming);
+	}
+	if(sms && dev->initialized)
+	{
+		if(dev->next_sms <= now)
+		{
+			sms_incoming(dev);
+			dev->next_sms = now + sms;
+		}
+		NEXT(dev->next_sms);
+	}
+
+	/* responses */
+	while(dev->out_head != dev->out_tail)
+	{
+		out = &dev->out[dev->out_head & (OUT_QUEUE - 1)];
+		if(out->due > now)
+		{
+			NEXT(out->due);
+			break;
+		}
+		written = write(dev->data_fd, out->text, out->length);
+		if(written != (ssize_t)out->length)
+			stats.output_dropped++;
+		dev->out_head++;
+	}
+
+	/* audio */
+	if(dev->audio_base)
+	{
+		/* resync after long stall instead of burst */
+		if(now > dev->audio_base + 10 * AUDIO_PERIOD)
+		{
+			dev->audio_base = now;
+			dev->audio_due = now;
+		}
+		while(dev->audio_due <= now)
+		{
+			if(now - dev->audio_due > AUDIO_LATE)
+				stats.frames_late++;
+			if(write(dev->audio_fd, audio_frame, sizeof(audio_frame)) == sizeof(audio_frame))
+				stats.frames_out++;
+			else
+				stats.frames_dropped++;
+			dev->audio_base += AUDIO_PERIOD;
+			dev->audio_due = dev->audio_base + jitter_us();
+		}
+		NEXT(dev->audio_due);
+	}
+#undef NEXT
+}
+
+#/* open pty, hold slave in raw mode and link it; return master or -1 */
+static int pty_open(const char * link, int * slave)
+{
+	struct termios term;
+	const char * name;
+	int fd;
+
+	fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if(fd < 0)
+		return -1;
+	if(grantpt(fd) || unlockpt(fd) || !(name = ptsname(fd)))
+		goto fail;
+
+	*slave = open(name, O_RDWR | O_NOCTTY);
+	if(*slave < 0)
+		goto fail;
+	if(tcgetattr(*slave, &term) == 0)
+	{
+		cfmakeraw(&term);
+		tcsetattr(*slave, TCSANOW, &term);
+	}
+
+	if(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK))
+		goto fail_slave;
+
+	unlink(link);
+	if(symlink(name, link))
+		goto fail_slave;
+	return fd;
+
+fail_slave:
+	close(*slave);
+fail:
+	close(fd);
+	return -1;
+}
+
+#/* */
+static int device_open(struct device * dev, const char * dir, int index)
+{
+	dev->index = index;
+	dev->pdu_mode = 1;
+	snprintf(dev->data_link, sizeof(dev->data_link), "%s/sim%d-data", dir, index);
+	snprintf(dev->audio_link, sizeof(dev->audio_link), "%s/sim%d-audio", dir, index);
+
+	dev->data_fd = pty_open(dev->data_link, &dev->data_slave);
+	if(dev->data_fd < 0)
+	{
+		perror(dev->data_link);
+		return -1;
+	}
+	dev->audio_fd = pty_open(dev->audio_link, &dev->audio_slave);
+	if(dev->audio_fd < 0)
+	{
+		perror(dev->audio_link);
+		return -1;
+	}
+
+	/* spread generated traffic of devices */
+	if(incoming)
+		dev->next_incoming = now_us() + (uint64_t)random() % incoming;
+	if(sms)
+		dev->next_sms = now_us() + (uint64_t)random() % sms;
+
+	printf("[sim%d]\naudio=%s\ndata=%s\n\n", index, dev->audio_link, dev->data_link);
+	return 0;
+}
+
+#/* */
+static void stat_print(uint64_t elapsed)
+{
+	int i, initialized = 0, calls = 0;
+
+	for(i = 0; i < ndevices; ++i)
+	{
+		initialized += devices[i].initialized;
+		calls += calls_count(&devices[i], CALL_ACTIVE);
+	}
+	fprintf(stderr, "%6.1f s devices %d/%d active %d | commands %lu errors %lu | calls out %lu in %lu answered %lu hangup %lu"
+		" | sms in %lu out %lu ussd %lu | frames out %lu late %lu dropped %lu audio in %lu bytes | output dropped %lu\n",
+		elapsed / 1e6, initialized, ndevices, calls, stats.commands, stats.errors,
+		stats.calls_out, stats.calls_in, stats.answered, stats.hangups,
+		stats.sms_in, stats.sms_out, stats.ussd,
+		stats.frames_out, stats.frames_late, stats.frames_dropped, stats.audio_in, stats.output_dropped);
+}
+
+#/* */
+static void on_signal(__attribute__ ((unused)) int sig)
+{
+	stop = 1;
+}
+
+#/* */
+int main(int argc, char * argv[])
+{
+	const char * dir = "/tmp/simdongle";
+	struct pollfd * fds;
+	struct rlimit limit;
+	char buf[4096];
+	uint64_t start, now, next, next_stat;
+	ssize_t readed;
+	int timeout;
+	int opt, i;
+
+	while((opt = getopt(argc, argv, "n:d:l:j:e:a:t:i:s:")) != -1)
+	{
+		switch(opt)
+		{
+			case 'n':
+				ndevices = atoi(optarg);
+				break;
+			case 'd':
+				dir = optarg;
+				break;
+			case 'l':
+				latency = strtoull(optarg, NULL, 10) * 1000;
+				break;
+			case 'j':
+				jitter = strtoull(optarg, NULL, 10) * 1000;
+				break;
+			case 'e':
+				errors = atoi(optarg);
+				break;
+			case 'a':
+				answer = strtoull(optarg, NULL, 10) * 1000;
+				break;
+			case 't':
+				duration = strtoull(optarg, NULL, 10) * 1000;
+				break;
+			case 'i':
+				incoming = strtoull(optarg, NULL, 10) * 1000;
+				break;
+			case 's':
+				sms = strtoull(optarg, NULL, 10) * 1000;
+				break;
+			default:
+				ndevices = 0;
+		}
+	}
+	if(ndevices < 1 || optind != argc)
+	{
+		fprintf(stderr, "Usage: %s [-n devices] [-d dir] [-l latency] [-j jitter] [-e errors] [-a answer] [-t duration] [-i incoming] [-s sms]\n", argv[0]);
+		return 1;
+	}
+
+	/* 4 descriptors per device */
+	if(getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+	{
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+	}
+
+	for(i = 0; i < AUDIO_SAMPLES; ++i)
+		audio_frame[i] = 8000 * sin(2 * M_PI * 400 * i / 8000);		/* 400 Hz, integer periods in frame */
+
+	srandom(time(NULL));
+	mkdir(dir, 0755);
+	devices = calloc(ndevices, sizeof(*devices));
+	fds = calloc(ndevices * 2, sizeof(*fds));
+	if(!devices || !fds)
+	{
+		fprintf(stderr, "Out of memory\n");
+		return 1;
+	}
+	for(i = 0; i < ndevices; ++i)
+	{
+		if(device_open(&devices[i], dir, i))
+			return 1;
+		fds[i * 2].fd = devices[i].data_fd;
+		fds[i * 2].events = POLLIN;
+		fds[i * 2 + 1].fd = devices[i].audio_fd;
+		fds[i * 2 + 1].events = POLLIN;
+	}
+	fflush(stdout);
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+	signal(SIGPIPE, SIG_IGN);
+
+	start = now = now_us();
+	next = now;
+	next_stat = start + STAT_PERIOD;
+	while(!stop)
+	{
+		timeout = next > now ? (int)((next - now + 999) / 1000) : 0;
+		if(poll(fds, ndevices * 2, timeout) < 0 && errno != EINTR)
+		{
+			perror("poll");
+			break;
+		}
+
+		for(i = 0; i < ndevices; ++i)
+		{
+			if(fds[i * 2].revents & POLLIN)
+			{
+				readed = read(devices[i].data_fd, buf, sizeof(buf));
+				if(readed > 0)
+					device_input(&devices[i], buf, readed);
+			}
+			/* audio of driver only counted */
+			if(fds[i * 2 + 1].revents & POLLIN)
+			{
+				readed = read(devices[i].audio_fd, buf, sizeof(buf));
+				if(readed > 0)
+					stats.audio_in += readed;
+			}
+		}
+
+		now = now_us();
+		next = now + 1000000;
+		for(i = 0; i < ndevices; ++i)
+			device_run(&devices[i], now, &next);
+
+		if(now >= next_stat)
+		{
+			stat_print(now - start);
+			next_stat += STAT_PERIOD;
+		}
+		if(next_stat < next)
+			next = next_stat;
+	}
+
+	stat_print(now_us() - start);
+	for(i = 0; i < ndevices; ++i)
+	{
+		unlink(devices[i].data_link);
+		unlink(devices[i].audio_link);
+	}
+	return 0;
+}
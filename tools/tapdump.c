@@ -0,0 +1,209 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Reference consumer of chan_dongle audio tap
+     tapdump <socket path> [output directory]
+   Listen on unix SOCK_SEQPACKET socket, print frame summary and if output directory
+   specified append samples to <device>-<uniqueid or call idx>-<rx|tx>.raw files,
+   silence not sent by VAD written as zero samples
+   play result with: sox -t raw -r 8000 -e signed -b 16 -c 1 file.raw file.wav
+*/
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <signal.h>
+
+#include "audiotap.h"
+
+#define MAX_CLIENTS	16
+#define MAX_FILES	32
+
+struct out_file {
+	char		name[256];
+	FILE *		file;
+	uint32_t	next_seqno;
+	unsigned long	frames;
+	unsigned long	lost;
+	unsigned long	silence;		/* samples of gaps */
+};
+
+static struct out_file files[MAX_FILES];
+static volatile int stop;
+
+#/* */
+static void on_signal(int sig)
+{
+	(void)sig;
+	stop = 1;
+}
+
+#/* append samples of silence */
+static void write_gap(FILE * file, uint32_t samples)
+{
+	static const short zero[160];
+	uint32_t chunk;
+
+	for(; samples; samples -= chunk) {
+		chunk = samples < 160 ? samples : 160;
+		fwrite(zero, sizeof(zero[0]), chunk, file);
+	}
+}
+
+#/* find or open output, reuse least used slot when table full */
+static struct out_file * get_file(const char * outdir, const struct audiotap_hdr * hdr)
+{
+	char name[256];
+	char id[AUDIOTAP_UNIQUEID_SIZE + 1];
+	struct out_file * victim = &files[0];
+	unsigned i;
+
+	if(hdr->uniqueid[0])
+		snprintf(id, sizeof(id), "%s", hdr->uniqueid);
+	else
+		snprintf(id, sizeof(id), "idx%u", hdr->call_idx);
+
+	snprintf(name, sizeof(name), "%s/%.*s-%s-%s.raw", outdir ? outdir : ".", AUDIOTAP_DEVICE_SIZE, hdr->device, id,
+		hdr->dir == AUDIOTAP_DIR_RX ? "rx" : "tx");
+
+	for(i = 0; i < MAX_FILES; i++) {
+		if(strcmp(files[i].name, name) == 0)
+			return &files[i];
+		if(files[i].frames < victim->frames)
+			victim = &files[i];
+	}
+
+	if(victim->file) {
+		fclose(victim->file);
+		fprintf(stdout, "%s: %lu frames %lu lost %lu silence samples\n", victim->name, victim->frames, victim->lost, victim->silence);
+	}
+	memset(victim, 0, sizeof(*victim));
+	snprintf(victim->name, sizeof(victim->name), "%s", name);
+	victim->next_seqno = hdr->seqno;
+	if(outdir) {
+		victim->file = fopen(name, "ab");
+		if(!victim->file)
+			fprintf(stderr, "can't open %s: %s\n", name, strerror(errno));
+	}
+	return victim;
+}
+
+#/* return 0 on success */
+static int handle_packet(int fd, const char * outdir, int verbose)
+{
+	char buf[sizeof(struct audiotap_hdr) + 4096];
+	const struct audiotap_hdr * hdr = (const struct audiotap_hdr *)buf;
+	struct out_file * out;
+	ssize_t res;
+
+	res = recv(fd, buf, sizeof(buf), 0);
+	if(res <= 0)
+		return -1;
+
+	if((size_t)res < sizeof(*hdr) || hdr->magic != AUDIOTAP_MAGIC || hdr->version != AUDIOTAP_VERSION
+		|| hdr->datalen != (size_t)res - sizeof(*hdr)) {
+		fprintf(stderr, "invalid packet of %d bytes\n", (int)res);
+		return 0;
+	}
+
+	out = get_file(outdir, hdr);
+	/* gap in sequence of device direction mean frames dropped by sender */
+	if(hdr->seqno != out->next_seqno && out->frames)
+		out->lost += hdr->seqno - out->next_seqno;
+	out->next_seqno = hdr->seqno + 1;
+	out->frames++;
+	out->silence += hdr->gap;
+
+	if(out->file) {
+		write_gap(out->file, hdr->gap);
+		fwrite(buf + sizeof(*hdr), 1, hdr->datalen, out->file);
+	}
+
+	if(verbose)
+		fprintf(stdout, "%llu.%06llu %s %s call %u seq %u %u bytes gap %u\n",
+			(unsigned long long)(hdr->timestamp / 1000000), (unsigned long long)(hdr->timestamp % 1000000),
+			hdr->device, hdr->dir == AUDIOTAP_DIR_RX ? "rx" : "tx", hdr->call_idx, hdr->seqno, hdr->datalen, hdr->gap);
+	return 0;
+}
+
+#/* */
+int main(int argc, char * argv[])
+{
+	struct sockaddr_un addr;
+	struct pollfd fds[MAX_CLIENTS + 1];
+	const char * outdir = NULL;
+	int verbose = 0;
+	int nfds = 1;
+	int i;
+
+	if(argc < 2) {
+		fprintf(stderr, "Usage: %s <socket path> [output directory] [-v]\n", argv[0]);
+		return 1;
+	}
+	for(i = 2; i < argc; i++) {
+		if(strcmp(argv[i], "-v") == 0)
+			verbose = 1;
+		else
+			outdir = argv[i];
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", argv[1]);
+	unlink(addr.sun_path);
+
+	fds[0].fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	fds[0].events = POLLIN;
+	if(fds[0].fd < 0 || bind(fds[0].fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fds[0].fd, MAX_CLIENTS) != 0) {
+		fprintf(stderr, "can't listen on %s: %s\n", argv[1], strerror(errno));
+		return 1;
+	}
+
+	signal(SIGINT, on_signal);
+	signal(SIGTERM, on_signal);
+
+	while(!stop) {
+		if(poll(fds, nfds, -1) < 0) {
+			if(errno == EINTR)
+				continue;
+			break;
+		}
+
+		for(i = nfds - 1; i > 0; i--) {
+			if(fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+				if(handle_packet(fds[i].fd, outdir, verbose)) {
+					close(fds[i].fd);
+					fds[i] = fds[--nfds];
+				}
+			}
+		}
+
+		if(fds[0].revents & POLLIN) {
+			int fd = accept(fds[0].fd, NULL, NULL);
+			if(fd >= 0) {
+				if(nfds <= MAX_CLIENTS) {
+					fds[nfds].fd = fd;
+					fds[nfds].events = POLLIN;
+					nfds++;
+				} else {
+					close(fd);
+				}
+			}
+		}
+	}
+
+	for(i = 0; i < MAX_FILES; i++) {
+		if(files[i].name[0]) {
+			fprintf(stdout, "%s: %lu frames %lu lost %lu silence samples\n", files[i].name, files[i].frames, files[i].lost, files[i].silence);
+			if(files[i].file)
+				fclose(files[i].file);
+		}
+	}
+	unlink(addr.sun_path);
+	return 0;
+}
@@ -0,0 +1,130 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+
+   Offline decoder of chan_dongle trace ring saved by 'dongle trace dump <file>'
+     tracedump <file> [device]
+   Print records from oldest as text like debug log, optionally only of one device,
+   and summary of events with min/avg/max interval between same events of device.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+#define MAX_DEVICES	256
+
+struct event_stat {
+	char		device[TRACE_DEVICE_SIZE + 1];
+	uint64_t	last[TRACE_EVENTS_NUMBER];
+	unsigned long	count[TRACE_EVENTS_NUMBER];
+	uint64_t	min[TRACE_EVENTS_NUMBER];
+	uint64_t	max[TRACE_EVENTS_NUMBER];
+	uint64_t	sum[TRACE_EVENTS_NUMBER];
+};
+
+static struct event_stat stats[MAX_DEVICES];
+static int nstats;
+
+#/* */
+static struct event_stat * stat_get(const char * device)
+{
+	int i;
+
+	for(i = 0; i < nstats; ++i)
+		if(strcmp(stats[i].device, device) == 0)
+			return &stats[i];
+	if(nstats >= MAX_DEVICES)
+		return NULL;
+	memcpy(stats[nstats].device, device, TRACE_DEVICE_SIZE);
+	return &stats[nstats++];
+}
+
+#/* */
+static void stat_update(const char * device, unsigned event, uint64_t timestamp)
+{
+	struct event_stat * st = stat_get(device);
+	uint64_t diff;
+
+	if(!st || event >= TRACE_EVENTS_NUMBER)
+		return;
+	if(st->count[event])
+	{
+		diff = timestamp - st->last[event];
+		if(st->count[event] == 1 || diff < st->min[event])
+			st->min[event] = diff;
+		if(diff > st->max[event])
+			st->max[event] = diff;
+		st->sum[event] += diff;
+	}
+	st->last[event] = timestamp;
+	st->count[event]++;
+}
+
+#/* */
+int main(int argc, char * argv[])
+{
+	static const char * const names[] = {
+		"channel_read", "channel_timing", "channel_write", "write_frame", "timing_write", "at_read"
+		};
+	struct trace_dump_hdr hdr;
+	struct trace_record rec;
+	char device[TRACE_DEVICE_SIZE + 1];
+	char tbuf[32];
+	time_t sec;
+	unsigned i;
+	int d, e;
+	FILE * file;
+
+	if(argc < 2)
+	{
+		fprintf(stderr, "Usage: %s <file> [device]\n", argv[0]);
+		return 1;
+	}
+
+	file = fopen(argv[1], "rb");
+	if(!file)
+	{
+		perror(argv[1]);
+		return 1;
+	}
+	if(fread(&hdr, sizeof(hdr), 1, file) != 1 || hdr.magic != TRACE_MAGIC || hdr.version != TRACE_VERSION || hdr.record_size != sizeof(rec))
+	{
+		fprintf(stderr, "%s: not a trace dump or unsupported version\n", argv[1]);
+		fclose(file);
+		return 1;
+	}
+
+	printf("%u records, %u lost\n", hdr.count, hdr.lost);
+	for(i = 0; i < hdr.count && fread(&rec, sizeof(rec), 1, file) == 1; ++i)
+	{
+		memcpy(device, rec.device, TRACE_DEVICE_SIZE);
+		device[TRACE_DEVICE_SIZE] = 0;
+		if(argc > 2 && strcmp(argv[2], device))
+			continue;
+
+		stat_update(device, rec.event, rec.timestamp);
+
+		sec = rec.timestamp / 1000000;
+		strftime(tbuf, sizeof(tbuf), "%H:%M:%S", localtime(&sec));
+		printf("%s.%06u [%s] ", tbuf, (unsigned)(rec.timestamp % 1000000), device);
+		printf(trace_event2fmt(rec.event), rec.args[0], rec.args[1], rec.args[2], rec.args[3]);
+	}
+	fclose(file);
+
+	printf("\n%-20s %-16s %10s %12s %12s %12s\n", "device", "event", "count", "min us", "avg us", "max us");
+	for(d = 0; d < nstats; ++d)
+	{
+		for(e = 0; e < TRACE_EVENTS_NUMBER; ++e)
+		{
+			if(stats[d].count[e] == 0)
+				continue;
+			printf("%-20s %-16s %10lu %12llu %12llu %12llu\n", stats[d].device, names[e], stats[d].count[e],
+				(unsigned long long)stats[d].min[e],
+				(unsigned long long)(stats[d].count[e] > 1 ? stats[d].sum[e] / (stats[d].count[e] - 1) : 0),
+				(unsigned long long)stats[d].max[e]);
+		}
+	}
+	return 0;
+}
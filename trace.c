@@ -0,0 +1,104 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#ifdef BUILD_TRACE
+
+#include <stdio.h>				/* fopen() fwrite() fclose() snprintf() */
+#include <string.h>				/* strncpy() */
+#include <errno.h>				/* errno */
+
+#include <asterisk.h>
+#include <asterisk/logger.h>			/* ast_log() */
+#include <asterisk/time.h>			/* ast_tvnow() */
+
+#include "trace.h"
+
+EXPORT_DEF volatile int trace_mode = TRACE_OFF;
+
+static struct trace_record trace_ring[TRACE_RING_SIZE];
+static volatile unsigned trace_head;			/* total number of records, next record at trace_head % TRACE_RING_SIZE */
+
+#/* called only when trace_mode != TRACE_OFF */
+EXPORT_DEF void trace_event(trace_event_t event, const char * device, int a1, int a2, int a3, int a4)
+{
+	struct trace_record * rec;
+	struct timeval tv;
+	char msg[128];
+
+	if(trace_mode == TRACE_DEBUG)
+	{
+		snprintf(msg, sizeof(msg), trace_event2fmt(event), a1, a2, a3, a4);
+		ast_log(LOG_DEBUG, "[%s] %s", device, msg);
+		return;
+	}
+
+	/* each writer own slot, concurrent writers of same slot only after ring wrap */
+	rec = &trace_ring[__sync_fetch_and_add(&trace_head, 1) & (TRACE_RING_SIZE - 1)];
+	tv = ast_tvnow();
+	rec->timestamp = tv.tv_sec * 1000000ULL + tv.tv_usec;
+	rec->event = event;
+	rec->args[0] = a1;
+	rec->args[1] = a2;
+	rec->args[2] = a3;
+	rec->args[3] = a4;
+	strncpy(rec->device, device, sizeof(rec->device));
+}
+
+#/* */
+EXPORT_DEF const char * trace_mode2str(trace_mode_t mode)
+{
+	static const char * const modes[] = { "off", "ring", "debug" };
+	return (unsigned)mode < sizeof(modes) / sizeof(modes[0]) ? modes[mode] : "unknown";
+}
+
+#/* */
+EXPORT_DEF int trace_set_mode(trace_mode_t mode)
+{
+	int old = trace_mode;
+
+	/* start ring from empty state */
+	if(mode == TRACE_RING && old != TRACE_RING)
+		trace_head = 0;
+	trace_mode = mode;
+	return old;
+}
+
+#/* save ring from oldest record; return 0 on success or errno */
+EXPORT_DEF int trace_dump(const char * path, unsigned * count)
+{
+	struct trace_dump_hdr hdr;
+	unsigned head = trace_head;
+	unsigned first, i;
+	FILE * file;
+	int err = 0;
+
+	hdr.magic = TRACE_MAGIC;
+	hdr.version = TRACE_VERSION;
+	hdr.record_size = sizeof(struct trace_record);
+	hdr.count = head < TRACE_RING_SIZE ? head : TRACE_RING_SIZE;
+	hdr.lost = head - hdr.count;
+	first = head - hdr.count;
+
+	file = fopen(path, "wb");
+	if(!file)
+		return errno;
+
+	if(fwrite(&hdr, sizeof(hdr), 1, file) != 1)
+		err = errno;
+	for(i = 0; i < hdr.count && !err; ++i)
+	{
+		if(fwrite(&trace_ring[(first + i) & (TRACE_RING_SIZE - 1)], sizeof(struct trace_record), 1, file) != 1)
+			err = errno;
+	}
+	if(fclose(file) && !err)
+		err = errno;
+
+	*count = hdr.count;
+	return err;
+}
+
+#endif /* BUILD_TRACE */
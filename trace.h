@@ -0,0 +1,95 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifndef CHAN_DONGLE_TRACE_H_INCLUDED
+#define CHAN_DONGLE_TRACE_H_INCLUDED
+
+#include <stdint.h>			/* uint32_t uint64_t */
+
+#include "export.h"			/* EXPORT_DECL INLINE_DECL */
+
+/*
+   Per frame and per read events of audio and AT paths.
+   Mode selected by CLI 'dongle trace off|ring|debug', default off:
+     off	one not taken branch per event, no formatting, no debug level check
+     ring	binary record to in memory ring, 'dongle trace dump <file>' save it for tools/tracedump
+     debug	format as ast_debug() like before
+   Build with ./configure --disable-trace remove all events from code
+*/
+
+#define TRACE_MAGIC			0x52544344			/* 'DCTR' */
+#define TRACE_VERSION			1
+#define TRACE_DEVICE_SIZE		20
+#define TRACE_RING_SIZE			8192				/* number of records, power of 2 */
+
+typedef enum {
+	TRACE_OFF = 0,
+	TRACE_RING,
+	TRACE_DEBUG,
+} trace_mode_t;
+
+/* magic order !!! keep order of this values like in trace_event2fmt() */
+typedef enum {
+	TRACE_CHANNEL_READ = 0,
+	TRACE_CHANNEL_TIMING,
+	TRACE_CHANNEL_WRITE,
+	TRACE_CHANNEL_WRITE_FRAME,
+	TRACE_TIMING_WRITE,
+	TRACE_AT_READ,
+	TRACE_EVENTS_NUMBER,
+} trace_event_t;
+
+struct trace_record
+{
+	uint64_t		timestamp;			/*!< wall clock time in microseconds */
+	uint16_t		event;				/*!< see trace_event_t */
+	uint16_t		reserved;
+	int32_t			args[4];			/*!< event arguments, see trace_event2fmt() */
+	char			device[TRACE_DEVICE_SIZE];	/*!< device name, may be truncated */
+};
+
+/* dump file is header followed by count records from oldest */
+struct trace_dump_hdr
+{
+	uint32_t		magic;				/*!< TRACE_MAGIC */
+	uint16_t		version;			/*!< TRACE_VERSION */
+	uint16_t		record_size;			/*!< sizeof(struct trace_record) */
+	uint32_t		count;				/*!< number of records */
+	uint32_t		lost;				/*!< number of overwritten records */
+};
+
+/* format of event arguments after '[device] ' */
+INLINE_DECL const char * trace_event2fmt(trace_event_t event)
+{
+	static const char * const fmts[] = {
+		"read call idx %d state %d audio_fd %d\n",
+		"*** timing *** call idx %d\n",
+		"write call idx %d state %d\n",
+		"Write frame: samples = %d, data lenght = %d byte\n",
+		"timing write used %d truncated %d silence %d\n",
+		"receive %d byte, used %d, free %d, write %d\n",
+		};
+	return (unsigned)event < sizeof(fmts) / sizeof(fmts[0]) ? fmts[event] : "unknown event %d %d %d %d\n";
+}
+
+#ifdef BUILD_TRACE
+
+EXPORT_DECL volatile int trace_mode;
+
+EXPORT_DECL void trace_event(trace_event_t event, const char * device, int a1, int a2, int a3, int a4);
+EXPORT_DECL int trace_set_mode(trace_mode_t mode);
+EXPORT_DECL const char * trace_mode2str(trace_mode_t mode);
+EXPORT_DECL int trace_dump(const char * path, unsigned * count);
+
+#define TRACE_ON()					__builtin_expect(trace_mode != TRACE_OFF, 0)
+#define TRACE(event, device, a1, a2, a3, a4)		do { if(TRACE_ON()) trace_event(event, device, a1, a2, a3, a4); } while(0)
+#define TRACE_DEBUG()					__builtin_expect(trace_mode == TRACE_DEBUG, 0)
+
+#else /* BUILD_TRACE */
+
+#define TRACE(event, device, a1, a2, a3, a4)
+#define TRACE_DEBUG()					0
+
+#endif /* BUILD_TRACE */
+
+#endif /* CHAN_DONGLE_TRACE_H_INCLUDED */
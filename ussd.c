@@ -0,0 +1,293 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>			/* malloc() calloc() free() */
+#include <string.h>			/* memcpy() memset() strcmp() strlen() */
+#include <errno.h>			/* E2BIG ENOMEM EBUSY ENOENT */
+
+#include "ussd.h"
+
+struct ussd_cache_entry
+{
+	struct ussd_cache_entry	* next;				/*!< next older answer */
+	time_t			expire;
+	size_t			length;				/*!< bytes of text */
+	const char		* code;				/*!< stored after sim */
+	const char		* text;				/*!< stored after code */
+	char			sim[1];				/*!< payload: sim\0code\0text\0 */
+};
+
+#/* */
+EXPORT_DEF int ussd_session_check(const struct ussd_session * session, uint64_t id)
+{
+	if(id)
+		return session->state == USSD_OPEN && session->id == id ? 0 : -ENOENT;
+
+	/* while session open network take any request as next step */
+	return session->state == USSD_IDLE ? 0 : -EBUSY;
+}
+
+#/* */
+EXPORT_DEF void ussd_session_queue(struct ussd_session * session, uint64_t id, const char * code, const void * task, time_t now)
+{
+	if(code)
+	{
+		session->steps = 1;
+		strncpy(session->code, code, sizeof(session->code) - 1);
+		session->code[sizeof(session->code) - 1] = 0;
+	}
+	else
+	{
+		session->steps++;
+	}
+	session->id = id;
+	session->state = USSD_QUEUED;
+	session->deadline = now + USSD_SESSION_TIMEOUT;
+	session->task = task;
+}
+
+#/* */
+EXPORT_DEF int ussd_session_sent(struct ussd_session * session, const void * task, int sent, time_t now)
+{
+	if(session->state != USSD_QUEUED || session->task != task)
+		return 0;
+
+	session->task = NULL;
+	if(sent)
+	{
+		session->state = USSD_WAITING;
+		session->deadline = now + USSD_SESSION_TIMEOUT;
+	}
+	return 1;
+}
+
+#/* */
+EXPORT_DEF int ussd_session_cacheable(const struct ussd_session * session, int type)
+{
+	return session->state != USSD_IDLE && type == 0 && session->steps == 1 && session->code[0];
+}
+
+#/* */
+EXPORT_DEF ussd_answer_t ussd_session_answer(struct ussd_session * session, int type, uint64_t * next_id, time_t now)
+{
+	if(type == 1)
+	{
+		if(session->state == USSD_IDLE)
+		{
+			/* menu started by network */
+			session->id = (*next_id)++;
+			session->steps = 0;
+			session->code[0] = 0;
+		}
+		session->state = USSD_OPEN;
+		session->task = NULL;
+		session->deadline = now + USSD_SESSION_TIMEOUT;
+		return USSD_ANSWER_OPEN;
+	}
+	if(session->state == USSD_IDLE)
+		return USSD_ANSWER_IGNORED;
+
+	/* 0 notify and 2 terminated by network carry answer, others are errors */
+	return type == 0 || type == 2 ? USSD_ANSWER_DONE : USSD_ANSWER_FAILED;
+}
+
+#/* */
+EXPORT_DEF int ussd_session_expired(const struct ussd_session * session, time_t now)
+{
+	return session->state != USSD_IDLE && now >= session->deadline;
+}
+
+#/* */
+EXPORT_DEF void ussd_cache_init(struct ussd_cache * cache)
+{
+	memset(cache, 0, sizeof(*cache));
+}
+
+#/* unlink entry after prev and free it */
+static void ussd_cache_free(struct ussd_cache * cache, struct ussd_cache_entry ** prev)
+{
+	struct ussd_cache_entry * entry = *prev;
+
+	*prev = entry->next;
+	cache->count--;
+	free(entry);
+}
+
+#/* */
+EXPORT_DEF void ussd_cache_destroy(struct ussd_cache * cache)
+{
+	while(cache->head)
+		ussd_cache_free(cache, &cache->head);
+}
+
+#/* */
+EXPORT_DEF const char * ussd_cache_get(struct ussd_cache * cache, const char * sim, const char * code, time_t now, size_t * length)
+{
+	struct ussd_cache_entry ** prev;
+	struct ussd_cache_entry * entry;
+
+	for(prev = &cache->head; (entry = *prev); prev = &entry->next)
+	{
+		if(strcmp(entry->sim, sim) == 0 && strcmp(entry->code, code) == 0)
+		{
+			if(entry->expire <= now)
+			{
+				ussd_cache_free(cache, prev);
+				break;
+			}
+			cache->hits++;
+			*length = entry->length;
+			return entry->text;
+		}
+	}
+	cache->misses++;
+	return NULL;
+}
+
+#/* */
+EXPORT_DEF int ussd_cache_put(struct ussd_cache * cache, const char * sim, const char * code, const char * text, size_t length, time_t expire)
+{
+	struct ussd_cache_entry ** prev;
+	struct ussd_cache_entry * entry;
+	size_t sim_len = strlen(sim) + 1;
+	size_t code_len = strlen(code) + 1;
+	char * ptr;
+
+	if(length >= USSD_TEXT_MAX || code_len > USSD_CODE_MAX)
+		return -E2BIG;
+
+	for(prev = &cache->head; (entry = *prev); prev = &entry->next)
+	{
+		if(strcmp(entry->sim, sim) == 0 && strcmp(entry->code, code) == 0)
+		{
+			ussd_cache_free(cache, prev);
+			break;
+		}
+	}
+
+	entry = malloc(sizeof(*entry) + sim_len + code_len + length);
+	if(!entry)
+		return -ENOMEM;
+
+	ptr = entry->sim;
+	memcpy(ptr, sim, sim_len);
+	ptr += sim_len;
+	memcpy(ptr, code, code_len);
+	entry->code = ptr;
+	ptr += code_len;
+	memcpy(ptr, text, length);
+	ptr[length] = 0;
+	entry->text = ptr;
+	entry->length = length;
+	entry->expire = expire;
+
+	entry->next = cache->head;
+	cache->head = entry;
+	if(++cache->count > USSD_CACHE_MAX)
+	{
+		for(prev = &cache->head; (*prev)->next; prev = &(*prev)->next)
+			;
+		ussd_cache_free(cache, prev);
+	}
+	return 0;
+}
+
+#/* */
+EXPORT_DEF void ussd_cache_expire(struct ussd_cache * cache, time_t now)
+{
+	struct ussd_cache_entry ** prev = &cache->head;
+
+	while(*prev)
+	{
+		if((*prev)->expire <= now)
+			ussd_cache_free(cache, prev);
+		else
+			prev = &(*prev)->next;
+	}
+}
+
+#/* */
+EXPORT_DEF struct ussd_fanout * ussd_fanout_alloc(uint64_t id, int group, const char * code, unsigned limit, unsigned capacity)
+{
+	struct ussd_fanout * fanout;
+	size_t code_len = strlen(code) + 1;
+
+	if(code_len > USSD_CODE_MAX)
+		return NULL;
+
+	fanout = calloc(1, sizeof(*fanout) + (capacity ? capacity - 1 : 0) * sizeof(fanout->devices[0]));
+	if(!fanout)
+		return NULL;
+
+	fanout->id = id;
+	fanout->group = group;
+	fanout->limit = limit ? limit : USSD_FANOUT_LIMIT;
+	fanout->capacity = capacity;
+	memcpy(fanout->code, code, code_len);
+	return fanout;
+}
+
+#/* */
+EXPORT_DEF int ussd_fanout_add(struct ussd_fanout * fanout, const char * device)
+{
+	struct ussd_fanout_device * dev;
+	size_t length = strlen(device);
+
+	if(fanout->count >= fanout->capacity || length >= sizeof(dev->name))
+		return -1;
+
+	dev = &fanout->devices[fanout->count++];
+	memcpy(dev->name, device, length + 1);
+	dev->state = USSD_FANOUT_PENDING;
+	return 0;
+}
+
+#/* */
+EXPORT_DEF int ussd_fanout_next(const struct ussd_fanout * fanout, unsigned from)
+{
+	unsigned idx;
+
+	if(fanout->inflight >= fanout->limit)
+		return -1;
+
+	for(idx = from; idx < fanout->count; ++idx)
+	{
+		if(fanout->devices[idx].state == USSD_FANOUT_PENDING)
+			return idx;
+	}
+	return -1;
+}
+
+#/* */
+EXPORT_DEF void ussd_fanout_start(struct ussd_fanout * fanout, unsigned idx)
+{
+	fanout->devices[idx].state = USSD_FANOUT_STARTED;
+	fanout->inflight++;
+}
+
+#/* */
+EXPORT_DEF int ussd_fanout_finish(struct ussd_fanout * fanout, unsigned idx, int answered)
+{
+	struct ussd_fanout_device * dev = &fanout->devices[idx];
+
+	if(dev->state == USSD_FANOUT_STARTED)
+		fanout->inflight--;
+	if(dev->state == USSD_FANOUT_PENDING || dev->state == USSD_FANOUT_STARTED)
+	{
+		if(answered)
+		{
+			dev->state = USSD_FANOUT_ANSWERED;
+			fanout->answered++;
+		}
+		else
+		{
+			dev->state = USSD_FANOUT_FAILED;
+			fanout->failed++;
+		}
+	}
+	return fanout->answered + fanout->failed == fanout->count;
+}
@@ -0,0 +1,152 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifndef CHAN_DONGLE_USSD_H_INCLUDED
+#define CHAN_DONGLE_USSD_H_INCLUDED
+
+#include <stdint.h>			/* uint64_t uintptr_t */
+#include <sys/types.h>			/* size_t time_t */
+
+#include "export.h"			/* EXPORT_DECL EXPORT_DEF */
+#include "dc_config.h"			/* DEVNAMELEN */
+
+/*
+   USSD requests, menu sessions, cache of answers and group fan-out.
+
+   Device has at most one session: request queued or sent and waiting for
+   +CUSD, or open after answer of type 1 (further user action) until next
+   step with same id. Other answers, send errors and USSD_SESSION_TIMEOUT
+   close session. +CUSD may come before result of AT+CUSD, then result
+   does not belong to session anymore.
+
+   Cache keep final answer (type 0) of one step request by SIM and code until
+   expire time, so repeated request answered without network. Entries kept
+   newest first and limited by USSD_CACHE_MAX.
+
+   Fan-out is one request to devices of group. Devices started in order
+   while less than limit of them in flight, answer, error or timeout of
+   device free slot for next.
+
+   Structures not locked, caller must serialize access.
+*/
+
+#define USSD_CODE_MAX			161			/* request with terminator */
+#define USSD_TEXT_MAX			1024			/* decoded answer with terminator */
+#define USSD_CACHE_MAX			256			/* answers in cache */
+#define USSD_SESSION_TIMEOUT		60			/* seconds for answer or next step of menu */
+#define USSD_FANOUT_LIMIT		4			/* default devices of fan-out in flight */
+
+/* request id as id of manager events and CLI */
+#define USSD_ID(id)			((void *)(uintptr_t)(id))
+
+typedef enum {
+	USSD_IDLE = 0,
+	USSD_QUEUED,						/*!< AT+CUSD in queue of device */
+	USSD_WAITING,						/*!< sent, wait for +CUSD */
+	USSD_OPEN,						/*!< answered with type 1, wait for next step */
+} ussd_state_t;
+
+/* result of +CUSD for session */
+typedef enum {
+	USSD_ANSWER_IGNORED = 0,				/*!< no session, answer without request id */
+	USSD_ANSWER_OPEN,					/*!< menu open, wait for next step */
+	USSD_ANSWER_DONE,					/*!< answered, session must be closed */
+	USSD_ANSWER_FAILED,					/*!< error of network, session must be closed */
+} ussd_answer_t;
+
+typedef enum {
+	USSD_FANOUT_PENDING = 0,
+	USSD_FANOUT_STARTED,
+	USSD_FANOUT_ANSWERED,
+	USSD_FANOUT_FAILED,
+} ussd_fanout_state_t;
+
+struct ussd_fanout;
+struct ussd_cache_entry;
+
+struct ussd_session
+{
+	uint64_t		id;				/*!< request id, 0 when idle */
+	ussd_state_t		state;
+	unsigned		steps;				/*!< requests of session */
+	time_t			deadline;			/*!< answer or next step expected before */
+	const void		* task;				/*!< AT task of request until sent */
+	struct ussd_fanout	* fanout;			/*!< fan-out of request or NULL */
+	unsigned		fanout_idx;			/*!< index of device in fanout */
+	char			code[USSD_CODE_MAX];		/*!< request of first step, key of cache */
+};
+
+struct ussd_cache
+{
+	struct ussd_cache_entry	* head;				/*!< newest first */
+	unsigned		count;
+	unsigned long		hits;
+	unsigned long		misses;
+};
+
+struct ussd_fanout_device
+{
+	char			name[DEVNAMELEN];
+	ussd_fanout_state_t	state;
+};
+
+struct ussd_fanout
+{
+	struct ussd_fanout	* next;				/*!< list of active fan-outs */
+	uint64_t		id;
+	int			group;
+	unsigned		limit;				/*!< devices in flight at most */
+	unsigned		capacity;
+	unsigned		count;				/*!< devices added */
+	unsigned		inflight;
+	unsigned		answered;
+	unsigned		failed;
+	char			code[USSD_CODE_MAX];
+	struct ussd_fanout_device devices[1];
+};
+
+/* return 0 if request (id 0) or step of session id may be queued, -EBUSY or -ENOENT otherwise */
+EXPORT_DECL int ussd_session_check(const struct ussd_session * session, uint64_t id);
+
+/* request of session queued as task: first step with code or next step with NULL */
+EXPORT_DECL void ussd_session_queue(struct ussd_session * session, uint64_t id, const char * code, const void * task, time_t now);
+
+/* result of AT+CUSD; return 1 if task is request of session, not sent session must be closed */
+EXPORT_DECL int ussd_session_sent(struct ussd_session * session, const void * task, int sent, time_t now);
+
+/* return non-zero if +CUSD of type is final answer of one step request */
+EXPORT_DECL int ussd_session_cacheable(const struct ussd_session * session, int type);
+
+/* +CUSD of type, menu started by network get id from next_id */
+EXPORT_DECL ussd_answer_t ussd_session_answer(struct ussd_session * session, int type, uint64_t * next_id, time_t now);
+
+/* return non-zero if session not answered or continued in time */
+EXPORT_DECL int ussd_session_expired(const struct ussd_session * session, time_t now);
+
+EXPORT_DECL void ussd_cache_init(struct ussd_cache * cache);
+EXPORT_DECL void ussd_cache_destroy(struct ussd_cache * cache);
+
+/* return answer and set length or return NULL; answer valid until next change of cache */
+EXPORT_DECL const char * ussd_cache_get(struct ussd_cache * cache, const char * sim, const char * code, time_t now, size_t * length);
+
+/* replace answer of SIM and code, drop oldest when full; return 0, -E2BIG or -ENOMEM */
+EXPORT_DECL int ussd_cache_put(struct ussd_cache * cache, const char * sim, const char * code, const char * text, size_t length, time_t expire);
+
+/* drop answers expired at now */
+EXPORT_DECL void ussd_cache_expire(struct ussd_cache * cache, time_t now);
+
+/* allocate fan-out for capacity devices, free() by caller; NULL if no memory */
+EXPORT_DECL struct ussd_fanout * ussd_fanout_alloc(uint64_t id, int group, const char * code, unsigned limit, unsigned capacity);
+
+/* return 0 or -1 when full */
+EXPORT_DECL int ussd_fanout_add(struct ussd_fanout * fanout, const char * device);
+
+/* return index of pending device from index from when slot free, -1 otherwise */
+EXPORT_DECL int ussd_fanout_next(const struct ussd_fanout * fanout, unsigned from);
+
+EXPORT_DECL void ussd_fanout_start(struct ussd_fanout * fanout, unsigned idx);
+
+/* finish started or pending device, return 1 when all devices finished */
+EXPORT_DECL int ussd_fanout_finish(struct ussd_fanout * fanout, unsigned idx, int answered);
+
+#endif /* CHAN_DONGLE_USSD_H_INCLUDED */
@@ -0,0 +1,622 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif /* HAVE_CONFIG_H */
+
+#include <stdlib.h>				/* free() */
+#include <string.h>				/* memcpy() memset() strlen() */
+#include <errno.h>				/* errno E2BIG EBUSY EIO ENODEV ENOENT ENOMEM */
+#include <pthread.h>				/* pthread_t pthread_join() */
+
+#include <asterisk.h>
+#include <asterisk/utils.h>			/* ast_pthread_create_background() ast_copy_string() */
+#include <asterisk/lock.h>			/* AST_MUTEX_DEFINE_STATIC ast_cond_t */
+#include <asterisk/time.h>			/* ast_tvnow() ast_tvadd() ast_samp2tv() */
+
+#include "ussdq.h"
+#include "ussd.h"				/* struct ussd_session ussd_session_*() struct ussd_cache struct ussd_fanout */
+#include "chan_dongle.h"			/* gpublic struct pvt pvt_enabled() find_device() */
+#include "at_command.h"				/* at_enque_ussd() */
+#include "at_response.h"			/* at_ussd_deliver() */
+#include "manager.h"				/* manager_event_sent_notify() manager_event_ussd_group() */
+
+/* answer from cache of request, delivered by USSD thread after response to caller */
+struct ussdq_answer
+{
+	struct ussdq_answer	* next;
+	uint64_t		id;
+	time_t			hold;				/*!< not delivered before this time unless released */
+	int			released;			/*!< caller sent response with id */
+	size_t			length;
+	char			device[DEVNAMELEN];
+	char			text[1];
+};
+
+static struct ussdq
+{
+	struct ussd_cache	cache;				/*!< final answers by SIM and code */
+	struct ussd_fanout	* fanouts;			/*!< fan-outs, finished freed by USSD thread */
+	struct ussdq_answer	* answers;			/*!< answers from cache waiting for delivery */
+	ast_cond_t		cond;				/*!< wakeup of USSD thread */
+	pthread_t		thread;
+	int			initialized;			/*!< cond and cache ready */
+	volatile int		running;
+	int			wakeup;
+	uint64_t		next_id;
+	struct ussdq_stat	stat;
+} ussdq = { .thread = AST_PTHREADT_NULL, .next_id = 1 };
+
+AST_MUTEX_DEFINE_STATIC(ussdq_lock);			/* cache, fan-outs, ids and counters, taken after pvt lock */
+
+#/* ussdq_lock must be held */
+static void ussdq_wakeup()
+{
+	ussdq.wakeup = 1;
+	ast_cond_signal(&ussdq.cond);
+}
+
+#/* pvt lock must be held */
+static int ussdq_device_ready(const struct pvt * pvt)
+{
+	return pvt->connected && pvt->initialized && pvt->gsm_registered && pvt_enabled(pvt);
+}
+
+#/* key of cache, device id until IMSI known */
+static const char * ussdq_sim(const struct pvt * pvt)
+{
+	return pvt->imsi[0] ? pvt->imsi : PVT_ID(pvt);
+}
+
+#/* ussdq_lock must be held, finish device of fan-out and report last */
+static void ussdq_fanout_finish(struct ussd_fanout * fanout, unsigned idx, int answered)
+{
+	if(ussd_fanout_finish(fanout, idx, answered))
+	{
+		ast_verb (3, "USSD %llu to group %d finished, %u of %u devices answered\n", (unsigned long long)fanout->id, fanout->group, fanout->answered, fanout->count);
+		manager_event_ussd_group(USSD_ID(fanout->id), fanout->group, fanout->count, fanout->answered, fanout->failed);
+	}
+	ussdq_wakeup();
+}
+
+#/* pvt lock must be held, finish part of fan-out of device session */
+static void ussdq_fanout_release(struct pvt * pvt, int answered)
+{
+	struct ussd_session * session = &pvt->ussd;
+
+	if(!session->fanout)
+		return;
+
+	ast_mutex_lock(&ussdq_lock);
+	ussdq_fanout_finish(session->fanout, session->fanout_idx, answered);
+	ast_mutex_unlock(&ussdq_lock);
+	session->fanout = NULL;
+}
+
+#/* pvt lock must be held */
+static void ussdq_close(struct pvt * pvt, int answered)
+{
+	ussdq_fanout_release(pvt, answered);
+	memset(&pvt->ussd, 0, sizeof(pvt->ussd));
+}
+
+#/* ussdq_lock must be held, add answer for delivery by USSD thread; return 0 or -1 */
+static int ussdq_answer_defer(const struct pvt * pvt, uint64_t id, const char * text, size_t length)
+{
+	struct ussdq_answer * answer;
+	struct ussdq_answer ** tail;
+
+	if(!ussdq.running)
+		return -1;
+	answer = malloc(sizeof(*answer) + length);
+	if(!answer)
+		return -1;
+
+	answer->next = NULL;
+	answer->id = id;
+	answer->hold = time(NULL) + USSDQ_HOLD;
+	answer->released = 0;
+	answer->length = length;
+	ast_copy_string(answer->device, PVT_ID(pvt), sizeof(answer->device));
+	memcpy(answer->text, text, length + 1);
+
+	for(tail = &ussdq.answers; *tail; tail = &(*tail)->next)
+		;
+	*tail = answer;
+	return 0;
+}
+
+#/* pvt lock must be held, answer from cache or queue first step; return 0 queued, 1 answered or negative errno */
+static int ussdq_start(struct pvt * pvt, uint64_t id, const char * code, struct ussd_fanout * fanout, unsigned idx)
+{
+	struct ussd_session * session = &pvt->ussd;
+	char text[USSD_TEXT_MAX];
+	const char * cached = NULL;
+	size_t length = 0;
+	int deferred = 0;
+	void * task;
+
+	ast_mutex_lock(&ussdq_lock);
+	ussdq.stat.requests++;
+	if(CONF_GLOBAL(ussdcache) > 0)
+	{
+		cached = ussd_cache_get(&ussdq.cache, ussdq_sim(pvt), code, time(NULL), &length);
+		if(cached)
+		{
+			/* caller of fan-out already has response, other caller get response before answer */
+			if(fanout || ussdq_answer_defer(pvt, id, cached, length))
+				/* events split text in place */
+				memcpy(text, cached, length + 1);
+			else
+				deferred = 1;
+			ussdq.stat.cached++;
+		}
+	}
+	ast_mutex_unlock(&ussdq_lock);
+
+	if(cached)
+	{
+		ast_verb (3, "[%s] USSD %llu '%s' answered from cache\n", PVT_ID(pvt), (unsigned long long)id, code);
+		if(!deferred)
+			at_ussd_deliver(pvt, id, 0, text, length);
+		return 1;
+	}
+
+	if(at_enque_ussd(&pvt->sys_chan, code, NULL, 0, 0, &task))
+	{
+		ast_mutex_lock(&ussdq_lock);
+		ussdq.stat.failed++;
+		ast_mutex_unlock(&ussdq_lock);
+		return -EIO;
+	}
+
+	ussd_session_queue(session, id, code, task, time(NULL));
+	session->fanout = fanout;
+	session->fanout_idx = idx;
+	return 0;
+}
+
+#/* pvt lock must be held, give request of fan-out to device */
+static void ussdq_device_pull(struct pvt * pvt, struct ussd_fanout * fanout, unsigned idx)
+{
+	int res;
+
+	ast_mutex_lock(&ussdq_lock);
+	ussd_fanout_start(fanout, idx);
+	ast_mutex_unlock(&ussdq_lock);
+
+	res = ussdq_start(pvt, fanout->id, fanout->code, fanout, idx);
+	if(res == 0)
+	{
+		ast_debug (1, "[%s] USSD %llu of group %d queued as %p\n", PVT_ID(pvt), (unsigned long long)fanout->id, fanout->group, pvt->ussd.task);
+		return;
+	}
+
+	if(res < 0)
+	{
+		ast_log (LOG_ERROR, "[%s] Error adding USSD %llu of group %d to queue\n", PVT_ID(pvt), (unsigned long long)fanout->id, fanout->group);
+		manager_event_sent_notify(PVT_ID(pvt), "USSD", USSD_ID(fanout->id), "NotSent");
+	}
+	ast_mutex_lock(&ussdq_lock);
+	ussdq_fanout_finish(fanout, idx, res > 0);
+	ast_mutex_unlock(&ussdq_lock);
+}
+
+#/* deliver answers from cache released by caller or held too long, or all */
+static void ussdq_answers_deliver(int all)
+{
+	struct ussdq_answer ** prev;
+	struct ussdq_answer * answer;
+	struct ussdq_answer * ready = NULL;
+	struct ussdq_answer ** tail = &ready;
+	struct pvt * pvt;
+	time_t now = time(NULL);
+
+	ast_mutex_lock(&ussdq_lock);
+	prev = &ussdq.answers;
+	while((answer = *prev))
+	{
+		if(all || answer->released || now >= answer->hold)
+		{
+			*prev = answer->next;
+			answer->next = NULL;
+			*tail = answer;
+			tail = &answer->next;
+		}
+		else
+		{
+			prev = &answer->next;
+		}
+	}
+	ast_mutex_unlock(&ussdq_lock);
+
+	while((answer = ready))
+	{
+		ready = answer->next;
+		pvt = find_device(answer->device);
+		if(pvt)
+		{
+			at_ussd_deliver(pvt, answer->id, 0, answer->text, answer->length);
+			ast_mutex_unlock(&pvt->lock);
+		}
+		else
+		{
+			ast_log (LOG_WARNING, "[%s] USSD %llu answer from cache dropped, device removed\n", answer->device, (unsigned long long)answer->id);
+		}
+		free(answer);
+	}
+}
+
+#/* free finished fan-outs and start pending devices while slots free */
+static void ussdq_dispatch()
+{
+	struct ussd_fanout ** prev;
+	struct ussd_fanout * fanout;
+	struct pvt * pvt;
+	char device[DEVNAMELEN];
+	int idx;
+
+	ast_mutex_lock(&ussdq_lock);
+	prev = &ussdq.fanouts;
+	while((fanout = *prev))
+	{
+		if(fanout->answered + fanout->failed == fanout->count)
+		{
+			*prev = fanout->next;
+			ussdq.stat.fanouts--;
+			free(fanout);
+		}
+		else
+		{
+			prev = &fanout->next;
+		}
+	}
+
+	/* only this thread free fan-outs, fan-out live while lock released */
+	for(fanout = ussdq.fanouts; fanout; fanout = fanout->next)
+	{
+		for(idx = ussd_fanout_next(fanout, 0); idx >= 0; idx = ussd_fanout_next(fanout, idx + 1))
+		{
+			memcpy(device, fanout->devices[idx].name, sizeof(device));
+			ast_mutex_unlock(&ussdq_lock);
+
+			pvt = find_device(device);
+			if(pvt && pvt->ussd.state != USSD_IDLE && ussdq_device_ready(pvt))
+			{
+				/* device busy by own session, try on next run */
+				ast_mutex_unlock(&pvt->lock);
+				ast_mutex_lock(&ussdq_lock);
+				continue;
+			}
+			if(pvt && ussdq_device_ready(pvt))
+			{
+				ussdq_device_pull(pvt, fanout, idx);
+				ast_mutex_unlock(&pvt->lock);
+				ast_mutex_lock(&ussdq_lock);
+				continue;
+			}
+
+			if(pvt)
+			{
+				manager_event_sent_notify(PVT_ID(pvt), "USSD", USSD_ID(fanout->id), "NotSent");
+				ast_mutex_unlock(&pvt->lock);
+			}
+			ast_verb (3, "[%s] USSD %llu of group %d not sent, device not ready\n", device, (unsigned long long)fanout->id, fanout->group);
+			ast_mutex_lock(&ussdq_lock);
+			ussdq.stat.failed++;
+			ussdq_fanout_finish(fanout, idx, 0);
+		}
+	}
+	ussd_cache_expire(&ussdq.cache, time(NULL));
+	ussdq.stat.cache_entries = ussdq.cache.count;
+	ast_mutex_unlock(&ussdq_lock);
+}
+
+#/* */
+static void * ussdq_run(attribute_unused void * arg)
+{
+	struct timespec ts;
+	struct timeval tv;
+
+	while(ussdq.running)
+	{
+		ussdq_answers_deliver(0);
+		ussdq_dispatch();
+
+		ast_mutex_lock(&ussdq_lock);
+		if(ussdq.running && !ussdq.wakeup)
+		{
+			tv = ast_tvadd(ast_tvnow(), ast_samp2tv(USSDQ_INTERVAL, 1));
+			ts.tv_sec = tv.tv_sec;
+			ts.tv_nsec = tv.tv_usec * 1000;
+			ast_cond_timedwait(&ussdq.cond, &ussdq_lock, &ts);
+		}
+		ussdq.wakeup = 0;
+		ast_mutex_unlock(&ussdq_lock);
+	}
+	return NULL;
+}
+
+#/* start USSD thread; return 0 or errno */
+EXPORT_DEF int ussdq_init()
+{
+	int err = 0;
+
+	ussd_cache_init(&ussdq.cache);
+	ast_cond_init(&ussdq.cond, NULL);
+	ussdq.initialized = 1;
+
+	ussdq.running = 1;
+	if(ast_pthread_create_background(&ussdq.thread, NULL, ussdq_run, NULL) < 0)
+	{
+		err = errno;
+		ussdq.running = 0;
+		ast_log (LOG_ERROR, "Unable to start USSD thread: %s\n", strerror(err));
+	}
+	return err;
+}
+
+#/* stop USSD thread, devices keep sessions until ussdq_device_reset() */
+EXPORT_DEF void ussdq_stop()
+{
+	if(ussdq.running)
+	{
+		ast_mutex_lock(&ussdq_lock);
+		ussdq.running = 0;
+		ussdq_wakeup();
+		ast_mutex_unlock(&ussdq_lock);
+
+		pthread_join(ussdq.thread, NULL);
+		ussdq.thread = AST_PTHREADT_NULL;
+
+		/* devices still exist, answers not lost by reload */
+		ussdq_answers_deliver(1);
+	}
+}
+
+#/* after devices destroyed */
+EXPORT_DEF void ussdq_fini()
+{
+	struct ussd_fanout * fanout;
+	struct ussdq_answer * answer;
+
+	ussdq_stop();
+	if(!ussdq.initialized)
+		return;
+
+	ast_mutex_lock(&ussdq_lock);
+	while((fanout = ussdq.fanouts))
+	{
+		ussdq.fanouts = fanout->next;
+		free(fanout);
+	}
+	while((answer = ussdq.answers))
+	{
+		ussdq.answers = answer->next;
+		free(answer);
+	}
+	ussd_cache_destroy(&ussdq.cache);
+	memset(&ussdq.stat, 0, sizeof(ussdq.stat));
+	ast_mutex_unlock(&ussdq_lock);
+	ast_cond_destroy(&ussdq.cond);
+	ussdq.initialized = 0;
+}
+
+#/* pvt lock must be held, queue request or next step of open session; return 0 queued, 1 answered from cache or negative errno */
+EXPORT_DEF int ussdq_send(struct pvt * pvt, const char * code, uint64_t session_id, uint64_t * id)
+{
+	struct ussd_session * session = &pvt->ussd;
+	void * task;
+	int res;
+
+	if(strlen(code) >= USSD_CODE_MAX)
+		return -E2BIG;
+	if(!ussdq_device_ready(pvt))
+		return -ENODEV;
+	res = ussd_session_check(session, session_id);
+	if(res)
+		return res;
+
+	if(session_id)
+	{
+		if(at_enque_ussd(&pvt->sys_chan, code, NULL, 0, 0, &task))
+			return -EIO;
+
+		ast_mutex_lock(&ussdq_lock);
+		ussdq.stat.requests++;
+		ast_mutex_unlock(&ussdq_lock);
+
+		ussd_session_queue(session, session_id, NULL, task, time(NULL));
+		*id = session_id;
+		return 0;
+	}
+
+	ast_mutex_lock(&ussdq_lock);
+	*id = ussdq.next_id++;
+	ast_mutex_unlock(&ussdq_lock);
+
+	return ussdq_start(pvt, *id, code, NULL, 0);
+}
+
+#/* caller sent response with id of request, answer from cache may be delivered */
+EXPORT_DEF void ussdq_release(uint64_t id)
+{
+	struct ussdq_answer * answer;
+
+	ast_mutex_lock(&ussdq_lock);
+	for(answer = ussdq.answers; answer; answer = answer->next)
+	{
+		if(answer->id == id)
+		{
+			answer->released = 1;
+			ussdq_wakeup();
+			break;
+		}
+	}
+	ast_mutex_unlock(&ussdq_lock);
+}
+
+#/* queue request to ready devices of group; return 0 or negative errno */
+EXPORT_DEF int ussdq_fanout(int group, const char * code, unsigned limit, uint64_t * id)
+{
+	struct ussd_fanout * fanout = NULL;
+	struct pvt * pvt;
+	unsigned capacity = 0;
+	int pass;
+
+	if(strlen(code) >= USSD_CODE_MAX)
+		return -E2BIG;
+	if(!ussdq.running)
+		return -EIO;
+
+	/* count and add devices with same list lock */
+	AST_RWLIST_RDLOCK(&gpublic->devices);
+	for(pass = 0; pass < 2; ++pass)
+	{
+		AST_RWLIST_TRAVERSE(&gpublic->devices, pvt, entry)
+		{
+			ast_mutex_lock(&pvt->lock);
+			if(CONF_SHARED(pvt, group) == group && ussdq_device_ready(pvt))
+			{
+				if(fanout)
+					ussd_fanout_add(fanout, PVT_ID(pvt));
+				else
+					capacity++;
+			}
+			ast_mutex_unlock(&pvt->lock);
+		}
+		if(!capacity)
+			break;
+		if(!fanout)
+		{
+			fanout = ussd_fanout_alloc(0, group, code, limit, capacity);
+			if(!fanout)
+				break;
+		}
+	}
+	AST_RWLIST_UNLOCK(&gpublic->devices);
+
+	if(!capacity)
+		return -ENODEV;
+	if(!fanout)
+		return -ENOMEM;
+	if(!fanout->count)
+	{
+		free(fanout);
+		return -ENODEV;
+	}
+
+	capacity = fanout->count;
+	ast_mutex_lock(&ussdq_lock);
+	fanout->id = ussdq.next_id++;
+	fanout->next = ussdq.fanouts;
+	ussdq.fanouts = fanout;
+	ussdq.stat.fanouts++;
+	*id = fanout->id;
+	ussdq_wakeup();
+	ast_mutex_unlock(&ussdq_lock);
+
+	ast_verb (3, "USSD %llu '%s' queued to %u devices of group %d\n", (unsigned long long)*id, code, capacity, group);
+	return 0;
+}
+
+#/* pvt lock must be held, return id of request or 0 if task is not request of session */
+EXPORT_DEF uint64_t ussdq_sent(struct pvt * pvt, const void * task, int sent)
+{
+	struct ussd_session * session = &pvt->ussd;
+	uint64_t id = session->id;
+
+	/* +CUSD before result already closed session or opened menu */
+	if(!ussd_session_sent(session, task, sent, time(NULL)))
+		return 0;
+
+	if(!sent)
+	{
+		ast_mutex_lock(&ussdq_lock);
+		ussdq.stat.failed++;
+		ast_mutex_unlock(&ussdq_lock);
+		ussdq_close(pvt, 0);
+	}
+	return id;
+}
+
+#/* pvt lock must be held, update session by +CUSD of type and cache final answer; return id of request or 0 */
+EXPORT_DEF uint64_t ussdq_answer(struct pvt * pvt, int type, const char * text, size_t length)
+{
+	struct ussd_session * session = &pvt->ussd;
+	uint64_t id;
+	time_t now = time(NULL);
+	int ttl = CONF_GLOBAL(ussdcache);
+	ussd_answer_t res;
+
+	ast_mutex_lock(&ussdq_lock);
+	ussdq.stat.answers++;
+	if(ttl > 0 && ussd_session_cacheable(session, type))
+	{
+		ussd_cache_put(&ussdq.cache, ussdq_sim(pvt), session->code, text, length, now + ttl);
+		ussdq.stat.cache_entries = ussdq.cache.count;
+	}
+	/* menu started by network answered with new id */
+	res = ussd_session_answer(session, type, &ussdq.next_id, now);
+	ast_mutex_unlock(&ussdq_lock);
+
+	id = session->id;
+	if(res == USSD_ANSWER_OPEN)
+		ussdq_fanout_release(pvt, 1);
+	else if(res != USSD_ANSWER_IGNORED)
+		ussdq_close(pvt, res == USSD_ANSWER_DONE);
+	return id;
+}
+
+#/* pvt lock must be held, close session without answer or next step in time */
+EXPORT_DEF void ussdq_device_expire(struct pvt * pvt)
+{
+	struct ussd_session * session = &pvt->ussd;
+
+	if(!ussd_session_expired(session, time(NULL)))
+		return;
+
+	ast_verb (3, "[%s] USSD %llu session timed out at step %u\n", PVT_ID(pvt), (unsigned long long)session->id, session->steps);
+	manager_event_sent_notify(PVT_ID(pvt), "USSD", USSD_ID(session->id), "Timeout");
+
+	ast_mutex_lock(&ussdq_lock);
+	ussdq.stat.timeouts++;
+	ast_mutex_unlock(&ussdq_lock);
+	ussdq_close(pvt, 0);
+}
+
+#/* pvt lock must be held, close session of disconnected device */
+EXPORT_DEF void ussdq_device_reset(struct pvt * pvt)
+{
+	struct ussd_session * session = &pvt->ussd;
+
+	if(session->state == USSD_IDLE)
+		return;
+
+	ast_debug (1, "[%s] USSD %llu session closed by disconnect\n", PVT_ID(pvt), (unsigned long long)session->id);
+	manager_event_sent_notify(PVT_ID(pvt), "USSD", USSD_ID(session->id), session->state == USSD_QUEUED ? "NotSent" : "Closed");
+	ussdq_close(pvt, 0);
+}
+
+#/* */
+EXPORT_DEF void ussdq_stat_read(struct ussdq_stat * stat)
+{
+	ast_mutex_lock(&ussdq_lock);
+	memcpy(stat, &ussdq.stat, sizeof(*stat));
+	ast_mutex_unlock(&ussdq_lock);
+}
+
+#/* call callback for each fan-out in progress under USSD lock */
+EXPORT_DEF void ussdq_fanouts_read(void (*callback)(void * arg, uint64_t id, int group, unsigned count, unsigned finished, unsigned inflight), void * arg)
+{
+	struct ussd_fanout * fanout;
+
+	ast_mutex_lock(&ussdq_lock);
+	for(fanout = ussdq.fanouts; fanout; fanout = fanout->next)
+	{
+		if(fanout->answered + fanout->failed < fanout->count)
+			callback(arg, fanout->id, fanout->group, fanout->count, fanout->answered + fanout->failed, fanout->inflight);
+	}
+	ast_mutex_unlock(&ussdq_lock);
+}
@@ -0,0 +1,60 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifndef CHAN_DONGLE_USSDQ_H_INCLUDED
+#define CHAN_DONGLE_USSDQ_H_INCLUDED
+
+#include <stdint.h>			/* uint64_t */
+#include <sys/types.h>			/* size_t */
+
+#include "export.h"			/* EXPORT_DECL EXPORT_DEF */
+
+/*
+   USSD engine of devices.
+
+   Request to device get id from ussdq_send(), same id carried by
+   DongleUSSDStatus and DongleNewUSSD events of result and by next steps of
+   menu session. Request with session id continue open session of device,
+   other request refused while device has session. With ussdcache final
+   answer of SIM repeated from cache without network.
+
+   Answer from cache is delivered by USSD thread after caller sent response
+   with id and called ussdq_release(), or after USSDQ_HOLD seconds.
+
+   Request to g<group> become fan-out: USSD thread give request to ready
+   devices of group, at most limit of them in flight, and send
+   DongleUSSDGroupComplete after last device answered or failed.
+*/
+
+#define USSDQ_INTERVAL			1			/* seconds between USSD thread runs without wakeup */
+#define USSDQ_HOLD			2			/* seconds answer from cache wait for ussdq_release() */
+
+struct ussdq_stat
+{
+	uint64_t		requests;			/*!< requests and steps of sessions */
+	uint64_t		answers;			/*!< +CUSD received */
+	uint64_t		cached;				/*!< requests answered from cache */
+	uint64_t		failed;				/*!< requests not sent */
+	uint64_t		timeouts;			/*!< sessions closed without answer or next step */
+	unsigned		fanouts;			/*!< fan-outs in progress */
+	unsigned		cache_entries;			/*!< answers in cache */
+};
+
+struct pvt;
+
+EXPORT_DECL int ussdq_init();
+EXPORT_DECL void ussdq_stop();
+EXPORT_DECL void ussdq_fini();
+
+EXPORT_DECL int ussdq_send(struct pvt * pvt, const char * code, uint64_t session, uint64_t * id);
+EXPORT_DECL void ussdq_release(uint64_t id);
+EXPORT_DECL int ussdq_fanout(int group, const char * code, unsigned limit, uint64_t * id);
+EXPORT_DECL uint64_t ussdq_sent(struct pvt * pvt, const void * task, int sent);
+EXPORT_DECL uint64_t ussdq_answer(struct pvt * pvt, int type, const char * text, size_t length);
+EXPORT_DECL void ussdq_device_expire(struct pvt * pvt);
+EXPORT_DECL void ussdq_device_reset(struct pvt * pvt);
+
+EXPORT_DECL void ussdq_stat_read(struct ussdq_stat * stat);
+EXPORT_DECL void ussdq_fanouts_read(void (*callback)(void * arg, uint64_t id, int group, unsigned count, unsigned finished, unsigned inflight), void * arg);
+
+#endif /* CHAN_DONGLE_USSDQ_H_INCLUDED */
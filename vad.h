@@ -0,0 +1,72 @@
+/*
+   Copyright (C) 2010 bg <bg_one@mail.ru>
+*/
+#ifndef CHAN_DONGLE_VAD_H_INCLUDED
+#define CHAN_DONGLE_VAD_H_INCLUDED
+
+#include <sys/types.h>			/* size_t */
+#include <endian.h>			/* __BYTE_ORDER __BIG_ENDIAN */
+
+#include "export.h"			/* INLINE_DECL */
+
+/*
+   Energy based voice activity detection of incoming audio.
+
+   Level of frame is mean absolute sample value. Speech start when level
+   reach threshold, continue while level stay above half of threshold and
+   for hangover frames after it drop, rest is silence.
+*/
+
+/* load sample in device (little endian) byte order */
+#if __BYTE_ORDER == __BIG_ENDIAN
+#define VAD_SAMPLE_LOAD(ptr)	((short)((((unsigned short)*(ptr)) << 8) | (((unsigned short)*(ptr)) >> 8)))
+#else
+#define VAD_SAMPLE_LOAD(ptr)	(*(ptr))
+#endif
+
+#/* return mean absolute sample value of frame in device byte order */
+INLINE_DECL unsigned vad_energy(const short * sample, size_t samples)
+{
+	const short * end = sample + samples;
+	unsigned sum = 0;
+	int value;
+
+	if(samples == 0)
+		return 0;
+
+	for(; sample < end; ++sample)
+	{
+		value = VAD_SAMPLE_LOAD(sample);
+		sum += value < 0 ? -value : value;
+	}
+	return sum / samples;
+}
+
+#/* update hangover state by level of frame, return non-zero for silence */
+INLINE_DECL int vad_silent(unsigned * hangover, unsigned energy, unsigned threshold, unsigned frames)
+{
+	if(energy >= threshold || (*hangover && energy >= threshold / 2))
+	{
+		*hangover = frames + 1;
+		return 0;
+	}
+	if(*hangover)
+	{
+		(*hangover)--;
+		if(*hangover)
+			return 0;
+	}
+	return 1;
+}
+
+#/* convert level to approximate noise level in -dBov for CNG frame */
+INLINE_DECL int vad_energy2dbov(unsigned energy)
+{
+	int level = 90;
+
+	for(; energy; energy >>= 1)
+		level -= 6;
+	return level < 0 ? 0 : level;
+}
+
+#endif /* CHAN_DONGLE_VAD_H_INCLUDED */